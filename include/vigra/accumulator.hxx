@@ -61,6 +61,8 @@
 #include "multi_labeling.hxx"
 #include <algorithm>
 #include <iostream>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace vigra {
 
@@ -82,6 +84,7 @@ The function \ref acc::extractFeatures() "extractFeatures()" scans the data in a
     - FlatScatterMatrix (flattened upper-triangular part of scatter matrix)
     - 4 histogram classes (see \ref histogram "below")
     - StandardQuantiles (0%, 10%, 25%, 50%, 75%, 90%, 100%)
+    - TDigest (mergeable single-pass quantile sketch, see \ref histogram "below")
     - ArgMinWeight, ArgMaxWeight (store data or coordinate where weight assumes its minimal or maximal value)
     - CoordinateSystem (identity matrix of appropriate size)
 
@@ -235,6 +238,8 @@ Pixel coordinates are always at index 0. To collect statistics, you simply pass
     std::cout << get<Mean>(a, regionlabel) << std::endl; //get Mean of region with label 'regionlabel'
     \endcode
 
+    When only the basic region statistics <tt>Count</tt>, <tt>Sum</tt>, <tt>SumOfSquares</tt>, <tt>Minimum</tt>, <tt>Maximum</tt>, and <tt>Coord<Sum></tt> are needed, \ref acc::SoARegionStatistics in <tt>\<vigra/accumulator_soa.hxx\></tt> computes them considerably faster by storing one array per statistic instead of one accumulator chain per region.
+
 
     In some application it will be known only at run-time which statistics have to be computed. An Accumulator with <b>run-time activation</b> is provided by the \ref acc::DynamicAccumulatorChain class. One specifies a set of statistics at compile-time and from this set one can activate the needed statistics at run-time:
 
@@ -277,6 +282,12 @@ Pixel coordinates are always at index 0. To collect statistics, you simply pass
     extractFeatures(data.begin()+data.size()/2, data.end(), a);   // all statistics only need pass 1
     \endcode
 
+    A multi-threaded version of extractFeatures() is provided in <tt>\<vigra/accumulator_parallel.hxx\></tt>. It takes an additional <tt>ParallelOptions</tt> argument, uses one accumulator chain per thread and merges the results pass by pass (see <tt>mergePassN()</tt>), so that multi-pass statistics are computed from the global results of the previous passes:
+
+    \code
+    extractFeatures(data.begin(), data.end(), a, ParallelOptions().numThreads(4));
+    \endcode
+
     More care is needed to merge coordinate-based statistics. By default, all coordinate statistics are computed in the local coordinate system of the current region of interest. That is, the upper left corner of the ROI has the coordinate (0, 0) by default. This behavior is not desirable when you want to merge coordinate statistics from different ROIs: then, all accumulators should use the same coordinate system, usually the global system of the entire dataset. This can be achieved by the <tt>setCoordinateOffset()</tt> function. The following code demonstrates this for the <tt>RegionCenter</tt> statistic:
 
     \code
@@ -340,6 +351,16 @@ Pixel coordinates are always at index 0. To collect statistics, you simply pass
 
     With the StandardQuantiles class, <b>histogram quantiles</b> (0%, 10%, 25%, 50%, 75%, 90%, 100%) are computed from a given histgram using linear interpolation. The return type is TinyVector<double, 7> .
 
+    Since the range of AutoRangeHistogram and GlobalRangeHistogram is only known after a first pass, quantiles based on these histograms require two passes over the data. The TDigest accumulator computes a mergeable quantile sketch (see \ref vigra::QuantileSketch) in a single pass instead. It can be used in place of the histogram in StandardQuantiles, and arbitrary quantiles can be obtained from the sketch itself:
+
+    \code
+    AccumulatorChainArray<CoupledArrays<3, float, UInt32>,
+                          Select<DataArg<1>, LabelArg<2>, StandardQuantiles<TDigest<100> >, Global<TDigest<100> > > > a;
+    extractFeatures(data, labels, a);   // single pass
+    TinyVector<double, 7> quantiles = get<StandardQuantiles<TDigest<100> > >(a, regionLabel);
+    double globalPercentile99 = get<Global<TDigest<100> > >(a).quantile(0.99);
+    \endcode
+
     \anchor acc_hist_options Usage:
     \code
     using namespace vigra::acc;
@@ -924,10 +945,17 @@ struct AccumulatorEndImpl
     void mergeImpl(U const &)
     {}
 
+    template <unsigned, class U>
+    void mergePassImpl(U const &)
+    {}
+
     template <class U>
     void resize(U const &)
     {}
 
+    void flushImpl()
+    {}
+
     template <class U>
     void setCoordinateOffsetImpl(U const &)
     {}
@@ -967,6 +995,16 @@ struct AccumulatorEndImpl
         return 0;
     }
 
+    static bool allMergeable()
+    {
+        return true;
+    }
+
+    static bool allMergeable(AccumulatorFlags const &)
+    {
+        return true;
+    }
+
     void reset()
     {
         active_accumulators_.clear();
@@ -1003,6 +1041,9 @@ struct DecoratorImpl
     template <class T>
     static void exec(A &, T const &, double)
     {}
+
+    static void mergeImpl(A &, A const &)
+    {}
 };
 
 template <class A, unsigned CurrentPass>
@@ -1036,6 +1077,11 @@ struct DecoratorImpl<A, CurrentPass, false, CurrentPass>
         a.reshape(t);
     }
 
+    static void flush(A & a)
+    {
+        a.flush();
+    }
+
     static void applyHistogramOptions(A & a, HistogramOptions const & options)
     {
         ApplyHistogramOptions<typename A::Tag>::exec(a, options);
@@ -1046,6 +1092,11 @@ struct DecoratorImpl<A, CurrentPass, false, CurrentPass>
         static const unsigned int A_workInPass = A::workInPass;
         return std::max(A_workInPass, A::InternalBaseType::passesRequired());
     }
+
+    static bool allMergeable()
+    {
+        return A::mergeable && A::InternalBaseType::allMergeable();
+    }
 };
 
 template <class A, unsigned CurrentPass>
@@ -1094,6 +1145,12 @@ struct DecoratorImpl<A, CurrentPass, true, CurrentPass>
             a.reshape(t);
     }
 
+    static void flush(A & a)
+    {
+        if(isActive(a))
+            a.flush();
+    }
+
     static void applyHistogramOptions(A & a, HistogramOptions const & options)
     {
         if(isActive(a))
@@ -1108,6 +1165,12 @@ struct DecoratorImpl<A, CurrentPass, true, CurrentPass>
                    ? std::max(A_workInPass, A::InternalBaseType::passesRequired(flags))
                    : A::InternalBaseType::passesRequired(flags);
     }
+
+    template <class ActiveFlags>
+    static bool allMergeable(ActiveFlags const & flags)
+    {
+        return (A::mergeable || !A::isActiveImpl(flags)) && A::InternalBaseType::allMergeable(flags);
+    }
 };
 
     // Generic reshape function (expands to a no-op when T has fixed shape, and to
@@ -1210,6 +1273,7 @@ VIGRA_SHAPE_OF(long double)
     //  * hold an array of accumulator chains (one per region) for region statistics
     //  * forward data to the appropriate chains
     //  * allocate the region array with appropriate size
+    //    (or, in sparse mode, only for the labels actually encountered)
     //  * store and forward activation requests
     //  * compute required number of passes as maximum from global and region accumulators
 template <class T, class GlobalAccumulators, class RegionAccumulators>
@@ -1220,6 +1284,7 @@ struct LabelDispatch
     typedef RegionAccumulators RegionAccumulatorChain;
     typedef typename LookupTag<AccumulatorEnd, RegionAccumulatorChain>::type::AccumulatorFlags ActiveFlagsType;
     typedef ArrayVector<RegionAccumulatorChain> RegionAccumulatorArray;
+    typedef std::unordered_map<MultiArrayIndex, unsigned int> RegionSlotMap;
 
     typedef LabelDispatch type;
     typedef LabelDispatch & reference;
@@ -1256,6 +1321,15 @@ struct LabelDispatch
     ActiveFlagsType active_region_accumulators_;
     CoordinateType coordinateOffset_;
 
+        // sparse mode: regions_[0] is an empty region that represents all labels
+        // not encountered so far, the other regions are allocated on demand
+    bool sparse_;
+    ArrayVector<MultiArrayIndex> region_labels_;  // label of each entry in regions_
+    RegionSlotMap region_slots_;                  // index in regions_ of each label
+    MultiArrayIndex max_label_;
+    MultiArrayIndex last_label_;                  // cache for the last lookup
+    unsigned int last_slot_;
+
     template <class TAG>
     struct ActivateImpl
     {
@@ -1307,7 +1381,11 @@ struct LabelDispatch
       regions_(),
       region_histogram_options_(),
       ignore_label_(-1),
-      active_region_accumulators_()
+      active_region_accumulators_(),
+      sparse_(false),
+      max_label_(-1),
+      last_label_(-1),
+      last_slot_(0)
     {}
 
     LabelDispatch(LabelDispatch const & o)
@@ -1315,7 +1393,14 @@ struct LabelDispatch
       regions_(o.regions_),
       region_histogram_options_(o.region_histogram_options_),
       ignore_label_(o.ignore_label_),
-      active_region_accumulators_(o.active_region_accumulators_)
+      active_region_accumulators_(o.active_region_accumulators_),
+      coordinateOffset_(o.coordinateOffset_),
+      sparse_(o.sparse_),
+      region_labels_(o.region_labels_),
+      region_slots_(o.region_slots_),
+      max_label_(o.max_label_),
+      last_label_(o.last_label_),
+      last_slot_(o.last_slot_)
     {
         for(unsigned int k=0; k<regions_.size(); ++k)
         {
@@ -1325,22 +1410,141 @@ struct LabelDispatch
 
     MultiArrayIndex maxRegionLabel() const
     {
-        return (MultiArrayIndex)regions_.size() - 1;
+        return sparse_
+                   ? max_label_
+                   : (MultiArrayIndex)regions_.size() - 1;
     }
 
     void setMaxRegionLabel(unsigned maxlabel)
     {
+        if(sparse_)
+        {
+            max_label_ = maxlabel;
+            return;
+        }
         if(maxRegionLabel() == (MultiArrayIndex)maxlabel)
             return;
         unsigned int oldSize = regions_.size();
         regions_.resize(maxlabel + 1);
         for(unsigned int k=oldSize; k<regions_.size(); ++k)
+            initRegion(k);
+    }
+
+    void initRegion(unsigned int k)
+    {
+        getAccumulator<AccumulatorEnd>(regions_[k]).setGlobalAccumulator(&next_);
+        getAccumulator<AccumulatorEnd>(regions_[k]).active_accumulators_ = active_region_accumulators_;
+        regions_[k].applyHistogramOptions(region_histogram_options_);
+        regions_[k].setCoordinateOffsetImpl(coordinateOffset_);
+    }
+
+    void setSparseRegionStorage(bool sparse)
+    {
+        if(sparse == sparse_)
+            return;
+        vigra_precondition(regions_.size() <= (sparse_ ? 1u : 0u),
+            "AccumulatorChainArray::setSparseRegionStorage(): must be called before regions are allocated.");
+        sparse_ = sparse;
+        initSparseRegions();
+    }
+
+    void initSparseRegions()
+    {
+        RegionAccumulatorArray().swap(regions_);
+        region_labels_.clear();
+        region_slots_.clear();
+        max_label_ = -1;
+        last_label_ = -1;
+        last_slot_ = 0;
+        if(sparse_)
         {
-            getAccumulator<AccumulatorEnd>(regions_[k]).setGlobalAccumulator(&next_);
-            getAccumulator<AccumulatorEnd>(regions_[k]).active_accumulators_ = active_region_accumulators_;
-            regions_[k].applyHistogramOptions(region_histogram_options_);
-            regions_[k].setCoordinateOffsetImpl(coordinateOffset_);
+            regions_.resize(1);
+            initRegion(0);
+            region_labels_.push_back(-1);
+        }
+    }
+
+        // index of the region with the given label in regions_ (in sparse mode,
+        // labels not encountered so far are mapped to the empty region 0)
+    unsigned int regionSlot(MultiArrayIndex label) const
+    {
+        if(!sparse_)
+            return label;
+        typename RegionSlotMap::const_iterator i = region_slots_.find(label);
+        return i == region_slots_.end()
+                   ? 0
+                   : i->second;
+    }
+
+        // like regionSlot(), but the region is created if it doesn't exist yet
+    unsigned int regionSlotForUpdate(MultiArrayIndex label)
+    {
+        if(!sparse_)
+        {
+            if(label > maxRegionLabel())
+                setMaxRegionLabel(label);
+            return label;
+        }
+        if(label == last_label_)
+            return last_slot_;
+        typename RegionSlotMap::const_iterator i = region_slots_.find(label);
+        unsigned int slot;
+        if(i == region_slots_.end())
+        {
+            slot = regions_.size();
+            regions_.resize(slot + 1);
+            initRegion(slot);
+            region_labels_.push_back(label);
+            region_slots_[label] = slot;
+            max_label_ = std::max(max_label_, label);
+        }
+        else
+        {
+            slot = i->second;
         }
+        last_label_ = label;
+        last_slot_  = slot;
+        return slot;
+    }
+
+        // label of regions_[k], -1 for the empty region in sparse mode
+    MultiArrayIndex slotLabel(unsigned int k) const
+    {
+        return sparse_
+                   ? region_labels_[k]
+                   : (MultiArrayIndex)k;
+    }
+
+        // index of the region in regions_ that receives a region with the given label
+        // in a merge (-1 if there is none, i.e. the region is the empty region of a
+        // sparse chain and this chain is dense)
+    MultiArrayIndex mergeSlot(MultiArrayIndex label)
+    {
+        if(label < 0)
+            return sparse_ ? 0 : -1;
+        return regionSlotForUpdate(label);
+    }
+
+    ArrayVector<MultiArrayIndex> mergeTargets(LabelDispatch const & o)
+    {
+        unsigned int size = o.regions_.size();
+        ArrayVector<MultiArrayIndex> targets(size);
+        for(unsigned int k=0; k<size; ++k)
+            targets[k] = mergeSlot(o.slotLabel(k));
+        return targets;
+    }
+
+    template <class ArrayLike>
+    ArrayVector<MultiArrayIndex> mergeTargets(LabelDispatch const & o, ArrayLike const & labelMapping)
+    {
+        unsigned int size = o.regions_.size();
+        ArrayVector<MultiArrayIndex> targets(size);
+        for(unsigned int k=0; k<size; ++k)
+        {
+            MultiArrayIndex label = o.slotLabel(k);
+            targets[k] = mergeSlot(label < 0 ? label : (MultiArrayIndex)labelMapping[label]);
+        }
+        return targets;
     }
 
     void ignoreLabel(MultiArrayIndex l)
@@ -1381,15 +1585,15 @@ struct LabelDispatch
 
     void setCoordinateOffsetImpl(MultiArrayIndex k, CoordinateType const & offset)
     {
-        vigra_precondition(0 <= k && k < (MultiArrayIndex)regions_.size(),
+        vigra_precondition(0 <= k && k <= maxRegionLabel() && (!sparse_ || regionSlot(k) != 0),
              "Accumulator::setCoordinateOffset(k, offset): region k does not exist.");
-        regions_[k].setCoordinateOffsetImpl(offset);
+        regions_[regionSlot(k)].setCoordinateOffsetImpl(offset);
     }
 
     template <class U>
     void resize(U const & t)
     {
-        if(regions_.size() == 0)
+        if(regions_.size() == 0 || (sparse_ && regions_.size() == 1))
         {
             typedef HandleArgSelector<U, LabelArgTag, GlobalAccumulatorChain> LabelHandle;
             typedef typename LabelHandle::value_type LabelType;
@@ -1397,9 +1601,30 @@ struct LabelDispatch
             LabelArray labelArray(t.shape(), LabelHandle::getHandle(t).strides(),
                                   const_cast<LabelType *>(LabelHandle::getHandle(t).ptr()));
 
-            LabelType minimum, maximum;
-            labelArray.minmax(&minimum, &maximum);
-            setMaxRegionLabel(maximum);
+            if(sparse_)
+            {
+                // allocate regions for the labels that actually occur, in ascending order
+                std::unordered_set<MultiArrayIndex> found;
+                MultiArrayIndex last = ignore_label_;
+                for(typename LabelArray::iterator i = labelArray.begin(); i != labelArray.end(); ++i)
+                {
+                    if((MultiArrayIndex)*i == last)
+                        continue;
+                    last = *i;
+                    if(last != ignore_label_)
+                        found.insert(last);
+                }
+                ArrayVector<MultiArrayIndex> labels(found.begin(), found.end());
+                std::sort(labels.begin(), labels.end());
+                for(unsigned int k=0; k<labels.size(); ++k)
+                    regionSlotForUpdate(labels[k]);
+            }
+            else
+            {
+                LabelType minimum, maximum;
+                labelArray.minmax(&minimum, &maximum);
+                setMaxRegionLabel(maximum);
+            }
         }
         next_.resize(t);
         // FIXME: only call resize when label k actually exists?
@@ -1407,6 +1632,13 @@ struct LabelDispatch
             regions_[k].resize(t);
     }
 
+    void flushImpl()
+    {
+        next_.flushImpl();
+        for(unsigned int k=0; k<regions_.size(); ++k)
+            regions_[k].flushImpl();
+    }
+
     template <unsigned N>
     void pass(T const & t)
     {
@@ -1414,7 +1646,10 @@ struct LabelDispatch
         if(LabelHandle::getValue(t) != ignore_label_)
         {
             next_.template pass<N>(t);
-            regions_[LabelHandle::getValue(t)].template pass<N>(t);
+            if(sparse_)
+                sparseRegion(t).template pass<N>(t);
+            else
+                regions_[LabelHandle::getValue(t)].template pass<N>(t);
         }
     }
 
@@ -1425,10 +1660,24 @@ struct LabelDispatch
         if(LabelHandle::getValue(t) != ignore_label_)
         {
             next_.template pass<N>(t, weight);
-            regions_[LabelHandle::getValue(t)].template pass<N>(t, weight);
+            if(sparse_)
+                sparseRegion(t).template pass<N>(t, weight);
+            else
+                regions_[LabelHandle::getValue(t)].template pass<N>(t, weight);
         }
     }
 
+        // region of the current sample in sparse mode (created if necessary)
+    RegionAccumulatorChain & sparseRegion(T const & t)
+    {
+        typedef HandleArgSelector<T, LabelArgTag, GlobalAccumulatorChain> LabelHandle;
+        unsigned int size = regions_.size();
+        unsigned int slot = regionSlotForUpdate(LabelHandle::getValue(t));
+        if(regions_.size() > size)
+            regions_[slot].resize(t);
+        return regions_[slot];
+    }
+
     static unsigned int passesRequired()
     {
         return std::max(GlobalAccumulatorChain::passesRequired(), RegionAccumulatorChain::passesRequired());
@@ -1440,12 +1689,23 @@ struct LabelDispatch
                         RegionAccumulatorChain::passesRequired(active_region_accumulators_));
     }
 
+    static bool allMergeable()
+    {
+        return GlobalAccumulatorChain::allMergeable() && RegionAccumulatorChain::allMergeable();
+    }
+
+    bool allMergeableDynamic() const
+    {
+        return GlobalAccumulatorChain::allMergeable(getAccumulator<AccumulatorEnd>(next_).active_accumulators_) &&
+               RegionAccumulatorChain::allMergeable(active_region_accumulators_);
+    }
+
     void reset()
     {
         next_.reset();
 
         active_region_accumulators_.clear();
-        RegionAccumulatorArray().swap(regions_);
+        initSparseRegions();
         // FIXME: or is it better to just reset the region accumulators?
         // for(unsigned int k=0; k<regions_.size(); ++k)
             // regions_[k].reset();
@@ -1473,27 +1733,119 @@ struct LabelDispatch
 
     void mergeImpl(LabelDispatch const & o)
     {
-        for(unsigned int k=0; k<regions_.size(); ++k)
-            regions_[k].mergeImpl(o.regions_[k]);
+        if(sparse_ || o.sparse_)
+        {
+            ArrayVector<MultiArrayIndex> targets(mergeTargets(o));
+            for(unsigned int k=0; k<targets.size(); ++k)
+                if(targets[k] >= 0)
+                    regions_[targets[k]].mergeImpl(o.regions_[k]);
+        }
+        else
+        {
+            for(unsigned int k=0; k<regions_.size(); ++k)
+                regions_[k].mergeImpl(o.regions_[k]);
+        }
         next_.mergeImpl(o.next_);
     }
 
+    template <unsigned N>
+    void mergePassImpl(LabelDispatch const & o)
+    {
+        if(sparse_ || o.sparse_)
+        {
+            ArrayVector<MultiArrayIndex> targets(mergeTargets(o));
+            for(unsigned int k=0; k<targets.size(); ++k)
+                if(targets[k] >= 0)
+                    regions_[targets[k]].template mergePassImpl<N>(o.regions_[k]);
+        }
+        else
+        {
+            for(unsigned int k=0; k<regions_.size(); ++k)
+                regions_[k].template mergePassImpl<N>(o.regions_[k]);
+        }
+        next_.template mergePassImpl<N>(o.next_);
+    }
+
     void mergeImpl(unsigned i, unsigned j)
     {
-        regions_[i].mergeImpl(regions_[j]);
-        regions_[j].reset();
-        getAccumulator<AccumulatorEnd>(regions_[j]).active_accumulators_ = active_region_accumulators_;
+        unsigned int sj = regionSlot(j);
+        if(sparse_ && sj == 0)
+            return; // region j is empty
+        unsigned int si = regionSlotForUpdate(i);
+        regions_[si].mergeImpl(regions_[sj]);
+        regions_[sj].reset();
+        getAccumulator<AccumulatorEnd>(regions_[sj]).active_accumulators_ = active_region_accumulators_;
     }
 
     template <class ArrayLike>
     void mergeImpl(LabelDispatch const & o, ArrayLike const & labelMapping)
     {
-        MultiArrayIndex newMaxLabel = std::max<MultiArrayIndex>(maxRegionLabel(), *argMax(labelMapping.begin(), labelMapping.end()));
-        setMaxRegionLabel(newMaxLabel);
-        for(unsigned int k=0; k<labelMapping.size(); ++k)
-            regions_[labelMapping[k]].mergeImpl(o.regions_[k]);
+        if(sparse_ || o.sparse_)
+        {
+            ArrayVector<MultiArrayIndex> targets(mergeTargets(o, labelMapping));
+            for(unsigned int k=0; k<targets.size(); ++k)
+                if(targets[k] >= 0)
+                    regions_[targets[k]].mergeImpl(o.regions_[k]);
+        }
+        else
+        {
+            MultiArrayIndex newMaxLabel = std::max<MultiArrayIndex>(maxRegionLabel(), *argMax(labelMapping.begin(), labelMapping.end()));
+            setMaxRegionLabel(newMaxLabel);
+            for(unsigned int k=0; k<labelMapping.size(); ++k)
+                regions_[labelMapping[k]].mergeImpl(o.regions_[k]);
+        }
         next_.mergeImpl(o.next_);
     }
+
+    template <unsigned N, class ArrayLike>
+    void mergePassImpl(LabelDispatch const & o, ArrayLike const & labelMapping)
+    {
+        if(sparse_ || o.sparse_)
+        {
+            ArrayVector<MultiArrayIndex> targets(mergeTargets(o, labelMapping));
+            for(unsigned int k=0; k<targets.size(); ++k)
+                if(targets[k] >= 0)
+                    regions_[targets[k]].template mergePassImpl<N>(o.regions_[k]);
+        }
+        else
+        {
+            MultiArrayIndex newMaxLabel = std::max<MultiArrayIndex>(maxRegionLabel(), *argMax(labelMapping.begin(), labelMapping.end()));
+            setMaxRegionLabel(newMaxLabel);
+            for(unsigned int k=0; k<labelMapping.size(); ++k)
+                regions_[labelMapping[k]].template mergePassImpl<N>(o.regions_[k]);
+        }
+        next_.template mergePassImpl<N>(o.next_);
+    }
+
+    template <class ArrayLike>
+    void assignRegionsImpl(LabelDispatch const & o, ArrayLike const & labels)
+    {
+        next_ = o.next_;
+        if(!sparse_)
+            setMaxRegionLabel(labels.size() - 1);
+        for(unsigned int k=0; k<labels.size(); ++k)
+        {
+            unsigned int slot = regionSlotForUpdate(k);
+            regions_[slot] = o.regions_[o.regionSlot(labels[k])];
+            getAccumulator<AccumulatorEnd>(regions_[slot]).setGlobalAccumulator(&next_);
+        }
+    }
+
+    template <class ArrayLike>
+    void replaceRegionsImpl(LabelDispatch const & o, ArrayLike const & labelMapping)
+    {
+        if(!sparse_)
+        {
+            MultiArrayIndex newMaxLabel = std::max<MultiArrayIndex>(maxRegionLabel(), *argMax(labelMapping.begin(), labelMapping.end()));
+            setMaxRegionLabel(newMaxLabel);
+        }
+        for(unsigned int k=0; k<labelMapping.size(); ++k)
+        {
+            unsigned int slot = regionSlotForUpdate(labelMapping[k]);
+            regions_[slot] = o.regions_[o.regionSlot(k)];
+            getAccumulator<AccumulatorEnd>(regions_[slot]).setGlobalAccumulator(&next_);
+        }
+    }
 };
 
 template <class TargetTag, class TagList>
@@ -1565,6 +1917,7 @@ struct AccumulatorFactory
 
         static const unsigned int            workInPass = 1;
         static const int                     index = InternalBaseType::index + 1;
+        static const bool                    mergeable = true;  // operator+=() is supported
 
         InternalBaseType next_;
 
@@ -1639,6 +1992,9 @@ struct AccumulatorFactory
         void reshape(Shape const &)
         {}
 
+        void flush()
+        {}
+
         void operator+=(AccumulatorBase const &)
         {}
 
@@ -1683,6 +2039,12 @@ struct AccumulatorFactory
             DecoratorImpl<Accumulator, workInPass, allowRuntimeActivation>::resize(*this, t);
         }
 
+        void flushImpl()
+        {
+            this->next_.flushImpl();
+            DecoratorImpl<Accumulator, workInPass, allowRuntimeActivation>::flush(*this);
+        }
+
         void reset()
         {
             this->next_.reset();
@@ -1714,6 +2076,13 @@ struct AccumulatorFactory
             this->next_.mergeImpl(o.next_);
         }
 
+        template <unsigned N>
+        void mergePassImpl(Accumulator const & o)
+        {
+            DecoratorImpl<Accumulator, N, allowRuntimeActivation>::mergeImpl(*this, o);
+            this->next_.template mergePassImpl<N>(o.next_);
+        }
+
         void applyHistogramOptions(HistogramOptions const & options)
         {
             DecoratorImpl<Accumulator, workInPass, allowRuntimeActivation>::applyHistogramOptions(*this, options);
@@ -1737,6 +2106,17 @@ struct AccumulatorFactory
         {
             return DecoratorImpl<Accumulator, workInPass, allowRuntimeActivation>::passesRequired(flags);
         }
+
+        static bool allMergeable()
+        {
+            return DecoratorImpl<Accumulator, workInPass, allowRuntimeActivation>::allMergeable();
+        }
+
+        template <class ActiveFlags>
+        static bool allMergeable(ActiveFlags const & flags)
+        {
+            return DecoratorImpl<Accumulator, workInPass, allowRuntimeActivation>::allMergeable(flags);
+        }
     };
 
     typedef Accumulator type;
@@ -1890,6 +2270,8 @@ class AccumulatorChainImpl
         }
         else if(current_pass_ < N)
         {
+            if(current_pass_ > 0)
+                next_.flushImpl();
             current_pass_ = N;
             if(N == 1)
                 next_.resize(acc_detail::shapeOf(t));
@@ -1912,6 +2294,8 @@ class AccumulatorChainImpl
         }
         else if(current_pass_ < N)
         {
+            if(current_pass_ > 0)
+                next_.flushImpl();
             current_pass_ = N;
             if(N == 1)
                 next_.resize(acc_detail::shapeOf(t));
@@ -1939,6 +2323,30 @@ class AccumulatorChainImpl
         next_.mergeImpl(o.next_);
     }
 
+    /** Merge only those statistics of accumulator chain 'o' that work in pass N. Statistics of other passes remain unchanged. This is useful when several chains have computed pass N on different parts of the data, starting from identical results of the previous passes (see the parallel version of extractFeatures()). Requirement: 0 < N < 6.
+    */
+    void mergePassN(AccumulatorChainImpl const & o, unsigned int N)
+    {
+        switch (N)
+        {
+            case 1: next_.template mergePassImpl<1>(o.next_); break;
+            case 2: next_.template mergePassImpl<2>(o.next_); break;
+            case 3: next_.template mergePassImpl<3>(o.next_); break;
+            case 4: next_.template mergePassImpl<4>(o.next_); break;
+            case 5: next_.template mergePassImpl<5>(o.next_); break;
+            default:
+                vigra_precondition(false,
+                     "AccumulatorChain::mergePassN(): 0 < N < 6 required.");
+        }
+    }
+
+    /** Add the samples that some statistics buffer for efficiency (FlatScatterMatrix for Multiband data, TDigest) to their results. This happens automatically when the chain proceeds to the next pass, when it is merged, and at the end of extractFeatures(). After calling update() directly, flush() makes subsequent get<>() calls cheaper, because they otherwise add pending samples to a temporary copy of the result.
+    */
+    void flush()
+    {
+        next_.flushImpl();
+    }
+
     result_type operator()() const
     {
         return next_.get();
@@ -2004,6 +2412,14 @@ class AccumulatorChainImpl
     {
         return InternalBaseType::passesRequired();
     }
+
+    /** Return true if all statistics in the accumulator chain support merge().
+        This is determined at compile time.
+    */
+    bool isMergeable() const
+    {
+        return InternalBaseType::allMergeable();
+    }
 };
 
 
@@ -2093,6 +2509,10 @@ class AccumulatorChain
    */
   void merge(AccumulatorChainImpl const & o);
 
+  /** Add the samples that some statistics buffer for efficiency to their results. This happens automatically when the chain proceeds to the next pass, when it is merged, and at the end of extractFeatures().
+   */
+  void flush();
+
   /** Upate all accumulators in the accumulator chain that work in pass N with data t. Requirement: 0 < N < 6 and N >= current_pass_ . If N < current_pass_ call reset first.
    */
   void updatePassN(T const & t, unsigned int N);
@@ -2219,6 +2639,13 @@ class DynamicAccumulatorChain
         return InternalBaseType::passesRequired(getAccumulator<AccumulatorEnd>(*this).active_accumulators_);
     }
 
+    /** Return true if all active statistics in the accumulator chain support merge().
+    */
+    bool isMergeable() const
+    {
+        return InternalBaseType::allMergeable(getAccumulator<AccumulatorEnd>(*this).active_accumulators_);
+    }
+
   protected:
 
     bool activateImpl(std::string tag)
@@ -2402,6 +2829,32 @@ class AccumulatorChainArray
         return this->next_.ignoredLabel();
     }
 
+    /** Allocate region accumulators only for the labels that actually occur (default: false).
+
+        By default, one accumulator chain is allocated for every label between 0 and maxRegionLabel().
+        When only a small fraction of these labels is present (e.g. in a crop of a supervoxel volume),
+        sparse region storage saves memory and improves the cache locality of the region updates.
+        The region chains are then allocated in ascending label order when the label array is first
+        seen (or when a new label is encountered during update or merging), and labels are mapped
+        to their chains by a hash table. Access via <tt>get<TAG>(a, label)</tt> is unchanged: labels
+        without data refer to an empty region. Consequently, region-specific options (e.g.
+        <tt>getAccumulator<TAG>(a, label).setMinMax(...)</tt>) can only be set for labels that
+        already have a chain, and <tt>setMaxRegionLabel()</tt> doesn't allocate anything in sparse mode.
+
+        This function must be called before any regions are allocated.
+    */
+    void setSparseRegionStorage(bool sparse = true)
+    {
+        this->next_.setSparseRegionStorage(sparse);
+    }
+
+    /** Check if sparse region storage is enabled (see setSparseRegionStorage()).
+    */
+    bool hasSparseRegionStorage() const
+    {
+        return this->next_.sparse_;
+    }
+
     /** Set the maximum region label (e.g. for merging two accumulator chains).
     */
     void setMaxRegionLabel(unsigned label)
@@ -2420,7 +2873,7 @@ class AccumulatorChainArray
     */
     unsigned int regionCount() const
     {
-        return this->next_.regions_.size();
+        return maxRegionLabel() + 1;
     }
 
     /** Equivalent to <tt>merge(o)</tt>.
@@ -2445,7 +2898,7 @@ class AccumulatorChainArray
     {
         if(maxRegionLabel() == -1)
             setMaxRegionLabel(o.maxRegionLabel());
-        vigra_precondition(maxRegionLabel() == o.maxRegionLabel(),
+        vigra_precondition(hasSparseRegionStorage() || maxRegionLabel() == o.maxRegionLabel(),
             "AccumulatorChainArray::merge(): maxRegionLabel must be equal.");
         this->next_.mergeImpl(o.next_);
     }
@@ -2460,6 +2913,57 @@ class AccumulatorChainArray
         this->next_.mergeImpl(o.next_, labelMapping);
     }
 
+    /** Merge only those statistics of accumulator chain o that work in pass N (see <tt>AccumulatorChain::mergePassN()</tt>). maxRegionLabel() of the two accumulators must be equal.
+    */
+    void mergePassN(AccumulatorChainArray const & o, unsigned int N)
+    {
+        if(maxRegionLabel() == -1)
+            setMaxRegionLabel(o.maxRegionLabel());
+        vigra_precondition(hasSparseRegionStorage() || maxRegionLabel() == o.maxRegionLabel(),
+            "AccumulatorChainArray::mergePassN(): maxRegionLabel must be equal.");
+        base_type::mergePassN(o, N);
+    }
+
+    /** Merge only those statistics of accumulator chain o that work in pass N, using a mapping between labels of the two accumulators (see <tt>merge(o, labelMapping)</tt>).
+    */
+    template <class ArrayLike>
+    void mergePassN(AccumulatorChainArray const & o, ArrayLike const & labelMapping, unsigned int N)
+    {
+        vigra_precondition(labelMapping.size() == o.regionCount(),
+            "AccumulatorChainArray::mergePassN(): labelMapping.size() must match regionCount() of RHS.");
+        switch (N)
+        {
+            case 1: this->next_.template mergePassImpl<1>(o.next_, labelMapping); break;
+            case 2: this->next_.template mergePassImpl<2>(o.next_, labelMapping); break;
+            case 3: this->next_.template mergePassImpl<3>(o.next_, labelMapping); break;
+            case 4: this->next_.template mergePassImpl<4>(o.next_, labelMapping); break;
+            case 5: this->next_.template mergePassImpl<5>(o.next_, labelMapping); break;
+            default:
+                vigra_precondition(false,
+                     "AccumulatorChainArray::mergePassN(): 0 < N < 6 required.");
+        }
+    }
+
+    /** Replace the regions of this accumulator chain with copies of selected regions of accumulator chain o: region k becomes a copy of region labels[k] of o, and maxRegionLabel() becomes <tt>labels.size()-1</tt>. The global statistics are copied from o as well. This is the counterpart of <tt>merge(o, labelMapping)</tt>, e.g. for initializing a chain that processes a subset of the regions in a later pass with the results of the earlier passes.
+    */
+    template <class ArrayLike>
+    void assignRegions(AccumulatorChainArray const & o, ArrayLike const & labels)
+    {
+        vigra_precondition(labels.size() > 0,
+            "AccumulatorChainArray::assignRegions(): labels must not be empty.");
+        this->next_.assignRegionsImpl(o.next_, labels);
+    }
+
+    /** Replace selected regions of this accumulator chain with copies of the regions of accumulator chain o: region labelMapping[k] becomes a copy of region k of o. In contrast to <tt>merge(o, labelMapping)</tt>, the old contents of the target regions are discarded, and the global statistics remain unchanged. This is useful to update the statistics of a few regions after they have been recomputed separately (see \ref acc::IncrementalRegionFeatures).
+    */
+    template <class ArrayLike>
+    void replaceRegions(AccumulatorChainArray const & o, ArrayLike const & labelMapping)
+    {
+        vigra_precondition(labelMapping.size() > 0 && labelMapping.size() <= o.regionCount(),
+            "AccumulatorChainArray::replaceRegions(): labelMapping.size() must be in [1, o.regionCount()].");
+        this->next_.replaceRegionsImpl(o.next_, labelMapping);
+    }
+
     /** Return names of all tags in the accumulator chain (selected statistics and their dependencies).
     */
     static ArrayVector<std::string> const & tagNames()
@@ -2502,6 +3006,9 @@ class AccumulatorChainArray
   /** \copydoc vigra::acc::AccumulatorChain::operator+=() */
   void operator+=(AccumulatorChainImpl const & o);
 
+  /** \copydoc vigra::acc::AccumulatorChain::flush() */
+  void flush();
+
   /** \copydoc vigra::acc::AccumulatorChain::updatePassN(T const &,unsigned int) */
   void updatePassN(T const & t, unsigned int N);
 
@@ -2607,6 +3114,12 @@ class DynamicAccumulatorChainArray
         return this->next_.passesRequiredDynamic();
     }
 
+    /** \copydoc DynamicAccumulatorChain::isMergeable() */
+    bool isMergeable() const
+    {
+        return this->next_.allMergeableDynamic();
+    }
+
   protected:
 
     bool activateImpl(std::string tag)
@@ -2854,7 +3367,7 @@ struct CastImpl<Tag, LabelDispatchTag, reference>
     template <class A>
     static reference exec(A & a, MultiArrayIndex label)
     {
-        return CastImpl<Tag, typename A::RegionAccumulatorChain::Tag, reference>::exec(a.regions_[label]);
+        return CastImpl<Tag, typename A::RegionAccumulatorChain::Tag, reference>::exec(a.regions_[a.regionSlot(label)]);
     }
 };
 
@@ -3088,6 +3601,7 @@ void extractFeatures(ITERATOR start, ITERATOR end, ACCUMULATOR & a)
     for(unsigned int k=1; k <= a.passesRequired(); ++k)
         for(ITERATOR i=start; i < end; ++i)
             a.updatePassN(*i, k);
+    a.flush();
 }
 
 template <unsigned int N, class T1, class S1,
@@ -3643,6 +4157,7 @@ class Central
         typedef typename TargetTag::template Impl<typename AccumulatorResultTraits<U>::SumType, BASE> ImplType;
 
         static const unsigned int workInPass = 2;
+        static const bool mergeable = false;
 
         void operator+=(Impl const &)
         {
@@ -3795,6 +4310,7 @@ class Principal
         typedef typename TargetTag::template Impl<typename AccumulatorResultTraits<U>::SumType, BASE> ImplType;
 
         static const unsigned int workInPass = 2;
+        static const bool mergeable = false;
 
         void operator+=(Impl const &)
         {
@@ -4597,6 +5113,184 @@ void updateFlatScatterMatrix(double & sc, Sum const & s, double w)
     sc += w*s*s;
 }
 
+    // Sample buffer for FlatScatterMatrix. With a runtime number of bands (Multiband data),
+    // samples are collected in a preallocated buffer and added to the scatter matrix as a
+    // rank-k update, which avoids the per-sample difference to the running mean and
+    // allows the compiler to vectorize the inner loops. Fixed-size data are updated
+    // directly (the generic version below disables batching).
+template <class SumType>
+struct FlatScatterMatrixBatch
+{
+    template <class Shape>
+    void reshape(Shape const &)
+    {}
+
+    void reset()
+    {}
+
+    template <class U>
+    bool push(U const &, double)
+    {
+        return false;
+    }
+
+    bool full() const
+    {
+        return false;
+    }
+
+    unsigned int size() const
+    {
+        return 0;
+    }
+
+    template <class Scatter, class Mean>
+    void flush(Scatter &, Mean const &, double)
+    {}
+};
+
+template <class T, class Alloc>
+struct FlatScatterMatrixBatch<MultiArray<1, T, Alloc> >
+{
+    static const int capacity = 8;
+
+    ArrayVector<double> samples_, weights_, blockMean_;
+    int bands_, size_;
+
+    FlatScatterMatrixBatch()
+    : bands_(0),
+      size_(0)
+    {}
+
+    template <class Shape>
+    void reshape(Shape const & s)
+    {
+        bands_ = prod(s);
+        size_ = 0;
+        samples_.resize(capacity*bands_);
+        weights_.resize(capacity);
+        blockMean_.resize(bands_);
+    }
+
+    void reset()
+    {
+        size_ = 0;
+    }
+
+        // only samples with positive weight are buffered, the others take the
+        // per-sample update (the block update needs sqrt(weight) and a non-zero weight sum)
+    template <class U>
+    bool push(U const & t, double weight)
+    {
+        if(weight <= 0.0)
+            return false;
+        double * x = samples_.begin() + size_*bands_;
+        for(int i=0; i<bands_; ++i)
+            x[i] = t[i];
+        weights_[size_++] = weight;
+        return true;
+    }
+
+    bool full() const
+    {
+        return size_ == capacity;
+    }
+
+    unsigned int size() const
+    {
+        return size_;
+    }
+
+        // Add the scatter of the buffered samples around their mean to 'sc', plus the
+        // correction term for the difference between the block mean and the mean of
+        // the previous samples ('mean' and 'n' refer to all samples including the buffer).
+    template <class Scatter, class Mean>
+    void flush(Scatter & sc, Mean const & mean, double n)
+    {
+        if(size_ == 0)
+            return;
+
+        double w = 0.0;
+        for(int b=0; b<size_; ++b)
+            w += weights_[b];
+        if(w <= 0.0)
+        {
+            size_ = 0;
+            return;
+        }
+        std::fill(blockMean_.begin(), blockMean_.end(), 0.0);
+        for(int b=0; b<size_; ++b)
+        {
+            double const * x = samples_.begin() + b*bands_;
+            for(int i=0; i<bands_; ++i)
+                blockMean_[i] += weights_[b]*x[i];
+        }
+        for(int i=0; i<bands_; ++i)
+            blockMean_[i] /= w;
+        for(int b=0; b<size_; ++b)
+        {
+            double * x = samples_.begin() + b*bands_;
+            double sw = std::sqrt(weights_[b]);
+            for(int i=0; i<bands_; ++i)
+                x[i] = sw*(x[i] - blockMean_[i]);
+        }
+
+        // rank-k update, eight or four samples at a time
+        double * scatter = &sc[0];
+        int b = 0;
+        for(; b+8<=size_; b+=8)
+        {
+            double const * x0 = samples_.begin() + b*bands_;
+            double const * x1 = x0 + bands_;
+            double const * x2 = x1 + bands_;
+            double const * x3 = x2 + bands_;
+            double const * x4 = x3 + bands_;
+            double const * x5 = x4 + bands_;
+            double const * x6 = x5 + bands_;
+            double const * x7 = x6 + bands_;
+            for(int j=0, k=0; j<bands_; ++j)
+            {
+                double y0 = x0[j], y1 = x1[j], y2 = x2[j], y3 = x3[j],
+                       y4 = x4[j], y5 = x5[j], y6 = x6[j], y7 = x7[j];
+                for(int i=j; i<bands_; ++i, ++k)
+                    scatter[k] += y0*x0[i] + y1*x1[i] + y2*x2[i] + y3*x3[i] +
+                                  y4*x4[i] + y5*x5[i] + y6*x6[i] + y7*x7[i];
+            }
+        }
+        for(; b+4<=size_; b+=4)
+        {
+            double const * x0 = samples_.begin() + b*bands_;
+            double const * x1 = x0 + bands_;
+            double const * x2 = x1 + bands_;
+            double const * x3 = x2 + bands_;
+            for(int j=0, k=0; j<bands_; ++j)
+            {
+                double y0 = x0[j], y1 = x1[j], y2 = x2[j], y3 = x3[j];
+                for(int i=j; i<bands_; ++i, ++k)
+                    scatter[k] += y0*x0[i] + y1*x1[i] + y2*x2[i] + y3*x3[i];
+            }
+        }
+        for(; b<size_; ++b)
+        {
+            double const * x0 = samples_.begin() + b*bands_;
+            for(int j=0, k=0; j<bands_; ++j)
+            {
+                double y0 = x0[j];
+                for(int i=j; i<bands_; ++i, ++k)
+                    scatter[k] += y0*x0[i];
+            }
+        }
+
+        if(n > w)
+        {
+            for(int i=0; i<bands_; ++i)
+                blockMean_[i] = mean[i] - blockMean_[i];
+            updateFlatScatterMatrix(sc, blockMean_, w*n / (n - w));
+        }
+        size_ = 0;
+    }
+};
+
 template <class Cov, class Scatter>
 void flatScatterMatrixToScatterMatrix(Cov & cov, Scatter const & sc)
 {
@@ -4645,6 +5339,12 @@ void flatScatterMatrixToCovariance(double & cov, Scatter const & sc, double n)
 /** \brief Basic statistic. Flattened uppter-triangular part of scatter matrix.
 
     Works in pass 1, %operator+=() supported (merging supported).
+
+    For Multiband data, samples are buffered and added in blocks. Pending samples
+    are added at the end of each pass and when merging (see AccumulatorChain::flush()).
+    The result is returned by value: if samples are still pending (e.g. after calling
+    update() directly), they are added to a temporary copy, so that the accumulator
+    is never modified by <tt>get<>()</tt>.
 */
 class FlatScatterMatrix
 {
@@ -4664,12 +5364,13 @@ class FlatScatterMatrix
     {
         typedef typename AccumulatorResultTraits<U>::element_promote_type  element_type;
         typedef typename AccumulatorResultTraits<U>::FlatCovarianceType    value_type;
-        typedef value_type const &                                   result_type;
+        typedef value_type                                           result_type;
 
         typedef typename AccumulatorResultTraits<U>::SumType        SumType;
 
-        value_type value_;
+        value_type  value_;
         SumType     diff_;
+        acc_detail::FlatScatterMatrixBatch<SumType> batch_;
 
         Impl()
         : value_(),  // call default constructor explicitly to ensure zero initialization
@@ -4679,6 +5380,7 @@ class FlatScatterMatrix
         void reset()
         {
             value_ = element_type();
+            batch_.reset();
         }
 
         template <class Shape>
@@ -4687,21 +5389,26 @@ class FlatScatterMatrix
             int size = prod(s);
             acc_detail::reshapeImpl(value_, Shape1(size*(size+1)/2));
             acc_detail::reshapeImpl(diff_, s);
+            batch_.reshape(s);
         }
 
         void operator+=(Impl const & o)
         {
+            flush();
             double n1 = getDependency<Count>(*this), n2 = getDependency<Count>(o);
             if(n1 == 0.0)
             {
-                value_ = o.value_;
+                value_ = o();
             }
             else if(n2 != 0.0)
             {
                 using namespace vigra::multi_math;
                 diff_ = getDependency<Mean>(*this) - getDependency<Mean>(o);
                 acc_detail::updateFlatScatterMatrix(value_, diff_, n1 * n2 / (n1 + n2));
-                value_ += o.value_;
+                if(o.batch_.size() > 0)
+                    value_ += o();
+                else
+                    value_ += o.value_;
             }
         }
 
@@ -4715,15 +5422,40 @@ class FlatScatterMatrix
             compute(t, weight);
         }
 
+        void flush()
+        {
+            if(batch_.size() > 0)
+                batch_.flush(value_, getDependency<Mean>(*this), getDependency<Count>(*this));
+        }
+
         result_type operator()() const
         {
-            return value_;
+            if(batch_.size() == 0)
+                return value_;
+            value_type res(value_);
+            acc_detail::FlatScatterMatrixBatch<SumType> batch(batch_);
+            batch.flush(res, getDependency<Mean>(*this), getDependency<Count>(*this));
+            return res;
         }
 
       private:
+
         void compute(U const & t, double weight = 1.0)
         {
+            if(batch_.push(t, weight))
+            {
+                if(batch_.full())
+                    flush();
+                return;
+            }
             double n = getDependency<Count>(*this);
+            if(batch_.size() > 0)
+            {
+                // the buffered samples come first, so add them w.r.t. the mean and count before t
+                using namespace vigra::multi_math;
+                diff_ = (n*getDependency<Mean>(*this) - weight*t) / (n - weight);
+                batch_.flush(value_, diff_, n - weight);
+            }
             if(n > weight)
             {
                 using namespace vigra::multi_math;
@@ -6044,7 +6776,7 @@ class GlobalRangeHistogram
     };
 };
 
-/** \brief Compute (0%, 10%, 25%, 50%, 75%, 90%, 100%) quantiles from given histogram.
+/** \brief Compute (0%, 10%, 25%, 50%, 75%, 90%, 100%) quantiles from given histogram or TDigest sketch.
 
     Return type is TinyVector<double, 7> .
 */
@@ -6087,6 +6819,88 @@ class StandardQuantiles
     };
 };
 
+/** \brief Mergeable single-pass quantile sketch (t-digest).
+
+    The template parameter <tt>Compression</tt> determines the size/accuracy trade-off of the
+    sketch (see \ref vigra::QuantileSketch; 100 is a good default, i.e. at most about 100
+    centroids per region). The return type is <tt>QuantileSketch const &</tt>, so arbitrary
+    quantiles can be computed via <tt>get<TDigest<100> >(a).quantile(q)</tt>. Use
+    <tt>StandardQuantiles<TDigest<100> ></tt> to get the same quantiles as from a histogram.
+    Only scalar data are supported.
+
+    The buffered values of the sketch are merged at the end of each pass and when
+    merging (see AccumulatorChain::flush()), so that queries only read the centroids.
+
+    Works in pass 1, %operator+=() is supported (merging).
+*/
+template <int Compression>
+class TDigest
+{
+  public:
+    typedef Select<> Dependencies;
+
+    static std::string name()
+    {
+        return std::string("TDigest<") + asString(Compression) + ">";
+    }
+
+    template <class U, class BASE>
+    struct Impl
+    : public BASE
+    {
+        static_assert(Compression >= 10, "TDigest<Compression>: Compression >= 10 required.");
+
+        typedef QuantileSketch           value_type;
+        typedef value_type const &       result_type;
+
+        value_type value_;
+
+        Impl()
+        : value_(Compression)
+        {}
+
+        void reset()
+        {
+            value_.reset();
+        }
+
+        void operator+=(Impl const & o)
+        {
+            value_ += o.value_;
+        }
+
+        void update(U const & t)
+        {
+            value_.insert(t);
+        }
+
+        void update(U const & t, double weight)
+        {
+            value_.insert(t, weight);
+        }
+
+        void flush()
+        {
+            value_.flush();
+        }
+
+        result_type operator()() const
+        {
+            return value_;
+        }
+
+        template <class ArrayLike>
+        void computeStandardQuantiles(double, double, double count,
+                                      ArrayLike const & desiredQuantiles, ArrayLike & res) const
+        {
+            if(count == 0.0)
+                return;
+            for(unsigned int k=0; k<desiredQuantiles.size(); ++k)
+                res[k] = value_.quantile(desiredQuantiles[k]);
+        }
+    };
+};
+
 template <int N>
 struct feature_RegionContour_can_only_be_computed_for_2D_arrays
 : vigra::staticAssert::AssertBool<N==2>
@@ -6149,6 +6963,8 @@ class RegionContour
             update(t);
         }
 
+        static const bool mergeable = false;
+
         void operator+=(Impl const &)
         {
             vigra_precondition(false,
@@ -6334,6 +7150,8 @@ class ConvexHull
             initialized_ = true;
         }
 
+        static const bool mergeable = false;
+
         void operator+=(Impl const &)
         {
             vigra_precondition(
@@ -6557,6 +7375,8 @@ class ConvexHullFeatures
             }
         }
 
+        static const bool mergeable = false;
+
         void operator+=(Impl const &)
         {
             vigra_precondition(
@@ -0,0 +1,325 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_ACCUMULATOR_INCREMENTAL_HXX
+#define VIGRA_ACCUMULATOR_INCREMENTAL_HXX
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+
+#include "accumulator.hxx"
+#include "array_vector.hxx"
+#include "box.hxx"
+#include "multi_array.hxx"
+#include "multi_iterator.hxx"
+#include "union_find.hxx"
+
+namespace vigra {
+
+namespace acc {
+
+/** \brief Maintain region features under interactive merges and splits of regions.
+
+    <b>\#include</b> \<vigra/accumulator_incremental.hxx\><br>
+    Namespace: vigra::acc
+
+    In interactive applications (e.g. proofreading of a segmentation), regions are
+    repeatedly merged or split, and recomputing all region features from scratch after
+    each edit is too expensive. This class owns an \ref AccumulatorChainArray (template
+    parameter <tt>ACCUMULATOR</tt>) and keeps it up-to-date incrementally:
+
+    <ul>
+    <li> <tt>merge(a, b)</tt> merges two regions by merging their accumulators
+         (see <tt>AccumulatorChainArray::merge(i, j)</tt>). This takes constant time per
+         merge, because the label array is not modified. Instead, the merged labels are
+         recorded in a \ref UnionFindArray, and <tt>representative(l)</tt> returns the
+         region a label currently belongs to. Therefore, all statistics in the chain
+         must be mergeable.
+    <li> After the label array has been edited (e.g. a region has been split by assigning
+         new labels to some of its pixels), <tt>recomputeRegions(regions)</tt> recomputes
+         the given regions by re-scanning only the union of their bounding boxes.
+         The list must contain all regions whose pixels were edited and all new labels.
+         New labels must not have been used before, e.g. use
+         <tt>nextFreeLabel()</tt>, <tt>nextFreeLabel()+1</tt> etc.
+    </ul>
+
+    The representatives of all regions that changed since the last call to
+    <tt>clearChangedRegions()</tt> are reported by <tt>changedRegions()</tt>, e.g. to update
+    a classifier's predictions only for these regions. The global statistics of the chain
+    refer to the data at construction time and are never updated (merges and splits don't
+    change the data). Consequently, region statistics that depend on global statistics
+    (such as <tt>GlobalRangeHistogram</tt>) are not supported.
+
+    The data and label arrays are not copied, they must remain valid as long as the store
+    is used.
+
+    <b> Usage:</b>
+
+    \code
+    using namespace vigra::acc;
+    typedef AccumulatorChainArray<CoupledArrays<3, float, UInt32>,
+                                  Select<DataArg<1>, LabelArg<2>, Count, Mean, RegionCenter> > Chain;
+    MultiArray<3, float>  data(...);
+    MultiArray<3, UInt32> labels(...);
+
+    Chain prototype;
+    prototype.ignoreLabel(0);   // the prototype's configuration is used for all recomputations
+    IncrementalRegionFeatures<3, float, UInt32, Chain> store(data, labels, prototype);
+
+    UInt32 r = store.merge(5, 7);   // region 7 is now part of region r (which is 5)
+    std::cout << get<Count>(store.features(), r) << "\n";
+
+    // split region r: pixels on the right of x = 100 get a new label
+    UInt32 newLabel = store.nextFreeLabel();
+    ... // write newLabel into 'labels' where store.representative(labels[p]) == r and p[0] > 100
+    std::vector<UInt32> edited = { r, newLabel };
+    store.recomputeRegions(edited);
+    \endcode
+*/
+template <unsigned int N, class T, class Label, class ACCUMULATOR>
+class IncrementalRegionFeatures
+{
+  public:
+    typedef ACCUMULATOR                                 Accumulator;
+    typedef typename MultiArrayShape<N>::type           shape_type;
+    typedef Box<MultiArrayIndex, N>                     box_type;
+    typedef MultiArrayView<N, T, StridedArrayTag>       DataView;
+    typedef MultiArrayView<N, Label, StridedArrayTag>   LabelView;
+
+    /** Compute the features of all regions in the given arrays. The accumulator chain
+        <tt>prototype</tt> must not contain data yet. Its configuration (e.g. ignored label,
+        histogram options, activated statistics) is used for all subsequent computations.
+    */
+    template <class S1, class S2>
+    IncrementalRegionFeatures(MultiArrayView<N, T, S1> const & data,
+                              MultiArrayView<N, Label, S2> const & labels,
+                              Accumulator const & prototype = Accumulator())
+    : data_(data),
+      labels_(labels),
+      prototype_(prototype),
+      features_(prototype),
+      union_find_(0)
+    {
+        vigra_precondition(data.shape() == labels.shape(),
+            "IncrementalRegionFeatures(): shape mismatch between data and labels.");
+        vigra_precondition(prototype.maxRegionLabel() == -1,
+            "IncrementalRegionFeatures(): the prototype accumulator must be empty.");
+
+        extractFeatures(data_, labels_, features_);
+        resizeRegions(features_.maxRegionLabel());
+
+        MultiCoordinateIterator<N> i(labels_.shape()), end(i.getEndIterator());
+        for(; i != end; ++i)
+        {
+            MultiArrayIndex l = labels_[*i];
+            if(l != ignoredLabel())
+                boxes_[l] |= *i;
+        }
+    }
+
+    /** The accumulator chain holding the features. The features of the region containing
+        label l are accessed by <tt>get<TAG>(store.features(), store.representative(l))</tt>.
+    */
+    Accumulator const & features() const
+    {
+        return features_;
+    }
+
+    /** The region that label l currently belongs to.
+    */
+    Label representative(Label l) const
+    {
+        vigra_precondition(l <= maxRegionLabel(),
+            "IncrementalRegionFeatures::representative(): label out of range.");
+        return (Label)union_find_.findIndex(l);
+    }
+
+    /** Bounding box of the region represented by label l (empty if the region is empty).
+    */
+    box_type const & boundingBox(Label l) const
+    {
+        return boxes_[representative(l)];
+    }
+
+    MultiArrayIndex maxRegionLabel() const
+    {
+        return features_.maxRegionLabel();
+    }
+
+    MultiArrayIndex ignoredLabel() const
+    {
+        return prototype_.ignoredLabel();
+    }
+
+    /** The smallest label that has not been used yet (for splitting regions).
+    */
+    Label nextFreeLabel() const
+    {
+        return (Label)(maxRegionLabel() + 1);
+    }
+
+    /** Merge the regions containing labels a and b in constant time. Returns the
+        representative of the merged region.
+    */
+    Label merge(Label a, Label b)
+    {
+        vigra_precondition((MultiArrayIndex)a != ignoredLabel() && (MultiArrayIndex)b != ignoredLabel(),
+            "IncrementalRegionFeatures::merge(): cannot merge the ignored label.");
+        MultiArrayIndex ra = representative(a),
+                        rb = representative(b);
+        if(ra == rb)
+            return (Label)ra;
+        MultiArrayIndex r = union_find_.makeUnion(ra, rb),
+                        o = (r == ra) ? rb : ra;
+        features_.merge(r, o);
+        boxes_[r] |= boxes_[o];
+        boxes_[o] = box_type();
+        changed_.insert(r);
+        changed_.erase(o);
+        return (Label)r;
+    }
+
+    /** Recompute the features of the given regions after the label array has been edited.
+        <tt>regions</tt> must contain (a label of) every region whose pixels were relabeled
+        and all new labels introduced by the edit. Only the union of the bounding boxes of
+        the existing regions is re-scanned, so the new labels must have been assigned to
+        pixels of the listed regions only.
+    */
+    template <class ArrayLike>
+    void recomputeRegions(ArrayLike const & regions)
+    {
+        if(regions.size() == 0)
+            return;
+
+        // determine the affected representatives and the area to be re-scanned
+        MultiArrayIndex newMaxLabel = maxRegionLabel();
+        for(unsigned int k=0; k<regions.size(); ++k)
+        {
+            vigra_precondition((MultiArrayIndex)regions[k] != ignoredLabel(),
+                "IncrementalRegionFeatures::recomputeRegions(): cannot recompute the ignored label.");
+            newMaxLabel = std::max<MultiArrayIndex>(newMaxLabel, regions[k]);
+        }
+        resizeRegions(newMaxLabel);
+
+        ArrayVector<MultiArrayIndex> affected;
+        std::unordered_map<MultiArrayIndex, MultiArrayIndex> localIndex;
+        box_type box;
+        for(unsigned int k=0; k<regions.size(); ++k)
+        {
+            MultiArrayIndex r = union_find_.findIndex(regions[k]);
+            if(localIndex.insert(std::make_pair(r, (MultiArrayIndex)affected.size())).second)
+            {
+                affected.push_back(r);
+                box |= boxes_[r];
+                boxes_[r] = box_type();
+                changed_.insert(r);
+            }
+        }
+        if(box.isEmpty())
+            return;
+
+        // relabel the box: affected regions get consecutive labels, all other pixels are ignored
+        MultiArrayIndex ignored = affected.size();
+        LabelView labels = labels_.subarray(box.begin(), box.end());
+        MultiArray<N, Label> localLabels(box.size());
+        MultiArrayIndex lastLabel = -1, lastIndex = ignored;
+        MultiCoordinateIterator<N> i(box.size()), end(i.getEndIterator());
+        for(; i != end; ++i)
+        {
+            MultiArrayIndex l = labels[*i];
+            if(l != lastLabel)
+            {
+                lastLabel = l;
+                lastIndex = ignored;
+                if(l != ignoredLabel())
+                {
+                    vigra_precondition(l <= maxRegionLabel(),
+                        "IncrementalRegionFeatures::recomputeRegions(): unknown label in the edited area.");
+                    typename std::unordered_map<MultiArrayIndex, MultiArrayIndex>::const_iterator
+                        r = localIndex.find(union_find_.findIndex(l));
+                    if(r != localIndex.end())
+                        lastIndex = r->second;
+                }
+            }
+            localLabels[*i] = (Label)lastIndex;
+            if(lastIndex != ignored)
+                boxes_[affected[lastIndex]] |= *i + box.begin();
+        }
+
+        Accumulator local(prototype_);
+        local.setMaxRegionLabel(ignored - 1);
+        local.ignoreLabel(ignored);
+        local.setCoordinateOffset(box.begin());
+        extractFeatures(data_.subarray(box.begin(), box.end()), localLabels, local);
+        features_.replaceRegions(local, affected);
+    }
+
+    /** Representatives of all regions that were merged or recomputed since the last call
+        to <tt>clearChangedRegions()</tt>, in ascending order.
+    */
+    std::set<MultiArrayIndex> const & changedRegions() const
+    {
+        return changed_;
+    }
+
+    void clearChangedRegions()
+    {
+        changed_.clear();
+    }
+
+  private:
+    void resizeRegions(MultiArrayIndex maxLabel)
+    {
+        if(maxLabel > features_.maxRegionLabel())
+            features_.setMaxRegionLabel(maxLabel);
+        boxes_.resize(maxLabel + 1);
+        while(union_find_.nextFreeIndex() <= maxLabel)
+            union_find_.makeNewIndex();
+    }
+
+    DataView data_;
+    LabelView labels_;
+    Accumulator prototype_, features_;
+    UnionFindArray<MultiArrayIndex> union_find_;
+    ArrayVector<box_type> boxes_;
+    std::set<MultiArrayIndex> changed_;
+};
+
+} // namespace acc
+
+} // namespace vigra
+
+#endif // VIGRA_ACCUMULATOR_INCREMENTAL_HXX
@@ -0,0 +1,412 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_ACCUMULATOR_PARALLEL_HXX
+#define VIGRA_ACCUMULATOR_PARALLEL_HXX
+
+#include <vector>
+#include <algorithm>
+
+#include "accumulator.hxx"
+#include "threadpool.hxx"
+#include "multi_array_chunked.hxx"
+
+namespace vigra {
+
+namespace acc {
+
+/** \brief Parallel version of \ref extractFeatures().
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra { namespace acc {
+
+        // iterator version
+        template <class ITERATOR, class ACCUMULATOR>
+        void extractFeatures(ITERATOR start, ITERATOR end, ACCUMULATOR & a,
+                             ParallelOptions const & options);
+
+        // MultiArrayView versions (up to 5 arrays, as in the sequential version)
+        template <unsigned int N, class T1, class S1,
+                  class ACCUMULATOR>
+        void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                             ACCUMULATOR & a,
+                             ParallelOptions const & options);
+
+        template <unsigned int N, class T1, class S1,
+                                  class T2, class S2,
+                  class ACCUMULATOR>
+        void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                             MultiArrayView<N, T2, S2> const & a2,
+                             ACCUMULATOR & a,
+                             ParallelOptions const & options);
+
+        ...
+    }}
+    \endcode
+
+    The scan order range is divided into one contiguous chunk per thread. Each thread
+    fills its own copy of the accumulator chain <tt>a</tt>, and the copies are merged into
+    <tt>a</tt> afterwards. Multi-pass statistics are handled pass by pass: after pass
+    <tt>k</tt> has been merged, the merged chain is assigned to the threads' chains (reusing
+    their memory), and the threads start pass <tt>k+1</tt> from there, so that statistics like <tt>Central<PowerSum<3> ></tt> or <tt>GlobalRangeHistogram</tt>
+    see the global results of the earlier passes (e.g. the global mean or range), and only
+    the statistics working in pass <tt>k+1</tt> are merged at the end (see
+    <tt>AccumulatorChain::mergePassN()</tt>). Therefore, the results are identical to the
+    sequential version up to floating point round-off.
+
+    The chain <tt>a</tt> must be in its initial state (just like in the sequential version,
+    statistics may be activated and histogram options may be set before the call). The
+    iterator must support random access (<tt>end - start</tt> and <tt>start + k</tt>),
+    as the coupled scan order iterators do. If the chain contains active statistics that
+    don't support merging (e.g. <tt>Principal<Minimum></tt>, <tt>RegionContour</tt>,
+    <tt>ConvexHull</tt>), or if only a single thread is requested, the function falls back
+    to the sequential version.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/accumulator_parallel.hxx\><br>
+    Namespace: vigra::acc
+
+    \code
+    MultiArray<3, float>  data(...);
+    MultiArray<3, UInt32> labels(...);
+
+    AccumulatorChainArray<CoupledArrays<3, float, UInt32>,
+                          Select<DataArg<1>, LabelArg<2>, Mean, Variance, Skewness, RegionCenter> > a;
+
+    extractFeatures(data, labels, a, ParallelOptions().numThreads(4));
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void extractFeatures)
+
+template <class ITERATOR, class ACCUMULATOR>
+void extractFeatures(ITERATOR start, ITERATOR end, ACCUMULATOR & a,
+                     ParallelOptions const & options)
+{
+    vigra_precondition(a.current_pass_ == 0,
+        "extractFeatures(): accumulator chain must be in its initial state (call reset() first).");
+
+    MultiArrayIndex size = end - start;
+    MultiArrayIndex nThreads = std::min<MultiArrayIndex>(options.getActualNumThreads(), size);
+    unsigned int passes = a.passesRequired();
+    if(nThreads <= 1 || passes == 0)
+    {
+        extractFeatures(start, end, a);
+        return;
+    }
+
+    // Shape the chain for the whole data set (e.g. determine maxRegionLabel()
+    // and the number of bands), just like the first update() does.
+    a.next_.resize(acc_detail::shapeOf(*start));
+
+    if(!a.isMergeable())
+    {
+        extractFeatures(start, end, a);
+        return;
+    }
+
+    std::vector<MultiArrayIndex> chunks(nThreads+1);
+    for(MultiArrayIndex t=0; t<=nThreads; ++t)
+        chunks[t] = size * t / nThreads;
+
+    ThreadPool pool(options);
+    std::vector<ACCUMULATOR> chains(nThreads, a);
+    for(unsigned int k=1; k <= passes; ++k)
+    {
+        std::vector<threading::future<void> > futures;
+        for(MultiArrayIndex t=0; t<nThreads; ++t)
+        {
+            futures.emplace_back(
+                pool.enqueue([&chains, &chunks, &start, &a, t, k](size_t /*thread_id*/)
+                    {
+                        // 'a' holds the merged results of the previous passes,
+                        // the assignment reuses the memory of the thread's chain
+                        if(k > 1)
+                            chains[t] = a;
+                        ITERATOR i    = start + chunks[t],
+                                 iend = start + chunks[t+1];
+                        for(; i < iend; ++i)
+                            chains[t].updatePassN(*i, k);
+                        chains[t].flush();
+                    }
+                )
+            );
+        }
+        for(auto & fut : futures)
+            fut.get();
+        for(MultiArrayIndex t=0; t<nThreads; ++t)
+            a.mergePassN(chains[t], k);
+    }
+    a.current_pass_ = passes;
+}
+
+template <unsigned int N, class T1, class S1,
+          class ACCUMULATOR>
+void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                     ACCUMULATOR & a,
+                     ParallelOptions const & options)
+{
+    typedef typename CoupledIteratorType<N, T1>::type Iterator;
+    Iterator start = createCoupledIterator(a1),
+             end   = start.getEndIterator();
+    extractFeatures(start, end, a, options);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2,
+          class ACCUMULATOR>
+void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                     MultiArrayView<N, T2, S2> const & a2,
+                     ACCUMULATOR & a,
+                     ParallelOptions const & options)
+{
+    typedef typename CoupledIteratorType<N, T1, T2>::type Iterator;
+    Iterator start = createCoupledIterator(a1, a2),
+             end   = start.getEndIterator();
+    extractFeatures(start, end, a, options);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2,
+                          class T3, class S3,
+          class ACCUMULATOR>
+void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                     MultiArrayView<N, T2, S2> const & a2,
+                     MultiArrayView<N, T3, S3> const & a3,
+                     ACCUMULATOR & a,
+                     ParallelOptions const & options)
+{
+    typedef typename CoupledIteratorType<N, T1, T2, T3>::type Iterator;
+    Iterator start = createCoupledIterator(a1, a2, a3),
+             end   = start.getEndIterator();
+    extractFeatures(start, end, a, options);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2,
+                          class T3, class S3,
+                          class T4, class S4,
+          class ACCUMULATOR>
+void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                     MultiArrayView<N, T2, S2> const & a2,
+                     MultiArrayView<N, T3, S3> const & a3,
+                     MultiArrayView<N, T4, S4> const & a4,
+                     ACCUMULATOR & a,
+                     ParallelOptions const & options)
+{
+    typedef typename CoupledIteratorType<N, T1, T2, T3, T4>::type Iterator;
+    Iterator start = createCoupledIterator(a1, a2, a3, a4),
+             end   = start.getEndIterator();
+    extractFeatures(start, end, a, options);
+}
+
+template <unsigned int N, class T1, class S1,
+                          class T2, class S2,
+                          class T3, class S3,
+                          class T4, class S4,
+                          class T5, class S5,
+          class ACCUMULATOR>
+void extractFeatures(MultiArrayView<N, T1, S1> const & a1,
+                     MultiArrayView<N, T2, S2> const & a2,
+                     MultiArrayView<N, T3, S3> const & a3,
+                     MultiArrayView<N, T4, S4> const & a4,
+                     MultiArrayView<N, T5, S5> const & a5,
+                     ACCUMULATOR & a,
+                     ParallelOptions const & options)
+{
+    typedef typename CoupledIteratorType<N, T1, T2, T3, T4, T5>::type Iterator;
+    Iterator start = createCoupledIterator(a1, a2, a3, a4, a5),
+             end   = start.getEndIterator();
+    extractFeatures(start, end, a, options);
+}
+
+/** \brief Compute region statistics of chunked data and label arrays.
+
+    <b> Declaration:</b>
+
+    \code
+    namespace vigra { namespace acc {
+
+        template <unsigned int N, class T1, class T2, class ACCUMULATOR>
+        void extractFeatures(ChunkedArray<N, T1> const & data,
+                             ChunkedArray<N, T2> const & labels,
+                             ACCUMULATOR & a,
+                             ParallelOptions const & options = ParallelOptions());
+    }}
+    \endcode
+
+    This is the out-of-core counterpart of <tt>extractFeatures(data, labels, a)</tt>
+    for an <tt>AccumulatorChainArray</tt> (or <tt>DynamicAccumulatorChainArray</tt>) over
+    <tt>CoupledArrays<N, T1, T2></tt>. The arrays are processed in blocks that coincide
+    with the chunks of <tt>data</tt>, so that only one block per thread is held in memory,
+    and every chunk is read exactly once per pass.
+
+    Each block is relabeled to the consecutive range of labels it actually contains,
+    and the statistics are collected in a block-local chain holding just these regions.
+    The block-local chains are then merged into <tt>a</tt> with the appropriate label mapping
+    (see <tt>AccumulatorChainArray::mergePassN()</tt>). Therefore, the memory of the
+    temporary chains does not depend on the total number of regions. In multi-pass
+    computations, the block-local chains of pass <tt>k</tt> are initialized with the merged
+    results of the previous passes (see <tt>AccumulatorChainArray::assignRegions()</tt>),
+    so that e.g. <tt>Skewness</tt> and <tt>GlobalRangeHistogram</tt> are computed exactly.
+    Coordinate statistics refer to the coordinate system of the chunked arrays.
+
+    All active statistics must support merging (see \ref FeatureAccumulators). The chain
+    <tt>a</tt> must be in its initial state, but statistics may be activated and
+    histogram options and the ignore label may be set before the call. Reading of the
+    chunks is serialized, because the storage backend (e.g. HDF5) may not be thread-safe,
+    whereas the statistics of different blocks are computed in parallel.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/accumulator_parallel.hxx\><br>
+    Namespace: vigra::acc
+
+    \code
+    ChunkedArrayHDF5<3, float>  data(hdf5_file, "data");
+    ChunkedArrayHDF5<3, UInt32> labels(hdf5_file, "labels");
+
+    AccumulatorChainArray<CoupledArrays<3, float, UInt32>,
+                          Select<DataArg<1>, LabelArg<2>, Count, Mean, Variance, RegionCenter> > a;
+    a.ignoreLabel(0);
+
+    extractFeatures(data, labels, a, ParallelOptions().numThreads(4));
+    \endcode
+*/
+template <unsigned int N, class T1, class T2, class ACCUMULATOR>
+void extractFeatures(ChunkedArray<N, T1> const & data,
+                     ChunkedArray<N, T2> const & labels,
+                     ACCUMULATOR & a,
+                     ParallelOptions const & options = ParallelOptions())
+{
+    typedef typename MultiArrayShape<N>::type Shape;
+    typedef typename CoupledIteratorType<N, T1, T2>::type Iterator;
+
+    vigra_precondition(data.shape() == labels.shape(),
+        "extractFeatures(ChunkedArray, ChunkedArray, ...): shape mismatch between data and labels.");
+    vigra_precondition(a.current_pass_ == 0 && a.maxRegionLabel() == -1,
+        "extractFeatures(ChunkedArray, ChunkedArray, ...): accumulator chain must be in its initial state.");
+
+    // prototype of the block-local chains: same configuration as 'a', but just a single region
+    ACCUMULATOR prototype(a);
+    prototype.setMaxRegionLabel(0);
+    vigra_precondition(prototype.isMergeable(),
+        "extractFeatures(ChunkedArray, ChunkedArray, ...): all statistics must support merging.");
+
+    MultiArrayIndex ignored = a.ignoredLabel();
+    Shape blockShape = data.chunkShape();
+    std::vector<Shape> blockStarts;
+    MultiCoordinateIterator<N> c(data.chunkArrayShape()), cend(c.getEndIterator());
+    for(; c != cend; ++c)
+        blockStarts.push_back(blockShape * *c);
+    unsigned int passes = a.passesRequired();
+
+    threading::mutex read_mutex, merge_mutex;
+    ThreadPool pool(options);
+    for(unsigned int k=1; k <= passes; ++k)
+    {
+        // results of the previous passes, from which the block-local chains are initialized
+        ACCUMULATOR previous(k > 1 ? a : prototype);
+
+        std::vector<threading::future<void> > futures;
+        for(std::size_t b=0; b<blockStarts.size(); ++b)
+        {
+            futures.emplace_back(
+                pool.enqueue([&, b, k](size_t /*thread_id*/)
+                    {
+                        Shape start = blockStarts[b],
+                              stop  = min(start + blockShape, data.shape());
+
+                        MultiArray<N, T1> blockData(stop - start);
+                        MultiArray<N, T2> blockLabels(stop - start);
+                        {
+                            threading::lock_guard<threading::mutex> lock(read_mutex);
+                            data.checkoutSubarray(start, blockData);
+                            labels.checkoutSubarray(start, blockLabels);
+                        }
+
+                        // relabel the block consecutively, the ignored label becomes 'present.size()'
+                        // (an ignored label outside the range of T2 cannot occur in the block)
+                        bool const ignore = ignored >= 0 && (UInt64)ignored <= (UInt64)NumericTraits<T2>::max();
+                        std::vector<T2> present(blockLabels.begin(), blockLabels.end());
+                        std::sort(present.begin(), present.end());
+                        present.erase(std::unique(present.begin(), present.end()), present.end());
+                        if(ignore)
+                            present.erase(std::remove(present.begin(), present.end(), (T2)ignored), present.end());
+                        if(present.size() == 0)
+                            return;
+                        vigra_precondition(!ignore || present.size() <= (UInt64)NumericTraits<T2>::max(),
+                            "extractFeatures(ChunkedArray, ChunkedArray, ...): the ignored label does not fit into the label type after relabeling.");
+                        for(auto & l : blockLabels)
+                        {
+                            if(ignore && l == (T2)ignored)
+                                l = (T2)present.size();
+                            else
+                                l = (T2)(std::lower_bound(present.begin(), present.end(), l) - present.begin());
+                        }
+
+                        ACCUMULATOR local(prototype);
+                        if(k > 1)
+                            local.assignRegions(previous, present);
+                        else
+                            local.setMaxRegionLabel(present.size() - 1);
+                        local.ignoreLabel(ignore ? (MultiArrayIndex)present.size() : -1);
+                        local.setCoordinateOffset(start);
+
+                        Iterator i    = createCoupledIterator(blockData, blockLabels),
+                                 iend = i.getEndIterator();
+                        for(; i < iend; ++i)
+                            local.updatePassN(*i, k);
+                        local.flush();
+
+                        threading::lock_guard<threading::mutex> lock(merge_mutex);
+                        a.mergePassN(local, present, k);
+                    }
+                )
+            );
+        }
+        for(auto & fut : futures)
+            fut.get();
+    }
+    a.current_pass_ = passes;
+}
+
+} // namespace acc
+
+} // namespace vigra
+
+#endif // VIGRA_ACCUMULATOR_PARALLEL_HXX
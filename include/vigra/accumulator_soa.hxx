@@ -0,0 +1,441 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_ACCUMULATOR_SOA_HXX
+#define VIGRA_ACCUMULATOR_SOA_HXX
+
+#include <type_traits>
+
+#include "accumulator.hxx"
+#include "array_vector.hxx"
+#include "multi_array.hxx"
+#include "multi_iterator.hxx"
+#include "numerictraits.hxx"
+
+namespace vigra {
+
+namespace acc {
+
+namespace acc_detail {
+
+template <class TAG>
+struct IsSoARegionStatistic
+{
+    static const bool value = std::is_same<TAG, Count>::value ||
+                              std::is_same<TAG, Sum>::value ||
+                              std::is_same<TAG, SumOfSquares>::value ||
+                              std::is_same<TAG, Minimum>::value ||
+                              std::is_same<TAG, Maximum>::value ||
+                              std::is_same<TAG, Coord<Sum> >::value;
+};
+
+template <class LIST>
+struct AllSoARegionStatistics
+{
+    static const bool value = IsSoARegionStatistic<typename LIST::Head>::value &&
+                              AllSoARegionStatistics<typename LIST::Tail>::value;
+};
+
+template <>
+struct AllSoARegionStatistics<void>
+{
+    static const bool value = true;
+};
+
+} // namespace acc_detail
+
+/** \brief Structure-of-arrays storage for the basic per-region statistics.
+
+    <b>\#include</b> \<vigra/accumulator_soa.hxx\><br>
+    Namespace: vigra::acc
+
+    An AccumulatorChainArray stores one accumulator chain per region, i.e. an array of
+    structures. Updating a region touches the entire structure, including all
+    internal state that is not needed for the current sample. When only the basic
+    statistics <tt>Count</tt>, <tt>Sum</tt>, <tt>SumOfSquares</tt> (i.e. <tt>PowerSum<2></tt>),
+    <tt>Minimum</tt>, <tt>Maximum</tt> and <tt>Coord<Sum></tt> are needed,
+    this class is a leaner alternative: it keeps one dense array per statistic
+    (and per coordinate axis), indexed by the region label. The data are processed line by
+    line in runs of equal labels. The statistics of each run are accumulated in registers
+    and added to the region's array entries only once per run, and the coordinate sums
+    are computed in closed form. This reduces the per-region footprint (e.g. 72 bytes for
+    all statistics of a 3D volume with <tt>float</tt> data) and the number of memory
+    accesses per pixel, especially for compact regions.
+
+    The statistics are selected at compile time by the template parameter <tt>Selected</tt>,
+    which must only contain the tags listed above (<tt>Count</tt> is always computed).
+    Derived results (mean, variance, region center) are computed on request. Note that the
+    variance is computed from the sum of squares and is therefore less accurate than the
+    <tt>Variance</tt> statistic of the accumulator chains when the mean is large compared
+    to the standard deviation.
+
+    <b> Usage:</b>
+
+    \code
+    using namespace vigra::acc;
+    MultiArray<3, float>  data(...);
+    MultiArray<3, UInt32> labels(...);
+
+    SoARegionStatistics<3, float, Select<Count, Sum, Minimum, Maximum, Coord<Sum> > > a;
+    a.ignoreLabel(0);
+    extractFeatures(data, labels, a);
+
+    for(int k=1; k<=a.maxRegionLabel(); ++k)
+        std::cout << "region " << k << ": size " << a.count(k) << ", mean " << a.mean(k)
+                  << ", center " << a.regionCenter(k) << "\n";
+    \endcode
+*/
+template <unsigned int N, class T,
+          class Selected = Select<Count, Sum, SumOfSquares, Minimum, Maximum, Coord<Sum> > >
+class SoARegionStatistics
+{
+  public:
+    typedef typename Selected::type                     TagList;
+    typedef T                                           value_type;
+    typedef typename MultiArrayShape<N>::type           shape_type;
+    typedef TinyVector<double, N>                       coordinate_type;
+
+    static_assert(acc_detail::AllSoARegionStatistics<TagList>::value,
+        "SoARegionStatistics: only Count, Sum, SumOfSquares, Minimum, Maximum, and Coord<Sum> are supported.");
+
+    static const bool hasSum          = Contains<TagList, Sum>::type::value;
+    static const bool hasSumOfSquares = Contains<TagList, SumOfSquares>::type::value;
+    static const bool hasMinimum      = Contains<TagList, Minimum>::type::value;
+    static const bool hasMaximum      = Contains<TagList, Maximum>::type::value;
+    static const bool hasCoordSum     = Contains<TagList, Coord<Sum> >::type::value;
+
+    SoARegionStatistics()
+    : ignore_label_(-1),
+      coordinate_offset_()
+    {}
+
+    /** Statistics will not be computed for label l (default: -1, i.e. no label is ignored).
+    */
+    void ignoreLabel(MultiArrayIndex l)
+    {
+        ignore_label_ = l;
+    }
+
+    MultiArrayIndex ignoredLabel() const
+    {
+        return ignore_label_;
+    }
+
+    /** Set an offset for <tt>Coord<Sum></tt>, see <tt>AccumulatorChain::setCoordinateOffset()</tt>.
+    */
+    void setCoordinateOffset(shape_type const & offset)
+    {
+        coordinate_offset_ = offset;
+    }
+
+    /** Set the maximum region label. When data are passed to update() and the maximum label
+        has not been set yet, it is determined from the label array. Later calls of update()
+        enlarge the arrays when they encounter a larger label.
+    */
+    void setMaxRegionLabel(unsigned int label)
+    {
+        unsigned int size = label + 1;
+        count_.resize(size, 0.0);
+        if(hasSum)
+            sum_.resize(size, 0.0);
+        if(hasSumOfSquares)
+            sum2_.resize(size, 0.0);
+        if(hasMinimum)
+            minimum_.resize(size, NumericTraits<T>::max());
+        if(hasMaximum)
+            maximum_.resize(size, NumericTraits<T>::min());
+        if(hasCoordSum)
+            for(unsigned int d=0; d<N; ++d)
+                coord_sum_[d].resize(size, 0.0);
+    }
+
+    MultiArrayIndex maxRegionLabel() const
+    {
+        return (MultiArrayIndex)count_.size() - 1;
+    }
+
+    unsigned int regionCount() const
+    {
+        return count_.size();
+    }
+
+    /** Remove all regions and their statistics.
+    */
+    void reset()
+    {
+        MultiArrayIndex ignore_label = ignore_label_;
+        *this = SoARegionStatistics();
+        ignore_label_ = ignore_label;
+    }
+
+    /** Add the given data and labels. The function can be called repeatedly, e.g.
+        for the blocks of a large volume (use setCoordinateOffset() to translate
+        the coordinates of each block into the global coordinate system).
+    */
+    template <class S1, class Label, class S2>
+    void update(MultiArrayView<N, T, S1> const & data,
+                MultiArrayView<N, Label, S2> const & labels)
+    {
+        vigra_precondition(data.shape() == labels.shape(),
+            "SoARegionStatistics::update(): shape mismatch between data and labels.");
+        if(data.size() == 0)
+            return;
+        if(maxRegionLabel() < 0)
+        {
+            Label minimum, maximum;
+            labels.minmax(&minimum, &maximum);
+            setMaxRegionLabel(maximum);
+        }
+
+        MultiArrayIndex width = data.shape(0),
+                        dstride = data.stride(0),
+                        lstride = labels.stride(0);
+        shape_type lineShape(data.shape());
+        lineShape[0] = 1;
+        MultiCoordinateIterator<N> line(lineShape), end(line.getEndIterator());
+        for(; line != end; ++line)
+        {
+            T const * d = &data[*line];
+            Label const * l = &labels[*line];
+
+            for(MultiArrayIndex x0=0, x1=0; x0<width; x0=x1)
+            {
+                // find the run of equal labels starting at x0
+                Label label = l[x0*lstride];
+                for(x1=x0+1; x1<width && l[x1*lstride] == label; ++x1)
+                    ;
+                if((MultiArrayIndex)label == ignore_label_)
+                    continue;
+                vigra_precondition(0 <= (MultiArrayIndex)label,
+                    "SoARegionStatistics::update(): labels must be non-negative.");
+                if((MultiArrayIndex)label > maxRegionLabel())
+                    setMaxRegionLabel(label);
+                addRun(label, d + x0*dstride, dstride, x0, x1, *line);
+            }
+        }
+    }
+
+    /** Merge the statistics of o into this object. If the maximum labels differ,
+        the larger one is used.
+    */
+    void merge(SoARegionStatistics const & o)
+    {
+        if(o.maxRegionLabel() > maxRegionLabel())
+            setMaxRegionLabel(o.maxRegionLabel());
+        for(unsigned int k=0; k<o.regionCount(); ++k)
+        {
+            count_[k] += o.count_[k];
+            if(hasSum)
+                sum_[k] += o.sum_[k];
+            if(hasSumOfSquares)
+                sum2_[k] += o.sum2_[k];
+            if(hasMinimum)
+                minimum_[k] = std::min(minimum_[k], o.minimum_[k]);
+            if(hasMaximum)
+                maximum_[k] = std::max(maximum_[k], o.maximum_[k]);
+            if(hasCoordSum)
+                for(unsigned int d=0; d<N; ++d)
+                    coord_sum_[d][k] += o.coord_sum_[d][k];
+        }
+    }
+
+    /** Merge region j into region i. Region j is empty afterwards.
+    */
+    void merge(unsigned int i, unsigned int j)
+    {
+        vigra_precondition(i <= maxRegionLabel() && j <= maxRegionLabel(),
+            "SoARegionStatistics::merge(): region labels out of range.");
+        count_[i] += count_[j];
+        count_[j] = 0.0;
+        if(hasSum)
+        {
+            sum_[i] += sum_[j];
+            sum_[j] = 0.0;
+        }
+        if(hasSumOfSquares)
+        {
+            sum2_[i] += sum2_[j];
+            sum2_[j] = 0.0;
+        }
+        if(hasMinimum)
+        {
+            minimum_[i] = std::min(minimum_[i], minimum_[j]);
+            minimum_[j] = NumericTraits<T>::max();
+        }
+        if(hasMaximum)
+        {
+            maximum_[i] = std::max(maximum_[i], maximum_[j]);
+            maximum_[j] = NumericTraits<T>::min();
+        }
+        if(hasCoordSum)
+        {
+            for(unsigned int d=0; d<N; ++d)
+            {
+                coord_sum_[d][i] += coord_sum_[d][j];
+                coord_sum_[d][j] = 0.0;
+            }
+        }
+    }
+
+    double count(MultiArrayIndex k) const
+    {
+        return count_[checkRegion(k)];
+    }
+
+    double sum(MultiArrayIndex k) const
+    {
+        static_assert(hasSum, "SoARegionStatistics::sum(): Sum must be selected.");
+        return sum_[checkRegion(k)];
+    }
+
+    double sumOfSquares(MultiArrayIndex k) const
+    {
+        static_assert(hasSumOfSquares, "SoARegionStatistics::sumOfSquares(): SumOfSquares must be selected.");
+        return sum2_[checkRegion(k)];
+    }
+
+    T minimum(MultiArrayIndex k) const
+    {
+        static_assert(hasMinimum, "SoARegionStatistics::minimum(): Minimum must be selected.");
+        return minimum_[checkRegion(k)];
+    }
+
+    T maximum(MultiArrayIndex k) const
+    {
+        static_assert(hasMaximum, "SoARegionStatistics::maximum(): Maximum must be selected.");
+        return maximum_[checkRegion(k)];
+    }
+
+    coordinate_type coordSum(MultiArrayIndex k) const
+    {
+        static_assert(hasCoordSum, "SoARegionStatistics::coordSum(): Coord<Sum> must be selected.");
+        checkRegion(k);
+        coordinate_type res;
+        for(unsigned int d=0; d<N; ++d)
+            res[d] = coord_sum_[d][k];
+        return res;
+    }
+
+    /** Equivalent to <tt>get<Mean>(a, k)</tt> of an accumulator chain.
+    */
+    double mean(MultiArrayIndex k) const
+    {
+        return sum(k) / count(k);
+    }
+
+    /** Population variance computed as <tt>sumOfSquares(k) / count(k) - sq(mean(k))</tt>.
+    */
+    double variance(MultiArrayIndex k) const
+    {
+        return std::max(0.0, sumOfSquares(k) / count(k) - sq(mean(k)));
+    }
+
+    /** Equivalent to <tt>get<RegionCenter>(a, k)</tt> of an accumulator chain.
+    */
+    coordinate_type regionCenter(MultiArrayIndex k) const
+    {
+        return coordSum(k) / count(k);
+    }
+
+  private:
+    MultiArrayIndex checkRegion(MultiArrayIndex k) const
+    {
+        vigra_precondition(0 <= k && k <= maxRegionLabel(),
+            "SoARegionStatistics: region label out of range.");
+        return k;
+    }
+
+    // Accumulate the run [x0, x1) of the current line in registers and
+    // write the results to the arrays of region 'label' once.
+    void addRun(MultiArrayIndex label, T const * d, MultiArrayIndex dstride,
+                MultiArrayIndex x0, MultiArrayIndex x1, shape_type const & line)
+    {
+        MultiArrayIndex n = x1 - x0;
+        count_[label] += n;
+        if(hasSum || hasSumOfSquares || hasMinimum || hasMaximum)
+        {
+            double s = 0.0, s2 = 0.0;
+            T mi = d[0], ma = d[0];
+            for(MultiArrayIndex x=0; x<n; ++x)
+            {
+                T v = d[x*dstride];
+                s  += v;
+                s2 += sq((double)v);
+                mi = std::min(mi, v);
+                ma = std::max(ma, v);
+            }
+            if(hasSum)
+                sum_[label] += s;
+            if(hasSumOfSquares)
+                sum2_[label] += s2;
+            if(hasMinimum)
+                minimum_[label] = std::min(minimum_[label], mi);
+            if(hasMaximum)
+                maximum_[label] = std::max(maximum_[label], ma);
+        }
+        if(hasCoordSum)
+        {
+            // sum of x over the run in closed form
+            coord_sum_[0][label] += n*(double)coordinate_offset_[0] + 0.5*(double)(x0 + x1 - 1)*n;
+            for(unsigned int k=1; k<N; ++k)
+                coord_sum_[k][label] += n*(double)(line[k] + coordinate_offset_[k]);
+        }
+    }
+
+    ArrayVector<double> count_, sum_, sum2_;
+    ArrayVector<T> minimum_, maximum_;
+    ArrayVector<double> coord_sum_[N];
+    MultiArrayIndex ignore_label_;
+    shape_type coordinate_offset_;
+};
+
+/** \brief Compute the statistics of SoARegionStatistics.
+
+    Equivalent to <tt>a.update(data, labels)</tt>, so that SoARegionStatistics can be used
+    like an AccumulatorChainArray.
+*/
+template <unsigned int N, class T, class S1, class Label, class S2, class Selected>
+void extractFeatures(MultiArrayView<N, T, S1> const & data,
+                     MultiArrayView<N, Label, S2> const & labels,
+                     SoARegionStatistics<N, T, Selected> & a)
+{
+    a.update(data, labels);
+}
+
+} // namespace acc
+
+} // namespace vigra
+
+#endif // VIGRA_ACCUMULATOR_SOA_HXX
@@ -40,6 +40,7 @@
 /*std*/
 #include <vector>
 #include  <set>
+#include <algorithm>
 
 /*vigra*/
 #include "multi_array.hxx"
@@ -218,8 +219,99 @@ namespace vigra{
             mutable Arc arc_;
         };
 
+
+        // output iterator which ignores everything written to it
+        struct DiscardIterator{
+            DiscardIterator & operator*(){
+                return *this;
+            }
+            DiscardIterator & operator++(){
+                return *this;
+            }
+            template<class T>
+            DiscardIterator & operator=(const T &){
+                return *this;
+            }
+        };
+
+        // incident item iterator of FrozenAdjacencyListGraph, which walks
+        // the contiguous adjacency range of a node
+        template<class GRAPH,class FILTER>
+        class CsrIncItemIt
+        : public ForwardIteratorFacade<
+            CsrIncItemIt<GRAPH,FILTER>,
+            typename FILTER::ResultType,true
+        >
+        {
+        public:
+            typedef GRAPH Graph;
+            typedef typename Graph::index_type index_type;
+            typedef typename Graph::NodeIt NodeIt;
+            typedef typename Graph::Node Node;
+            typedef typename FILTER::ResultType ResultItem;
+            typedef typename Graph::NodeStorage::AdjacencyElement AdjacencyElement;
+
+            CsrIncItemIt(const lemon::Invalid & /*invalid*/ = lemon::INVALID)
+            :   graph_(NULL),
+                ownNodeId_(-1),
+                adjIter_(NULL),
+                adjEnd_(NULL),
+                resultItem_(lemon::INVALID){
+            }
+            CsrIncItemIt(const Graph & g, const NodeIt & nodeIt)
+            :   graph_(&g),
+                ownNodeId_(g.id(*nodeIt)),
+                adjIter_(g.adjacencyBegin(ownNodeId_)),
+                adjEnd_(g.adjacencyEnd(ownNodeId_)),
+                resultItem_(lemon::INVALID){
+                skipInvalid();
+            }
+            CsrIncItemIt(const Graph & g, const Node & node)
+            :   graph_(&g),
+                ownNodeId_(g.id(node)),
+                adjIter_(g.adjacencyBegin(ownNodeId_)),
+                adjEnd_(g.adjacencyEnd(ownNodeId_)),
+                resultItem_(lemon::INVALID){
+                skipInvalid();
+            }
+
+        private:
+            friend class vigra::IteratorFacadeCoreAccess;
+
+            void skipInvalid(){
+                if(FILTER::IsFilter){
+                    while(adjIter_!=adjEnd_ && !FILTER::valid(*graph_,*adjIter_,ownNodeId_))
+                        ++adjIter_;
+                }
+            }
+            bool isEnd()const{
+                return adjIter_==adjEnd_;
+            }
+            bool equal(const CsrIncItemIt & other)const{
+                if(isEnd() || other.isEnd())
+                    return isEnd() == other.isEnd();
+                return adjIter_==other.adjIter_;
+            }
+            void increment(){
+                ++adjIter_;
+                skipInvalid();
+            }
+            const ResultItem & dereference()const{
+                resultItem_ = FILTER::transform(*graph_,*adjIter_,ownNodeId_);
+                return resultItem_;
+            }
+
+            const GRAPH * graph_;
+            index_type ownNodeId_;
+            const AdjacencyElement * adjIter_;
+            const AdjacencyElement * adjEnd_;
+            mutable ResultItem resultItem_;
+        };
+
     } // namespace detail_adjacency_list_graph
 
+    class FrozenAdjacencyListGraph;
+
 
     /** \brief undirected adjacency list graph in the LEMON API 
 
@@ -471,11 +563,36 @@ namespace vigra{
         */
         Edge addEdge(const index_type u ,const index_type v);
 
+        /** \brief add many edges at once.
+
+            \a begin and \a end refer to a sequence of node id pairs
+            (anything with <tt>operator[]</tt>, e.g. <tt>TinyVector<Int64, 2></tt>),
+            which may be unsorted and contain duplicates. The result is the same as
+            calling <tt>addEdge(e[0], e[1])</tt> for each pair in turn (missing nodes
+            are added, existing edges are reused, new edges get consecutive ids in
+            order of their first occurrence). The edge id of each pair is written
+            to \a edgeIds.
+
+            Instead of a duplicate check and a sorted insertion per edge, the pairs
+            are sorted once and the node adjacencies are filled in a single pass.
+            Since addEdge() adds a new edge for every self loop, a sequence
+            containing self loops is inserted pair by pair.
+        */
+        template<class ITER, class OUT_ITER>
+        void addEdges(ITER begin, ITER end, OUT_ITER edgeIds);
+
+        /** \brief add many edges at once, see above.
+        */
+        template<class ITER>
+        void addEdges(ITER begin, ITER end){
+            addEdges(begin, end, detail_adjacency_list_graph::DiscardIterator());
+        }
+
         
         size_t maxDegree()const{
             size_t md=0;
             for(NodeIt it(*this);it!=lemon::INVALID;++it){
-                std::max(md, size_t( degree(*it) ) );
+                md = std::max(md, size_t( degree(*it) ) );
             }
             return md;
         }
@@ -496,6 +613,13 @@ namespace vigra{
 
         static const bool is_directed = false;
 
+        /** \brief Create an immutable copy of this graph with contiguous (CSR) adjacency.
+
+            The copy has the same node, edge and arc ids and can be used
+            with the same maps, see FrozenAdjacencyListGraph.
+        */
+        FrozenAdjacencyListGraph freeze()const;
+
     public:
 
         void reserveMaxNodeId(const index_type mxid ){
@@ -638,6 +762,7 @@ namespace vigra{
 
         friend class detail_adjacency_list_graph::ItemIter<GraphType,Node>;
         friend class detail_adjacency_list_graph::ItemIter<GraphType,Edge>;
+        friend class FrozenAdjacencyListGraph;
 
 
         const NodeStorage & nodeImpl(const Node & node)const{
@@ -662,6 +787,399 @@ namespace vigra{
 
 
 
+    /** \brief immutable undirected graph in the LEMON API with contiguous adjacency
+
+        A FrozenAdjacencyListGraph is created from an AdjacencyListGraph via
+        AdjacencyListGraph::freeze(). The adjacency of all nodes is stored in
+        one array (compressed sparse row layout: an offset per node, and
+        (neighbor id, edge id) pairs sorted by neighbor id), the end nodes of all
+        edges in another. This avoids the per-node vectors of the AdjacencyListGraph
+        and makes traversal in read-heavy algorithms (ShortestPathDijkstra,
+        edgeWeightedWatershedsSegmentation(), felzenszwalbSegmentation(),
+        hierarchical clustering, ...) cache friendly.
+
+        Node, edge and arc descriptors and ids are the same as in the original
+        graph, so node and edge maps of the original graph can be used directly.
+        The graph cannot be modified.
+
+        <b>\#include</b> \<vigra/adjacency_list_graph.hxx\><br>
+        Namespace: vigra
+    */
+    class FrozenAdjacencyListGraph
+    {
+    public:
+        typedef Int64                                                     index_type;
+    private:
+        typedef FrozenAdjacencyListGraph                                    GraphType;
+
+        struct NodeStorage{
+            typedef detail::Adjacency<index_type> AdjacencyElement;
+        };
+        typedef NodeStorage::AdjacencyElement AdjacencyElement;
+    public:
+        /// node descriptor
+        typedef detail::GenericNode<index_type>                           Node;
+        /// edge descriptor
+        typedef detail::GenericEdge<index_type>                           Edge;
+        /// arc descriptor
+        typedef detail::GenericArc<index_type>                            Arc;
+    private:
+        // filters for the incident item iterators, which build the items directly
+        // from the adjacency element instead of going through the id lookups
+        // of the generic filters in graph_item_impl.hxx
+        struct NnFilter{
+            typedef Node ResultType;
+            static bool valid(const GraphType &, const AdjacencyElement &, const index_type){
+                return true;
+            }
+            static ResultType transform(const GraphType &, const AdjacencyElement & adj, const index_type){
+                return Node(adj.nodeId());
+            }
+            static const bool IsFilter = false;
+        };
+        struct IncFilter{
+            typedef Edge ResultType;
+            static bool valid(const GraphType &, const AdjacencyElement &, const index_type){
+                return true;
+            }
+            static ResultType transform(const GraphType &, const AdjacencyElement & adj, const index_type){
+                return Edge(adj.edgeId());
+            }
+            static const bool IsFilter = false;
+        };
+        struct OutFilter{
+            typedef Arc ResultType;
+            static bool valid(const GraphType &, const AdjacencyElement &, const index_type){
+                return true;
+            }
+            static ResultType transform(const GraphType & g, const AdjacencyElement & adj, const index_type ownNodeId){
+                return g.directFrom(adj.edgeId(), ownNodeId);
+            }
+            static const bool IsFilter = false;
+        };
+        struct InFlter{
+            typedef Arc ResultType;
+            static bool valid(const GraphType &, const AdjacencyElement &, const index_type){
+                return true;
+            }
+            static ResultType transform(const GraphType & g, const AdjacencyElement & adj, const index_type){
+                return g.directFrom(adj.edgeId(), adj.nodeId());
+            }
+            static const bool IsFilter = false;
+        };
+        struct BackOutFilter{
+            typedef Arc ResultType;
+            static bool valid(const GraphType &, const AdjacencyElement & adj, const index_type ownNodeId){
+                return adj.nodeId() < ownNodeId;
+            }
+            static ResultType transform(const GraphType & g, const AdjacencyElement & adj, const index_type ownNodeId){
+                return g.directFrom(adj.edgeId(), ownNodeId);
+            }
+            static const bool IsFilter = true;
+        };
+    public:
+        /// edge iterator
+        typedef detail_adjacency_list_graph::ItemIter<GraphType,Edge>    EdgeIt;
+        /// node iterator
+        typedef detail_adjacency_list_graph::ItemIter<GraphType,Node>    NodeIt;
+        /// arc iterator
+        typedef detail_adjacency_list_graph::ArcIt<GraphType>            ArcIt;
+
+        /// incident edge iterator
+        typedef detail_adjacency_list_graph::CsrIncItemIt<GraphType,IncFilter >  IncEdgeIt;
+        /// incoming arc iterator
+        typedef detail_adjacency_list_graph::CsrIncItemIt<GraphType,InFlter   >  InArcIt;
+        /// outgoing arc iterator
+        typedef detail_adjacency_list_graph::CsrIncItemIt<GraphType,OutFilter >  OutArcIt;
+
+        typedef detail_adjacency_list_graph::CsrIncItemIt<GraphType,NnFilter  >  NeighborNodeIt;
+
+        /// outgoing back arc iterator
+        typedef detail_adjacency_list_graph::CsrIncItemIt<GraphType,BackOutFilter >  OutBackArcIt;
+
+        // BOOST GRAPH API TYPEDEFS
+        typedef directed_tag            directed_category;
+        typedef NeighborNodeIt          adjacency_iterator;
+        typedef EdgeIt                  edge_iterator;
+        typedef NodeIt                  vertex_iterator;
+        typedef IncEdgeIt               in_edge_iterator;
+        typedef IncEdgeIt               out_edge_iterator;
+        typedef size_t                  degree_size_type;
+        typedef size_t                  edge_size_type;
+        typedef size_t                  vertex_size_type;
+        typedef Edge                    edge_descriptor;
+        typedef Node                    vertex_descriptor;
+
+        /// default edge map
+        template<class T>
+        struct EdgeMap : DenseEdgeReferenceMap<GraphType,T> {
+            EdgeMap(): DenseEdgeReferenceMap<GraphType,T>(){
+            }
+            EdgeMap(const GraphType & g)
+            : DenseEdgeReferenceMap<GraphType,T>(g){
+            }
+            EdgeMap(const GraphType & g,const T & val)
+            : DenseEdgeReferenceMap<GraphType,T>(g,val){
+            }
+        };
+
+        /// default node map
+        template<class T>
+        struct NodeMap : DenseNodeReferenceMap<GraphType,T> {
+            NodeMap(): DenseNodeReferenceMap<GraphType,T>(){
+            }
+            NodeMap(const GraphType & g)
+            : DenseNodeReferenceMap<GraphType,T>(g){
+            }
+            NodeMap(const GraphType & g,const T & val)
+            : DenseNodeReferenceMap<GraphType,T>(g,val){
+            }
+        };
+
+        /// default arc map
+        template<class T>
+        struct ArcMap : DenseArcReferenceMap<GraphType,T> {
+            ArcMap(): DenseArcReferenceMap<GraphType,T>(){
+            }
+            ArcMap(const GraphType & g)
+            : DenseArcReferenceMap<GraphType,T>(g){
+            }
+            ArcMap(const GraphType & g,const T & val)
+            : DenseArcReferenceMap<GraphType,T>(g,val){
+            }
+        };
+
+        /** \brief Create an empty graph.
+        */
+        FrozenAdjacencyListGraph()
+        :   nodeExists_(),
+            offsets_(1, 0),
+            adjacency_(),
+            edges_(),
+            nodeNum_(0),
+            edgeNum_(0){
+        }
+
+        /** \brief Create a frozen copy of \a graph (same as <tt>graph.freeze()</tt>).
+        */
+        explicit FrozenAdjacencyListGraph(const AdjacencyListGraph & graph);
+
+        /** \brief Get the number of edges in this graph (API: LEMON).
+        */
+        index_type edgeNum()const{
+            return edgeNum_;
+        }
+        /** \brief Get the number of nodes in this graph (API: LEMON).
+        */
+        index_type nodeNum()const{
+            return nodeNum_;
+        }
+        /** \brief Get the number of arcs in this graph (API: LEMON).
+        */
+        index_type arcNum()const{
+            return edgeNum()*2;
+        }
+        /** \brief Get the maximum ID of any edge in this graph (API: LEMON).
+        */
+        index_type maxEdgeId()const{
+            return static_cast<index_type>(edges_.size()) - 1;
+        }
+        /** \brief Get the maximum ID of any node in this graph (API: LEMON).
+        */
+        index_type maxNodeId()const{
+            return static_cast<index_type>(nodeExists_.size()) - 1;
+        }
+        /** \brief Get the maximum ID of any edge in arc graph (API: LEMON).
+        */
+        index_type maxArcId()const{
+            return maxEdgeId()*2+1;
+        }
+
+        /** \brief Create an arc for the given edge \a e, oriented along the
+            edge's natural (<tt>forward = true</tt>) or reversed
+            (<tt>forward = false</tt>) direction (API: LEMON).
+        */
+        Arc direct(const Edge & edge,const bool forward)const{
+            if(edge==lemon::INVALID)
+                return Arc(lemon::INVALID);
+            return forward ? Arc(id(edge),id(edge)) : Arc(id(edge)+maxEdgeId()+1,id(edge));
+        }
+        /** \brief Create an arc for the given edge \a e oriented
+            so that node \a n is the starting node of the arc (API: LEMON), or
+            return <tt>lemon::INVALID</tt> if the edge is not incident to this node.
+        */
+        Arc direct(const Edge & edge,const Node & node)const{
+            if(u(edge)==node)
+                return Arc(id(edge),id(edge));
+            else if(v(edge)==node)
+                return Arc(id(edge)+maxEdgeId()+1,id(edge));
+            else
+                return Arc(lemon::INVALID);
+        }
+        /** \brief Return <tt>true</tt> when the arc is looking on the underlying
+            edge in its natural (i.e. forward) direction, <tt>false</tt> otherwise (API: LEMON).
+        */
+        bool direction(const Arc & arc)const{
+            return id(arc)<=maxEdgeId();
+        }
+
+        /** \brief Get the start node of the given edge \a e (API: LEMON).
+        */
+        Node u(const Edge & edge)const{
+            return Node(edges_[id(edge)][0]);
+        }
+        /** \brief Get the end node of the given edge \a e (API: LEMON).
+        */
+        Node v(const Edge & edge)const{
+            return Node(edges_[id(edge)][1]);
+        }
+        /** \brief Get the start node of the given arc \a a (API: LEMON).
+        */
+        Node source(const Arc & arc)const{
+            return Node(edges_[arc.edgeId()][direction(arc) ? 0 : 1]);
+        }
+        /** \brief Get the end node of the given arc \a a (API: LEMON).
+        */
+        Node target(const Arc & arc)const{
+            return Node(edges_[arc.edgeId()][direction(arc) ? 1 : 0]);
+        }
+        /** \brief Return the opposite node of the given node \a n
+            along edge \a e (API: LEMON), or return <tt>lemon::INVALID</tt>
+            if the edge is not incident to this node.
+        */
+        Node oppositeNode(Node const &n, const Edge &e) const{
+            if(u(e)==n)
+                return v(e);
+            else if(v(e)==n)
+                return u(e);
+            else
+                return Node(-1);
+        }
+
+        /** \brief Return the start node of the edge the given iterator is referring to (API: LEMON).
+        */
+        Node baseNode(const IncEdgeIt & iter)const{
+            return u(*iter);
+        }
+        /** \brief Return the start node of the edge the given iterator is referring to (API: LEMON).
+        */
+        Node baseNode(const OutArcIt & iter)const{
+            return source(*iter);
+        }
+        /** \brief Return the end node of the edge the given iterator is referring to (API: LEMON).
+        */
+        Node runningNode(const IncEdgeIt & iter)const{
+            return v(*iter);
+        }
+        /** \brief Return the end node of the edge the given iterator is referring to (API: LEMON).
+        */
+        Node runningNode(const OutArcIt & iter)const{
+            return target(*iter);
+        }
+
+        /** \brief Get the ID  for node desciptor \a v (API: LEMON).
+        */
+        index_type id(const Node & node)const{
+            return node.id();
+        }
+        /** \brief Get the ID  for edge desciptor \a v (API: LEMON).
+        */
+        index_type id(const Edge & edge)const{
+            return edge.id();
+        }
+        /** \brief Get the ID  for arc desciptor \a v (API: LEMON).
+        */
+        index_type id(const Arc  & arc )const{
+            return arc.id();
+        }
+
+        /** \brief Get edge descriptor for given node ID \a i (API: LEMON).
+            Return <tt>Edge(lemon::INVALID)</tt> when the ID does not exist in this graph.
+        */
+        Edge edgeFromId(const index_type id)const{
+            if(id>=0 && id<=maxEdgeId() && edges_[id][0]!=-1)
+                return Edge(id);
+            else
+                return Edge(lemon::INVALID);
+        }
+        /** \brief Get node descriptor for given node ID \a i (API: LEMON).
+            Return <tt>Node(lemon::INVALID)</tt> when the ID does not exist in this graph.
+        */
+        Node nodeFromId(const index_type id)const{
+            if(id>=0 && id<=maxNodeId() && nodeExists_[id])
+                return Node(id);
+            else
+                return Node(lemon::INVALID);
+        }
+        /** \brief Get arc descriptor for given node ID \a i (API: LEMON).
+            Return <tt>Arc(lemon::INVALID)</tt> when the ID does not exist in this graph.
+        */
+        Arc  arcFromId(const index_type id)const{
+            const index_type edgeId = id<=maxEdgeId() ? id : id - (maxEdgeId() + 1);
+            if(edgeFromId(edgeId)==lemon::INVALID)
+                return Arc(lemon::INVALID);
+            else
+                return Arc(id,edgeId);
+        }
+
+        /** \brief Get a descriptor for the edge connecting vertices \a u and \a v,<br/>or <tt>lemon::INVALID</tt> if no such edge exists (API: LEMON).
+        */
+        Edge findEdge(const Node & a,const Node & b)const{
+            if(a!=b){
+                const AdjacencyElement * end = adjacencyEnd(id(a));
+                const AdjacencyElement * iter = std::lower_bound(adjacencyBegin(id(a)), end,
+                                                                 AdjacencyElement(id(b), 0));
+                if(iter!=end && iter->nodeId()==id(b))
+                    return Edge(iter->edgeId());
+            }
+            return Edge(lemon::INVALID);
+        }
+        /** \brief Get a descriptor for the arc connecting vertices \a u and \a v,<br/>or <tt>lemon::INVALID</tt> if no such edge exists (API: LEMON).
+        */
+        Arc  findArc(const Node & uNode,const Node & vNode)const{
+            const Edge e = findEdge(uNode,vNode);
+            if(e==lemon::INVALID)
+                return Arc(lemon::INVALID);
+            return direct(e, u(e)==uNode);
+        }
+
+        degree_size_type degree(const vertex_descriptor & node)const{
+            return offsets_[id(node)+1] - offsets_[id(node)];
+        }
+
+        size_t maxDegree()const{
+            size_t md=0;
+            for(index_type n=0; n<=maxNodeId(); ++n)
+                md = std::max(md, size_t(offsets_[n+1] - offsets_[n]));
+            return md;
+        }
+
+        static const bool is_directed = false;
+
+    private:
+        template<class G,class FILT>
+        friend class detail_adjacency_list_graph::CsrIncItemIt;
+
+        // arc of edge \a edgeId starting at node \a nodeId
+        Arc directFrom(const index_type edgeId, const index_type nodeId)const{
+            return edges_[edgeId][0]==nodeId ? Arc(edgeId,edgeId) : Arc(edgeId+maxEdgeId()+1,edgeId);
+        }
+        const AdjacencyElement * adjacencyBegin(const index_type nodeId)const{
+            return adjacency_.data() + offsets_[nodeId];
+        }
+        const AdjacencyElement * adjacencyEnd(const index_type nodeId)const{
+            return adjacency_.data() + offsets_[nodeId+1];
+        }
+
+        std::vector<UInt8>                          nodeExists_;
+        std::vector<index_type>                     offsets_;
+        std::vector<AdjacencyElement>               adjacency_;
+        std::vector<TinyVector<index_type, 2> >     edges_;
+        size_t nodeNum_;
+        size_t edgeNum_;
+    };
+
+
 #ifndef DOXYGEN  // doxygen doesn't like out-of-line definitions
 
     inline AdjacencyListGraph::AdjacencyListGraph(
@@ -1076,6 +1594,145 @@ namespace vigra{
         return EdgeIt(edgeNum(),edgeNum());
     }
 
+    template<class ITER, class OUT_ITER>
+    inline void
+    AdjacencyListGraph::addEdges(ITER begin, ITER end, OUT_ITER edgeIds){
+        typedef TinyVector<index_type, 2> Pair;
+        // (smaller node id, larger node id, position in the input, 1 if given as (larger, smaller))
+        typedef TinyVector<index_type, 4> Item;
+
+        std::vector<Pair> pairs;
+        index_type maxId = -1;
+        bool selfLoops = false;
+        for(ITER iter=begin; iter!=end; ++iter){
+            pairs.push_back(Pair(static_cast<index_type>((*iter)[0]), static_cast<index_type>((*iter)[1])));
+            maxId = std::max(maxId, std::max(pairs.back()[0], pairs.back()[1]));
+            selfLoops = selfLoops || pairs.back()[0]==pairs.back()[1];
+        }
+        if(selfLoops){
+            for(size_t i=0; i<pairs.size(); ++i, ++edgeIds)
+                *edgeIds = id(addEdge(pairs[i][0], pairs[i][1]));
+            return;
+        }
+        std::vector<index_type> ids(pairs.size(), -1);
+
+        // nodes, in increasing id order
+        std::vector<UInt8> usedIds(maxId+1, 0);
+        for(size_t i=0; i<pairs.size(); ++i)
+            usedIds[pairs[i][0]] = usedIds[pairs[i][1]] = 1;
+        reserveMaxNodeId(maxId);
+        for(index_type n=0; n<=maxId; ++n)
+            if(usedIds[n])
+                addNode(n);
+
+        // sort the pairs: counting sort by the smaller id (stable, so positions
+        // stay increasing), then sort each bucket by the larger id
+        std::vector<size_t> buckets(maxId+2, 0);
+        for(size_t i=0; i<pairs.size(); ++i)
+            ++buckets[std::min(pairs[i][0], pairs[i][1])+1];
+        for(index_type n=0; n<=maxId; ++n)
+            buckets[n+1] += buckets[n];
+        std::vector<Item> items(buckets.back());
+        {
+            std::vector<size_t> fill(buckets.begin(), buckets.end()-1);
+            for(size_t i=0; i<pairs.size(); ++i){
+                const index_type uid = pairs[i][0], vid = pairs[i][1];
+                items[fill[std::min(uid,vid)]++] = Item(std::min(uid,vid), std::max(uid,vid), i, uid > vid);
+            }
+        }
+        for(index_type n=0; n<=maxId; ++n)
+            if(buckets[n+1] - buckets[n] > 1)
+                std::sort(items.begin()+buckets[n], items.begin()+buckets[n+1]);
+
+        // one group per distinct node pair, its first item is the first occurrence
+        std::vector<size_t> groups;
+        for(size_t i=0; i<items.size(); ++i)
+            if(i==0 || items[i][0]!=items[i-1][0] || items[i][1]!=items[i-1][1])
+                groups.push_back(i);
+        groups.push_back(items.size());
+        const size_t groupNum = groups.size()-1;
+
+        // existing edges keep their ids, new ones are numbered by first occurrence
+        std::vector<index_type> groupEdges(groupNum, -1);
+        std::vector<std::pair<index_type, size_t> > newEdges;
+        for(size_t g=0; g<groupNum; ++g){
+            const Item & first = items[groups[g]];
+            const Edge edge = edgeNum_==0 ? Edge(lemon::INVALID) : findEdge(Node(first[0]), Node(first[1]));
+            if(edge!=lemon::INVALID)
+                groupEdges[g] = id(edge);
+            else
+                newEdges.push_back(std::make_pair(first[2], g));
+        }
+        std::sort(newEdges.begin(), newEdges.end());
+        const index_type firstNewEdge = edges_.size();
+        edges_.reserve(edges_.size() + newEdges.size());
+        for(size_t i=0; i<newEdges.size(); ++i){
+            const Item & first = items[groups[newEdges[i].second]];
+            const index_type eid = edges_.size();
+            if(first[3])
+                edges_.push_back(EdgeStorage(first[1], first[0], eid));
+            else
+                edges_.push_back(EdgeStorage(first[0], first[1], eid));
+            groupEdges[newEdges[i].second] = eid;
+        }
+        edgeNum_ += newEdges.size();
+
+        // adjacency: visiting the pairs in sorted order yields the new neighbors
+        // of every node in increasing order, so they can mostly be appended
+        std::vector<size_t> newDegree(nodes_.size(), 0);
+        for(size_t g=0; g<groupNum; ++g){
+            if(groupEdges[g] >= firstNewEdge){
+                ++newDegree[items[groups[g]][0]];
+                ++newDegree[items[groups[g]][1]];
+            }
+        }
+        for(size_t n=0; n<nodes_.size(); ++n)
+            if(newDegree[n]>0)
+                nodes_[n].adjacency_.reserve(nodes_[n].adjacency_.size() + newDegree[n]);
+        for(size_t g=0; g<groupNum; ++g){
+            const Item & first = items[groups[g]];
+            if(groupEdges[g] >= firstNewEdge){
+                NodeStorage::SetType & ua = nodes_[first[0]].adjacency_;
+                NodeStorage::SetType & va = nodes_[first[1]].adjacency_;
+                ua.insert(ua.end(), NodeStorage::AdjacencyElement(first[1], groupEdges[g]));
+                va.insert(va.end(), NodeStorage::AdjacencyElement(first[0], groupEdges[g]));
+            }
+            for(size_t i=groups[g]; i<groups[g+1]; ++i)
+                ids[items[i][2]] = groupEdges[g];
+        }
+
+        for(size_t i=0; i<ids.size(); ++i, ++edgeIds)
+            *edgeIds = ids[i];
+    }
+
+    inline FrozenAdjacencyListGraph::FrozenAdjacencyListGraph(const AdjacencyListGraph & graph)
+    :   nodeExists_(graph.nodes_.size(), 0),
+        offsets_(graph.nodes_.size()+1, 0),
+        adjacency_(),
+        edges_(graph.edges_.size()),
+        nodeNum_(graph.nodeNum_),
+        edgeNum_(graph.edgeNum_)
+    {
+        for(size_t n=0; n<graph.nodes_.size(); ++n){
+            nodeExists_[n] = graph.nodes_[n].id() != -1;
+            offsets_[n+1] = offsets_[n] + graph.nodes_[n].numberOfEdges();
+        }
+        adjacency_.reserve(offsets_.back());
+        for(size_t n=0; n<graph.nodes_.size(); ++n)
+            adjacency_.insert(adjacency_.end(), graph.nodes_[n].adjacencyBegin(), graph.nodes_[n].adjacencyEnd());
+        for(size_t e=0; e<graph.edges_.size(); ++e){
+            if(graph.edges_[e].id() != -1)
+                edges_[e] = TinyVector<index_type, 2>(graph.edges_[e].u(), graph.edges_[e].v());
+            else
+                edges_[e] = TinyVector<index_type, 2>(-1, -1);
+        }
+    }
+
+    inline FrozenAdjacencyListGraph
+    AdjacencyListGraph::freeze()const{
+        return FrozenAdjacencyListGraph(*this);
+    }
+
 #endif //DOXYGEN
 
 //@}
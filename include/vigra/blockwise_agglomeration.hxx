@@ -0,0 +1,502 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_BLOCKWISE_AGGLOMERATION_HXX
+#define VIGRA_BLOCKWISE_AGGLOMERATION_HXX
+
+#include "threadpool.hxx"
+#include "multi_array.hxx"
+#include "multi_array_chunked.hxx"
+#include "multi_gridgraph.hxx"
+#include "blockwise_labeling.hxx"
+#include "adjacency_list_graph.hxx"
+#include "edge_contraction_graph.hxx"
+#include "graph_algorithms.hxx"
+#include "priority_queue.hxx"
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
+
+namespace vigra
+{
+
+/** \addtogroup Superpixels
+*/
+//@{
+
+namespace blockwise_agglomeration_detail
+{
+
+// accumulated boundary indicator along the common boundary of two regions
+template <class Label>
+struct Boundary
+{
+    Label u, v;
+    double sum, count;
+};
+
+// adds the boundary (u, v) to 'boundaries', merging it with an existing boundary
+// between the same regions
+template <class Label, class PairIndexMap>
+inline void
+addBoundary(std::vector<Boundary<Label> > & boundaries, PairIndexMap & index,
+            Label u, Label v, double sum, double count)
+{
+    if(v < u)
+        std::swap(u, v);
+    std::pair<typename PairIndexMap::iterator, bool> i =
+        index.insert(std::make_pair(std::make_pair(u, v), boundaries.size()));
+    if(i.second)
+    {
+        Boundary<Label> b = { u, v, sum, count };
+        boundaries.push_back(b);
+    }
+    else
+    {
+        boundaries[i.first->second].sum   += sum;
+        boundaries[i.first->second].count += count;
+    }
+}
+
+// EdgeContractionGraph callbacks: keep the mean boundary indicator of
+// merged edges up to date
+struct MeanBoundaryCallbacks
+{
+    typedef detail::GenericNode<Int64> Node;
+    typedef detail::GenericEdge<Int64> Edge;
+
+    MeanBoundaryCallbacks(std::vector<double> & sum, std::vector<double> & count,
+                          ChangeablePriorityQueue<double> & queue)
+    : sum_(&sum), count_(&count), queue_(&queue)
+    {}
+
+    void mergeNodes(const Node &, const Node &)
+    {}
+
+    void mergeEdges(const Edge & alive, const Edge & dead)
+    {
+        (*sum_)[alive.id()]   += (*sum_)[dead.id()];
+        (*count_)[alive.id()] += (*count_)[dead.id()];
+        queue_->deleteItem(dead.id());
+        queue_->push(alive.id(), (*sum_)[alive.id()] / (*count_)[alive.id()]);
+    }
+
+    void eraseEdge(const Edge & edge)
+    {
+        queue_->deleteItem(edge.id());
+    }
+
+    std::vector<double> * sum_, * count_;
+    ChangeablePriorityQueue<double> * queue_;
+};
+
+// Merges the regions given as 'boundaries' greedily, cheapest boundary first,
+// as long as the mean boundary indicator is below 'threshold'.
+// On return, 'representative' maps every label in 'boundaries' which has been
+// merged to the label of its cluster.
+template <class Label>
+void
+agglomerateBoundaries(std::vector<Boundary<Label> > const & boundaries, double threshold,
+                      std::unordered_map<Label, Label> & representative)
+{
+    std::vector<Label> nodeLabel;
+    std::unordered_map<Label, Int64> nodeIndex;
+    AdjacencyListGraph graph(0, boundaries.size());
+    std::vector<double> sum, count;
+    sum.reserve(boundaries.size());
+    count.reserve(boundaries.size());
+
+    for(std::size_t i = 0; i < boundaries.size(); ++i)
+    {
+        Int64 ids[2];
+        Label labels[2] = { boundaries[i].u, boundaries[i].v };
+        for(int j = 0; j < 2; ++j)
+        {
+            std::pair<typename std::unordered_map<Label, Int64>::iterator, bool> n =
+                nodeIndex.insert(std::make_pair(labels[j], (Int64)nodeLabel.size()));
+            if(n.second)
+            {
+                graph.addNode(nodeLabel.size());
+                nodeLabel.push_back(labels[j]);
+            }
+            ids[j] = n.first->second;
+        }
+        graph.addEdge(ids[0], ids[1]);
+        sum.push_back(boundaries[i].sum);
+        count.push_back(boundaries[i].count);
+    }
+    if(graph.edgeNum() == 0)
+        return;
+
+    ChangeablePriorityQueue<double> queue(graph.maxEdgeId() + 1);
+    for(std::size_t i = 0; i < sum.size(); ++i)
+        queue.push(i, sum[i] / count[i]);
+
+    typedef EdgeContractionGraph<AdjacencyListGraph, MeanBoundaryCallbacks> ContractionGraph;
+    ContractionGraph cgraph(graph, MeanBoundaryCallbacks(sum, count, queue));
+    while(!queue.empty() && queue.topPriority() < threshold)
+        cgraph.contractEdge(cgraph.edgeFromId(queue.top()));
+
+    for(std::size_t i = 0; i < nodeLabel.size(); ++i)
+    {
+        Int64 r = cgraph.reprNodeId(i);
+        if(r != (Int64)i)
+            representative[nodeLabel[i]] = nodeLabel[r];
+    }
+}
+
+template <unsigned int N, class T, class S, class U>
+inline void
+readBlock(MultiArrayView<N, T, S> const & array,
+          typename MultiArrayShape<N>::type const & start, MultiArray<N, U> & block)
+{
+    block = array.subarray(start, start + block.shape());
+}
+
+template <unsigned int N, class T, class U>
+inline void
+readBlock(ChunkedArray<N, T> const & array,
+          typename MultiArrayShape<N>::type const & start, MultiArray<N, U> & block)
+{
+    array.checkoutSubarray(start, block);
+}
+
+template <unsigned int N, class T, class S, class U>
+inline void
+writeBlock(MultiArrayView<N, T, S> & array,
+           typename MultiArrayShape<N>::type const & start, MultiArrayView<N, U> const & block)
+{
+    array.subarray(start, start + block.shape()) = block;
+}
+
+template <unsigned int N, class T, class U>
+inline void
+writeBlock(ChunkedArray<N, T> & array,
+           typename MultiArrayShape<N>::type const & start, MultiArrayView<N, U> const & block)
+{
+    array.commitSubarray(start, block);
+}
+
+template <unsigned int N, class LabelArray, class DataArray, class OutArray>
+typename OutArray::value_type
+agglomerateRegionsBlockwiseImpl(LabelArray const & labels, DataArray const & data, OutArray & out,
+                                double threshold, BlockwiseLabelOptions const & options,
+                                typename MultiArrayShape<N>::type const & block_shape)
+{
+    typedef typename MultiArrayShape<N>::type                Shape;
+    typedef typename LabelArray::value_type                  Label;
+    typedef typename DataArray::value_type                   Data;
+    typedef typename OutArray::value_type                    OutLabel;
+    typedef Boundary<Label>                                  BoundaryType;
+    typedef std::unordered_map<std::pair<Label, Label>, std::size_t,
+                               detail_graph_algorithms::RagLabelPairHash<Label> > PairIndexMap;
+    typedef std::unordered_map<Label, Label>                 LabelMap;
+
+    Shape shape = labels.shape();
+    vigra_precondition(shape == data.shape() && shape == out.shape(),
+        "agglomerateRegionsBlockwise(): shape mismatch between input and output.");
+    vigra_precondition(threshold >= 0.0,
+        "agglomerateRegionsBlockwise(): threshold must be non-negative.");
+
+    Shape blocks_shape = (shape + block_shape - Shape(1)) / block_shape;
+    std::size_t block_count = prod(blocks_shape);
+    auto block_begin = [&](std::size_t b)
+    {
+        Shape start;
+        for(unsigned int d = 0; d < N; ++d)
+        {
+            start[d] = (b % blocks_shape[d]) * block_shape[d];
+            b /= blocks_shape[d];
+        }
+        return start;
+    };
+
+    // find the block owning each label: regions occurring in a single block
+    // can be merged locally, all others must wait for the global stage
+    std::vector<std::vector<Label> > block_labels(block_count);
+    parallel_foreach(options.getNumThreads(), block_count,
+        [&](const int /*threadId*/, const uint64_t b)
+        {
+            Shape start = block_begin(b);
+            MultiArray<N, Label> block(min(start + block_shape, shape) - start);
+            readBlock(labels, start, block);
+            std::vector<Label> & l = block_labels[b];
+            l.assign(block.begin(), block.end());
+            std::sort(l.begin(), l.end());
+            l.erase(std::unique(l.begin(), l.end()), l.end());
+            l.shrink_to_fit();
+        });
+
+    Label max_label = 0;
+    for(std::size_t b = 0; b < block_count; ++b)
+        if(block_labels[b].size() > 0)
+            max_label = std::max(max_label, block_labels[b].back());
+    const std::size_t absent = block_count, shared = block_count + 1;
+    std::vector<std::size_t> label_blocks(max_label + 1, absent);
+    for(std::size_t b = 0; b < block_count; ++b)
+    {
+        for(std::size_t i = 0; i < block_labels[b].size(); ++i)
+        {
+            std::size_t & owner = label_blocks[block_labels[b][i]];
+            owner = owner == absent ? b : shared;
+        }
+        std::vector<Label>().swap(block_labels[b]);
+    }
+
+    // per block: sub-RAG of the pixel pairs anchored in the block, local
+    // agglomeration of the interior regions, and the reduced boundary list
+    GridGraph<N, undirected_tag> grid(Shape(3), options.getNeighborhood());
+    std::vector<Shape> offsets;
+    for(int k = 0; k < (int)grid.maxUniqueDegree(); ++k)
+        offsets.push_back(grid.neighborOffset(k));
+
+    std::vector<std::vector<std::pair<Label, Label> > > block_merges(block_count);
+    std::vector<std::vector<BoundaryType> > block_boundaries(block_count);
+    parallel_foreach(options.getNumThreads(), block_count,
+        [&](const int /*threadId*/, const uint64_t b)
+        {
+            Shape core_begin = block_begin(b),
+                  core_end   = min(core_begin + block_shape, shape),
+                  read_begin = max(core_begin - Shape(1), Shape(0)),
+                  read_end   = min(core_end + Shape(1), shape);
+            MultiArray<N, Label> label_block(read_end - read_begin);
+            MultiArray<N, Data>  data_block(read_end - read_begin);
+            readBlock(labels, read_begin, label_block);
+            readBlock(data, read_begin, data_block);
+
+            // each unordered pixel pair is owned by the block containing the
+            // anchor p, because only half of the neighborhood is visited
+            std::vector<BoundaryType> boundaries;
+            PairIndexMap index;
+            MultiCoordinateIterator<N> c(core_end - core_begin),
+                                       end = c.getEndIterator();
+            for(; c != end; ++c)
+            {
+                Shape p = *c + core_begin - read_begin;
+                Label lu = label_block[p];
+                for(std::size_t k = 0; k < offsets.size(); ++k)
+                {
+                    Shape q = p + offsets[k];
+                    if(!label_block.isInside(q))
+                        continue;
+                    Label lv = label_block[q];
+                    if(lu != lv)
+                        addBoundary(boundaries, index, lu, lv,
+                                    0.5*((double)data_block[p] + (double)data_block[q]), 1.0);
+                }
+            }
+
+            std::vector<BoundaryType> interior;
+            for(std::size_t i = 0; i < boundaries.size(); ++i)
+                if(label_blocks[boundaries[i].u] == b && label_blocks[boundaries[i].v] == b)
+                    interior.push_back(boundaries[i]);
+            LabelMap representative;
+            agglomerateBoundaries(interior, threshold, representative);
+
+            std::vector<BoundaryType> reduced;
+            PairIndexMap reduced_index;
+            for(std::size_t i = 0; i < boundaries.size(); ++i)
+            {
+                typename LabelMap::const_iterator ru = representative.find(boundaries[i].u),
+                                                  rv = representative.find(boundaries[i].v);
+                Label u = ru == representative.end() ? boundaries[i].u : ru->second,
+                      v = rv == representative.end() ? boundaries[i].v : rv->second;
+                if(u != v)
+                    addBoundary(reduced, reduced_index, u, v, boundaries[i].sum, boundaries[i].count);
+            }
+            block_boundaries[b].swap(reduced);
+            block_merges[b].assign(representative.begin(), representative.end());
+        });
+
+    // stitch: apply the local merges and agglomerate the merged sub-RAGs
+    std::vector<Label> mapping(max_label + 1);
+    for(std::size_t l = 0; l <= (std::size_t)max_label; ++l)
+        mapping[l] = l;
+    for(std::size_t b = 0; b < block_count; ++b)
+    {
+        for(std::size_t i = 0; i < block_merges[b].size(); ++i)
+            mapping[block_merges[b][i].first] = block_merges[b][i].second;
+        std::vector<std::pair<Label, Label> >().swap(block_merges[b]);
+    }
+    // halo labels may have been merged by their owning block
+    std::vector<BoundaryType> boundaries;
+    PairIndexMap index;
+    for(std::size_t b = 0; b < block_count; ++b)
+    {
+        for(std::size_t i = 0; i < block_boundaries[b].size(); ++i)
+        {
+            BoundaryType const & e = block_boundaries[b][i];
+            Label u = mapping[e.u], v = mapping[e.v];
+            if(u != v)
+                addBoundary(boundaries, index, u, v, e.sum, e.count);
+        }
+        std::vector<BoundaryType>().swap(block_boundaries[b]);
+    }
+    PairIndexMap().swap(index);
+
+    LabelMap representative;
+    agglomerateBoundaries(boundaries, threshold, representative);
+    std::vector<BoundaryType>().swap(boundaries);
+
+    // dense output labels 1..count for the labels actually present
+    std::vector<OutLabel> relabeling(max_label + 1, 0);
+    OutLabel count = 0;
+    for(std::size_t l = 0; l <= (std::size_t)max_label; ++l)
+    {
+        if(label_blocks[l] == absent)
+            continue;
+        typename LabelMap::const_iterator r = representative.find(mapping[l]);
+        if(r != representative.end())
+            mapping[l] = r->second;
+        if(relabeling[mapping[l]] == 0)
+            relabeling[mapping[l]] = ++count;
+    }
+    for(std::size_t l = 0; l <= (std::size_t)max_label; ++l)
+        if(label_blocks[l] != absent)
+            mapping[l] = relabeling[mapping[l]];
+
+    parallel_foreach(options.getNumThreads(), block_count,
+        [&](const int /*threadId*/, const uint64_t b)
+        {
+            Shape start = block_begin(b);
+            MultiArray<N, Label> block(min(start + block_shape, shape) - start);
+            readBlock(labels, start, block);
+            MultiArray<N, OutLabel> result(block.shape());
+            for(MultiArrayIndex i = 0; i < block.size(); ++i)
+                result[i] = mapping[block[i]];
+            writeBlock(out, start, result);
+        });
+    return count;
+}
+
+} // namespace blockwise_agglomeration_detail
+
+/** \brief Blockwise agglomeration of an over-segmentation on its region adjacency graph.
+
+    <b> Declaration:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class Label, class S1,
+                                  class Data, class S2,
+                                  class OutLabel, class S3>
+        OutLabel
+        agglomerateRegionsBlockwise(MultiArrayView<N, Label, S1> const & labels,
+                                    MultiArrayView<N, Data, S2> const & boundaryIndicator,
+                                    MultiArrayView<N, OutLabel, S3> out,
+                                    double threshold,
+                                    BlockwiseLabelOptions const & options = BlockwiseLabelOptions());
+
+        template <unsigned int N, class Label, class Data, class OutLabel>
+        OutLabel
+        agglomerateRegionsBlockwise(ChunkedArray<N, Label> const & labels,
+                                    ChunkedArray<N, Data> const & boundaryIndicator,
+                                    ChunkedArray<N, OutLabel> & out,
+                                    double threshold,
+                                    BlockwiseLabelOptions const & options = BlockwiseLabelOptions());
+    }
+    \endcode
+
+    The regions of \a labels (e.g. superpixels from \ref unionFindWatershedsBlockwise)
+    are merged greedily along the edges of their region adjacency graph, lowest mean
+    \a boundaryIndicator first, as long as the mean boundary indicator between two
+    regions is below \a threshold. The indicator of a pixel pair is the mean of
+    its two pixels, and the mean of a merged edge is the mean over all its pixel pairs.
+
+    The volume is never held in memory as a whole: each block (of shape
+    <tt>options.getBlockShape()</tt>, or the chunk shape for \ref ChunkedArray)
+    is read with a one-pixel halo, converted into a sub-RAG, and the regions
+    lying entirely inside the block are agglomerated locally and in parallel.
+    The remaining, much smaller boundary lists of all blocks are then stitched into
+    one RAG on which the agglomeration is completed. Since regions touching
+    several blocks only take part in the global stage, the merge order may differ
+    from a global agglomeration, but the result does not depend on the number of
+    threads. Memory consumption is dominated by a few lookup tables of size
+    <tt>max(labels)+1</tt>, so labels should be reasonably dense.
+
+    Return: the number of regions after agglomeration. \a out receives consecutive
+    labels starting at one.
+
+    <b> Usage: </b>
+
+    <b>\#include </b> \<vigra/blockwise_agglomeration.hxx\><br>
+    Namespace: vigra
+
+    \code
+    Shape3 shape(512), chunk_shape(64);
+    ChunkedArrayLazy<3, float>    boundaries(shape, chunk_shape);
+    ChunkedArrayLazy<3, UInt32> superpixels(shape, chunk_shape),
+                                regions(shape, chunk_shape);
+    // fill boundaries and compute superpixels ...
+
+    UInt32 count = agglomerateRegionsBlockwise(superpixels, boundaries, regions, 0.3,
+                                               BlockwiseLabelOptions().numThreads(4));
+    \endcode
+    */
+doxygen_overloaded_function(template <...> OutLabel agglomerateRegionsBlockwise)
+
+template <unsigned int N, class Label, class S1,
+                          class Data, class S2,
+                          class OutLabel, class S3>
+OutLabel
+agglomerateRegionsBlockwise(MultiArrayView<N, Label, S1> const & labels,
+                            MultiArrayView<N, Data, S2> const & boundaryIndicator,
+                            MultiArrayView<N, OutLabel, S3> out,
+                            double threshold,
+                            BlockwiseLabelOptions const & options = BlockwiseLabelOptions())
+{
+    return blockwise_agglomeration_detail::agglomerateRegionsBlockwiseImpl<N>(
+               labels, boundaryIndicator, out, threshold, options, options.getBlockShapeN<N>());
+}
+
+template <unsigned int N, class Label, class Data, class OutLabel>
+OutLabel
+agglomerateRegionsBlockwise(ChunkedArray<N, Label> const & labels,
+                            ChunkedArray<N, Data> const & boundaryIndicator,
+                            ChunkedArray<N, OutLabel> & out,
+                            double threshold,
+                            BlockwiseLabelOptions const & options = BlockwiseLabelOptions())
+{
+    return blockwise_agglomeration_detail::agglomerateRegionsBlockwiseImpl<N>(
+               labels, boundaryIndicator, out, threshold, options, labels.chunkShape());
+}
+
+//@}
+
+} // namespace vigra
+
+#endif // VIGRA_BLOCKWISE_AGGLOMERATION_HXX
@@ -37,8 +37,10 @@
 #define VIGRA_BLOCKWISE_LABELING_HXX
 
 #include <algorithm>
+#include <vector>
 
 #include "threadpool.hxx"
+#include "threading.hxx"
 #include "counting_iterator.hxx"
 #include "multi_gridgraph.hxx"
 #include "multi_labeling.hxx"
@@ -113,7 +115,7 @@ struct BorderVisitor
 {
     Label u_label_offset;
     Label v_label_offset;
-    UnionFindArray<Label>* global_unions;
+    ConcurrentUnionFindArray<Label>* global_unions;
     Equal* equal;
 
     template <class Data, class Shape>
@@ -195,7 +197,7 @@ blockwiseLabeling(DataBlocksIterator data_blocks_begin, DataBlocksIterator data_
     }
 
     // reduce stage: merge adjacent labels if the region overlaps
-    UnionFindArray<Label> global_unions(unmerged_label_number);
+    ConcurrentUnionFindArray<Label> global_unions(unmerged_label_number);
     if(has_background)
     {
         // merge all labels that refer to background
@@ -210,21 +212,27 @@ blockwiseLabeling(DataBlocksIterator data_blocks_begin, DataBlocksIterator data_
     typedef GridGraph<Dimensions, undirected_tag> Graph;
     typedef typename Graph::edge_iterator EdgeIterator;
     Graph blocks_graph(blocks_shape, options.getNeighborhood());
+    std::vector<std::pair<Shape, Shape> > block_pairs;
     for(EdgeIterator it = blocks_graph.get_edge_iterator(); it != blocks_graph.get_edge_end_iterator(); ++it)
-    {
-        Shape u = blocks_graph.u(*it);
-        Shape v = blocks_graph.v(*it);
-        Shape difference = v - u;
-
-        BorderVisitor<Equal, Label> border_visitor;
-        border_visitor.u_label_offset = label_offsets[u];
-        border_visitor.v_label_offset = label_offsets[v];
-        border_visitor.global_unions = &global_unions;
-        border_visitor.equal = &equal;
-        visitBorder(data_blocks_begin[u], label_blocks_begin[u],
-                    data_blocks_begin[v], label_blocks_begin[v],
-                    difference, options.getNeighborhood(), border_visitor);
-    }
+        block_pairs.push_back(std::make_pair(Shape(blocks_graph.u(*it)), Shape(blocks_graph.v(*it))));
+
+    // block borders are merged concurrently
+    parallel_foreach(options.getNumThreads(), block_pairs.size(),
+        [&](const int /*threadId*/, const uint64_t i){
+            Shape u = block_pairs[i].first;
+            Shape v = block_pairs[i].second;
+            Shape difference = v - u;
+
+            BorderVisitor<Equal, Label> border_visitor;
+            border_visitor.u_label_offset = label_offsets[u];
+            border_visitor.v_label_offset = label_offsets[v];
+            border_visitor.global_unions = &global_unions;
+            border_visitor.equal = &equal;
+            visitBorder(data_blocks_begin[u], label_blocks_begin[u],
+                        data_blocks_begin[v], label_blocks_begin[v],
+                        difference, options.getNeighborhood(), border_visitor);
+        }
+    );
 
     // fill mapping (local labels) -> (global labels)
     Label last_label = global_unions.makeContiguous();
@@ -296,6 +304,26 @@ void toGlobalLabels(LabelBlocksIterator label_blocks_begin, LabelBlocksIterator
     }
 }
 
+template <class Equal, class Label>
+struct ConcurrentBorderVisitor
+{
+    Label u_label_offset;
+    Label v_label_offset;
+    ConcurrentUnionFindArray<Label>* global_unions;
+    Equal* equal;
+
+    template <class Data, class Shape>
+    void operator()(const Data& u_data, Label& u_label, const Data& v_data, Label& v_label, const Shape& diff)
+    {
+        // label zero denotes background in both strips
+        if(u_label != 0 && v_label != 0 &&
+           labeling_equality::callEqual(*equal, u_data, v_data, diff))
+        {
+            global_unions->makeUnion(u_label + u_label_offset, v_label + v_label_offset);
+        }
+    }
+};
+
 } // namespace blockwise_labeling_detail
 
 /*************************************************************/
@@ -501,6 +529,164 @@ Label labelMultiArrayBlockwise(const ChunkedArray<N, Data>& data,
     return labelMultiArrayBlockwise(data, labels, options, std::equal_to<Data>());
 }
 
+/*************************************************************/
+/*                                                           */
+/*                      labelMultiArrayParallel              */
+/*                                                           */
+/*************************************************************/
+
+/** \weakgroup ParallelProcessing
+    \sa labelMultiArrayParallel <B>(...)</B>
+*/
+
+/** \brief Multi-threaded connected components labeling of a MultiArray.
+
+    <b> Declarations:</b>
+
+    \code
+    namespace vigra {
+        template <unsigned int N, class Data, class S1,
+                                  class Label, class S2,
+                  class Equal = std::equal_to<Data> >
+        Label labelMultiArrayParallel(const MultiArrayView<N, Data, S1>& data,
+                                      MultiArrayView<N, Label, S2> labels,
+                                      const BlockwiseLabelOptions& options = BlockwiseLabelOptions(),
+                                      Equal equal = std::equal_to<Data>());
+    }
+    \endcode
+
+    In contrast to \ref labelMultiArrayBlockwise(), the result is identical to
+    that of \ref labelMultiArray() with the same \ref vigra::LabelOptions, including
+    the numbering of the regions: labels are consecutive and ordered by the
+    first occurrence of each region in scan order.
+
+    The array is split into slabs along its last dimension, which are labeled
+    in parallel with \ref labelMultiArray(). Equivalences across the slab
+    borders are then merged concurrently in a lock-free union-find structure,
+    and the final labels are written in parallel. The number of threads is taken
+    from the options, the block shape is ignored.
+
+    Return: the number of regions found (=largest region label)
+
+    <b> Usage: </b>
+
+    <b>\#include </b> \<vigra/blockwise_labeling.hxx\><br>
+    Namespace: vigra
+
+    \code
+    MultiArray<3, int> data(Shape3(500));
+    MultiArray<3, UInt32> labels(data.shape());
+    // fill data ...
+
+    UInt32 max_label = labelMultiArrayParallel(data, labels,
+                             BlockwiseLabelOptions().neighborhood(IndirectNeighborhood)
+                                                    .ignoreBackgroundValue(0)
+                                                    .numThreads(8));
+    \endcode
+*/
+doxygen_overloaded_function(template <...> unsigned int labelMultiArrayParallel)
+
+template <unsigned int N, class Data, class S1,
+                          class Label, class S2,
+          class Equal>
+Label labelMultiArrayParallel(const MultiArrayView<N, Data, S1>& data,
+                              MultiArrayView<N, Label, S2> labels,
+                              const BlockwiseLabelOptions& options,
+                              Equal equal)
+{
+    using namespace blockwise_labeling_detail;
+
+    vigra_precondition(data.shape() == labels.shape(),
+        "labelMultiArrayParallel(): shape mismatch between input and output.");
+
+    typedef typename MultiArrayShape<N>::type Shape;
+
+    MultiArrayIndex length = data.shape(N-1);
+    int threads = options.getActualNumThreads();
+    MultiArrayIndex strip_count = std::min<MultiArrayIndex>(length, 2*threads);
+    if(threads <= 1 || strip_count <= 1)
+        return labelMultiArray(data, labels, options, equal);
+
+    // split the last dimension into slabs of (almost) equal thickness
+    std::vector<MultiArrayIndex> bounds(strip_count + 1);
+    for(MultiArrayIndex k = 0; k <= strip_count; ++k)
+        bounds[k] = k * length / strip_count;
+
+    std::vector<MultiArrayView<N, Data, S1> > data_strips;
+    std::vector<MultiArrayView<N, Label, S2> > label_strips;
+    for(MultiArrayIndex k = 0; k < strip_count; ++k)
+    {
+        Shape start, stop(data.shape());
+        start[N-1] = bounds[k];
+        stop[N-1] = bounds[k+1];
+        data_strips.push_back(data.subarray(start, stop));
+        label_strips.push_back(labels.subarray(start, stop));
+    }
+
+    // label the strips independently
+    std::vector<Label> strip_labels(strip_count);
+    parallel_foreach(threads, strip_count,
+        [&](const int /*threadId*/, const uint64_t k)
+        {
+            strip_labels[k] = labelMultiArray(data_strips[k], label_strips[k], options, equal);
+        }
+    );
+
+    // local label l > 0 of strip k becomes l + offsets[k], global index 0 is the background
+    std::vector<Label> offsets(strip_count + 1, 0);
+    for(MultiArrayIndex k = 0; k < strip_count; ++k)
+    {
+        vigra_precondition(offsets[k] <= NumericTraits<Label>::max() - strip_labels[k],
+            "labelMultiArrayParallel(): Need more labels than can be represented in the destination type.");
+        offsets[k+1] = offsets[k] + strip_labels[k];
+    }
+
+    // merge equivalences across strip borders
+    ConcurrentUnionFindArray<Label> global_unions(offsets[strip_count] + 1);
+    Shape difference;
+    difference[N-1] = 1;
+    parallel_foreach(threads, strip_count - 1,
+        [&](const int /*threadId*/, const uint64_t k)
+        {
+            ConcurrentBorderVisitor<Equal, Label> border_visitor;
+            border_visitor.u_label_offset = offsets[k];
+            border_visitor.v_label_offset = offsets[k+1];
+            border_visitor.global_unions = &global_unions;
+            border_visitor.equal = &equal;
+            visitBorder(data_strips[k], label_strips[k],
+                        data_strips[k+1], label_strips[k+1],
+                        difference, options.getNeighborhood(), border_visitor);
+        }
+    );
+
+    // roots are the smallest members of their sets, so numbering them in
+    // increasing order reproduces the scan order of labelMultiArray()
+    Label count = global_unions.makeContiguous();
+
+    // write final labels
+    parallel_foreach(threads, strip_count,
+        [&](const int /*threadId*/, const uint64_t k)
+        {
+            Label offset = offsets[k];
+            typename MultiArrayView<N, Label, S2>::iterator i = label_strips[k].begin(),
+                                                            end = label_strips[k].end();
+            for(; i != end; ++i)
+                if(*i != 0)
+                    *i = global_unions.findLabel(*i + offset);
+        }
+    );
+    return count;
+}
+
+template <unsigned int N, class Data, class S1,
+                          class Label, class S2>
+Label labelMultiArrayParallel(const MultiArrayView<N, Data, S1>& data,
+                              MultiArrayView<N, Label, S2> labels,
+                              const BlockwiseLabelOptions& options = BlockwiseLabelOptions())
+{
+    return labelMultiArrayParallel(data, labels, options, std::equal_to<Data>());
+}
+
 //@}
 
 } // namespace vigra
@@ -0,0 +1,572 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_EDGE_CONTRACTION_GRAPH_HXX
+#define VIGRA_EDGE_CONTRACTION_GRAPH_HXX
+
+/*std*/
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+/*vigra*/
+#include "error.hxx"
+#include "sized_int.hxx"
+#include "graphs.hxx"
+#include "graph_item_impl.hxx"
+
+namespace vigra{
+
+    /// \cond
+    namespace detail_edge_contraction_graph{
+
+        // open addressing hash table (linear probing, backward shift deletion)
+        // from the (ordered) node pair of an edge to the edge id
+        template<class INDEX_TYPE>
+        class NodePairTable{
+        public:
+            typedef INDEX_TYPE index_type;
+            static UInt64 empty(){
+                return ~UInt64(0);
+            }
+
+            void allocate(const size_t maxSize){
+                size_t capacity = 16;
+                while(capacity < 2*maxSize)
+                    capacity *= 2;
+                shift_ = 64;
+                for(size_t c=capacity; c>1; c/=2)
+                    --shift_;
+                mask_ = capacity-1;
+                keys_.assign(capacity, empty());
+                values_.resize(capacity);
+            }
+
+            // position of the key, or -1
+            Int64 find(const UInt64 key)const{
+                for(size_t i=slot(key); keys_[i]!=empty(); i=(i+1)&mask_)
+                    if(keys_[i]==key)
+                        return static_cast<Int64>(i);
+                return -1;
+            }
+
+            // the key must not be in the table, and the table must not be full
+            void insert(const UInt64 key, const index_type value){
+                size_t i = slot(key);
+                while(keys_[i]!=empty())
+                    i = (i+1)&mask_;
+                keys_[i] = key;
+                values_[i] = value;
+            }
+
+            void erase(size_t pos){
+                // shift back the following keys which can't be found otherwise
+                for(size_t i=(pos+1)&mask_; keys_[i]!=empty(); i=(i+1)&mask_){
+                    const size_t home = slot(keys_[i]);
+                    if(((i-home)&mask_) >= ((i-pos)&mask_)){
+                        keys_[pos] = keys_[i];
+                        values_[pos] = values_[i];
+                        pos = i;
+                    }
+                }
+                keys_[pos] = empty();
+            }
+
+            index_type value(const size_t pos)const{
+                return values_[pos];
+            }
+
+            size_t memoryConsumption()const{
+                return keys_.capacity()*sizeof(UInt64) + values_.capacity()*sizeof(index_type);
+            }
+
+        private:
+            size_t slot(const UInt64 key)const{
+                // Fibonacci hashing
+                return static_cast<size_t>((key * UInt64(0x9E3779B97F4A7C15ull)) >> shift_) & mask_;
+            }
+
+            std::vector<UInt64>     keys_;
+            std::vector<index_type> values_;
+            size_t                  mask_;
+            unsigned int            shift_;
+        };
+
+        template<class GRAPH, class ITEM>
+        class ItemIt{
+        public:
+            ItemIt(const lemon::Invalid & = lemon::INVALID)
+            :   graph_(0), id_(0), end_(0){
+            }
+            ItemIt(const GRAPH & graph)
+            :   graph_(&graph), id_(0), end_(graph.maxItemId(ITEM())+1){
+                advance();
+            }
+            ItemIt & operator++(){
+                ++id_;
+                advance();
+                return *this;
+            }
+            ITEM operator*()const{
+                return ITEM(id_);
+            }
+            bool operator==(const lemon::Invalid &)const{
+                return id_>=end_;
+            }
+            bool operator!=(const lemon::Invalid &)const{
+                return id_<end_;
+            }
+        private:
+            void advance(){
+                while(id_<end_ && !graph_->hasItemId(ITEM(id_)))
+                    ++id_;
+            }
+            const GRAPH * graph_;
+            Int64 id_, end_;
+        };
+
+        template<class GRAPH>
+        class IncEdgeIt{
+        public:
+            typedef typename GRAPH::Edge Edge;
+            IncEdgeIt(const lemon::Invalid & = lemon::INVALID)
+            :   graph_(0), iter_(0), end_(0){
+            }
+            IncEdgeIt(const GRAPH & graph, const typename GRAPH::Node & node)
+            :   graph_(&graph),
+                iter_(graph.adjacencyBegin(node)),
+                end_(graph.adjacencyEnd(node)){
+                advance();
+            }
+            IncEdgeIt & operator++(){
+                ++iter_;
+                advance();
+                return *this;
+            }
+            Edge operator*()const{
+                return Edge(*iter_);
+            }
+            bool operator==(const lemon::Invalid &)const{
+                return iter_==end_;
+            }
+            bool operator!=(const lemon::Invalid &)const{
+                return iter_!=end_;
+            }
+        private:
+            // adjacency lists may contain edges which have been removed
+            void advance(){
+                while(iter_!=end_ && !graph_->hasEdgeId(*iter_))
+                    ++iter_;
+            }
+            const GRAPH * graph_;
+            const Int64 * iter_;
+            const Int64 * end_;
+        };
+
+    } // namespace detail_edge_contraction_graph
+    /// \endcond
+
+    /// \brief callback policy of EdgeContractionGraph which does nothing
+    struct EdgeContractionNoCallbacks{
+        template<class NODE>
+        void mergeNodes(const NODE & /*alive*/, const NODE & /*dead*/){}
+        template<class EDGE>
+        void mergeEdges(const EDGE & /*alive*/, const EDGE & /*dead*/){}
+        template<class EDGE>
+        void eraseEdge(const EDGE & /*edge*/){}
+    };
+
+    /// \brief memory-lean edge contraction on top of a graph
+    ///
+    /// This is a lightweight alternative to MergeGraphAdaptor for agglomeration
+    /// on large graphs. Node and edge ids are the ids of the base graph.
+    /// Contracting an edge merges its end nodes, and parallel edges which
+    /// arise from the merge are merged as well.
+    ///
+    /// All state is kept in flat arrays: a union-find forest for the nodes
+    /// and for the merged edges, the current end nodes of every edge, and
+    /// an unordered list of incident edge ids per node. A single open
+    /// addressing hash table maps the node pair of every edge to the edge id.
+    /// Both forests are linked by rank, so reprNodeId() and reprEdgeId() take
+    /// O(log N) steps. The incident edges of the node with lower rank are moved
+    /// to the other node, which becomes the representative, so a merge costs
+    /// O(degree) hash lookups instead of merging sorted adjacency sets, and
+    /// every edge is moved at most O(log N) times. Removed edges are skipped
+    /// lazily in the adjacency lists.
+    ///
+    /// The \a CALLBACKS policy is called after every contraction, in the same
+    /// order as the callbacks of MergeGraphAdaptor:
+    /// <tt>mergeNodes(Node alive, Node dead)</tt>, then
+    /// <tt>mergeEdges(Edge alive, Edge dead)</tt> for all merged parallel edges,
+    /// and finally <tt>eraseEdge(Edge contracted)</tt>. The calls are resolved
+    /// at compile time, so they can be inlined. The policy object is stored
+    /// by value (see callbacks()).
+    ///
+    /// <b>Usage:</b>
+    /// \code
+    /// struct MeanEdgeWeight{
+    ///     ...
+    ///     template<class NODE> void mergeNodes(const NODE & a, const NODE & b){ ... }
+    ///     template<class EDGE> void mergeEdges(const EDGE & a, const EDGE & b){ ... }
+    ///     template<class EDGE> void eraseEdge(const EDGE & e){ ... }
+    /// };
+    ///
+    /// EdgeContractionGraph<AdjacencyListGraph, MeanEdgeWeight> cgraph(rag, MeanEdgeWeight(...));
+    /// cgraph.contractEdge(cgraph.edgeFromId(cheapestEdge));
+    /// \endcode
+    ///
+    template<class GRAPH, class CALLBACKS = EdgeContractionNoCallbacks>
+    class EdgeContractionGraph{
+    public:
+        typedef GRAPH                              Graph;
+        typedef CALLBACKS                          Callbacks;
+        typedef Int64                              index_type;
+        typedef EdgeContractionGraph<GRAPH, CALLBACKS> GraphType;
+        typedef detail::GenericNode<index_type>    Node;
+        typedef detail::GenericEdge<index_type>    Edge;
+        typedef detail_edge_contraction_graph::ItemIt<GraphType, Node> NodeIt;
+        typedef detail_edge_contraction_graph::ItemIt<GraphType, Edge> EdgeIt;
+        typedef detail_edge_contraction_graph::IncEdgeIt<GraphType>    IncEdgeIt;
+
+        /// \brief construct the contraction graph of \a graph (no edge is contracted)
+        EdgeContractionGraph(const Graph & graph, const Callbacks & callbacks = Callbacks());
+
+        /// \brief number of nodes (clusters)
+        size_t nodeNum()const{
+            return nodeNum_;
+        }
+        /// \brief number of edges between different clusters
+        size_t edgeNum()const{
+            return edgeNum_;
+        }
+        index_type maxNodeId()const{
+            return static_cast<index_type>(nodeParent_.size())-1;
+        }
+        index_type maxEdgeId()const{
+            return static_cast<index_type>(uIds_.size())-1;
+        }
+
+        /// \brief check if \a id is the id of a representative node
+        bool hasNodeId(const index_type id)const{
+            return id>=0 && id<=maxNodeId() && nodeParent_[id]==id;
+        }
+        /// \brief check if \a id is the id of an edge between different clusters
+        bool hasEdgeId(const index_type id)const{
+            return id>=0 && id<=maxEdgeId() && uIds_[id]>=0;
+        }
+
+        Node nodeFromId(const index_type id)const{
+            return hasNodeId(id) ? Node(id) : Node(lemon::INVALID);
+        }
+        Edge edgeFromId(const index_type id)const{
+            return hasEdgeId(id) ? Edge(id) : Edge(lemon::INVALID);
+        }
+        index_type id(const Node & node)const{
+            return node.id();
+        }
+        index_type id(const Edge & edge)const{
+            return edge.id();
+        }
+
+        /// \brief current end nodes of an edge
+        Node u(const Edge & edge)const{
+            return Node(uIds_[edge.id()]);
+        }
+        Node v(const Edge & edge)const{
+            return Node(vIds_[edge.id()]);
+        }
+
+        /// \brief number of edges of a node
+        size_t degree(const Node & node)const{
+            return degree_[node.id()];
+        }
+
+        /// \brief edge between two nodes, or lemon::INVALID
+        Edge findEdge(const Node & a, const Node & b)const{
+            if(a==b)
+                return Edge(lemon::INVALID);
+            const Int64 pos = table_.find(key(a.id(), b.id()));
+            return pos>=0 ? Edge(table_.value(pos)) : Edge(lemon::INVALID);
+        }
+
+        /// \brief representative node id of a node of the base graph (O(log N))
+        index_type reprNodeId(index_type id)const{
+            while(nodeParent_[id]!=id)
+                id = nodeParent_[id];
+            return id;
+        }
+        /// \brief representative edge id of an edge of the base graph
+        ///
+        /// For a contracted edge (and edges merged into it), this
+        /// is the id of the contracted edge.
+        index_type reprEdgeId(index_type id)const{
+            while(edgeParent_[id]!=id)
+                id = edgeParent_[id];
+            return id;
+        }
+        /// \brief the cluster which contains a contracted edge
+        Node inactiveEdgesNode(const Edge & edge)const{
+            return Node(reprNodeId(graph_.id(graph_.u(graph_.edgeFromId(edge.id())))));
+        }
+
+        /// \brief contract an edge
+        void contractEdge(const Edge & edge);
+
+        const Graph & graph()const{
+            return graph_;
+        }
+        Callbacks & callbacks(){
+            return callbacks_;
+        }
+        const Callbacks & callbacks()const{
+            return callbacks_;
+        }
+
+        /// \brief approximate number of bytes used by the contraction graph
+        size_t memoryConsumption()const;
+
+        /// \cond
+        // interface of the item iterators
+        index_type maxItemId(const Node &)const{
+            return maxNodeId();
+        }
+        index_type maxItemId(const Edge &)const{
+            return maxEdgeId();
+        }
+        bool hasItemId(const Node & node)const{
+            return hasNodeId(node.id());
+        }
+        bool hasItemId(const Edge & edge)const{
+            return hasEdgeId(edge.id());
+        }
+        const index_type * adjacencyBegin(const Node & node)const{
+            return adjacency_[node.id()].data();
+        }
+        const index_type * adjacencyEnd(const Node & node)const{
+            return adjacency_[node.id()].data() + adjacency_[node.id()].size();
+        }
+        /// \endcond
+
+    private:
+        EdgeContractionGraph(const EdgeContractionGraph &);             // non copyable
+        EdgeContractionGraph & operator=(const EdgeContractionGraph &); // non copyable
+
+        UInt64 key(index_type a, index_type b)const{
+            if(b<a)
+                std::swap(a, b);
+            return static_cast<UInt64>(a)*static_cast<UInt64>(nodeParent_.size()) + static_cast<UInt64>(b);
+        }
+
+        void eraseFromTable(const UInt64 k){
+            const Int64 pos = table_.find(k);
+            vigra_invariant(pos>=0,
+                "EdgeContractionGraph::contractEdge(): edge is missing in the node pair table.");
+            table_.erase(pos);
+        }
+
+        void removeFromAdjacency(const index_type node){
+            // drop the removed edges once they make up half of the list
+            std::vector<index_type> & adj = adjacency_[node];
+            if(adj.size() > 2*static_cast<size_t>(degree_[node]) + 8){
+                size_t k = 0;
+                for(size_t i=0; i<adj.size(); ++i)
+                    if(uIds_[adj[i]]>=0)
+                        adj[k++] = adj[i];
+                adj.resize(k);
+            }
+        }
+
+        const Graph & graph_;
+        Callbacks callbacks_;
+        size_t nodeNum_;
+        size_t edgeNum_;
+        std::vector<index_type> nodeParent_;
+        std::vector<index_type> edgeParent_;
+        std::vector<index_type> uIds_;   // -1 for removed edges
+        std::vector<index_type> vIds_;
+        std::vector<index_type> degree_;
+        std::vector<UInt8> nodeRank_;    // union by rank keeps the forests flat
+        std::vector<UInt8> edgeRank_;
+        std::vector<std::vector<index_type> > adjacency_;
+        detail_edge_contraction_graph::NodePairTable<index_type> table_;
+        std::vector<std::pair<index_type, index_type> > mergedEdges_;
+    };
+
+    template<class GRAPH, class CALLBACKS>
+    EdgeContractionGraph<GRAPH, CALLBACKS>::EdgeContractionGraph(
+        const Graph & graph,
+        const Callbacks & callbacks
+    )
+    :   graph_(graph),
+        callbacks_(callbacks),
+        nodeNum_(graph.nodeNum()),
+        edgeNum_(0),
+        nodeParent_(graph.maxNodeId()+1, -1),
+        edgeParent_(graph.maxEdgeId()+1),
+        uIds_(graph.maxEdgeId()+1, -1),
+        vIds_(graph.maxEdgeId()+1, -1),
+        degree_(graph.maxNodeId()+1, 0),
+        nodeRank_(graph.maxNodeId()+1, 0),
+        edgeRank_(graph.maxEdgeId()+1, 0),
+        adjacency_(graph.maxNodeId()+1),
+        table_(),
+        mergedEdges_()
+    {
+        for(typename Graph::NodeIt n(graph); n!=lemon::INVALID; ++n)
+            nodeParent_[graph.id(*n)] = graph.id(*n);
+        for(size_t e=0; e<edgeParent_.size(); ++e)
+            edgeParent_[e] = e;
+
+        table_.allocate(graph.edgeNum());
+        for(typename Graph::EdgeIt e(graph); e!=lemon::INVALID; ++e){
+            const index_type id = graph.id(*e);
+            const index_type u  = graph.id(graph.u(*e));
+            const index_type v  = graph.id(graph.v(*e));
+            if(u==v)
+                continue;
+            const Int64 pos = table_.find(key(u, v));
+            if(pos>=0){
+                // parallel edges of the base graph are merged right away
+                edgeParent_[id] = table_.value(pos);
+                edgeRank_[table_.value(pos)] = 1;
+                continue;
+            }
+            table_.insert(key(u, v), id);
+            uIds_[id] = u;
+            vIds_[id] = v;
+            ++degree_[u];
+            ++degree_[v];
+            ++edgeNum_;
+        }
+        for(size_t n=0; n<adjacency_.size(); ++n)
+            adjacency_[n].reserve(degree_[n]);
+        for(size_t e=0; e<uIds_.size(); ++e){
+            if(uIds_[e]>=0){
+                adjacency_[uIds_[e]].push_back(e);
+                adjacency_[vIds_[e]].push_back(e);
+            }
+        }
+    }
+
+    template<class GRAPH, class CALLBACKS>
+    void EdgeContractionGraph<GRAPH, CALLBACKS>::contractEdge(const Edge & edge){
+        const index_type e = edge.id();
+        vigra_precondition(hasEdgeId(e),
+            "EdgeContractionGraph::contractEdge(): edge has already been removed.");
+
+        // the node with higher rank survives, for equal ranks the one with more edges
+        index_type alive = uIds_[e];
+        index_type dead  = vIds_[e];
+        if(nodeRank_[alive] < nodeRank_[dead] ||
+           (nodeRank_[alive] == nodeRank_[dead] && degree_[alive] < degree_[dead]))
+            std::swap(alive, dead);
+        if(nodeRank_[alive] == nodeRank_[dead])
+            ++nodeRank_[alive];
+
+        eraseFromTable(key(alive, dead));
+        uIds_[e] = vIds_[e] = -1;
+        --edgeNum_;
+        --degree_[alive];
+        nodeParent_[dead] = alive;
+        --nodeNum_;
+
+        mergedEdges_.clear();
+        std::vector<index_type> deadAdjacency;
+        deadAdjacency.swap(adjacency_[dead]);
+        degree_[dead] = 0;
+        for(size_t i=0; i<deadAdjacency.size(); ++i){
+            const index_type f = deadAdjacency[i];
+            if(uIds_[f]<0)
+                continue;
+            const index_type other = uIds_[f]==dead ? vIds_[f] : uIds_[f];
+            eraseFromTable(key(dead, other));
+            const Int64 pos = table_.find(key(alive, other));
+            if(pos>=0){
+                // parallel edge, the edge with higher rank survives
+                index_type g = table_.value(pos);
+                index_type h = f;
+                if(edgeRank_[g] < edgeRank_[h]){
+                    std::swap(g, h);
+                    table_.erase(pos);
+                    table_.insert(key(alive, other), g);
+                    if(uIds_[g]==dead)
+                        uIds_[g] = alive;
+                    else
+                        vIds_[g] = alive;
+                    adjacency_[alive].push_back(g);
+                }
+                if(edgeRank_[g] == edgeRank_[h])
+                    ++edgeRank_[g];
+                edgeParent_[h] = g;
+                uIds_[h] = vIds_[h] = -1;
+                --edgeNum_;
+                --degree_[other];
+                removeFromAdjacency(other);
+                mergedEdges_.push_back(std::make_pair(g, h));
+            }
+            else{
+                if(uIds_[f]==dead)
+                    uIds_[f] = alive;
+                else
+                    vIds_[f] = alive;
+                table_.insert(key(alive, other), f);
+                adjacency_[alive].push_back(f);
+                ++degree_[alive];
+            }
+        }
+        removeFromAdjacency(alive);
+
+        callbacks_.mergeNodes(Node(alive), Node(dead));
+        for(size_t i=0; i<mergedEdges_.size(); ++i)
+            callbacks_.mergeEdges(Edge(mergedEdges_[i].first), Edge(mergedEdges_[i].second));
+        callbacks_.eraseEdge(edge);
+    }
+
+    template<class GRAPH, class CALLBACKS>
+    size_t EdgeContractionGraph<GRAPH, CALLBACKS>::memoryConsumption()const{
+        size_t size = sizeof(*this)
+                    + (nodeParent_.capacity() + degree_.capacity()) * sizeof(index_type)
+                    + nodeRank_.capacity() + edgeRank_.capacity()
+                    + (edgeParent_.capacity() + uIds_.capacity() + vIds_.capacity()) * sizeof(index_type)
+                    + adjacency_.capacity() * sizeof(std::vector<index_type>)
+                    + table_.memoryConsumption();
+        for(size_t n=0; n<adjacency_.size(); ++n)
+            size += adjacency_[n].capacity() * sizeof(index_type);
+        return size;
+    }
+
+} // namespace vigra
+
+#endif // VIGRA_EDGE_CONTRACTION_GRAPH_HXX
@@ -0,0 +1,198 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_GRAPH_AFFILIATED_EDGES_HXX
+#define VIGRA_GRAPH_AFFILIATED_EDGES_HXX
+
+/*std*/
+#include <vector>
+#include <limits>
+
+/*vigra*/
+#include "error.hxx"
+#include "sized_int.hxx"
+#include "graphs.hxx"
+#include "adjacency_list_graph.hxx"
+
+namespace vigra{
+
+    /// \brief compact store of the affiliated edges of a region adjacency graph
+    ///
+    /// For every edge of a region adjacency graph (see makeRegionAdjacencyGraph()),
+    /// the ids of the affiliated edges of the base graph are stored in one flat array,
+    /// indexed by an offset array (CSR layout). Compared to an
+    /// <tt>AdjacencyListGraph::EdgeMap< std::vector<GRAPH::Edge> ></tt> this
+    /// saves the per-vector heap overhead, and stores one id of type \a INDEX_TYPE
+    /// instead of a full edge descriptor (<tt>(N+1)*sizeof(MultiArrayIndex)</tt>
+    /// bytes for a GridGraph). Choosing <tt>UInt32</tt> as \a INDEX_TYPE halves the
+    /// memory again as long as <tt>graph.maxEdgeId()</tt> fits.
+    ///
+    /// <tt>affiliatedEdges[ragEdge]</tt> returns a lightweight range with
+    /// <tt>size()</tt> and <tt>operator[]</tt> that yields base graph edges, so code
+    /// templated on the affiliated edge container (e.g. serializeAffiliatedEdges(),
+    /// projectBackEdges()) works with both representations. The affiliated edges
+    /// of each RAG edge keep the order of the EdgeMap representation.
+    ///
+    /// Only a pointer to the base graph is stored (also in the ranges), so the base
+    /// graph must outlive the store and all ranges obtained from it.
+    ///
+    /// <b>\#include</b> \<vigra/graph_affiliated_edges.hxx\><br>
+    /// Namespace: vigra
+    template<class GRAPH, class INDEX_TYPE = MultiArrayIndex>
+    class CompactAffiliatedEdges{
+    public:
+        typedef GRAPH                         Graph;
+        typedef typename Graph::Edge          Edge;
+        typedef INDEX_TYPE                    index_type;
+        typedef AdjacencyListGraph::Edge      RagEdge;
+
+        /// affiliated edges of a single RAG edge
+        class const_reference{
+        public:
+            typedef Edge                value_type;
+            typedef const index_type *  const_iterator;
+
+            const_reference(const Graph & graph, const index_type * begin, const index_type * end)
+            :   graph_(&graph),
+                begin_(begin),
+                end_(end){
+            }
+
+            size_t size()const{
+                return end_ - begin_;
+            }
+            bool empty()const{
+                return begin_ == end_;
+            }
+            /// i-th affiliated edge of the base graph
+            Edge operator[](const size_t i)const{
+                return graph_->edgeFromId(begin_[i]);
+            }
+            /// id of the i-th affiliated edge in the base graph
+            index_type id(const size_t i)const{
+                return begin_[i];
+            }
+            /// iterate over the ids of the affiliated edges
+            const_iterator begin()const{
+                return begin_;
+            }
+            const_iterator end()const{
+                return end_;
+            }
+
+        private:
+            const Graph * graph_;
+            const index_type * begin_;
+            const index_type * end_;
+        };
+
+        CompactAffiliatedEdges()
+        :   graph_(NULL),
+            offsets_(1, 0),
+            ids_(){
+        }
+
+        /// convert from the EdgeMap representation
+        template<class AFF_EDGES>
+        CompactAffiliatedEdges(const Graph & graph, const AdjacencyListGraph & rag, const AFF_EDGES & affiliatedEdges)
+        :   graph_(NULL),
+            offsets_(1, 0),
+            ids_(){
+            std::vector<size_t> counts(rag.edgeNum()==0 ? 0 : rag.maxEdgeId()+1, 0);
+            for(AdjacencyListGraph::EdgeIt iter(rag); iter!=lemon::INVALID; ++iter)
+                counts[rag.id(*iter)] = affiliatedEdges[*iter].size();
+            allocate(graph, counts);
+            for(AdjacencyListGraph::EdgeIt iter(rag); iter!=lemon::INVALID; ++iter){
+                index_type * target = ids(rag.id(*iter));
+                for(size_t i=0; i<counts[rag.id(*iter)]; ++i)
+                    target[i] = static_cast<index_type>(graph.id(affiliatedEdges[*iter][i]));
+            }
+        }
+
+        /// \brief allocate the store
+        ///
+        /// \a counts holds the number of affiliated edges per RAG edge id. The ids
+        /// are left uninitialized and have to be written via ids().
+        void allocate(const Graph & graph, const std::vector<size_t> & counts){
+            vigra_precondition(graph.maxEdgeId() < 0 ||
+                static_cast<UInt64>(graph.maxEdgeId()) <= static_cast<UInt64>(std::numeric_limits<index_type>::max()),
+                "CompactAffiliatedEdges::allocate(): index_type too small for the edge ids of the graph.");
+            graph_ = &graph;
+            offsets_.resize(counts.size()+1);
+            offsets_[0] = 0;
+            for(size_t e=0; e<counts.size(); ++e)
+                offsets_[e+1] = offsets_[e] + counts[e];
+            std::vector<index_type>().swap(ids_);
+            ids_.resize(offsets_.back());
+        }
+
+        const_reference operator[](const RagEdge & edge)const{
+            const size_t e = static_cast<size_t>(edge.id());
+            return const_reference(*graph_, ids_.data() + offsets_[e], ids_.data() + offsets_[e+1]);
+        }
+
+        /// number of affiliated edges of the RAG edge with id \a ragEdgeId
+        size_t size(const Int64 ragEdgeId)const{
+            return offsets_[ragEdgeId+1] - offsets_[ragEdgeId];
+        }
+        /// ids of the affiliated edges of the RAG edge with id \a ragEdgeId
+        index_type * ids(const Int64 ragEdgeId){
+            return ids_.data() + offsets_[ragEdgeId];
+        }
+        const index_type * ids(const Int64 ragEdgeId)const{
+            return ids_.data() + offsets_[ragEdgeId];
+        }
+
+        /// number of affiliated edges of all RAG edges
+        size_t numberOfAffiliatedEdges()const{
+            return ids_.size();
+        }
+        /// heap memory in bytes
+        size_t memoryConsumption()const{
+            return offsets_.capacity()*sizeof(size_t) + ids_.capacity()*sizeof(index_type);
+        }
+        const Graph & graph()const{
+            return *graph_;
+        }
+
+    private:
+        const Graph * graph_;
+        std::vector<size_t> offsets_;
+        std::vector<index_type> ids_;
+    };
+
+} // namespace vigra
+
+#endif // VIGRA_GRAPH_AFFILIATED_EDGES_HXX
@@ -45,7 +45,10 @@
 #include <vector>
 #include <functional>
 #include <set>
+#include <unordered_map>
+#include <utility>
 #include <iomanip>
+#include <type_traits>
 
 /*vigra*/
 #include "graphs.hxx"
@@ -55,6 +58,8 @@
 #include "union_find.hxx"
 #include "adjacency_list_graph.hxx"
 #include "graph_maps.hxx"
+#include "graph_affiliated_edges.hxx"
+#include "threadpool.hxx"
 
 #include "timing.hxx"
 //#include "openmp_helper.hxx"
@@ -213,6 +218,290 @@ namespace vigra{
         }
     }
 
+    namespace detail_graph_algorithms{
+
+        // hash of an (ordered) label pair
+        template<class LABEL_TYPE>
+        struct RagLabelPairHash{
+            size_t operator()(const std::pair<LABEL_TYPE,LABEL_TYPE> & p)const{
+                const std::hash<LABEL_TYPE> h;
+                return h(p.first) * static_cast<size_t>(0x9E3779B97F4A7C15ull) ^ h(p.second);
+            }
+        };
+
+        // boundary edges of one slab with equal label pair:
+        // [begin,end) in the grouped EdgeIt positions of the slab
+        template<class LABEL_TYPE>
+        struct RagBoundaryRun{
+            LABEL_TYPE u, v;
+            size_t slab, begin, end;
+            Int64  ragEdge;
+        };
+
+        // slab-parallel RAG construction, see makeRegionAdjacencyGraph(..., ParallelOptions).
+        // allocate(counts) sizes the affiliated edge store (counts per rag edge id),
+        // write(ragEdgeId, offset, begin, end) stores the affiliated edges given by
+        // their EdgeIt positions (node id * maxUniqueDegree + neighbor index)
+        template<unsigned int DIM, class DTAG, class LABEL_TYPE, class STRIDE, class ALLOCATE, class WRITE>
+        void makeRegionAdjacencyGraphSlabs(
+            const GridGraph<DIM,DTAG> & graphIn,
+            const MultiArrayView<DIM,LABEL_TYPE,STRIDE> & labels,
+            AdjacencyListGraph & rag,
+            const Int64 ignoreLabel,
+            const ParallelOptions & options,
+            ALLOCATE allocate,
+            WRITE write
+        ){
+            // only the back neighbors are visited, i.e. every edge is seen once
+            static_assert(std::is_same<DTAG, undirected_tag>::value,
+                "makeRegionAdjacencyGraph(..., ParallelOptions): only undirected grid graphs are supported.");
+            typedef GridGraph<DIM,DTAG>                  GraphIn;
+            typedef typename GraphIn::Edge               EdgeGraphIn;
+            typedef typename GraphIn::shape_type         Shape;
+            typedef std::pair<LABEL_TYPE,LABEL_TYPE>     LabelPair;
+            typedef detail_graph_algorithms::RagBoundaryRun<LABEL_TYPE> BoundaryRun;
+            typedef std::unordered_map<LabelPair, size_t,
+                        detail_graph_algorithms::RagLabelPairHash<LABEL_TYPE> > PairIndexMap;
+
+            vigra_precondition(graphIn.shape() == labels.shape(),
+                "makeRegionAdjacencyGraph(): shape mismatch between graph and labels.");
+
+            rag=AdjacencyListGraph();
+
+            const Shape shape = graphIn.shape();
+            const int nThreads = options.getActualNumThreads();
+            const size_t nSlabs = std::max<size_t>(1, std::min<size_t>(shape[DIM-1], 4*nThreads));
+            const Int64  maxUniqueDegree = graphIn.maxUniqueDegree();
+            const typename GraphIn::IndexArray & backIndices = *graphIn.neighborIndexArray(true);
+
+            std::vector<MultiArrayIndex> labelOffsets(maxUniqueDegree);
+            for(Int64 k=0; k<maxUniqueDegree; ++k)
+                labelOffsets[k] = dot(graphIn.neighborOffset(k), labels.stride());
+
+            std::vector<std::vector<LABEL_TYPE> > slabLabels(nSlabs);
+            std::vector<std::vector<LabelPair> >  slabPairs(nSlabs);
+            std::vector<std::vector<size_t> >     slabPairBegin(nSlabs);
+            std::vector<std::vector<Int64> >      slabOrders(nSlabs);
+
+            // collect the labels and boundary edges of each slab
+            parallel_foreach(nThreads, nSlabs,
+                [&](const int /*threadId*/, const uint64_t s){
+                    Shape begin, end(shape);
+                    begin[DIM-1] = s*shape[DIM-1]/nSlabs;
+                    end[DIM-1]   = (s+1)*shape[DIM-1]/nSlabs;
+                    const Int64 firstNode = graphIn.id(graphIn.nodeFromId(0) + begin);
+
+                    std::vector<LABEL_TYPE> & slabL = slabLabels[s];
+                    std::vector<LabelPair>  & pairs = slabPairs[s];
+                    std::vector<std::pair<size_t, Int64> > found;
+                    PairIndexMap pairIndex;
+                    size_t lastIndex = 0;
+                    for(MultiCoordinateIterator<DIM> iter(end-begin); iter.isValid(); ++iter){
+                        const Shape node(*iter + begin);
+                        const LABEL_TYPE * l = &labels[node];
+                        if(ignoreLabel!=-1 && static_cast<Int64>(*l)==ignoreLabel)
+                            continue;
+                        // labels come in runs, so consecutive duplicates are cheap to skip
+                        if(slabL.empty() || slabL.back()!=*l)
+                            slabL.push_back(*l);
+                        const ArrayVector<MultiArrayIndex> & back = backIndices[graphIn.get_border_type(node)];
+                        for(size_t k=0; k<back.size(); ++k){
+                            const LABEL_TYPE lo = l[labelOffsets[back[k]]];
+                            if(lo==*l || (ignoreLabel!=-1 && static_cast<Int64>(lo)==ignoreLabel))
+                                continue;
+                            const LabelPair p(std::min(*l,lo), std::max(*l,lo));
+                            // consecutive boundary edges mostly separate the same regions
+                            if(pairs.empty() || pairs[lastIndex]!=p){
+                                lastIndex = pairIndex.insert(std::make_pair(p, pairs.size())).first->second;
+                                if(lastIndex==pairs.size())
+                                    pairs.push_back(p);
+                            }
+                            found.push_back(std::make_pair(lastIndex,
+                                (firstNode + iter.scanOrderIndex())*maxUniqueDegree + back[k]));
+                        }
+                    }
+                    std::sort(slabL.begin(), slabL.end());
+                    slabL.erase(std::unique(slabL.begin(), slabL.end()), slabL.end());
+
+                    // counting sort by pair, stable w.r.t. EdgeIt order
+                    std::vector<size_t> & pairBegin = slabPairBegin[s];
+                    pairBegin.assign(pairs.size()+1, 0);
+                    for(size_t i=0; i<found.size(); ++i)
+                        ++pairBegin[found[i].first+1];
+                    for(size_t i=0; i<pairs.size(); ++i)
+                        pairBegin[i+1] += pairBegin[i];
+                    std::vector<size_t> fillPos(pairBegin.begin(), pairBegin.end()-1);
+                    std::vector<Int64> & orders = slabOrders[s];
+                    orders.resize(found.size());
+                    for(size_t i=0; i<found.size(); ++i)
+                        orders[fillPos[found[i].first]++] = found[i].second;
+                }
+            );
+
+            // nodes
+            std::vector<LABEL_TYPE> nodeLabels;
+            for(size_t s=0; s<nSlabs; ++s)
+                nodeLabels.insert(nodeLabels.end(), slabLabels[s].begin(), slabLabels[s].end());
+            std::sort(nodeLabels.begin(), nodeLabels.end());
+            nodeLabels.erase(std::unique(nodeLabels.begin(), nodeLabels.end()), nodeLabels.end());
+            if(!nodeLabels.empty())
+                rag.reserveMaxNodeId(nodeLabels.back());
+            for(size_t i=0; i<nodeLabels.size(); ++i)
+                rag.addNode(nodeLabels[i]);
+
+            // one run per label pair and slab, in slab order
+            std::vector<BoundaryRun> runs;
+            for(size_t s=0; s<nSlabs; ++s){
+                for(size_t i=0; i<slabPairs[s].size(); ++i){
+                    BoundaryRun run;
+                    run.u = slabPairs[s][i].first;
+                    run.v = slabPairs[s][i].second;
+                    run.slab = s;
+                    run.begin = slabPairBegin[s][i];
+                    run.end = slabPairBegin[s][i+1];
+                    runs.push_back(run);
+                }
+            }
+            const auto firstOrder = [&](size_t r){
+                return slabOrders[runs[r].slab][runs[r].begin];
+            };
+            const auto samePair = [&](size_t a, size_t b){
+                return runs[a].u==runs[b].u && runs[a].v==runs[b].v;
+            };
+
+            // rag edges are added in order of their first occurrence, as in the serial algorithm
+            std::vector<size_t> byPair(runs.size());
+            for(size_t i=0; i<runs.size(); ++i)
+                byPair[i]=i;
+            std::sort(byPair.begin(), byPair.end(), [&](size_t a, size_t b){
+                return runs[a].u < runs[b].u || (runs[a].u == runs[b].u &&
+                      (runs[a].v < runs[b].v || (runs[a].v == runs[b].v && a < b)));
+            });
+            std::vector<size_t> firstRuns;
+            for(size_t i=0; i<byPair.size(); ++i)
+                if(i==0 || !samePair(byPair[i], byPair[i-1]))
+                    firstRuns.push_back(byPair[i]);
+            std::sort(firstRuns.begin(), firstRuns.end(), [&](size_t a, size_t b){
+                return firstOrder(a) < firstOrder(b);
+            });
+            rag.reserveEdges(firstRuns.size());
+            for(size_t i=0; i<firstRuns.size(); ++i){
+                // orientation as in the first boundary edge
+                EdgeGraphIn first;
+                first.template subarray<0,DIM>() = graphIn.nodeFromId(firstOrder(firstRuns[i]) / maxUniqueDegree);
+                first[DIM] = firstOrder(firstRuns[i]) % maxUniqueDegree;
+                runs[firstRuns[i]].ragEdge = rag.id(rag.addEdge(rag.nodeFromId(labels[graphIn.u(first)]),
+                                                                rag.nodeFromId(labels[graphIn.v(first)])));
+            }
+            for(size_t i=1; i<byPair.size(); ++i)
+                if(samePair(byPair[i], byPair[i-1]))
+                    runs[byPair[i]].ragEdge = runs[byPair[i-1]].ragEdge;
+
+            // affiliated edges: slab order, and EdgeIt order within each slab
+            std::vector<size_t> fill(rag.maxEdgeId()+1, 0);
+            std::vector<size_t> runOffsets(runs.size());
+            for(size_t i=0; i<runs.size(); ++i){
+                runOffsets[i] = fill[runs[i].ragEdge];
+                fill[runs[i].ragEdge] += runs[i].end - runs[i].begin;
+            }
+            allocate(fill);
+
+            std::vector<size_t> slabRuns(nSlabs+1, 0);
+            for(size_t s=0; s<nSlabs; ++s)
+                slabRuns[s+1] = slabRuns[s] + slabPairs[s].size();
+
+            parallel_foreach(nThreads, nSlabs,
+                [&](const int /*threadId*/, const uint64_t s){
+                    const std::vector<Int64> & orders = slabOrders[s];
+                    for(size_t r=slabRuns[s]; r<slabRuns[s+1]; ++r)
+                        write(runs[r].ragEdge, runOffsets[r], orders.data() + runs[r].begin, orders.data() + runs[r].end);
+                }
+            );
+        }
+    } // namespace detail_graph_algorithms
+
+    /// \brief make a region adjacency graph from a GridGraph and labels in parallel
+    ///
+    /// \param graphIn  : input grid graph
+    /// \param labels   : labels w.r.t. graphIn
+    /// \param[out] rag  : region adjacency graph
+    /// \param[out] affiliatedEdges : a vector of edges of graphIn for each edge in rag
+    /// \param      ignoreLabel : label to ignore (-1 means no label will be ignored)
+    /// \param      options : number of threads
+    ///
+    /// The result is identical to the generic makeRegionAdjacencyGraph(), including
+    /// node and edge ids and the order of the affiliated edges. Instead of calling
+    /// findEdge() for every grid edge, the volume is split into slabs along the last
+    /// dimension whose boundary edges are grouped by label pair in parallel
+    /// (hashing plus a counting sort, which keeps EdgeIt order within each group).
+    /// The RAG is then built from the deduplicated pairs, and the affiliated edges
+    /// are written in parallel into preallocated vectors. graphIn must be undirected.
+    ///
+    template<unsigned int DIM, class DTAG, class LABEL_TYPE, class STRIDE>
+    void makeRegionAdjacencyGraph(
+        const GridGraph<DIM,DTAG> & graphIn,
+        const MultiArrayView<DIM,LABEL_TYPE,STRIDE> & labels,
+        AdjacencyListGraph & rag,
+        typename AdjacencyListGraph:: template EdgeMap< std::vector<typename GridGraph<DIM,DTAG>::Edge> > & affiliatedEdges,
+        const Int64 ignoreLabel,
+        const ParallelOptions & options
+    ){
+        typedef typename GridGraph<DIM,DTAG>::Edge EdgeGraphIn;
+        const Int64 maxUniqueDegree = graphIn.maxUniqueDegree();
+        detail_graph_algorithms::makeRegionAdjacencyGraphSlabs(graphIn, labels, rag, ignoreLabel, options,
+            [&](const std::vector<size_t> & counts){
+                affiliatedEdges.assign(rag);
+                for(size_t e=0; e<counts.size(); ++e)
+                    affiliatedEdges[rag.edgeFromId(e)].resize(counts[e]);
+            },
+            [&](const Int64 ragEdge, const size_t offset, const Int64 * begin, const Int64 * end){
+                std::vector<EdgeGraphIn> & target = affiliatedEdges[rag.edgeFromId(ragEdge)];
+                for(size_t i=offset; begin!=end; ++begin, ++i){
+                    target[i].template subarray<0,DIM>() = graphIn.nodeFromId(*begin / maxUniqueDegree);
+                    target[i][DIM] = *begin % maxUniqueDegree;
+                }
+            }
+        );
+    }
+
+    /// \brief make a region adjacency graph with compact affiliated edges
+    ///
+    /// \param graphIn  : input grid graph
+    /// \param labels   : labels w.r.t. graphIn
+    /// \param[out] rag  : region adjacency graph
+    /// \param[out] affiliatedEdges : ids of the edges of graphIn for each edge in rag
+    /// \param      ignoreLabel : label to ignore (-1 means no label will be ignored)
+    /// \param      options : number of threads
+    ///
+    /// Same as the EdgeMap version above, but the affiliated edges are stored in
+    /// a CompactAffiliatedEdges container, which needs only
+    /// <tt>sizeof(INDEX_TYPE)</tt> bytes per grid edge. The full EdgeMap is never
+    /// materialized, so this is the variant to use for very large volumes.
+    ///
+    template<unsigned int DIM, class DTAG, class LABEL_TYPE, class STRIDE, class INDEX_TYPE>
+    void makeRegionAdjacencyGraph(
+        const GridGraph<DIM,DTAG> & graphIn,
+        const MultiArrayView<DIM,LABEL_TYPE,STRIDE> & labels,
+        AdjacencyListGraph & rag,
+        CompactAffiliatedEdges<GridGraph<DIM,DTAG>, INDEX_TYPE> & affiliatedEdges,
+        const Int64 ignoreLabel = -1,
+        const ParallelOptions & options = ParallelOptions()
+    ){
+        const Int64 maxUniqueDegree = graphIn.maxUniqueDegree();
+        const Int64 nodeNum = graphIn.nodeNum();
+        detail_graph_algorithms::makeRegionAdjacencyGraphSlabs(graphIn, labels, rag, ignoreLabel, options,
+            [&](const std::vector<size_t> & counts){
+                affiliatedEdges.allocate(graphIn, counts);
+            },
+            [&](const Int64 ragEdge, const size_t offset, const Int64 * begin, const Int64 * end){
+                // EdgeIt position => edge id (the neighbor index is the slowest edge id dimension)
+                INDEX_TYPE * target = affiliatedEdges.ids(ragEdge) + offset;
+                for(; begin!=end; ++begin, ++target)
+                    *target = static_cast<INDEX_TYPE>(*begin / maxUniqueDegree + nodeNum * (*begin % maxUniqueDegree));
+            }
+        );
+    }
+
     template<unsigned int DIM, class DTAG, class AFF_EDGES>
     size_t affiliatedEdgesSerializationSize(
         const GridGraph<DIM,DTAG> &,
@@ -586,6 +875,634 @@ namespace vigra{
         Node target_;
     };
 
+    /// \brief shortest path computer for integer edge weights (Dial's algorithm)
+    ///
+    /// This has the same interface as \ref ShortestPathDijkstra (except for
+    /// the ROI and node weight variants of <tt>run()</tt>), but uses a cyclic array
+    /// of buckets instead of a heap. Edge weights must be non-negative integers (the
+    /// \a WEIGHT_TYPE may be a floating point type holding quantized weights).
+    /// The array holds <tt>maxWeight+1</tt> buckets, so the memory does not depend
+    /// on the path lengths. \a maxWeight may be passed to the constructor, otherwise
+    /// it is learned from the weights seen by previous runs. Nodes beyond the
+    /// window (i.e. reached via an edge heavier than the current \a maxWeight) are
+    /// buffered in a heap until the window reaches them.
+    ///
+    /// Each node is pushed once per distance improvement and outdated entries are
+    /// skipped. When all weights are at most \a maxWeight, a run costs <tt>O(E + D)</tt>
+    /// instead of <tt>O(E log N)</tt>, where \a D is the distance of the farthest visited
+    /// node. For ties, the predecessors may differ from ShortestPathDijkstra.
+    template<class GRAPH,class WEIGHT_TYPE>
+    class ShortestPathDial{
+    public:
+        typedef GRAPH Graph;
+
+        typedef typename Graph::Node Node;
+        typedef typename Graph::NodeIt NodeIt;
+        typedef typename Graph::Edge Edge;
+        typedef typename Graph::EdgeIt EdgeIt;
+        typedef typename Graph::OutArcIt OutArcIt;
+
+        typedef WEIGHT_TYPE WeightType;
+        typedef std::pair<Int64, WeightType>                  QueueItem;
+        typedef typename Graph:: template NodeMap<Node>       PredecessorsMap;
+        typedef typename Graph:: template NodeMap<WeightType> DistanceMap;
+        typedef ArrayVector<Node>                             DiscoveryOrder;
+
+        /// \brief constructor from graph
+        ///
+        /// \a maxWeight is the largest expected edge weight, it determines the number of buckets.
+        ShortestPathDial(const Graph & g, WeightType maxWeight = static_cast<WeightType>(0))
+        :   graph_(g),
+            maxWeight_(maxWeight),
+            queued_(0),
+            predMap_(g),
+            distMap_(g)
+        {
+        }
+
+        /// \brief run shortest path given edge weights
+        ///
+        /// See ShortestPathDijkstra::run(). The weights must be non-negative integers.
+        template<class WEIGHTS>
+        void run(const WEIGHTS & weights, const Node & source,
+                 const Node & target = lemon::INVALID,
+                 WeightType maxDistance=NumericTraits<WeightType>::max())
+        {
+            this->initializeMaps(source);
+            runImpl(weights, target, maxDistance);
+        }
+
+        /// \brief run shortest path again with given edge weights
+        ///
+        /// See ShortestPathDijkstra::reRun().
+        template<class WEIGHTS>
+        void reRun(const WEIGHTS & weights, const Node & source,
+                   const Node & target = lemon::INVALID,
+                   WeightType maxDistance=NumericTraits<WeightType>::max())
+        {
+            this->reInitializeMaps(source);
+            runImpl(weights, target, maxDistance);
+        }
+
+        /// \brief run shortest path with given edge weights from multiple sources.
+        ///
+        /// See ShortestPathDijkstra::runMultiSource().
+        template<class WEIGHTS, class ITER>
+        void
+        runMultiSource(const WEIGHTS & weights, ITER source_begin, ITER source_end,
+                 const Node & target = lemon::INVALID,
+                 WeightType maxDistance=NumericTraits<WeightType>::max())
+        {
+            this->initializeMapsMultiSource(source_begin, source_end);
+            runImpl(weights, target, maxDistance);
+        }
+
+        /// \brief get the graph
+        const Graph & graph()const{
+            return graph_;
+        }
+        /// \brief get the source node
+        const Node & source()const{
+            return source_;
+        }
+        /// \brief get the target node
+        const Node & target()const{
+            return target_;
+        }
+
+        /// \brief check if explicit target is given
+        bool hasTarget()const{
+            return target_!=lemon::INVALID;
+        }
+
+        /// \brief get an array with all visited nodes, sorted by distance from source
+        const DiscoveryOrder & discoveryOrder() const{
+            return discoveryOrder_;
+        }
+
+        /// \brief get the predecessors node map (after a call of run)
+        const PredecessorsMap & predecessors()const{
+            return predMap_;
+        }
+
+        /// \brief get the distances node map (after a call of run)
+        const DistanceMap & distances()const{
+            return distMap_;
+        }
+
+        /// \brief get the distance to a rarget node (after a call of run)
+        WeightType distance(const Node & target)const{
+            return distMap_[target];
+        }
+
+    private:
+
+        struct DistanceGreater{
+            bool operator()(const QueueItem & a, const QueueItem & b)const{
+                return a.second > b.second;
+            }
+        };
+
+        typedef std::priority_queue<QueueItem, std::vector<QueueItem>, DistanceGreater> OverflowQueue;
+
+        template<class WEIGHTS>
+        void runImpl(const WEIGHTS & weights,
+                     const Node & target,
+                     WeightType maxDistance)
+        {
+            // the buckets are empty unless a previous run was interrupted by an exception
+            if(queued_ > 0)
+                for(size_t i=0; i<buckets_.size(); ++i)
+                    buckets_[i].clear();
+            queued_ = 0;
+            if(buckets_.size() < static_cast<size_t>(maxWeight_) + 1)
+                buckets_.resize(static_cast<size_t>(maxWeight_) + 1);
+            const Int64 window = static_cast<Int64>(buckets_.size());
+
+            target_ = lemon::INVALID;
+            Int64 current = 0;
+            bool finished = false;
+            while(!finished){
+                if(queued_ == 0){
+                    // jump to the closest buffered node
+                    if(overflow_.empty())
+                        break;
+                    current = static_cast<Int64>(overflow_.top().second);
+                }
+                while(!overflow_.empty() && static_cast<Int64>(overflow_.top().second) - current < window){
+                    const QueueItem item = overflow_.top();
+                    overflow_.pop();
+                    buckets_[static_cast<Int64>(item.second) % window].push_back(item);
+                    ++queued_;
+                }
+                const size_t b = static_cast<size_t>(current % window);
+                while(!buckets_[b].empty()){
+                    const QueueItem item = buckets_[b].back();
+                    buckets_[b].pop_back();
+                    --queued_;
+                    const Node topNode(graph_.nodeFromId(item.first));
+                    if(item.second != distMap_[topNode])
+                        continue; // outdated entry
+                    discoveryOrder_.push_back(topNode);
+                    if(topNode == target){
+                        finished = true;
+                        break;
+                    }
+                    for(OutArcIt outArcIt(graph_,topNode);outArcIt!=lemon::INVALID;++outArcIt){
+                        const WeightType w = weights[Edge(*outArcIt)];
+                        vigra_precondition(w >= static_cast<WeightType>(0) &&
+                                           static_cast<WeightType>(static_cast<Int64>(w)) == w,
+                            "ShortestPathDial::run(): edge weights must be non-negative integers.");
+                        if(w > maxWeight_)
+                            maxWeight_ = w; // the window grows at the next run
+                        const Node otherNode = graph_.target(*outArcIt);
+                        const WeightType dist = item.second + w;
+                        if(dist > maxDistance)
+                            continue;
+                        if(predMap_[otherNode]==lemon::INVALID || dist < distMap_[otherNode]){
+                            distMap_[otherNode]=dist;
+                            predMap_[otherNode]=topNode;
+                            const QueueItem otherItem(graph_.id(otherNode), dist);
+                            if(static_cast<Int64>(dist) - current < window){
+                                buckets_[static_cast<Int64>(dist) % window].push_back(otherItem);
+                                ++queued_;
+                            }
+                            else
+                                overflow_.push(otherItem);
+                        }
+                    }
+                }
+                ++current;
+            }
+            // nodes which have been reached, but not visited
+            for(size_t i=0; queued_ > 0 && i<buckets_.size(); ++i){
+                for(size_t k=0; k<buckets_[i].size(); ++k)
+                    resetPending(buckets_[i][k]);
+                queued_ -= buckets_[i].size();
+                buckets_[i].clear();
+            }
+            for(; !overflow_.empty(); overflow_.pop())
+                resetPending(overflow_.top());
+
+            if(discoveryOrder_.size() > 0 && (target == lemon::INVALID || discoveryOrder_.back() == target))
+                target_ = discoveryOrder_.back();
+        }
+
+        void resetPending(const QueueItem & item){
+            const Node node(graph_.nodeFromId(item.first));
+            if(item.second == distMap_[node])
+                predMap_[node]=lemon::INVALID;
+        }
+
+        void initializeMaps(Node const & source){
+            overflow_ = OverflowQueue();
+            for(NodeIt n(graph_); n!=lemon::INVALID; ++n){
+                const Node node(*n);
+                predMap_[node]=lemon::INVALID;
+            }
+            discoveryOrder_.clear();
+            addSource(source);
+            source_=source;
+        }
+
+        template <class ITER>
+        void initializeMapsMultiSource(ITER source, ITER source_end){
+            overflow_ = OverflowQueue();
+            for(NodeIt n(graph_); n!=lemon::INVALID; ++n){
+                const Node node(*n);
+                predMap_[node]=lemon::INVALID;
+            }
+            discoveryOrder_.clear();
+            for( ; source != source_end; ++source)
+                addSource(*source);
+            source_=lemon::INVALID;
+        }
+
+        void reInitializeMaps(Node const & source){
+            overflow_ = OverflowQueue();
+            for(unsigned int n=0; n<discoveryOrder_.size(); ++n){
+                predMap_[discoveryOrder_[n]]=lemon::INVALID;
+            }
+            discoveryOrder_.clear();
+            addSource(source);
+            source_=source;
+        }
+
+        void addSource(Node const & source){
+            distMap_[source]=static_cast<WeightType>(0.0);
+            predMap_[source]=source;
+            overflow_.push(QueueItem(graph_.id(source), static_cast<WeightType>(0.0)));
+        }
+
+        const Graph  & graph_;
+        WeightType maxWeight_;
+        std::vector<std::vector<QueueItem> > buckets_;
+        size_t queued_;
+        OverflowQueue overflow_;
+        PredecessorsMap predMap_;
+        DistanceMap     distMap_;
+        DiscoveryOrder  discoveryOrder_;
+
+        Node source_;
+        Node target_;
+    };
+
+    /// \brief parallel shortest path computer (delta-stepping)
+    ///
+    /// This has the same interface as \ref ShortestPathDial. Nodes are kept in buckets
+    /// of width \a delta. All nodes of the current bucket are relaxed together: the
+    /// outgoing arcs are scanned in parallel, and the resulting distance updates are
+    /// applied afterwards, so the distance and predecessor maps are never written
+    /// concurrently. Arcs with weight <= \a delta (which may re-insert nodes into the
+    /// current bucket) are relaxed until the bucket is stable, heavier arcs only once when
+    /// the bucket is finished. Edge weights must be non-negative.
+    ///
+    /// If \a delta is not positive, the mean edge weight is used. A small \a delta
+    /// approaches Dijkstra's algorithm, a large one approaches Bellman-Ford with more
+    /// parallelism, but also more redundant work.
+    /// The thread pool is created by the constructor and reused by all runs.
+    /// For ties, the predecessors may differ from ShortestPathDijkstra.
+    template<class GRAPH,class WEIGHT_TYPE>
+    class ShortestPathDeltaStepping{
+    public:
+        typedef GRAPH Graph;
+
+        typedef typename Graph::Node Node;
+        typedef typename Graph::NodeIt NodeIt;
+        typedef typename Graph::Edge Edge;
+        typedef typename Graph::EdgeIt EdgeIt;
+        typedef typename Graph::OutArcIt OutArcIt;
+
+        typedef WEIGHT_TYPE WeightType;
+        typedef typename Graph:: template NodeMap<Node>       PredecessorsMap;
+        typedef typename Graph:: template NodeMap<WeightType> DistanceMap;
+        typedef ArrayVector<Node>                             DiscoveryOrder;
+
+        /// \brief constructor from graph
+        ShortestPathDeltaStepping(const Graph & g,
+                                  WeightType delta = static_cast<WeightType>(0),
+                                  const ParallelOptions & options = ParallelOptions())
+        :   graph_(g),
+            delta_(delta),
+            pool_(options),
+            requests_(std::max<size_t>(pool_.nThreads(), 1)),
+            currentBucket_(0),
+            lastBucket_(-1),
+            predMap_(g),
+            distMap_(g),
+            frontierStamp_(g.maxNodeId()+1, -1),
+            settledStamp_(g.maxNodeId()+1, -1),
+            stamp_(0)
+        {
+        }
+
+        /// \brief run shortest path given edge weights
+        ///
+        /// See ShortestPathDijkstra::run().
+        template<class WEIGHTS>
+        void run(const WEIGHTS & weights, const Node & source,
+                 const Node & target = lemon::INVALID,
+                 WeightType maxDistance=NumericTraits<WeightType>::max())
+        {
+            this->initializeMaps(source);
+            runImpl(weights, target, maxDistance);
+        }
+
+        /// \brief run shortest path again with given edge weights
+        ///
+        /// See ShortestPathDijkstra::reRun().
+        template<class WEIGHTS>
+        void reRun(const WEIGHTS & weights, const Node & source,
+                   const Node & target = lemon::INVALID,
+                   WeightType maxDistance=NumericTraits<WeightType>::max())
+        {
+            this->reInitializeMaps(source);
+            runImpl(weights, target, maxDistance);
+        }
+
+        /// \brief run shortest path with given edge weights from multiple sources.
+        ///
+        /// See ShortestPathDijkstra::runMultiSource().
+        template<class WEIGHTS, class ITER>
+        void
+        runMultiSource(const WEIGHTS & weights, ITER source_begin, ITER source_end,
+                 const Node & target = lemon::INVALID,
+                 WeightType maxDistance=NumericTraits<WeightType>::max())
+        {
+            this->initializeMapsMultiSource(source_begin, source_end);
+            runImpl(weights, target, maxDistance);
+        }
+
+        /// \brief get the graph
+        const Graph & graph()const{
+            return graph_;
+        }
+        /// \brief get the source node
+        const Node & source()const{
+            return source_;
+        }
+        /// \brief get the target node
+        const Node & target()const{
+            return target_;
+        }
+
+        /// \brief check if explicit target is given
+        bool hasTarget()const{
+            return target_!=lemon::INVALID;
+        }
+
+        /// \brief get an array with all visited nodes, sorted by distance from source
+        const DiscoveryOrder & discoveryOrder() const{
+            return discoveryOrder_;
+        }
+
+        /// \brief get the predecessors node map (after a call of run)
+        const PredecessorsMap & predecessors()const{
+            return predMap_;
+        }
+
+        /// \brief get the distances node map (after a call of run)
+        const DistanceMap & distances()const{
+            return distMap_;
+        }
+
+        /// \brief get the distance to a rarget node (after a call of run)
+        WeightType distance(const Node & target)const{
+            return distMap_[target];
+        }
+
+    private:
+
+        struct Request{
+            Int64      node;
+            Int64      pred;
+            WeightType dist;
+        };
+
+        struct DistanceLess{
+            DistanceLess(const DistanceMap & distMap)
+            :   distMap_(distMap){
+            }
+            bool operator()(const Node & a, const Node & b)const{
+                return distMap_[a] < distMap_[b];
+            }
+            const DistanceMap & distMap_;
+        };
+
+        Int64 bucketIndex(const WeightType dist)const{
+            return static_cast<Int64>(dist / delta_);
+        }
+
+        std::vector<Int64> & bucket(const Int64 b){
+            return buckets_[static_cast<size_t>(b % static_cast<Int64>(buckets_.size()))];
+        }
+
+        // The buckets form a ring which only covers [currentBucket_, lastBucket_].
+        // This range is bounded by maxWeight/delta, so the ring does not depend on the
+        // path lengths, and emptied buckets are reused for later distances.
+        void addToBucket(const Int64 nodeId, const WeightType dist){
+            const Int64 b = bucketIndex(dist);
+            if(b - currentBucket_ >= static_cast<Int64>(buckets_.size())){
+                std::vector<std::vector<Int64> > buckets(std::max<size_t>(2*buckets_.size(),
+                                                                          static_cast<size_t>(b - currentBucket_ + 1)));
+                for(Int64 k=currentBucket_; k<=lastBucket_; ++k)
+                    buckets[static_cast<size_t>(k % static_cast<Int64>(buckets.size()))].swap(bucket(k));
+                buckets_.swap(buckets);
+            }
+            lastBucket_ = std::max(lastBucket_, b);
+            bucket(b).push_back(nodeId);
+        }
+
+        // scan the arcs of all nodes in 'nodes' and apply the improvements
+        template<class WEIGHTS>
+        void relax(const WEIGHTS & weights,
+                   const std::vector<Int64> & nodes, const bool light,
+                   const WeightType maxDistance)
+        {
+            auto scan = [&](const int threadId, const uint64_t i){
+                const Node node(graph_.nodeFromId(nodes[i]));
+                const WeightType nodeDist = distMap_[node];
+                for(OutArcIt outArcIt(graph_,node);outArcIt!=lemon::INVALID;++outArcIt){
+                    const WeightType w = weights[Edge(*outArcIt)];
+                    if((w <= delta_) != light)
+                        continue;
+                    const Node otherNode = graph_.target(*outArcIt);
+                    const WeightType dist = nodeDist + w;
+                    if(dist <= maxDistance &&
+                       (predMap_[otherNode]==lemon::INVALID || dist < distMap_[otherNode])){
+                        Request r;
+                        r.node = graph_.id(otherNode);
+                        r.pred = nodes[i];
+                        r.dist = dist;
+                        requests_[threadId].push_back(r);
+                    }
+                }
+            };
+            // small frontiers are not worth the thread synchronization
+            if(nodes.size() < 512)
+                for(size_t i=0; i<nodes.size(); ++i)
+                    scan(0, i);
+            else
+                parallel_foreach(pool_, nodes.size(), scan);
+
+            for(size_t t=0; t<requests_.size(); ++t){
+                for(size_t i=0; i<requests_[t].size(); ++i){
+                    const Request & r = requests_[t][i];
+                    const Node node(graph_.nodeFromId(r.node));
+                    if(predMap_[node]==lemon::INVALID || r.dist < distMap_[node]){
+                        distMap_[node]=r.dist;
+                        predMap_[node]=graph_.nodeFromId(r.pred);
+                        addToBucket(r.node, r.dist);
+                    }
+                }
+                requests_[t].clear();
+            }
+        }
+
+        template<class WEIGHTS>
+        void runImpl(const WEIGHTS & weights,
+                     const Node & target,
+                     WeightType maxDistance)
+        {
+            const WeightType userDelta = delta_;
+            if(delta_ <= static_cast<WeightType>(0)){
+                double sum = 0.0;
+                size_t count = 0;
+                for(EdgeIt e(graph_); e!=lemon::INVALID; ++e, ++count)
+                    sum += weights[*e];
+                delta_ = count > 0 && sum > 0.0
+                           ? static_cast<WeightType>(sum / count)
+                           : static_cast<WeightType>(1);
+                if(delta_ <= static_cast<WeightType>(0))
+                    delta_ = static_cast<WeightType>(1);
+            }
+            for(size_t i=0; i<sources_.size(); ++i)
+                addToBucket(sources_[i], static_cast<WeightType>(0));
+            sources_.clear();
+
+            target_ = lemon::INVALID;
+            Int64 b = 0;
+            for(; b<=lastBucket_; ++b){
+                if(static_cast<WeightType>(b) * delta_ > maxDistance)
+                    break;
+                currentBucket_ = b;
+                const Int64 bucketStamp = ++stamp_;
+                settled_.clear();
+                while(!bucket(b).empty()){
+                    // nodes which are (still) in this bucket, without duplicates
+                    const Int64 frontierStamp = ++stamp_;
+                    frontier_.clear();
+                    const std::vector<Int64> & nodes = bucket(b);
+                    for(size_t i=0; i<nodes.size(); ++i){
+                        const Int64 id = nodes[i];
+                        if(frontierStamp_[id] == frontierStamp ||
+                           bucketIndex(distMap_[graph_.nodeFromId(id)]) != b)
+                            continue;
+                        frontierStamp_[id] = frontierStamp;
+                        frontier_.push_back(id);
+                        if(settledStamp_[id] != bucketStamp){
+                            settledStamp_[id] = bucketStamp;
+                            settled_.push_back(id);
+                        }
+                    }
+                    bucket(b).clear();
+                    relax(weights, frontier_, true, maxDistance);
+                }
+                relax(weights, settled_, false, maxDistance);
+
+                const size_t first = discoveryOrder_.size();
+                for(size_t i=0; i<settled_.size(); ++i)
+                    discoveryOrder_.push_back(graph_.nodeFromId(settled_[i]));
+                std::sort(discoveryOrder_.begin()+first, discoveryOrder_.end(), DistanceLess(distMap_));
+
+                if(target != lemon::INVALID && predMap_[target] != lemon::INVALID &&
+                   bucketIndex(distMap_[target]) == b){
+                    // the target's distance is final, stop at the target as Dijkstra would
+                    while(discoveryOrder_.back() != target){
+                        predMap_[discoveryOrder_.back()] = lemon::INVALID;
+                        discoveryOrder_.pop_back();
+                    }
+                    ++b;
+                    break;
+                }
+            }
+            // nodes which have been reached, but not visited
+            for(Int64 k=b; k<=lastBucket_; ++k){
+                std::vector<Int64> & nodes = bucket(k);
+                for(size_t i=0; i<nodes.size(); ++i){
+                    const Node node(graph_.nodeFromId(nodes[i]));
+                    if(bucketIndex(distMap_[node]) == k)
+                        predMap_[node]=lemon::INVALID;
+                }
+                nodes.clear();
+            }
+            currentBucket_ = 0;
+            lastBucket_ = -1;
+            delta_ = userDelta;
+
+            if(discoveryOrder_.size() > 0 && (target == lemon::INVALID || discoveryOrder_.back() == target))
+                target_ = discoveryOrder_.back();
+        }
+
+        void initializeMaps(Node const & source){
+            for(NodeIt n(graph_); n!=lemon::INVALID; ++n){
+                const Node node(*n);
+                predMap_[node]=lemon::INVALID;
+            }
+            discoveryOrder_.clear();
+            addSource(source);
+            source_=source;
+        }
+
+        template <class ITER>
+        void initializeMapsMultiSource(ITER source, ITER source_end){
+            for(NodeIt n(graph_); n!=lemon::INVALID; ++n){
+                const Node node(*n);
+                predMap_[node]=lemon::INVALID;
+            }
+            discoveryOrder_.clear();
+            for( ; source != source_end; ++source)
+                addSource(*source);
+            source_=lemon::INVALID;
+        }
+
+        void reInitializeMaps(Node const & source){
+            for(unsigned int n=0; n<discoveryOrder_.size(); ++n){
+                predMap_[discoveryOrder_[n]]=lemon::INVALID;
+            }
+            discoveryOrder_.clear();
+            addSource(source);
+            source_=source;
+        }
+
+        void addSource(Node const & source){
+            distMap_[source]=static_cast<WeightType>(0.0);
+            predMap_[source]=source;
+            sources_.push_back(graph_.id(source));
+        }
+
+        const Graph  & graph_;
+        WeightType      delta_;
+        ThreadPool      pool_;
+        std::vector<std::vector<Request> > requests_;
+        std::vector<std::vector<Int64> >   buckets_;
+        Int64           currentBucket_;
+        Int64           lastBucket_;
+        PredecessorsMap predMap_;
+        DistanceMap     distMap_;
+        DiscoveryOrder  discoveryOrder_;
+
+        std::vector<Int64> sources_;
+        std::vector<Int64> frontier_;
+        std::vector<Int64> settled_;
+        std::vector<Int64> frontierStamp_;
+        std::vector<Int64> settledStamp_;
+        Int64              stamp_;
+
+        Node source_;
+        Node target_;
+    };
+
     /// \brief get the length in node units of a path
     template<class NODE,class PREDECESSORS>
     size_t pathLength(
@@ -1426,6 +2343,172 @@ namespace vigra{
         }
     }
 
+    /// \brief implicit edge weights of a \ref GridGraph, computed from node weights on the fly
+    ///
+    /// This is a read-only edge map which can be passed instead of an edge map filled by
+    /// edgeWeightsFromNodeWeights(), e.g. to ShortestPathDijkstra, edgeWeightedWatershedsSegmentation(),
+    /// felzenszwalbSegmentation(), and hierarchicalClustering(). Only a view to the node weights
+    /// is stored, so no memory is needed for the edges (a materialized edge map of a 3D graph
+    /// with IndirectNeighborhood has 13 entries per node). The weight of an edge is computed
+    /// whenever it is accessed, so cheap functors pay off most.
+    /// Create instances with implicitEdgeWeightsFromNodeWeights().
+    template<unsigned int N, class DirectedTag, class T, class FUNCTOR, class RESULT, class STRIDE = StridedArrayTag>
+    class ImplicitNodeWeightEdgeMap{
+    public:
+        typedef GridGraph<N, DirectedTag>     Graph;
+        typedef typename Graph::Edge          Key;
+        typedef RESULT                        Value;
+        typedef RESULT                        ConstReference;
+
+        typedef Key             key_type;
+        typedef Value           value_type;
+        typedef ConstReference  const_reference;
+
+        typedef boost_graph::readable_property_map_tag category;
+        typedef lemon::True                            ImplicitMapTag;
+
+        ImplicitNodeWeightEdgeMap(const Graph & graph,
+                                  const MultiArrayView<N, T, STRIDE> & nodeWeights,
+                                  bool euclidean,
+                                  const FUNCTOR & func)
+        :   graph_(graph),
+            nodeWeights_(nodeWeights),
+            euclidean_(euclidean),
+            func_(func),
+            offsetNorms_(graph.maxDegree())
+        {
+            vigra_precondition(nodeWeights.shape() == graph.shape(),
+                 "implicitEdgeWeightsFromNodeWeights(): shape mismatch between graph and nodeWeights.");
+            for(unsigned int k=0; k<offsetNorms_.size(); ++k)
+                offsetNorms_[k] = norm(graph.neighborOffset(k));
+        }
+
+        ConstReference operator[](const Key & edge)const{
+            const typename Graph::shape_type u(edge.template subarray<0,N>());
+            const typename Graph::shape_type v(u + graph_.neighborOffset(edge[N]));
+            const Value w = static_cast<Value>(func_(nodeWeights_[u], nodeWeights_[v]));
+            return euclidean_ ? static_cast<Value>(offsetNorms_[edge[N]] * w) : w;
+        }
+
+    private:
+        const Graph &                graph_;
+        MultiArrayView<N, T, STRIDE> nodeWeights_;
+        bool                         euclidean_;
+        FUNCTOR                      func_;
+        ArrayVector<double>          offsetNorms_;
+    };
+
+    /// \brief implicit edge weights of a \ref GridGraph, read from an interpolated image on the fly
+    ///
+    /// This is the implicit counterpart of edgeWeightsFromInterpolatedImage(), see
+    /// ImplicitNodeWeightEdgeMap. Create instances with implicitEdgeWeightsFromInterpolatedImage().
+    template<unsigned int N, class DirectedTag, class T, class STRIDE = StridedArrayTag>
+    class ImplicitInterpolatedEdgeMap{
+    public:
+        typedef GridGraph<N, DirectedTag>     Graph;
+        typedef typename Graph::Edge          Key;
+        typedef T                             Value;
+        typedef T                             ConstReference;
+
+        typedef Key             key_type;
+        typedef Value           value_type;
+        typedef ConstReference  const_reference;
+
+        typedef boost_graph::readable_property_map_tag category;
+        typedef lemon::True                            ImplicitMapTag;
+
+        ImplicitInterpolatedEdgeMap(const Graph & graph,
+                                    const MultiArrayView<N, T, STRIDE> & interpolatedImage,
+                                    bool euclidean)
+        :   graph_(graph),
+            interpolatedImage_(interpolatedImage),
+            euclidean_(euclidean),
+            offsetNorms_(graph.maxDegree())
+        {
+            vigra_precondition(interpolatedImage.shape() == 2*graph.shape()-typename Graph::shape_type(1),
+                 "implicitEdgeWeightsFromInterpolatedImage(): interpolated shape must be shape*2-1");
+            for(unsigned int k=0; k<offsetNorms_.size(); ++k)
+                offsetNorms_[k] = norm(graph.neighborOffset(k));
+        }
+
+        ConstReference operator[](const Key & edge)const{
+            const typename Graph::shape_type u(edge.template subarray<0,N>());
+            const Value w = interpolatedImage_[2*u + graph_.neighborOffset(edge[N])];
+            return euclidean_ ? static_cast<Value>(offsetNorms_[edge[N]] * w) : w;
+        }
+
+    private:
+        const Graph &                graph_;
+        MultiArrayView<N, T, STRIDE> interpolatedImage_;
+        bool                         euclidean_;
+        ArrayVector<double>          offsetNorms_;
+    };
+
+    /// \brief create implicit edge weights from node weights
+    ///
+    /// \param g : input graph
+    /// \param nodeWeights : node weights (an array with the graph's shape)
+    /// \param euclidean : if 'true', multiply the computed weights with the Euclidean
+    ///                    distance between the edge's end nodes (default: 'false')
+    /// \param func : binary function that computes the edge weight from the
+    ///               weights of the edge's end nodes (default: take the average)
+    ///
+    /// Returns an ImplicitNodeWeightEdgeMap with the same values as the edge map
+    /// computed by edgeWeightsFromNodeWeights(). The value type is \a RESULT, which
+    /// must be given explicitly when \a func is passed:
+    /// \code
+    /// MultiArray<3, float> gradient(shape);
+    /// GridGraph<3> graph(shape, IndirectNeighborhood);
+    /// ...
+    /// ShortestPathDijkstra<GridGraph<3>, float> sp(graph);
+    /// sp.run(implicitEdgeWeightsFromNodeWeights(graph, gradient), source);
+    /// sp.run(implicitEdgeWeightsFromNodeWeights<float>(graph, gradient, false, MaxFunctor()), source);
+    /// \endcode
+    /// The graph and the node weight array must outlive the returned map.
+    template<class RESULT, unsigned int N, class DirectedTag, class T, class STRIDE, class FUNCTOR>
+    inline ImplicitNodeWeightEdgeMap<N, DirectedTag, T, FUNCTOR, RESULT, STRIDE>
+    implicitEdgeWeightsFromNodeWeights(
+            const GridGraph<N, DirectedTag> & g,
+            const MultiArrayView<N, T, STRIDE> & nodeWeights,
+            bool euclidean,
+            FUNCTOR const & func)
+    {
+        return ImplicitNodeWeightEdgeMap<N, DirectedTag, T, FUNCTOR, RESULT, STRIDE>(g, nodeWeights, euclidean, func);
+    }
+
+    template<unsigned int N, class DirectedTag, class T, class STRIDE>
+    inline ImplicitNodeWeightEdgeMap<N, DirectedTag, T,
+                                     MeanFunctor<typename NumericTraits<T>::RealPromote>,
+                                     typename NumericTraits<T>::RealPromote, STRIDE>
+    implicitEdgeWeightsFromNodeWeights(
+            const GridGraph<N, DirectedTag> & g,
+            const MultiArrayView<N, T, STRIDE> & nodeWeights,
+            bool euclidean=false)
+    {
+        typedef typename NumericTraits<T>::RealPromote Result;
+        return implicitEdgeWeightsFromNodeWeights<Result>(g, nodeWeights, euclidean, MeanFunctor<Result>());
+    }
+
+    /// \brief create implicit edge weights from an interpolated image
+    ///
+    /// \param g : input graph
+    /// \param interpolatedImage : interpolated image
+    /// \param euclidean : if 'true', multiply the weights with the Euclidean
+    ///                    distance between the edge's end nodes (default: 'false')
+    ///
+    /// Returns an ImplicitInterpolatedEdgeMap with the same values as the edge map
+    /// computed by edgeWeightsFromInterpolatedImage().
+    /// The graph and the interpolated image must outlive the returned map.
+    template<unsigned int N, class DirectedTag, class T, class STRIDE>
+    inline ImplicitInterpolatedEdgeMap<N, DirectedTag, T, STRIDE>
+    implicitEdgeWeightsFromInterpolatedImage(
+            const GridGraph<N, DirectedTag> & g,
+            const MultiArrayView<N, T, STRIDE> & interpolatedImage,
+            bool euclidean = false)
+    {
+        return ImplicitInterpolatedEdgeMap<N, DirectedTag, T, STRIDE>(g, interpolatedImage, euclidean);
+    }
+
     template<class GRAPH>
     struct ThreeCycle{
 
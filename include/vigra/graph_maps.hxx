@@ -208,6 +208,7 @@ public:
     typedef ConstReference  const_reference;
 
     typedef boost_graph::readable_property_map_tag category;
+    typedef lemon::True                            ImplicitMapTag;
 
     OnTheFlyEdgeMap(const Graph & graph,const NodeMap & nodeMap,FUNCTOR & f)
     :   graph_(graph),
@@ -292,6 +293,7 @@ public:
     typedef ConstReference  const_reference;
 
     typedef boost_graph::readable_property_map_tag category;
+    typedef lemon::True                            ImplicitMapTag;
 
     OnTheFlyEdgeMap2(const Graph & graph,const NodeMap & nodeMap,FUNCTOR  f)
     :   graph_(graph),
@@ -318,6 +320,41 @@ private:
 };
 
 
+// implicit maps (computing their values on the fly)
+// are marked by the nested type ImplicitMapTag
+template<class MAP>
+struct IsImplicitGraphMap{
+    template<class U> static char test(typename U::ImplicitMapTag *);
+    template<class U> static int  test(...);
+    static const bool value = sizeof(test<MAP>(0)) == 1;
+};
+
+// storage for an edge map which is modified by an algorithm
+// (e.g. the edge weights in hierarchical clustering):
+// writable maps are copied, implicit maps are evaluated into
+// an edge map of the graph
+template<class GRAPH,class MAP,bool IMPLICIT = IsImplicitGraphMap<MAP>::value>
+struct EdgeMapStorage{
+    typedef MAP type;
+
+    static const MAP & make(const GRAPH &, const MAP & map){
+        return map;
+    }
+};
+
+template<class GRAPH,class MAP>
+struct EdgeMapStorage<GRAPH,MAP,true>{
+    typedef typename GRAPH:: template EdgeMap<typename MAP::Value> type;
+
+    static type make(const GRAPH & graph, const MAP & map){
+        type res(graph);
+        for(typename GRAPH::EdgeIt e(graph); e!=lemon::INVALID; ++e)
+            res[*e] = map[*e];
+        return res;
+    }
+};
+
+
 // convert 2 edge maps with a functor into a single edge map
 template<class G,class EDGE_MAP_A,class EDGE_MAP_B,class FUNCTOR,class RESULT>
 class BinaryOpEdgeMap{
@@ -0,0 +1,270 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_GRAPH_RAG_FEATURES_HXX
+#define VIGRA_GRAPH_RAG_FEATURES_HXX
+
+/*std*/
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+#include <type_traits>
+
+/*vigra*/
+#include "error.hxx"
+#include "graphs.hxx"
+#include "multi_gridgraph.hxx"
+#include "adjacency_list_graph.hxx"
+#include "graph_affiliated_edges.hxx"
+#include "graph_algorithms.hxx"
+#include "accumulator_parallel.hxx"
+#include "threadpool.hxx"
+
+namespace vigra{
+
+    /// \brief accumulate statistics of base graph edge values for each edge of a region adjacency graph
+    ///
+    /// \param rag              : region adjacency graph
+    /// \param affiliatedEdges  : affiliated edges of the base graph for each edge in rag,
+    ///                           either an <tt>AdjacencyListGraph::EdgeMap< std::vector<Edge> ></tt>
+    ///                           or a CompactAffiliatedEdges container (see makeRegionAdjacencyGraph())
+    /// \param edgeValues       : values of the base graph edges (any map with <tt>operator[](Edge)</tt>,
+    ///                           e.g. a <tt>GridGraph::EdgeMap</tt> or an OnTheFlyEdgeMap2 which
+    ///                           computes the values from a node map on demand)
+    /// \param[in,out] edgeAccumulators : an accumulator chain for each edge in rag,
+    ///                           e.g. <tt>AdjacencyListGraph::EdgeMap< acc::AccumulatorChain<float, acc::Select<...> > ></tt>
+    /// \param options          : number of threads
+    ///
+    /// The rag edges are distributed over the threads, and each rag edge feeds the
+    /// values of its affiliated edges into its own accumulator chain, pass by pass if
+    /// the chain requires several passes. The accumulators must be in their initial
+    /// state, but statistics may be activated and histogram options may be set per
+    /// edge before the call.
+    ///
+    /// <b>Usage:</b>
+    /// \code
+    /// using namespace vigra::acc;
+    /// typedef AccumulatorChain<float, Select<Mean, Minimum, Maximum, StandardQuantiles<TDigest<100> > > > EdgeChain;
+    ///
+    /// AdjacencyListGraph::EdgeMap<EdgeChain> ragEdgeFeatures(rag);
+    /// accumulateRagEdgeFeatures(rag, affiliatedEdges, gridEdgeWeights, ragEdgeFeatures,
+    ///                           ParallelOptions().numThreads(4));
+    /// float meanWeight = get<Mean>(ragEdgeFeatures[rag.edgeFromId(0)]);
+    /// \endcode
+    ///
+    template<class AFFILIATED_EDGES, class EDGE_VALUES, class EDGE_ACCUMULATORS>
+    void accumulateRagEdgeFeatures(
+        const AdjacencyListGraph & rag,
+        const AFFILIATED_EDGES & affiliatedEdges,
+        const EDGE_VALUES & edgeValues,
+        EDGE_ACCUMULATORS & edgeAccumulators,
+        const ParallelOptions & options = ParallelOptions()
+    ){
+        typedef AdjacencyListGraph::Edge RagEdge;
+
+        parallel_foreach(options.getActualNumThreads(), rag.maxEdgeId()+1,
+            [&](const int /*threadId*/, const uint64_t id){
+                const RagEdge ragEdge = rag.edgeFromId(id);
+                if(ragEdge == lemon::INVALID)
+                    return;
+                typename EDGE_ACCUMULATORS::Reference a = edgeAccumulators[ragEdge];
+                const size_t size = affiliatedEdges[ragEdge].size();
+                const unsigned int passes = a.passesRequired();
+                for(unsigned int k=1; k<=passes; ++k)
+                    for(size_t i=0; i<size; ++i)
+                        a.updatePassN(edgeValues[affiliatedEdges[ragEdge][i]], k);
+                a.flush();
+            }
+        );
+    }
+
+    /// \brief accumulate statistics of grid edge values for each edge of a region adjacency graph,
+    ///        streaming over the label volume
+    ///
+    /// \param graph            : grid graph
+    /// \param labels           : labels w.r.t. graph
+    /// \param rag              : region adjacency graph of the labels (see makeRegionAdjacencyGraph())
+    /// \param edgeValues       : values of the grid graph edges (any map with <tt>operator[](Edge)</tt>)
+    /// \param[in,out] edgeAccumulators : an accumulator chain for each edge in rag
+    /// \param ignoreLabel      : label to ignore (-1 means no label will be ignored)
+    /// \param options          : number of threads
+    ///
+    /// Same as the version above, but the affiliated edges are never materialized.
+    /// The volume is split into slabs along the last dimension, and every thread
+    /// visits the boundary edges of its slab in scan order. Each slab collects the
+    /// statistics of the rag edges it touches in slab-local copies of the chains
+    /// (the rag edge of a label pair is looked up once per slab), and the copies are
+    /// merged into \a edgeAccumulators in parallel over disjoint ranges of rag edge
+    /// ids. Multi-pass statistics are handled as in the parallel extractFeatures():
+    /// the slab-local chains of pass <tt>k</tt> start from the merged results of the
+    /// earlier passes, and only the statistics of pass <tt>k</tt> are merged.
+    /// Therefore, all active statistics must support merging. The results are
+    /// identical to the version above up to floating point round-off. The grid
+    /// graph must be undirected.
+    ///
+    template<unsigned int DIM, class DTAG, class LABEL_TYPE, class STRIDE, class EDGE_VALUES, class EDGE_ACCUMULATORS>
+    void accumulateRagEdgeFeatures(
+        const GridGraph<DIM,DTAG> & graph,
+        const MultiArrayView<DIM,LABEL_TYPE,STRIDE> & labels,
+        const AdjacencyListGraph & rag,
+        const EDGE_VALUES & edgeValues,
+        EDGE_ACCUMULATORS & edgeAccumulators,
+        const Int64 ignoreLabel = -1,
+        const ParallelOptions & options = ParallelOptions()
+    ){
+        typedef GridGraph<DIM,DTAG>                  Graph;
+        typedef typename Graph::Edge                 Edge;
+        typedef typename Graph::shape_type           Shape;
+        typedef AdjacencyListGraph::Edge             RagEdge;
+        typedef typename EDGE_ACCUMULATORS::Value    Accumulator;
+        typedef std::pair<LABEL_TYPE,LABEL_TYPE>     LabelPair;
+        typedef std::unordered_map<LabelPair, size_t,
+                    detail_graph_algorithms::RagLabelPairHash<LABEL_TYPE> > PairIndexMap;
+
+        // only the back neighbors are visited, as in makeRegionAdjacencyGraph(..., ParallelOptions)
+        static_assert(std::is_same<DTAG, undirected_tag>::value,
+            "accumulateRagEdgeFeatures(GridGraph, ...): only undirected grid graphs are supported.");
+
+        vigra_precondition(graph.shape() == labels.shape(),
+            "accumulateRagEdgeFeatures(): shape mismatch between graph and labels.");
+        if(rag.edgeNum() == 0)
+            return;
+
+        const RagEdge firstEdge = *AdjacencyListGraph::EdgeIt(rag);
+        vigra_precondition(edgeAccumulators[firstEdge].isMergeable(),
+            "accumulateRagEdgeFeatures(): all statistics must support merging.");
+        vigra_precondition(edgeAccumulators[firstEdge].current_pass_ == 0,
+            "accumulateRagEdgeFeatures(): accumulator chains must be in their initial state.");
+        const unsigned int passes = edgeAccumulators[firstEdge].passesRequired();
+
+        const Shape shape = graph.shape();
+        const int nThreads = options.getActualNumThreads();
+        const size_t nSlabs = std::max<size_t>(1, std::min<size_t>(shape[DIM-1], 4*nThreads));
+        const size_t nRanges = std::max<size_t>(1, std::min<size_t>(rag.maxEdgeId()+1, 4*nThreads));
+        const typename Graph::IndexArray & backIndices = *graph.neighborIndexArray(true);
+
+        std::vector<MultiArrayIndex> labelOffsets(graph.maxUniqueDegree());
+        for(size_t k=0; k<labelOffsets.size(); ++k)
+            labelOffsets[k] = dot(graph.neighborOffset(k), labels.stride());
+
+        // slab-local chains, and their rag edge ids sorted by rag edge id
+        std::vector<std::vector<Accumulator> >                   slabChains(nSlabs);
+        std::vector<std::vector<std::pair<Int64, size_t> > >     slabEdges(nSlabs);
+
+        for(unsigned int k=1; k<=passes; ++k){
+            parallel_foreach(nThreads, nSlabs,
+                [&](const int /*threadId*/, const uint64_t s){
+                    Shape begin, end(shape);
+                    begin[DIM-1] = s*shape[DIM-1]/nSlabs;
+                    end[DIM-1]   = (s+1)*shape[DIM-1]/nSlabs;
+
+                    std::vector<Accumulator> & chains = slabChains[s];
+                    std::vector<std::pair<Int64, size_t> > & edges = slabEdges[s];
+                    chains.clear();
+                    edges.clear();
+                    PairIndexMap pairIndex;
+                    LabelPair lastPair;
+                    size_t lastIndex = 0;
+                    Edge edge;
+                    for(MultiCoordinateIterator<DIM> iter(end-begin); iter.isValid(); ++iter){
+                        const Shape node(*iter + begin);
+                        const LABEL_TYPE * l = &labels[node];
+                        if(ignoreLabel!=-1 && static_cast<Int64>(*l)==ignoreLabel)
+                            continue;
+                        edge.template subarray<0,DIM>() = node;
+                        const ArrayVector<MultiArrayIndex> & back = backIndices[graph.get_border_type(node)];
+                        for(size_t n=0; n<back.size(); ++n){
+                            const LABEL_TYPE lo = l[labelOffsets[back[n]]];
+                            if(lo==*l || (ignoreLabel!=-1 && static_cast<Int64>(lo)==ignoreLabel))
+                                continue;
+                            const LabelPair p(std::min(*l,lo), std::max(*l,lo));
+                            // consecutive boundary edges mostly separate the same regions
+                            if(chains.empty() || lastPair!=p){
+                                lastPair = p;
+                                lastIndex = pairIndex.insert(std::make_pair(p, chains.size())).first->second;
+                                if(lastIndex==chains.size()){
+                                    const AdjacencyListGraph::Node u = rag.nodeFromId(p.first);
+                                    const AdjacencyListGraph::Node v = rag.nodeFromId(p.second);
+                                    vigra_precondition(u!=lemon::INVALID && v!=lemon::INVALID,
+                                        "accumulateRagEdgeFeatures(): label has no node in the rag.");
+                                    const RagEdge ragEdge = rag.findEdge(u, v);
+                                    vigra_precondition(ragEdge!=lemon::INVALID,
+                                        "accumulateRagEdgeFeatures(): rag does not match the labels.");
+                                    // pass k starts from the merged results of the earlier passes
+                                    chains.push_back(edgeAccumulators[ragEdge]);
+                                    edges.push_back(std::make_pair(rag.id(ragEdge), lastIndex));
+                                }
+                            }
+                            edge[DIM] = back[n];
+                            chains[lastIndex].updatePassN(edgeValues[edge], k);
+                        }
+                    }
+                    for(size_t i=0; i<chains.size(); ++i)
+                        chains[i].flush();
+                    std::sort(edges.begin(), edges.end());
+                }
+            );
+
+            // merge the slab-local chains, in slab order for each rag edge
+            parallel_foreach(nThreads, nRanges,
+                [&](const int /*threadId*/, const uint64_t r){
+                    const Int64 rangeBegin = r*(rag.maxEdgeId()+1)/nRanges;
+                    const Int64 rangeEnd   = (r+1)*(rag.maxEdgeId()+1)/nRanges;
+                    for(size_t s=0; s<nSlabs; ++s){
+                        const std::vector<std::pair<Int64, size_t> > & edges = slabEdges[s];
+                        typename std::vector<std::pair<Int64, size_t> >::const_iterator e =
+                            std::lower_bound(edges.begin(), edges.end(), std::make_pair(rangeBegin, size_t(0)));
+                        for(; e!=edges.end() && e->first<rangeEnd; ++e){
+                            Accumulator & a = edgeAccumulators[rag.edgeFromId(e->first)];
+                            // the first slab-local chain of pass 1 is taken over, so that
+                            // the chain gets shaped like the values (see AccumulatorChain::update())
+                            if(a.current_pass_ == 0)
+                                a = slabChains[s][e->second];
+                            else
+                                a.mergePassN(slabChains[s][e->second], k);
+                        }
+                    }
+                }
+            );
+        }
+
+        for(AdjacencyListGraph::EdgeIt iter(rag); iter!=lemon::INVALID; ++iter)
+            edgeAccumulators[*iter].current_pass_ = passes;
+    }
+
+} // namespace vigra
+
+#endif // VIGRA_GRAPH_RAG_FEATURES_HXX
@@ -185,6 +185,33 @@ namespace vigra{
             bg,ignoreLabel,bgLabels,ragFeatures,bgFeatures);
     }
 
+    /// project edge features of a region adjacency
+    /// graph back to the affiliated edges of the base graph.
+    ///
+    /// \a affiliatedEdges can be an
+    /// <tt>AdjacencyListGraph::EdgeMap< std::vector<BASE_GRAPH::Edge> ></tt>
+    /// or a CompactAffiliatedEdges container. Base graph edges which are
+    /// not affiliated with any RAG edge are left untouched.
+    template< class BASE_GRAPH,
+                class AFFILIATED_EDGES,
+                class RAG_FEATURES,
+                class BASE_GRAPH_FEATURES
+    >
+    inline void projectBackEdges(
+            const AdjacencyListGraph & rag,
+            const BASE_GRAPH & /*bg*/,
+            const AFFILIATED_EDGES & affiliatedEdges,
+            const RAG_FEATURES & ragFeatures,
+            BASE_GRAPH_FEATURES & bgFeatures
+    ){
+        typedef AdjacencyListGraph::EdgeIt RagEdgeIt;
+        for(RagEdgeIt iter(rag); iter!=lemon::INVALID; ++iter){
+            const size_t numAffEdges = affiliatedEdges[*iter].size();
+            for(size_t i=0; i<numAffEdges; ++i)
+                bgFeatures[affiliatedEdges[*iter][i]] = ragFeatures[*iter];
+        }
+    }
+
 
 
 }
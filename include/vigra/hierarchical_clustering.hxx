@@ -43,11 +43,15 @@
 /*std*/
 #include <queue>
 #include <iomanip>
+#include <vector>
+#include <algorithm>
 
 /*vigra*/
 #include "priority_queue.hxx"
 #include "metrics.hxx"
 #include "merge_graph_adaptor.hxx"
+#include "graph_maps.hxx"
+#include "threadpool.hxx"
 
 namespace vigra{
 
@@ -313,6 +317,20 @@ class EdgeWeightedUcm
     /// it is not guaranteed that they will merge. But a certain prior / multiplier
     /// must be specified. The total weight of an edge where the u/v node have
     /// the same label is multiplied with this very multiplier.
+    ///
+    /// After a merge, the weights of all edges of the merged node change.
+    /// By default, they are recomputed immediately. With 'lazyPriorityUpdates'
+    /// these edges are only marked as stale, and the weight of a stale edge is
+    /// recomputed when it reaches the top of the priority queue. This saves most
+    /// of the weight computations (and queue updates), but an edge whose weight
+    /// decreased by the merge may be contracted later than in the exact order.
+    /// Stale edges can also be updated all at once and in parallel
+    /// (see updateStaleWeights()), which is what the batch mode of
+    /// HierarchicalClusteringImpl does after every round of merges.
+    ///
+    /// The edge weight and edge size maps are updated during clustering.
+    /// Implicit edge maps (e.g. implicitEdgeWeightsFromNodeWeights()) are
+    /// therefore evaluated once into edge maps of the base graph.
     template<
         class MERGE_GRAPH,
         class EDGE_INDICATOR_MAP,
@@ -352,7 +370,13 @@ class EdgeWeightedUcm
         typedef MergeGraphItemHelper<MergeGraph,Node> NodeHelper;
 
 
-        typedef typename EDGE_INDICATOR_MAP::Reference EdgeIndicatorReference;
+        // implicit edge maps are evaluated into edge maps of the base graph
+        typedef EdgeMapStorage<Graph, EDGE_INDICATOR_MAP> EdgeIndicatorStorage;
+        typedef EdgeMapStorage<Graph, EDGE_SIZE_MAP>      EdgeSizeStorage;
+        typedef typename EdgeIndicatorStorage::type       EdgeIndicatorMap;
+        typedef typename EdgeSizeStorage::type            EdgeSizeMap;
+
+        typedef typename EdgeIndicatorMap::Reference EdgeIndicatorReference;
         typedef typename NODE_FEATURE_MAP::Reference NodeFeatureReference;
         /// \brief construct cluster operator
         EdgeWeightNodeFeatures(
@@ -367,11 +391,12 @@ class EdgeWeightedUcm
             const metrics::MetricType metricType,
             const ValueType wardness=static_cast<ValueType>(1.0),
             const ValueType gamma = static_cast<ValueType>(10000000.0),
-            const ValueType sameLabelMultiplier = static_cast<ValueType>(0.8)
+            const ValueType sameLabelMultiplier = static_cast<ValueType>(0.8),
+            const bool lazyPriorityUpdates = false
         )
         :   mergeGraph_(mergeGraph),
-            edgeIndicatorMap_(edgeIndicatorMap),
-            edgeSizeMap_(edgeSizeMap),
+            edgeIndicatorMap_(EdgeIndicatorStorage::make(mergeGraph.graph(), edgeIndicatorMap)),
+            edgeSizeMap_(EdgeSizeStorage::make(mergeGraph.graph(), edgeSizeMap)),
             nodeFeatureMap_(nodeFeatureMap),
             nodeSizeMap_(nodeSizeMap),
             minWeightEdgeMap_(minWeightEdgeMap),
@@ -381,7 +406,11 @@ class EdgeWeightedUcm
             wardness_(wardness),
             gamma_(gamma),
             sameLabelMultiplier_(sameLabelMultiplier),
-            metric_(metricType)
+            metric_(metricType),
+            lazy_(lazyPriorityUpdates),
+            stale_(lazyPriorityUpdates ? mergeGraph.maxEdgeId()+1 : 0, 0),
+            staleEdges_(),
+            touched_()
         {
             typedef typename MergeGraph::MergeNodeCallBackType MergeNodeCallBackType;
             typedef typename MergeGraph::MergeEdgeCallBackType MergeEdgeCallBackType;
@@ -474,6 +503,12 @@ class EdgeWeightedUcm
                 //std::cout<<"get inc edge\n";
                 const Edge incEdge(*e);
 
+                if(lazy_){
+                    // the weight is recomputed when needed
+                    markStale(incEdge.id());
+                    continue;
+                }
+
                 //std::cout<<"get inc graph edge\n";
                 const BaseGraphEdge incGraphEdge = EdgeHelper::itemToGraphItem(mergeGraph_,incEdge);
 
@@ -495,25 +530,81 @@ class EdgeWeightedUcm
 
         /// \brief get the edge which should be contracted next
         Edge contractionEdge(){
-            index_type minLabel = pq_.top();
-            while(mergeGraph_.hasEdgeId(minLabel)==false){
-                pq_.deleteItem(minLabel);
-                minLabel = pq_.top();
-            }
-            return Edge(minLabel);
+            refreshTop();
+            return Edge(pq_.top());
         }
 
         /// \brief get the edge weight of the edge which should be contracted next
         WeightType contractionWeight(){
-            index_type minLabel = pq_.top();
-            while(mergeGraph_.hasEdgeId(minLabel)==false){
-                pq_.deleteItem(minLabel);
-                minLabel = pq_.top();
-            }
+            refreshTop();
             return pq_.topPriority();
 
         }
 
+        /// \brief get up to \a maxCount edges which can be contracted next
+        ///
+        /// The edges are taken from the priority queue in order of increasing
+        /// weight, skipping edges which share a node with an edge taken before
+        /// (and stopping at edges whose weight is not below gamma). Contracting
+        /// an edge does not change the nodes and weights of the other edges,
+        /// so all of them can be contracted in a row. At most <tt>4*maxCount</tt>
+        /// edges are inspected. The edges remain in the priority queue.
+        size_t contractionEdges(
+            const size_t maxCount,
+            std::vector<Edge> & edges,
+            std::vector<WeightType> & weights
+        ){
+            edges.clear();
+            weights.clear();
+            touched_.resize(mergeGraph_.maxNodeId()+1, 0);
+            std::vector<std::pair<index_type, ValueType> > popped;
+            std::vector<index_type> touchedNodes;
+            while(edges.size()<maxCount && popped.size()<4*maxCount){
+                refreshTop();
+                if(pq_.empty() || pq_.topPriority()>=gamma_)
+                    break;
+                const Edge edge(pq_.top());
+                popped.push_back(std::make_pair(edge.id(), pq_.topPriority()));
+                pq_.pop();
+                const index_type u = mergeGraph_.id(mergeGraph_.u(edge));
+                const index_type v = mergeGraph_.id(mergeGraph_.v(edge));
+                if(touched_[u] || touched_[v])
+                    continue;
+                touched_[u] = touched_[v] = 1;
+                touchedNodes.push_back(u);
+                touchedNodes.push_back(v);
+                edges.push_back(edge);
+                weights.push_back(popped.back().second);
+            }
+            for(size_t i=0; i<popped.size(); ++i)
+                pq_.push(popped[i].first, popped[i].second);
+            for(size_t i=0; i<touchedNodes.size(); ++i)
+                touched_[touchedNodes[i]] = 0;
+            return edges.size();
+        }
+
+        /// \brief recompute the weights of all stale edges in parallel
+        /// (only needed with lazyPriorityUpdates)
+        void updateStaleWeights(const ParallelOptions & options = ParallelOptions()){
+            std::vector<index_type> edgeIds;
+            for(size_t i=0; i<staleEdges_.size(); ++i){
+                const index_type id = staleEdges_[i];
+                if(stale_[id] && mergeGraph_.hasEdgeId(id))
+                    edgeIds.push_back(id);
+                stale_[id] = 0;
+            }
+            staleEdges_.clear();
+
+            std::vector<ValueType> newWeights(edgeIds.size());
+            parallel_foreach(options.getActualNumThreads(), edgeIds.size(),
+                [&](const int /*threadId*/, const uint64_t i){
+                    newWeights[i] = getEdgeWeight(Edge(edgeIds[i]));
+                }
+            );
+            for(size_t i=0; i<edgeIds.size(); ++i)
+                updateWeight(Edge(edgeIds[i]), newWeights[i]);
+        }
+
 
         /// \brief get a reference to the merge
         MergeGraph & mergeGraph(){
@@ -522,17 +613,52 @@ class EdgeWeightedUcm
 
         bool done(){
 
-            index_type minLabel = pq_.top();
-            while(mergeGraph_.hasEdgeId(minLabel)==false){
-                pq_.deleteItem(minLabel);
-                minLabel = pq_.top();
-            }
+            refreshTop();
             const ValueType p =  pq_.topPriority();
 
             return p>= gamma_;
         }
 
     private:
+        // remove inactive edges from the top of the pq, and
+        // recompute the weight of a stale edge when it reaches the top
+        void refreshTop(){
+            while(!pq_.empty()){
+                const index_type minLabel = pq_.top();
+                if(mergeGraph_.hasEdgeId(minLabel)==false)
+                    pq_.deleteItem(minLabel);
+                else if(lazy_ && stale_[minLabel])
+                    updateWeight(Edge(minLabel), getEdgeWeight(Edge(minLabel)));
+                else
+                    break;
+            }
+        }
+
+        void updateWeight(const Edge & edge, const ValueType weight){
+            if(lazy_)
+                stale_[edge.id()] = 0;
+            pq_.push(edge.id(), weight);
+            minWeightEdgeMap_[EdgeHelper::itemToGraphItem(mergeGraph_,edge)] = weight;
+        }
+
+        void markStale(const index_type id){
+            if(stale_[id])
+                return;
+            stale_[id] = 1;
+            staleEdges_.push_back(id);
+            // without updateStaleWeights() the list only grows, so
+            // drop the edges which have been updated lazily in the meantime
+            if(staleEdges_.size() > 2*stale_.size()){
+                std::sort(staleEdges_.begin(), staleEdges_.end());
+                staleEdges_.erase(std::unique(staleEdges_.begin(), staleEdges_.end()), staleEdges_.end());
+                size_t k = 0;
+                for(size_t i=0; i<staleEdges_.size(); ++i)
+                    if(stale_[staleEdges_[i]])
+                        staleEdges_[k++] = staleEdges_[i];
+                staleEdges_.resize(k);
+            }
+        }
+
         ValueType getEdgeWeight(const Edge & e){
 
             const Node u = mergeGraph_.u(e);
@@ -569,8 +695,8 @@ class EdgeWeightedUcm
 
 
         MergeGraph & mergeGraph_;
-        EDGE_INDICATOR_MAP edgeIndicatorMap_;
-        EDGE_SIZE_MAP edgeSizeMap_;
+        EdgeIndicatorMap edgeIndicatorMap_;
+        EdgeSizeMap edgeSizeMap_;
         NODE_FEATURE_MAP nodeFeatureMap_;
         NODE_SIZE_MAP nodeSizeMap_;
         MIN_WEIGHT_MAP minWeightEdgeMap_;
@@ -581,6 +707,10 @@ class EdgeWeightedUcm
         ValueType gamma_;
         ValueType sameLabelMultiplier_;
         metrics::Metric<float> metric_;
+        bool lazy_;
+        std::vector<UInt8> stale_;
+        std::vector<index_type> staleEdges_;
+        std::vector<UInt8> touched_;
     };
 
 
@@ -610,6 +740,9 @@ class ClusteringOptions
     , nodeFeatureMetric_(metrics::ManhattanMetric)
     , buildMergeTreeEncoding_(buildMergeTree)
     , verbose_(verbose)
+    , lazyPriorityUpdates_(false)
+    , mergeBatchSize_(1)
+    , parallelOptions_()
     {}
 
         /** Stop merging when the number of clusters reaches this threshold.
@@ -692,6 +825,47 @@ class ClusteringOptions
         return *this;
     }
 
+        /** Recompute the weights of the edges of a merged cluster only when
+            they reach the top of the priority queue.
+
+            This is much faster on large graphs, but an edge whose weight
+            decreased by a merge may be merged later than in the exact order.
+
+            Default: false (update all weights after each merge)
+        */
+    ClusteringOptions & lazyPriorityUpdates(bool val=true)
+    {
+        lazyPriorityUpdates_ = val;
+        return *this;
+    }
+
+        /** Maximum number of merges per round.
+
+            When greater than 1, each round merges up to this many of the
+            cheapest edges which don't share a node, and then recomputes the
+            weights of the affected edges in parallel. With 1, the cheapest
+            edge is merged in every step.
+
+            Default: 1
+        */
+    ClusteringOptions & mergeBatchSize(size_t count)
+    {
+        vigra_precondition(count >= 1,
+            "ClusteringOptions::mergeBatchSize(count): count >= 1 required.");
+        mergeBatchSize_ = count;
+        return *this;
+    }
+
+        /** Number of threads used in batch mode (see mergeBatchSize()).
+
+            Default: ParallelOptions::Auto
+        */
+    ClusteringOptions & numThreads(int n)
+    {
+        parallelOptions_.numThreads(n);
+        return *this;
+    }
+
     size_t nodeNumStopCond_;
     double maxMergeWeight_;
     double nodeFeatureImportance_;
@@ -699,6 +873,9 @@ class ClusteringOptions
     metrics::MetricType nodeFeatureMetric_;
     bool   buildMergeTreeEncoding_;
     bool   verbose_;
+    bool   lazyPriorityUpdates_;
+    size_t mergeBatchSize_;
+    ParallelOptions parallelOptions_;
 };
 
 // \brief  do hierarchical clustering with a given cluster operator
@@ -773,17 +950,7 @@ class HierarchicalClusteringImpl
 
             const Edge edgeToRemove = clusterOperator_.contractionEdge();
             if(param_.buildMergeTreeEncoding_){
-                const MergeGraphIndexType uid = mergeGraph_.id(mergeGraph_.u(edgeToRemove));
-                const MergeGraphIndexType vid = mergeGraph_.id(mergeGraph_.v(edgeToRemove));
-                const ValueType w             = clusterOperator_.contractionWeight();
-                // do the merge
-                mergeGraph_.contractEdge( edgeToRemove);
-                const MergeGraphIndexType aliveNodeId = mergeGraph_.hasNodeId(uid) ? uid : vid;
-                const MergeGraphIndexType deadNodeId  = aliveNodeId==vid ? uid : vid;
-                timeStampIndexToMergeIndex_[timeStampToIndex(timestamp_)]=mergeTreeEndcoding_.size();
-                mergeTreeEndcoding_.push_back(MergeItem( toTimeStamp_[aliveNodeId],toTimeStamp_[deadNodeId],timestamp_,w));
-                toTimeStamp_[aliveNodeId]=timestamp_;
-                timestamp_+=1;
+                contractEdge(edgeToRemove, clusterOperator_.contractionWeight());
             }
             else{
                 //std::cout<<"constract\n";
@@ -799,6 +966,41 @@ class HierarchicalClusteringImpl
             std::cout<<"\n";
     }
 
+    /// \brief start the clustering in rounds of parallel merges
+    ///
+    /// In each round, up to <tt>mergeBatchSize</tt> of the cheapest edges
+    /// which don't share a node are contracted, and the weights of the
+    /// edges of all merged nodes are recomputed in parallel afterwards.
+    /// The cluster operator must provide <tt>contractionEdges()</tt> and
+    /// <tt>updateStaleWeights()</tt> (see cluster_operators::EdgeWeightNodeFeatures),
+    /// and the weights are only recomputed in parallel if it was constructed
+    /// with lazy priority updates. Every contracted edge has its current weight,
+    /// but edges which become cheaper by a merge are only considered in the
+    /// next round.
+    void clusterBatches(){
+        std::vector<Edge>      edges;
+        std::vector<ValueType> weights;
+        if(param_.verbose_)
+            std::cout<<"\n";
+        while(mergeGraph_.nodeNum()>param_.nodeNumStopCond_ && mergeGraph_.edgeNum()>0 && !clusterOperator_.done()){
+            const size_t maxCount = std::min(param_.mergeBatchSize_, mergeGraph_.nodeNum()-param_.nodeNumStopCond_);
+            if(clusterOperator_.contractionEdges(maxCount, edges, weights)==0)
+                break;
+            for(size_t i=0; i<edges.size(); ++i){
+                if(param_.buildMergeTreeEncoding_)
+                    contractEdge(edges[i], weights[i]);
+                else
+                    mergeGraph_.contractEdge(edges[i]);
+            }
+            clusterOperator_.updateStaleWeights(param_.parallelOptions_);
+            if(param_.verbose_){
+                std::cout<<"\rNodes: "<<std::setw(10)<<mergeGraph_.nodeNum()<<std::flush;
+            }
+        }
+        if(param_.verbose_)
+            std::cout<<"\n";
+    }
+
     /// \brief get the encoding of the merge tree
     const MergeTreeEncoding & mergeTreeEndcoding()const{
         return mergeTreeEndcoding_;
@@ -865,6 +1067,20 @@ class HierarchicalClusteringImpl
     }
 private:
 
+    // contract an edge and record the merge in the merge tree encoding
+    void contractEdge(const Edge & edgeToRemove, const ValueType w){
+        const MergeGraphIndexType uid = mergeGraph_.id(mergeGraph_.u(edgeToRemove));
+        const MergeGraphIndexType vid = mergeGraph_.id(mergeGraph_.v(edgeToRemove));
+        // do the merge
+        mergeGraph_.contractEdge( edgeToRemove);
+        const MergeGraphIndexType aliveNodeId = mergeGraph_.hasNodeId(uid) ? uid : vid;
+        const MergeGraphIndexType deadNodeId  = aliveNodeId==vid ? uid : vid;
+        timeStampIndexToMergeIndex_[timeStampToIndex(timestamp_)]=mergeTreeEndcoding_.size();
+        mergeTreeEndcoding_.push_back(MergeItem( toTimeStamp_[aliveNodeId],toTimeStamp_[deadNodeId],timestamp_,w));
+        toTimeStamp_[aliveNodeId]=timestamp_;
+        timestamp_+=1;
+    }
+
     MergeGraphIndexType timeStampToIndex(const MergeGraphIndexType timestamp)const{
         return timestamp- graph_.maxNodeId();
     }
@@ -938,6 +1154,11 @@ private:
     statistics as computed by \ref FeatureAccumulators (when clustering on
     superpixels).
 
+    On a \ref vigra::GridGraph, \a edgeWeights can also be an implicit edge map
+    (e.g. created by \ref implicitEdgeWeightsFromNodeWeights()). Since the edge
+    weights are updated during clustering, such a map is evaluated once into an
+    internal edge map, and the caller doesn't need to store a materialized copy.
+
     In each step, the algorithm merges the two nodes \f$u\f$ and \f$v\f$ whose
     cluster distance is smallest, where the cluster distance is defined as
 
@@ -978,6 +1199,14 @@ private:
     and \ref vigra::ClusteringOptions::maxMergeDistance() to stop at a particular number of
     clusters or a particular cluster distance respectively.
 
+    On large graphs (e.g. region adjacency graphs of millions of superpixels), most of the
+    time is spent recomputing the distances of the clusters adjacent to a merged cluster.
+    \ref vigra::ClusteringOptions::lazyPriorityUpdates() defers this until an edge becomes
+    the cheapest one, and \ref vigra::ClusteringOptions::mergeBatchSize() merges many
+    non-adjacent cheap edges per round and recomputes the distances in parallel
+    (see \ref vigra::ClusteringOptions::numThreads()). Both modes trade the exact merge
+    order for speed.
+
     <b> Usage:</b>
 
     <b>\#include</b> \<vigra/hierarchical_clustering.hxx\><br>
@@ -1030,12 +1259,17 @@ hierarchicalClustering(GRAPH const & graph,
                                 options.nodeFeatureImportance_,
                                 options.nodeFeatureMetric_,
                                 options.sizeImportance_,
-                                options.maxMergeWeight_);
+                                options.maxMergeWeight_,
+                                static_cast<typename MergeOperator::ValueType>(0.8),
+                                options.lazyPriorityUpdates_ || options.mergeBatchSize_ > 1);
 
     typedef HierarchicalClusteringImpl<MergeOperator> Clustering;
 
     Clustering clustering(mergeOperator, options);
-    clustering.cluster();
+    if(options.mergeBatchSize_ > 1)
+        clustering.clusterBatches();
+    else
+        clustering.cluster();
 
     for(typename GRAPH::NodeIt node(graph); node != lemon::INVALID; ++node)
     {
@@ -38,7 +38,10 @@
 
 #include "config.hxx"
 #include "array_vector.hxx"
+#include "mathutil.hxx"
+#include "numerictraits.hxx"
 #include <algorithm>
+#include <cmath>
 
 namespace vigra {
 
@@ -362,6 +365,273 @@ class Histogram
     }
  };
 
+/** \brief Mergeable streaming quantile sketch (t-digest).
+
+    <b>\#include</b> \<vigra/histogram.hxx\><br>
+    Namespace: vigra
+
+    Approximates the distribution of a stream of (weighted) values by a small, sorted set of
+    centroids (mean and weight), following the merging t-digest of T. Dunning and O. Ertl:
+    "Computing Extremely Accurate Quantiles Using t-Digests" (2019). Centroids are small
+    near the tails of the distribution and larger near the median, so that quantiles are
+    most accurate where the relative accuracy matters most. In contrast to a histogram, the
+    value range need not be known in advance, i.e. a single pass over the data suffices, and
+    sketches of different parts of the data can be merged at any time (e.g. from different
+    threads or blocks of a large dataset).
+
+    The <tt>compression</tt> parameter controls the size/accuracy trade-off: the sketch
+    holds at most about <tt>compression</tt> centroids (plus a buffer of unmerged values), and
+    the rank error of quantiles near the median is typically below <tt>1 / compression</tt>.
+    Minimum and maximum are exact.
+
+    \code
+    QuantileSketch sketch(100.0);
+    for(int k=0; k<data.size(); ++k)
+        sketch.insert(data[k]);
+    double median = sketch.quantile(0.5);
+    \endcode
+
+    See \ref acc::TDigest for the corresponding accumulator.
+*/
+class QuantileSketch
+{
+  public:
+    explicit QuantileSketch(double compression = 100.0)
+    : compression_(compression),
+      count_(0.0),
+      minimum_(NumericTraits<double>::max()),
+      maximum_(-NumericTraits<double>::max())
+    {
+        vigra_precondition(compression >= 10.0,
+            "QuantileSketch(): compression >= 10 required.");
+    }
+
+        /** Remove all data from the sketch.
+        */
+    void reset()
+    {
+        centroids_.clear();
+        buffer_.clear();
+        count_ = 0.0;
+        minimum_ = NumericTraits<double>::max();
+        maximum_ = -NumericTraits<double>::max();
+    }
+
+        /** Add a value with the given weight.
+        */
+    void insert(double value, double weight = 1.0)
+    {
+        if(weight <= 0.0)
+            return;
+        buffer_.push_back(Centroid(value, weight));
+        count_ += weight;
+        minimum_ = std::min(minimum_, value);
+        maximum_ = std::max(maximum_, value);
+        if(buffer_.size() >= bufferCapacity())
+            flush();
+    }
+
+        /** Merge the data of another sketch into this one.
+        */
+    QuantileSketch & operator+=(QuantileSketch const & o)
+    {
+        if(o.count_ == 0.0)
+            return *this;
+        buffer_.insert(buffer_.end(), o.centroids_.begin(), o.centroids_.end());
+        buffer_.insert(buffer_.end(), o.buffer_.begin(), o.buffer_.end());
+        count_ += o.count_;
+        minimum_ = std::min(minimum_, o.minimum_);
+        maximum_ = std::max(maximum_, o.maximum_);
+        flush();
+        return *this;
+    }
+
+        /** Merge the buffered values into the centroids.
+
+            This happens automatically when the buffer is full and after merging
+            (acc::TDigest also calls it at the end of each pass). Call flush() after
+            the last insert(): the const functions size() and quantile() then only read
+            the centroids. Otherwise, they never modify the sketch either (so that
+            concurrent reads are safe), but have to merge a temporary copy of the buffer
+            on every call.
+        */
+    void flush()
+    {
+        compress(buffer_, centroids_);
+    }
+
+        /** Total weight of all values in the sketch.
+        */
+    double count() const
+    {
+        return count_;
+    }
+
+    double minimum() const
+    {
+        return minimum_;
+    }
+
+    double maximum() const
+    {
+        return maximum_;
+    }
+
+    double compression() const
+    {
+        return compression_;
+    }
+
+        /** Number of centroids after merging all buffered values.
+        */
+    unsigned int size() const
+    {
+        ArrayVector<Centroid> merged;
+        return mergedCentroids(merged).size();
+    }
+
+        /** Estimate the q-quantile (0 <= q <= 1) by interpolation between the centroids.
+            Returns 0 if the sketch is empty.
+        */
+    double quantile(double q) const
+    {
+        vigra_precondition(0.0 <= q && q <= 1.0,
+            "QuantileSketch::quantile(): 0 <= q <= 1 required.");
+        if(count_ == 0.0)
+            return 0.0;
+        if(q == 0.0)
+            return minimum_;
+        if(q == 1.0)
+            return maximum_;
+        ArrayVector<Centroid> merged;
+        ArrayVector<Centroid> const & centroids = mergedCentroids(merged);
+
+        int n = (int)centroids.size();
+        double index = q * count_;
+        Centroid const & first = centroids[0];
+        Centroid const & last  = centroids[n-1];
+        if(index < 1.0)
+            return minimum_;
+        if(first.weight > 1.0 && index < 0.5 * first.weight)
+            return minimum_ + (index - 1.0) / (0.5 * first.weight - 1.0) * (first.mean - minimum_);
+        if(index > count_ - 1.0)
+            return maximum_;
+        if(last.weight > 1.0 && count_ - index <= 0.5 * last.weight)
+            return maximum_ - (count_ - index - 1.0) / (0.5 * last.weight - 1.0) * (maximum_ - last.mean);
+
+        // interpolate between the centers of adjacent centroids, treating
+        // singleton centroids as exact values
+        double weightSoFar = 0.5 * first.weight;
+        for(int k=0; k<n-1; ++k)
+        {
+            double dw = 0.5 * (centroids[k].weight + centroids[k+1].weight);
+            if(weightSoFar + dw > index)
+            {
+                double leftUnit = 0.0, rightUnit = 0.0;
+                if(centroids[k].weight == 1.0)
+                {
+                    if(index - weightSoFar < 0.5)
+                        return centroids[k].mean;
+                    leftUnit = 0.5;
+                }
+                if(centroids[k+1].weight == 1.0)
+                {
+                    if(weightSoFar + dw - index <= 0.5)
+                        return centroids[k+1].mean;
+                    rightUnit = 0.5;
+                }
+                double z1 = index - weightSoFar - leftUnit,
+                       z2 = weightSoFar + dw - index - rightUnit;
+                return (centroids[k].mean * z2 + centroids[k+1].mean * z1) / (z1 + z2);
+            }
+            weightSoFar += dw;
+        }
+        double z1 = index - count_ + 0.5 * last.weight,
+               z2 = 0.5 * last.weight - z1;
+        return (last.mean * z2 + maximum_ * z1) / (z1 + z2);
+    }
+
+  private:
+    struct Centroid
+    {
+        double mean, weight;
+
+        Centroid(double m = 0.0, double w = 0.0)
+        : mean(m), weight(w)
+        {}
+
+        bool operator<(Centroid const & o) const
+        {
+            return mean < o.mean;
+        }
+    };
+
+    unsigned int bufferCapacity() const
+    {
+        return (unsigned int)(5.0 * compression_);
+    }
+
+        // scale function k1 of the t-digest paper and its inverse
+    double scale(double q) const
+    {
+        return compression_ / (2.0 * M_PI) * std::asin(std::min(1.0, 2.0 * q - 1.0));
+    }
+
+    double scaleInverse(double k) const
+    {
+        if(k >= 0.25 * compression_)
+            return 1.0;
+        return 0.5 * (std::sin(2.0 * M_PI * k / compression_) + 1.0);
+    }
+
+        // the centroids with all buffered values merged, either the member
+        // or 'merged', which receives a merged copy if there are buffered values
+    ArrayVector<Centroid> const & mergedCentroids(ArrayVector<Centroid> & merged) const
+    {
+        if(buffer_.size() == 0)
+            return centroids_;
+        ArrayVector<Centroid> buffer(buffer_);
+        merged = centroids_;
+        compress(buffer, merged);
+        return merged;
+    }
+
+        // merge the values in 'buffer' into 'centroids' (the buffer is cleared)
+    void compress(ArrayVector<Centroid> & buffer, ArrayVector<Centroid> & centroids) const
+    {
+        if(buffer.size() == 0)
+            return;
+        buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+        std::sort(buffer.begin(), buffer.end());
+        centroids.clear();
+
+        Centroid current = buffer[0];
+        double weightSoFar = 0.0,
+               limit = count_ * scaleInverse(scale(0.0) + 1.0);
+        for(unsigned int k=1; k<buffer.size(); ++k)
+        {
+            Centroid const & next = buffer[k];
+            if(weightSoFar + current.weight + next.weight <= limit)
+            {
+                current.weight += next.weight;
+                current.mean += (next.mean - current.mean) * next.weight / current.weight;
+            }
+            else
+            {
+                weightSoFar += current.weight;
+                centroids.push_back(current);
+                limit = count_ * scaleInverse(scale(weightSoFar / count_) + 1.0);
+                current = next;
+            }
+        }
+        centroids.push_back(current);
+        buffer.clear();
+    }
+
+    double compression_, count_, minimum_, maximum_;
+    ArrayVector<Centroid> centroids_, buffer_;
+};
+
 } // namespace vigra
 
 #endif // VIGRA_HISTOGRAM_HXX
@@ -40,6 +40,7 @@
 #include "multi_gridgraph.hxx"
 #include "union_find.hxx"
 #include "any.hxx"
+#include <functional>
 
 namespace vigra{
 
@@ -304,12 +305,322 @@ labelGraphWithBackground(GridGraph<N, DirectedTag> const & g,
 
 } // namespace lemon_graph
 
+namespace detail {
+
+/* Two-pass labeling of 2D and 3D arrays by a direct raster scan.
+
+   Instead of visiting all causal neighbors of a pixel via GridGraph, the scan
+   inspects them in the order of a decision tree: since equality is transitive,
+   neighbors that are themselves adjacent already belong to the same
+   provisional region, so most pixels are resolved with one or two
+   comparisons and need no union operation at all (this generalizes the
+   decision trees of Wu et al. and He et al. from binary to arbitrary-valued
+   images). Provisional labels are merged in a path-compressing
+   UnionFindArray. Pixels are scanned in the same order as GridGraph::NodeIt,
+   so the result is identical to lemon_graph::labelGraph().
+*/
+template <class T, class S1, class Label, class S2>
+Label
+labelMultiArrayScan(MultiArrayView<2, T, S1> const & data,
+                    MultiArrayView<2, Label, S2> labels,
+                    NeighborhoodType neighborhood,
+                    bool hasBackground, T const & backgroundValue)
+{
+    vigra::UnionFindArray<Label>  regions;
+
+    const MultiArrayIndex w = data.shape(0), h = data.shape(1);
+    const MultiArrayIndex dx = data.stride(0), dy = data.stride(1),
+                          lx = labels.stride(0), ly = labels.stride(1);
+
+    // pass 1: find connected components
+    for(MultiArrayIndex y = 0; y < h; ++y)
+    {
+        T const * d = data.data() + y*dy;
+        Label * l = labels.data() + y*ly;
+
+        for(MultiArrayIndex x = 0; x < w; ++x, d += dx, l += lx)
+        {
+            T const & v = *d;
+
+            // background always gets label zero
+            if(hasBackground && v == backgroundValue)
+            {
+                *l = 0;
+                continue;
+            }
+
+            Label current;
+            if(neighborhood == DirectNeighborhood)
+            {
+                if(y > 0 && v == d[-dy])
+                {
+                    current = l[-ly];
+                    // left and top are already connected when the top-left pixel matches
+                    if(x > 0 && v == d[-dx] && !(v == d[-dx-dy]))
+                        current = regions.makeUnion(l[-lx], current);
+                }
+                else if(x > 0 && v == d[-dx])
+                {
+                    current = l[-lx];
+                }
+                else
+                {
+                    current = regions.makeNewIndex();
+                }
+            }
+            else
+            {
+                // the top neighbor is adjacent to all other causal neighbors
+                if(y > 0 && v == d[-dy])
+                {
+                    current = l[-ly];
+                }
+                else if(y > 0 && x < w-1 && v == d[dx-dy])
+                {
+                    // top-right is not adjacent to top-left and left
+                    current = l[lx-ly];
+                    if(x > 0 && v == d[-dx-dy])
+                        current = regions.makeUnion(l[-lx-ly], current);
+                    else if(x > 0 && v == d[-dx])
+                        current = regions.makeUnion(l[-lx], current);
+                }
+                else if(y > 0 && x > 0 && v == d[-dx-dy])
+                {
+                    current = l[-lx-ly];
+                }
+                else if(x > 0 && v == d[-dx])
+                {
+                    current = l[-lx];
+                }
+                else
+                {
+                    current = regions.makeNewIndex();
+                }
+            }
+            *l = current;
+        }
+    }
+
+    Label count = regions.makeContiguous();
+
+    // pass 2: make component labels contiguous
+    for(MultiArrayIndex y = 0; y < h; ++y)
+    {
+        Label * l = labels.data() + y*ly;
+        for(MultiArrayIndex x = 0; x < w; ++x, l += lx)
+            *l = regions.findLabel(*l);
+    }
+    return count;
+}
+
+template <class T, class S1, class Label, class S2>
+Label
+labelMultiArrayScan(MultiArrayView<3, T, S1> const & data,
+                    MultiArrayView<3, Label, S2> labels,
+                    NeighborhoodType neighborhood,
+                    bool hasBackground, T const & backgroundValue)
+{
+    vigra::UnionFindArray<Label>  regions;
+
+    const MultiArrayIndex w = data.shape(0), h = data.shape(1), depth = data.shape(2);
+    const MultiArrayIndex dx = data.stride(0), dy = data.stride(1), dz = data.stride(2),
+                          lx = labels.stride(0), ly = labels.stride(1), lz = labels.stride(2);
+
+    // causal neighbors (indirect neighborhood) that are not adjacent to the top neighbor,
+    // and all causal neighbors for the general case
+    static const int lowerRow[3][3]  = { {-1, 1, -1}, {0, 1, -1}, {1, 1, -1} };
+    static const int causal[13][3] = { {-1,-1,-1}, {0,-1,-1}, {1,-1,-1},
+                                       {-1, 0,-1},            {1, 0,-1},
+                                       {-1, 1,-1}, {0, 1,-1}, {1, 1,-1},
+                                       {-1,-1, 0}, {0,-1, 0}, {1,-1, 0},
+                                       {-1, 0, 0}, {0, 0, -1} };
+
+    // pass 1: find connected components
+    for(MultiArrayIndex z = 0; z < depth; ++z)
+    {
+        for(MultiArrayIndex y = 0; y < h; ++y)
+        {
+            T const * d = data.data() + y*dy + z*dz;
+            Label * l = labels.data() + y*ly + z*lz;
+
+            for(MultiArrayIndex x = 0; x < w; ++x, d += dx, l += lx)
+            {
+                T const & v = *d;
+
+                // background always gets label zero
+                if(hasBackground && v == backgroundValue)
+                {
+                    *l = 0;
+                    continue;
+                }
+
+                Label current;
+                if(neighborhood == DirectNeighborhood)
+                {
+                    bool front = z > 0 && v == d[-dz],
+                         top   = y > 0 && v == d[-dy],
+                         left  = x > 0 && v == d[-dx];
+                    if(front)
+                    {
+                        current = l[-lz];
+                        // skip unions with neighbors already connected via a shared diagonal pixel
+                        if(top && !(v == d[-dy-dz]))
+                            current = regions.makeUnion(l[-ly], current);
+                        if(left && !(v == d[-dx-dz]) && !(top && v == d[-dx-dy]))
+                            current = regions.makeUnion(l[-lx], current);
+                    }
+                    else if(top)
+                    {
+                        current = l[-ly];
+                        if(left && !(v == d[-dx-dy]))
+                            current = regions.makeUnion(l[-lx], current);
+                    }
+                    else if(left)
+                    {
+                        current = l[-lx];
+                    }
+                    else
+                    {
+                        current = regions.makeNewIndex();
+                    }
+                }
+                else if(z > 0 && v == d[-dz])
+                {
+                    // the front neighbor is adjacent to all other causal neighbors
+                    current = l[-lz];
+                }
+                else if(y > 0 && v == d[-dy])
+                {
+                    // the top neighbor is adjacent to all causal neighbors
+                    // except for the three in the lower row of the front slice
+                    current = l[-ly];
+                    if(z > 0 && y < h-1)
+                    {
+                        for(int k = 0; k < 3; ++k)
+                        {
+                            MultiArrayIndex xx = x + lowerRow[k][0];
+                            if(xx < 0 || xx >= w)
+                                continue;
+                            MultiArrayIndex o = lowerRow[k][0]*dx + dy - dz;
+                            if(v == d[o])
+                                current = regions.makeUnion(l[lowerRow[k][0]*lx + ly - lz], current);
+                        }
+                    }
+                }
+                else
+                {
+                    // general case: merge with all matching causal neighbors
+                    current = regions.nextFreeIndex();
+                    for(int k = 0; k < 13; ++k)
+                    {
+                        MultiArrayIndex xx = x + causal[k][0],
+                                        yy = y + causal[k][1],
+                                        zz = z + causal[k][2];
+                        if(xx < 0 || xx >= w || yy < 0 || yy >= h || zz < 0)
+                            continue;
+                        if(v == d[causal[k][0]*dx + causal[k][1]*dy + causal[k][2]*dz])
+                            current = regions.makeUnion(l[causal[k][0]*lx + causal[k][1]*ly + causal[k][2]*lz],
+                                                        current);
+                    }
+                    current = regions.finalizeIndex(current);
+                }
+                *l = current;
+            }
+        }
+    }
+
+    Label count = regions.makeContiguous();
+
+    // pass 2: make component labels contiguous
+    for(MultiArrayIndex z = 0; z < depth; ++z)
+    {
+        for(MultiArrayIndex y = 0; y < h; ++y)
+        {
+            Label * l = labels.data() + y*ly + z*lz;
+            for(MultiArrayIndex x = 0; x < w; ++x, l += lx)
+                *l = regions.findLabel(*l);
+        }
+    }
+    return count;
+}
+
+    // other dimensions are handled by the generic algorithm
+template <unsigned int N, class T, class S1, class Label, class S2>
+Label
+labelMultiArrayScan(MultiArrayView<N, T, S1> const & data,
+                    MultiArrayView<N, Label, S2> labels,
+                    NeighborhoodType neighborhood,
+                    bool hasBackground, T const & backgroundValue)
+{
+    GridGraph<N, undirected_tag> graph(data.shape(), neighborhood);
+    if(hasBackground)
+        return lemon_graph::labelGraphWithBackground(graph, data, labels, backgroundValue,
+                                                     std::equal_to<T>());
+    else
+        return lemon_graph::labelGraph(graph, data, labels, std::equal_to<T>());
+}
+
+template <unsigned int N, class T, class S1, class Label, class S2, class Equal>
+inline Label
+labelMultiArrayImpl(MultiArrayView<N, T, S1> const & data,
+                    MultiArrayView<N, Label, S2> labels,
+                    NeighborhoodType neighborhood,
+                    Equal equal, bool /* useScan */)
+{
+    GridGraph<N, undirected_tag> graph(data.shape(), neighborhood);
+    return lemon_graph::labelGraph(graph, data, labels, equal);
+}
+
+    // the scan relies on the transitivity of equality, so it is only
+    // used with the default equality predicate
+template <unsigned int N, class T, class S1, class Label, class S2>
+inline Label
+labelMultiArrayImpl(MultiArrayView<N, T, S1> const & data,
+                    MultiArrayView<N, Label, S2> labels,
+                    NeighborhoodType neighborhood,
+                    std::equal_to<T> equal, bool useScan)
+{
+    if(useScan)
+        return labelMultiArrayScan(data, labels, neighborhood, false, T());
+    GridGraph<N, undirected_tag> graph(data.shape(), neighborhood);
+    return lemon_graph::labelGraph(graph, data, labels, equal);
+}
+
+template <unsigned int N, class T, class S1, class Label, class S2, class Equal>
+inline Label
+labelMultiArrayWithBackgroundImpl(MultiArrayView<N, T, S1> const & data,
+                                  MultiArrayView<N, Label, S2> labels,
+                                  NeighborhoodType neighborhood,
+                                  T backgroundValue,
+                                  Equal equal, bool /* useScan */)
+{
+    GridGraph<N, undirected_tag> graph(data.shape(), neighborhood);
+    return lemon_graph::labelGraphWithBackground(graph, data, labels, backgroundValue, equal);
+}
+
+template <unsigned int N, class T, class S1, class Label, class S2>
+inline Label
+labelMultiArrayWithBackgroundImpl(MultiArrayView<N, T, S1> const & data,
+                                  MultiArrayView<N, Label, S2> labels,
+                                  NeighborhoodType neighborhood,
+                                  T backgroundValue,
+                                  std::equal_to<T> equal, bool useScan)
+{
+    if(useScan)
+        return labelMultiArrayScan(data, labels, neighborhood, true, backgroundValue);
+    GridGraph<N, undirected_tag> graph(data.shape(), neighborhood);
+    return lemon_graph::labelGraphWithBackground(graph, data, labels, backgroundValue, equal);
+}
+
+} // namespace detail
+
     /** \brief Option object for labelMultiArray().
     */
 class LabelOptions
 {
     Any background_value_;
     NeighborhoodType neighborhood_;
+    bool use_scan_;
 
   public:
 
@@ -317,6 +628,7 @@ class LabelOptions
         */
     LabelOptions()
     : neighborhood_(DirectNeighborhood)
+    , use_scan_(true)
     {}
 
         /** \brief Choose direct or indirect neighborhood.
@@ -361,6 +673,29 @@ class LabelOptions
         return bool(background_value_);
     }
 
+        /** \brief Choose between the specialized raster scan and the generic algorithm.
+
+            If <tt>true</tt>, labelMultiArray() uses a fast decision-tree scan
+            for 2- and 3-dimensional arrays whenever the default equality
+            predicate <tt>std::equal_to<T></tt> is used. Otherwise, or for other
+            dimensions and predicates, the array is labeled via its \ref GridGraph.
+            Both algorithms return identical results.
+
+            Default: <tt>true</tt>
+        */
+    LabelOptions & useScan(bool use = true)
+    {
+        use_scan_ = use;
+        return *this;
+    }
+
+        /** \brief Query whether the specialized raster scan is enabled.
+        */
+    bool getUseScan() const
+    {
+        return use_scan_;
+    }
+
         /** \brief Get the background value to be ignored.
 
             Throws an exception if the stored background value type
@@ -433,6 +768,12 @@ class LabelOptions
     <tt>IndirectNeighborhood</tt> (which corresponds to
     8-neighborhood in 2D and 26-neighborhood in 3D).
 
+    When the default equality predicate is used, 2- and 3-dimensional arrays
+    are labeled by a specialized raster scan which resolves most pixels by
+    a decision tree over the causal neighbors instead of iterating over
+    all edges of the \ref GridGraph. The result is identical to the generic
+    algorithm, which can be enforced by <tt>LabelOptions().useScan(false)</tt>.
+
     Return:  the highest region label used
 
     <b> Usage:</b>
@@ -481,8 +822,7 @@ labelMultiArray(MultiArrayView<N, T, S1> const & data,
     vigra_precondition(data.shape() == labels.shape(),
         "labelMultiArray(): shape mismatch between input and output.");
 
-    GridGraph<N, undirected_tag> graph(data.shape(), neighborhood);
-    return lemon_graph::labelGraph(graph, data, labels, equal);
+    return detail::labelMultiArrayImpl(data, labels, neighborhood, equal, true);
 }
 
 template <unsigned int N, class T, class S1,
@@ -502,11 +842,7 @@ labelMultiArray(MultiArrayView<N, T, S1> const & data,
                 MultiArrayView<N, Label, S2> labels,
                 LabelOptions const & options)
 {
-    if(options.hasBackgroundValue())
-        return labelMultiArrayWithBackground(data, labels, options.getNeighborhood(),
-                                             options.template getBackgroundValue<T>());
-    else
-        return labelMultiArray(data, labels, options.getNeighborhood());
+    return labelMultiArray(data, labels, options, std::equal_to<T>());
 }
 
 template <unsigned int N, class T, class S1,
@@ -518,12 +854,16 @@ labelMultiArray(MultiArrayView<N, T, S1> const & data,
                 LabelOptions const & options,
                 Equal equal)
 {
+    vigra_precondition(data.shape() == labels.shape(),
+        "labelMultiArray(): shape mismatch between input and output.");
+
     if(options.hasBackgroundValue())
-        return labelMultiArrayWithBackground(data, labels, options.getNeighborhood(),
-                                             options.template getBackgroundValue<T>(),
-                                             equal);
+        return detail::labelMultiArrayWithBackgroundImpl(data, labels, options.getNeighborhood(),
+                                                         options.template getBackgroundValue<T>(),
+                                                         equal, options.getUseScan());
     else
-        return labelMultiArray(data, labels, options.getNeighborhood(), equal);
+        return detail::labelMultiArrayImpl(data, labels, options.getNeighborhood(),
+                                           equal, options.getUseScan());
 }
 
 /********************************************************/
@@ -611,8 +951,8 @@ labelMultiArrayWithBackground(MultiArrayView<N, T, S1> const & data,
     vigra_precondition(data.shape() == labels.shape(),
         "labelMultiArrayWithBackground(): shape mismatch between input and output.");
 
-    GridGraph<N, undirected_tag> graph(data.shape(), neighborhood);
-    return lemon_graph::labelGraphWithBackground(graph, data, labels, backgroundValue, equal);
+    return detail::labelMultiArrayWithBackgroundImpl(data, labels, neighborhood,
+                                                     backgroundValue, equal, true);
 }
 
 template <unsigned int N, class T, class S1,
@@ -61,6 +61,7 @@
 #include "random_forest/rf_online_prediction_set.hxx"
 #include "random_forest/rf_earlystopping.hxx"
 #include "random_forest/rf_ridge_split.hxx"
+#include "threadpool.hxx"
 namespace vigra
 {
 
@@ -87,6 +88,36 @@ inline SamplerOptions make_sampler_opt ( RandomForestOptions     & RF_opt)
     return_opt.stratified(RF_opt.stratification_method_ == RF_EQUAL);
     return return_opt;
 }
+
+/* \brief forwards visit_after_split() of trees that are learned in parallel
+ * to the visitor, one call at a time.
+ */
+template <class Visitor_t>
+class SynchronizedSplitVisitor
+{
+    Visitor_t &         visitor_;
+    threading::mutex &  mutex_;
+
+  public:
+    SynchronizedSplitVisitor(Visitor_t & visitor, threading::mutex & mutex)
+    : visitor_(visitor),
+      mutex_(mutex)
+    {}
+
+    template<class Tree, class Split, class Region, class Feature_t, class Label_t>
+    void visit_after_split( Tree          & tree,
+                            Split         & split,
+                            Region        & parent,
+                            Region        & leftChild,
+                            Region        & rightChild,
+                            Feature_t     & features,
+                            Label_t       & labels)
+    {
+        threading::lock_guard<threading::mutex> lock(mutex_);
+        visitor_.visit_after_split(tree, split, parent, leftChild, rightChild,
+                                   features, labels);
+    }
+};
 }//namespace detail
 
 /** \brief Random forest version 2 (see also \ref vigra::rf3::RandomForest for version 3)
@@ -685,6 +716,18 @@ class RandomForest
 
     /** @} */
 
+  private:
+
+    /* learn the trees in parallel (called by learn()) */
+    template <class Preprocessor_t, class Sampler_t, class Split_t,
+              class Stop_t, class Visitor_t, class Random_t>
+    void learn_parallel(Preprocessor_t &    preprocessor,
+                        Sampler_t &         sampler,
+                        Split_t &           split,
+                        Stop_t &            stop,
+                        Visitor_t &         visitor,
+                        Random_t const &    random,
+                        int                 n_threads);
 };
 
 
@@ -1008,6 +1051,16 @@ void RandomForest<LabelType, PreprocessorTag>::
                                &random);
 
     visitor.visit_at_beginning(*this, preprocessor);
+
+    int n_threads = ParallelOptions().numThreads(options_.n_threads_).getNumThreads();
+    if(n_threads > 0 && !options_.prepare_online_learning_)
+    {
+        learn_parallel(preprocessor, sampler, split, stop, visitor, random, n_threads);
+        visitor.visit_at_end(*this, preprocessor);
+        online_visitor_.deactivate();
+        return;
+    }
+
     // THE MAIN EFFING RF LOOP - YEAY DUDE!
 
     for(int ii = 0; ii < static_cast<int>(trees_.size()); ++ii)
@@ -1043,6 +1096,83 @@ void RandomForest<LabelType, PreprocessorTag>::
     online_visitor_.deactivate();
 }
 
+template <class LabelType, class PreprocessorTag>
+template <class Preprocessor_t, class Sampler_t, class Split_t,
+          class Stop_t, class Visitor_t, class Random_t>
+void RandomForest<LabelType, PreprocessorTag>::
+                     learn_parallel(Preprocessor_t &    preprocessor,
+                                    Sampler_t &         sampler,
+                                    Split_t &           split,
+                                    Stop_t &            stop,
+                                    Visitor_t &         visitor,
+                                    Random_t const &    random,
+                                    int                 n_threads)
+{
+    typedef UniformIntRandomFunctor<Random_t> RandFunctor_t;
+
+    threading::mutex visitor_mutex;
+    detail::SynchronizedSplitVisitor<Visitor_t> split_visitor(visitor, visitor_mutex);
+    UniformIntRandomFunctor<Random_t> seed_functor(random);
+    ThreadPool pool(n_threads);
+
+    // The samples and random seeds are drawn sequentially, so that the result
+    // does not depend on the number of threads. Trees are learned in batches,
+    // because each tree needs its own copy of the sampler for visit_after_tree().
+    int const tree_count = static_cast<int>(trees_.size());
+    int const batch_size = 4*n_threads;
+    for(int batch_begin = 0; batch_begin < tree_count; batch_begin += batch_size)
+    {
+        int const batch_end = std::min(batch_begin + batch_size, tree_count);
+        std::vector<Sampler_t> samplers;
+        std::vector<StackEntry_t> stack_entries;
+        std::vector<UInt32> seeds;
+        samplers.reserve(batch_end - batch_begin);
+        stack_entries.reserve(batch_end - batch_begin);
+        for(int ii = batch_begin; ii < batch_end; ++ii)
+        {
+            sampler.sample();
+            samplers.push_back(sampler);
+            seeds.push_back(seed_functor());
+            stack_entries.push_back(StackEntry_t(samplers.back().sampledIndices().begin(),
+                                                 samplers.back().sampledIndices().end(),
+                                                 ext_param_.class_count_));
+            stack_entries.back().set_oob_range(samplers.back().oobIndices().begin(),
+                                               samplers.back().oobIndices().end());
+        }
+
+        std::vector<threading::future<void> > futures;
+        for(int ii = batch_begin; ii < batch_end; ++ii)
+        {
+            futures.emplace_back(
+                pool.enqueue([&, ii](size_t /* thread_id */)
+                    {
+                        Random_t tree_random(seeds[ii - batch_begin]);
+                        RandFunctor_t randint(tree_random);
+                        trees_[ii].learn(preprocessor.features(),
+                                         preprocessor.response(),
+                                         stack_entries[ii - batch_begin],
+                                         split,
+                                         stop,
+                                         split_visitor,
+                                         randint);
+                    }
+                )
+            );
+        }
+        for(auto & fut : futures)
+            fut.get();
+
+        for(int ii = batch_begin; ii < batch_end; ++ii)
+        {
+            visitor.visit_after_tree(*this,
+                                     preprocessor,
+                                     samplers[ii - batch_begin],
+                                     stack_entries[ii - batch_begin],
+                                     ii);
+        }
+    }
+}
+
 
 
 
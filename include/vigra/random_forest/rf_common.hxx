@@ -198,6 +198,7 @@ class RandomForestOptions
     int tree_count_;
     int min_split_node_size_;
     bool prepare_online_learning_;
+    int n_threads_;
     /*\}*/
 
     typedef ArrayVector<double> double_array;
@@ -357,7 +358,8 @@ class RandomForestOptions
         predict_weighted_(false),
         tree_count_(255),
         min_split_node_size_(1),
-        prepare_online_learning_(false)
+        prepare_online_learning_(false),
+        n_threads_(0)
     {}
 
     /**\brief specify stratification strategy
@@ -516,6 +518,22 @@ class RandomForestOptions
         min_split_node_size_ = in;
         return *this;
     }
+
+    /**\brief Number of threads used to learn the trees in parallel.
+     *
+     *  Possible values are the same as in ParallelOptions::numThreads().
+     *  In parallel mode, each tree uses its own random number generator
+     *  that is seeded from the generator passed to RandomForest::learn(),
+     *  so the result depends on the seed, but not on the number of threads.
+     *  It differs from the result of sequential learning, though.
+     *  Online learning always uses sequential learning.
+     *  <br> Default: 0 (sequential learning)
+     */
+    RandomForestOptions & n_threads(int in)
+    {
+        n_threads_ = in;
+        return *this;
+    }
 };
 
 
@@ -45,6 +45,9 @@
 #include "../matrix.hxx"
 #include "../random.hxx"
 #include "../functorexpression.hxx"
+#include "../memory.hxx"
+#include "../multi_array.hxx"
+#include "../threading.hxx"
 #include "rf_nodeproxy.hxx"
 //#include "rf_sampling.hxx"
 #include "rf_region.hxx"
@@ -897,6 +900,22 @@ public:
     {
         std::sort(begin, end, 
                   SortSamplesByDimensions<DataSourceF_t>(column, 0));
+        best_split_of_sorted(column, labels, begin, end, region_response);
+    }
+
+    /** same as operator(), but the range begin - end must already be
+     *  sorted by the column (used by PresortedThresholdSplit).
+     */
+    template<   class DataSourceF_t,
+                class DataSource_t, 
+                class I_Iter, 
+                class Array>
+    void best_split_of_sorted(DataSourceF_t   const & column,
+                              DataSource_t    const & labels,
+                              I_Iter                & begin, 
+                              I_Iter                & end,
+                              Array           const & region_response)
+    {
         typedef typename 
             LossTraits<LineSearchLossTag, DataSource_t>::type LineSearchLoss;
         LineSearchLoss left(labels, ext_param_); //initialize left and right region
@@ -1131,6 +1150,250 @@ typedef  ThresholdSplit<BestGiniOfColumn<GiniCriterion> >                      G
 typedef  ThresholdSplit<BestGiniOfColumn<EntropyCriterion> >                 EntropySplit;
 typedef  ThresholdSplit<BestGiniOfColumn<LSQLoss>, RegressionTag>              RegressionSplit;
 
+namespace detail
+{
+    /* Sample indices sorted by each feature column. Computed only once per
+     * call of RandomForest::learn() and shared by the split functors of all
+     * trees (which may be learned in parallel).
+     */
+    class PresortedColumns
+    {
+      public:
+        template<class T, class C>
+        MultiArrayView<2, Int32> order(MultiArrayView<2, T, C> const & features)
+        {
+            threading::lock_guard<threading::mutex> lock(mutex_);
+            if(order_.size() == 0)
+            {
+                order_.reshape(features.shape());
+                for(int k = 0; k < features.shape(1); ++k)
+                {
+                    MultiArrayView<1, Int32> column = order_.bindOuter(k);
+                    for(MultiArrayIndex ii = 0; ii < column.size(); ++ii)
+                        column(ii) = Int32(ii);
+                    std::sort(column.begin(), column.end(),
+                              SortSamplesByDimensions<MultiArrayView<2, T, C> >(features, k));
+                }
+            }
+            vigra_precondition(order_.shape() == features.shape(),
+                "PresortedThresholdSplit: features changed during learning.");
+            return order_;
+        }
+
+      private:
+        MultiArray<2, Int32> order_;
+        threading::mutex     mutex_;
+    };
+}
+
+/** Same splits as ThresholdSplit<BestGiniOfColumn<...> >, but the samples are
+ * sorted by all features only once before learning (as in Breiman's original
+ * implementation and SPRINT). Each tree keeps one index list per feature which
+ * is sorted within the range of every node. When a node is split, all lists are
+ * partitioned stably, so that the children's ranges remain sorted.
+ *
+ * Partitioning all lists costs O(features * samples), whereas sorting the
+ * columns to be tried costs O(mtry * samples * log(samples)). Therefore,
+ * nodes which are small enough that sorting is cheaper fall back to sorting.
+ * Presorting pays off when mtry is a considerable fraction of the number of
+ * features, and it needs an additional Int32 per sample and feature.
+ */
+template<class ColumnDecisionFunctor, class Tag = ClassificationTag>
+class PresortedThresholdSplit: public ThresholdSplit<ColumnDecisionFunctor, Tag>
+{
+  public:
+
+    typedef ThresholdSplit<ColumnDecisionFunctor, Tag> Base;
+    typedef SplitBase<Tag> SB;
+
+    VIGRA_SHARED_PTR<detail::PresortedColumns> presorted_;
+    MultiArray<2, Int32>        sorted_;      // per-feature index lists of the current tree
+    Int32 *                     tree_begin_;  // begin of the root range of the current tree
+    std::ptrdiff_t              tree_size_;
+    ArrayVector<Int32>          buffer_;
+    ArrayVector<UInt8>          goes_left_;
+
+    PresortedThresholdSplit()
+    : tree_begin_(0),
+      tree_size_(0)
+    {}
+
+    template<class T>
+    void set_external_parameters(ProblemSpec<T> const & in)
+    {
+        Base::set_external_parameters(in);
+        presorted_.reset(new detail::PresortedColumns);
+        tree_begin_ = 0;
+        tree_size_ = 0;
+    }
+
+    template<class T, class C, class T2, class C2, class Region, class Random>
+    int findBestSplit(MultiArrayView<2, T, C> features,
+                      MultiArrayView<2, T2, C2>  labels,
+                      Region & region,
+                      ArrayVector<Region>& childRegions,
+                      Random & randint)
+    {
+        typedef typename Region::IndexIterator IndexIterator;
+
+        int const num_features = features.shape(1);
+        int const mtry = SB::ext_param_.actual_mtry_;
+        std::ptrdiff_t const size = region.size();
+
+        // Small nodes are cheaper to sort than to keep the lists up to date.
+        if(size < 2 || mtry * std::log(double(size)) < std::log(2.0) * num_features)
+            return Base::findBestSplit(features, labels, region, childRegions, randint);
+
+        vigra_precondition(presorted_.get() != 0,
+            "PresortedThresholdSplit::findBestSplit(): set_external_parameters() was not called.");
+
+        detail::Correction<Tag>::exec(region, labels);
+
+        // Is the region pure already?
+        this->region_gini_ = this->bgfunc.loss_of_region(labels,
+                                                         region.begin(),
+                                                         region.end(),
+                                                         region.classCounts());
+        if(this->region_gini_ <= SB::ext_param_.precision_)
+            return this->makeTerminalNode(features, labels, region, randint);
+
+        // select columns  to be tried.
+        for(int ii = 0; ii < mtry; ++ii)
+            std::swap(this->splitColumns[ii],
+                      this->splitColumns[ii+ randint(num_features - ii)]);
+
+        std::ptrdiff_t const offset = prepare_sorted_lists(features, region.begin(), size);
+
+        // find the best gini index
+        this->bestSplitIndex        = 0;
+        double  current_min_gini    = this->region_gini_;
+        int     num2try             = num_features;
+        for(int k=0; k<num2try; ++k)
+        {
+            Int32 * sorted_begin = &sorted_(offset, this->splitColumns[k]);
+            Int32 * sorted_end   = sorted_begin + size;
+            this->bgfunc.best_split_of_sorted(columnVector(features, this->splitColumns[k]),
+                                              labels,
+                                              sorted_begin, sorted_end,
+                                              region.classCounts());
+            this->min_gini_[k]          = this->bgfunc.min_gini_;
+            this->min_indices_[k]       = this->bgfunc.min_index_;
+            this->min_thresholds_[k]    = this->bgfunc.min_threshold_;
+#ifdef CLASSIFIER_TEST
+            if(     this->bgfunc.min_gini_ < current_min_gini
+               &&  !closeAtTolerance(this->bgfunc.min_gini_, current_min_gini))
+#else
+            if(this->bgfunc.min_gini_ < current_min_gini)
+#endif
+            {
+                current_min_gini = this->bgfunc.min_gini_;
+                childRegions[0].classCounts() = this->bgfunc.bestCurrentCounts[0];
+                childRegions[1].classCounts() = this->bgfunc.bestCurrentCounts[1];
+                childRegions[0].classCountsIsValid = true;
+                childRegions[1].classCountsIsValid = true;
+
+                this->bestSplitIndex = k;
+                num2try = mtry;
+            }
+        }
+        if(closeAtTolerance(current_min_gini, this->region_gini_))
+            return this->makeTerminalNode(features, labels, region, randint);
+
+        //create a Node for output
+        Node<i_ThresholdNode>   node(SB::t_data, SB::p_data);
+        SB::node_ = node;
+        node.threshold()    = this->min_thresholds_[this->bestSplitIndex];
+        node.column()       = this->splitColumns[this->bestSplitIndex];
+
+        // partition the lists and the range according to the best dimension
+        std::ptrdiff_t const left_size =
+            partition_sorted_lists(features, region.begin(), offset, size,
+                                   node.column(), node.threshold());
+        IndexIterator bestSplit = region.begin() + left_size;
+        childRegions[0].setRange(   region.begin()  , bestSplit       );
+        childRegions[0].rule = region.rule;
+        childRegions[0].rule.push_back(std::make_pair(1, 1.0));
+        childRegions[1].setRange(   bestSplit       , region.end()    );
+        childRegions[1].rule = region.rule;
+        childRegions[1].rule.push_back(std::make_pair(1, 1.0));
+
+        return i_ThresholdNode;
+    }
+
+  private:
+
+    /* Return the offset of the range in the sorted lists. If the range does not
+     * belong to the current tree, it becomes the root of a new one and the lists
+     * are filled from the presorted columns in O(features * samples).
+     */
+    template<class T, class C>
+    std::ptrdiff_t prepare_sorted_lists(MultiArrayView<2, T, C> const & features,
+                                        Int32 * begin, std::ptrdiff_t size)
+    {
+        if(tree_begin_ != 0 && begin >= tree_begin_ && begin + size <= tree_begin_ + tree_size_)
+            return begin - tree_begin_;
+
+        tree_begin_ = begin;
+        tree_size_  = size;
+        MultiArrayView<2, Int32> order = presorted_->order(features);
+
+        // count how often each sample occurs (bootstrap samples contain duplicates)
+        ArrayVector<Int32> multiplicity(features.shape(0), 0);
+        for(std::ptrdiff_t ii = 0; ii < size; ++ii)
+            ++multiplicity[begin[ii]];
+
+        sorted_.reshape(Shape2(size, features.shape(1)));
+        for(int k = 0; k < features.shape(1); ++k)
+        {
+            std::ptrdiff_t pos = 0;
+            for(MultiArrayIndex ii = 0; ii < order.shape(0); ++ii)
+            {
+                Int32 const index = order(ii, k);
+                for(Int32 m = 0; m < multiplicity[index]; ++m, ++pos)
+                    sorted_(pos, k) = index;
+            }
+        }
+        return 0;
+    }
+
+    /* Stably partition all lists in the range and copy the result to the region.
+     * Return the number of samples that go to the left child.
+     */
+    template<class T, class C>
+    std::ptrdiff_t partition_sorted_lists(MultiArrayView<2, T, C> const & features,
+                                          Int32 * begin, std::ptrdiff_t offset,
+                                          std::ptrdiff_t size, int column, double threshold)
+    {
+        goes_left_.resize(features.shape(0));
+        buffer_.resize(size);
+        SortSamplesByDimensions<MultiArrayView<2, T, C> > sorter(features, column, threshold);
+        for(std::ptrdiff_t ii = 0; ii < size; ++ii)
+            goes_left_[begin[ii]] = sorter(begin[ii]);
+
+        std::ptrdiff_t left_size = 0;
+        for(int k = 0; k < features.shape(1); ++k)
+        {
+            Int32 * list = &sorted_(offset, k);
+            std::ptrdiff_t left = 0, right = 0;
+            for(std::ptrdiff_t ii = 0; ii < size; ++ii)
+            {
+                if(goes_left_[list[ii]])
+                    list[left++] = list[ii];
+                else
+                    buffer_[right++] = list[ii];
+            }
+            std::copy(buffer_.begin(), buffer_.begin() + right, list + left);
+            left_size = left;
+        }
+        std::copy(&sorted_(offset, 0), &sorted_(offset, 0) + size, begin);
+        return left_size;
+    }
+};
+
+typedef  PresortedThresholdSplit<BestGiniOfColumn<GiniCriterion> >                 PresortedGiniSplit;
+typedef  PresortedThresholdSplit<BestGiniOfColumn<EntropyCriterion> >              PresortedEntropySplit;
+typedef  PresortedThresholdSplit<BestGiniOfColumn<LSQLoss>, RegressionTag>         PresortedRegressionSplit;
+
 namespace rf
 {
 
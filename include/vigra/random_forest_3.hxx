@@ -48,6 +48,7 @@
 #include "random_forest_3/random_forest.hxx"
 #include "random_forest_3/random_forest_common.hxx"
 #include "random_forest_3/random_forest_visitors.hxx"
+#include "random_forest_3/random_forest_proximity.hxx"
 
 namespace vigra
 {
@@ -145,6 +146,9 @@ void split_score(
 
 /**
  * @brief Train a single randomized decision tree.
+ *
+ * The instance weights contain the multiplicities of the instances in the
+ * bootstrap sample (instances with weight 0 are not used).
  */
 template <typename RF, typename SCORER, typename VISITOR, typename STOP, typename RANDENGINE>
 void random_forest_single_tree(
@@ -154,6 +158,7 @@ void random_forest_single_tree(
         VISITOR & visitor,
         STOP stop,
         RF & tree,
+        std::vector<double> instance_weights,
         RANDENGINE const & randengine
 ){
     typedef typename RF::Features Features;
@@ -176,27 +181,14 @@ void random_forest_single_tree(
     vigra_precondition(num_features == spec.num_features_,
                        "random_forest_single_tree(): Wrong number of features.");
 
+    vigra_precondition((size_t)num_instances == instance_weights.size(),
+                       "random_forest_single_tree(): Shape mismatch between features and instance weights.");
+
     // Create the index vector for bookkeeping.
     std::vector<size_t> instance_indices(num_instances);
     std::iota(instance_indices.begin(), instance_indices.end(), 0);
     typedef std::vector<size_t>::iterator InstanceIter;
 
-    // Create the weights for the bootstrap sample.
-    std::vector<double> instance_weights(num_instances, 1.0);
-    if (options.bootstrap_sampling_)
-    {
-        std::fill(instance_weights.begin(), instance_weights.end(), 0.0);
-        Sampler<MersenneTwister> sampler(num_instances,
-                                         SamplerOptions().withReplacement().stratified(options.use_stratification_),
-                                         &randengine);
-        sampler.sample();
-        for (int i = 0; i < sampler.sampleSize(); ++i)
-        {
-            int const index = sampler[i];
-            ++instance_weights[index];
-        }
-    }
-
     // Multiply the instance weights by the class weights.
     if (options.class_weights_.size() > 0)
     {
@@ -356,6 +348,54 @@ void random_forest_single_tree(
 
 
 
+/// Draw the bootstrap sample and store the multiplicity of each instance.
+template <typename RANDENGINE>
+std::vector<double> bootstrap_weights(
+        size_t num_instances,
+        RandomForestOptions const & options,
+        RANDENGINE const & randengine
+){
+    if (!options.bootstrap_sampling_)
+        return std::vector<double>(num_instances, 1.0);
+
+    SamplerOptions sampler_options = SamplerOptions().withReplacement().stratified(options.use_stratification_);
+    if (options.bootstrap_sample_size_ > 0)
+        sampler_options.sampleSize(options.bootstrap_sample_size_);
+    Sampler<MersenneTwister> sampler(num_instances, sampler_options, &randengine);
+    sampler.sample();
+
+    std::vector<double> instance_weights(num_instances, 0.0);
+    for (int i = 0; i < sampler.sampleSize(); ++i)
+    {
+        int const index = sampler[i];
+        ++instance_weights[index];
+    }
+    return instance_weights;
+}
+
+
+
+/**
+ * @brief Train a single randomized decision tree on a bootstrap sample of the given instances.
+ */
+template <typename RF, typename SCORER, typename VISITOR, typename STOP, typename RANDENGINE>
+void random_forest_single_tree(
+        typename RF::Features const & features,
+        MultiArray<1, size_t>  const & labels,
+        RandomForestOptions const & options,
+        VISITOR & visitor,
+        STOP stop,
+        RF & tree,
+        RANDENGINE const & randengine
+){
+    random_forest_single_tree<RF, SCORER, VISITOR, STOP>(
+        features, labels, options, visitor, stop, tree,
+        bootstrap_weights(features.shape()[0], options, randengine),
+        randengine);
+}
+
+
+
 /// \brief Preprocess the labels and call the train functions on the single trees.
 template <typename FEATURES,
           typename LABELS,
@@ -382,7 +422,8 @@ random_forest_impl(
     pspec.num_instances(features.shape()[0])
          .num_features(features.shape()[1])
          .actual_mtry(options.get_features_per_node(features.shape()[1]))
-         .actual_msample(labels.size());
+         .actual_msample(options.bootstrap_sampling_ && options.bootstrap_sample_size_ > 0
+                             ? options.bootstrap_sample_size_ : labels.size());
 
     // Check the number of trees.
     size_t const tree_count = options.tree_count_;
@@ -634,6 +675,153 @@ random_forest(
     return random_forest(features, labels, RandomForestOptions());
 }
 
+/********************************************************/
+/*                                                      */
+/*                  random_forest_update                */
+/*                                                      */
+/********************************************************/
+
+/** \brief Incrementally update a \ref vigra::rf3::RandomForest when new labels arrive.
+
+    Instead of training the whole forest again, only the \a replace_count trees that
+    perform worst on the new instances are replaced by trees that are trained on the
+    complete training set. The loss of a tree is the sum of <tt>1 - p</tt> over the
+    instances in \a new_instances, where <tt>p</tt> is the probability the tree assigns
+    to the current label. Newly added instances have not been seen by any of the existing
+    trees, so for them this is an out-of-bag loss. Relabeled instances, however, were in
+    the bootstrap samples of some trees (with their old label), so their loss is not
+    out-of-bag: it measures how strongly a tree is tied to the old label, which is the
+    reason for replacing it. The remaining trees keep their order, the new trees are appended.
+
+    \a features and \a labels contain the complete training set (old and new instances),
+    \a new_instances the row indices of the new (or relabeled) instances. The new trees are
+    trained with the options that were used for the original forest. If the set of classes
+    has changed, the existing trees cannot represent the new classes, and the whole forest
+    is trained again. The function returns the indices of the trees that were replaced.
+
+    The cost of an update is roughly <tt>replace_count / tree_count</tt> of the cost
+    of a complete training.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/random_forest_3.hxx\><br>
+    Namespace: vigra::rf3
+
+    \code
+    auto rf = rf3::random_forest(train_features, train_labels);
+    ...
+    // the user labeled some more instances, they were appended to train_features and train_labels
+    std::vector<size_t> new_instances(...);
+    rf3::random_forest_update(rf, train_features, train_labels, new_instances, 10);
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void random_forest_update)
+
+template <typename FEATURES, typename LABELS, typename RANDENGINE>
+std::vector<size_t>
+random_forest_update(
+        RandomForest<FEATURES, LABELS> & rf,
+        FEATURES const & features,
+        LABELS const & labels,
+        std::vector<size_t> const & new_instances,
+        size_t replace_count,
+        RANDENGINE & randengine
+){
+    typedef typename FEATURES::value_type FeatureType;
+    typedef typename LABELS::value_type LabelType;
+
+    size_t const tree_count = rf.num_trees();
+    vigra_precondition(tree_count > 0,
+                       "random_forest_update(): The forest must be trained first.");
+    vigra_precondition(features.shape()[0] == labels.size(),
+                       "random_forest_update(): Shape mismatch between features and labels.");
+    vigra_precondition((size_t)features.shape()[1] == rf.num_features(),
+                       "random_forest_update(): Number of features differs from training.");
+    replace_count = std::min(replace_count, tree_count);
+
+    RandomForestOptions options = rf.options_;
+    options.tree_count(tree_count);
+
+    // Train the whole forest if the classes have changed.
+    std::set<LabelType> const dlabels(labels.begin(), labels.end());
+    std::vector<LabelType> const distinct_labels(dlabels.begin(), dlabels.end());
+    if (distinct_labels != rf.problem_spec_.distinct_classes_)
+    {
+        RFStopVisiting stop;
+        rf = random_forest(features, labels, options, stop, randengine);
+        std::vector<size_t> replaced(tree_count);
+        std::iota(replaced.begin(), replaced.end(), 0);
+        return replaced;
+    }
+    if (replace_count == 0)
+        return std::vector<size_t>();
+
+    // Compute the loss of each tree on the new instances (this is cheap compared
+    // to training, so it is done sequentially).
+    std::vector<double> losses(tree_count, 0.0);
+    if (new_instances.size() > 0)
+    {
+        MultiArray<2, FeatureType> new_features_array(Shape2(new_instances.size(), features.shape()[1]));
+        for (size_t k = 0; k < new_instances.size(); ++k)
+        {
+            vigra_precondition(new_instances[k] < (size_t)features.shape()[0],
+                               "random_forest_update(): Instance index out of range.");
+            new_features_array.template bind<0>(k) = features.template bind<0>(new_instances[k]);
+        }
+        FEATURES const new_features(new_features_array);
+        MultiArray<2, double> probs(Shape2(new_instances.size(), rf.num_classes()));
+        auto const & classes = rf.problem_spec_.distinct_classes_;
+        for (size_t t = 0; t < tree_count; ++t)
+        {
+            rf.predict_probabilities(new_features, probs, 1, std::vector<size_t>(1, t));
+            for (size_t k = 0; k < new_instances.size(); ++k)
+            {
+                size_t const c = std::lower_bound(classes.begin(), classes.end(), labels(new_instances[k])) - classes.begin();
+                losses[t] += 1.0 - probs(k, c);
+            }
+        }
+    }
+
+    // Find the worst trees (the first ones on ties).
+    std::vector<size_t> order(tree_count);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+        [&losses](size_t a, size_t b)
+        {
+            return losses[a] > losses[b];
+        }
+    );
+    std::vector<size_t> replaced(order.begin(), order.begin() + replace_count);
+    std::vector<size_t> kept(order.begin() + replace_count, order.end());
+    std::sort(replaced.begin(), replaced.end());
+    std::sort(kept.begin(), kept.end());
+
+    // Train the new trees and merge them with the remaining ones.
+    options.tree_count(replace_count);
+    RFStopVisiting stop;
+    auto const new_trees = random_forest(features, labels, options, stop, randengine);
+    auto updated = rf.sub_forest(kept);
+    updated.problem_spec_ = new_trees.problem_spec_;
+    updated.options_.tree_count(tree_count);
+    updated.merge(new_trees);
+    rf = updated;
+    return replaced;
+}
+
+template <typename FEATURES, typename LABELS>
+inline
+std::vector<size_t>
+random_forest_update(
+        RandomForest<FEATURES, LABELS> & rf,
+        FEATURES const & features,
+        LABELS const & labels,
+        std::vector<size_t> const & new_instances,
+        size_t replace_count
+){
+    auto randengine = MersenneTwister::global();
+    return random_forest_update(rf, features, labels, new_instances, replace_count, randengine);
+}
+
 } // namespace rf3
 
 //@}
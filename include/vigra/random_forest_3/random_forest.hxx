@@ -109,6 +109,11 @@ public:
         RandomForest const & other
     );
 
+    /// \brief Return a forest that consists of the given trees (in the given order).
+    RandomForest sub_forest(
+        std::vector<size_t> const & tree_indices
+    ) const;
+
     /// \brief Predict the given data and return the average number of split comparisons.
     /// \note labels must be a 1-D array with size <tt>features.shape(0)</tt>.
     void predict(
@@ -241,6 +246,46 @@ void RandomForest<FEATURES, LABELS, SPLITTESTS, ACC>::merge(
     }
 }
 
+template <typename FEATURES, typename LABELS, typename SPLITTESTS, typename ACC>
+RandomForest<FEATURES, LABELS, SPLITTESTS, ACC>
+RandomForest<FEATURES, LABELS, SPLITTESTS, ACC>::sub_forest(
+    std::vector<size_t> const & tree_indices
+) const {
+    RandomForest rf;
+    rf.problem_spec_ = problem_spec_;
+    rf.options_ = options_;
+    rf.options_.tree_count_ = tree_indices.size();
+
+    // Copy the trees in depth-first order, the children of a node get consecutive ids.
+    std::vector<std::pair<Node, Node> > stack;
+    for (auto i : tree_indices)
+    {
+        vigra_precondition(i < graph_.numRoots(), "RandomForest::sub_forest(): Tree index out of range.");
+        stack.push_back(std::make_pair(graph_.getRoot(i), rf.graph_.addNode()));
+        while (!stack.empty())
+        {
+            Node const node = stack.back().first;
+            Node const new_node = stack.back().second;
+            stack.pop_back();
+            if (graph_.numChildren(node) == 0)
+            {
+                rf.node_responses_.insert(new_node, node_responses_.at(node));
+            }
+            else
+            {
+                Node const left = rf.graph_.addNode();
+                Node const right = rf.graph_.addNode();
+                rf.graph_.addArc(new_node, left);
+                rf.graph_.addArc(new_node, right);
+                rf.split_tests_.insert(new_node, split_tests_.at(node));
+                stack.push_back(std::make_pair(graph_.getChild(node, 1), right));
+                stack.push_back(std::make_pair(graph_.getChild(node, 0), left));
+            }
+        }
+    }
+    return rf;
+}
+
 // FIXME TODO we don't support the selection of tree indices any more in predict_probabilities, might be a good idea
 // to re-enable this.
 template <typename FEATURES, typename LABELS, typename SPLITTESTS, typename ACC>
@@ -589,6 +589,7 @@ public:
         features_per_node_(0),
         features_per_node_switch_(RF_SQRT),
         bootstrap_sampling_(true),
+        bootstrap_sample_size_(0),
         resample_count_(0),
         split_(RF_GINI),
         max_depth_(0),
@@ -655,6 +656,17 @@ public:
         return *this;
     }
 
+    /**
+     * @brief The number of instances that are drawn (with replacement) for the bootstrap sample of each tree.
+     *
+     * Default: \a n = 0 (draw as many instances as there are in the training set)
+     */
+    RandomForestOptions & bootstrap_sample_size(size_t n)
+    {
+        bootstrap_sample_size_ = n;
+        return *this;
+    }
+
     /**
      * @brief If resample_count is greater than zero, the split in each node is computed using only resample_count data points.
      *
@@ -787,6 +799,7 @@ public:
     int features_per_node_;
     RandomForestOptionTags features_per_node_switch_;
     bool bootstrap_sampling_;
+    size_t bootstrap_sample_size_;
     size_t resample_count_;
     RandomForestOptionTags split_;
     size_t max_depth_;
@@ -0,0 +1,645 @@
+/************************************************************************/
+/*                                                                      */
+/*        Copyright 2014-2015 by Ullrich Koethe and Philip Schill       */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#ifndef VIGRA_RF3_RANDOM_FOREST_FLAT_HXX
+#define VIGRA_RF3_RANDOM_FOREST_FLAT_HXX
+
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "../sized_int.hxx"
+#include "../threadpool.hxx"
+#include "random_forest.hxx"
+#include "random_forest_common.hxx"
+
+namespace vigra
+{
+
+namespace rf3
+{
+
+/** \addtogroup MachineLearning
+**/
+//@{
+
+namespace detail
+{
+
+// Layout of the flat binary random forest format.
+//
+// All sections start at 8-byte aligned offsets and are stored in native byte order:
+//
+//     RF3FlatHeader
+//     UInt64       roots[num_trees]                    node index of each tree root
+//     RF3FlatNode  nodes[num_nodes]                    indexed by BinaryForest node id
+//     double       responses[num_leaves][num_classes]  normalized class distributions
+//     LabelType    classes[num_classes]                original class labels
+//
+// An inner node stores the split dimension and the index of its left child,
+// the right child immediately follows the left one. A leaf stores
+// rf3_flat_leaf_tag as dimension and the row of its response instead of a child.
+
+static const char   rf3_flat_magic[8]     = { 'V', 'I', 'G', 'R', 'A', 'R', 'F', '3' };
+static const UInt32 rf3_flat_byte_order   = 0x01020304;
+static const UInt32 rf3_flat_version      = 1;
+static const UInt32 rf3_flat_leaf_tag     = 0xffffffff;
+
+enum RF3FlatLabelKind
+{
+    rf3_flat_unsigned_label = 0,
+    rf3_flat_signed_label   = 1,
+    rf3_flat_float_label    = 2
+};
+
+struct RF3FlatHeader
+{
+    char   magic_[8];
+    UInt32 byte_order_;
+    UInt32 version_;
+    UInt32 label_size_;
+    UInt32 label_kind_;
+    UInt64 num_features_;
+    UInt64 num_instances_;
+    UInt64 num_classes_;
+    UInt64 actual_mtry_;
+    UInt64 actual_msample_;
+    UInt64 num_trees_;
+    UInt64 num_nodes_;
+    UInt64 num_leaves_;
+    UInt64 roots_offset_;
+    UInt64 nodes_offset_;
+    UInt64 responses_offset_;
+    UInt64 classes_offset_;
+    UInt64 total_size_;
+};
+
+struct RF3FlatNode
+{
+    double threshold_;
+    UInt32 dim_;
+    UInt32 child_;
+};
+
+template <typename LabelType>
+inline UInt32 rf3_flat_label_kind()
+{
+    return std::is_floating_point<LabelType>::value
+               ? rf3_flat_float_label
+               : std::is_signed<LabelType>::value
+                     ? rf3_flat_signed_label
+                     : rf3_flat_unsigned_label;
+}
+
+inline UInt64 rf3_flat_align(UInt64 offset)
+{
+    return (offset + 7) & ~UInt64(7);
+}
+
+} // namespace detail
+
+/********************************************************/
+/*                                                      */
+/*                rf3::FlatRandomForest                 */
+/*                                                      */
+/********************************************************/
+
+/** \brief Read-only random forest that predicts directly from the flat binary format.
+
+    A FlatRandomForest does not own or copy the forest: it merely interprets a memory
+    block written by \ref vigra::rf3::random_forest_export_binary(). When the block
+    is a memory-mapped file (see \ref vigra::rf3::random_forest_map_binary()),
+    several processes can share the same forest via the page cache, and loading
+    costs only a few pointer assignments regardless of the forest size.
+
+    The prediction interface matches \ref vigra::rf3::RandomForest with the
+    default <tt>LessEqualSplitTest</tt> and <tt>ArgMaxVectorAcc</tt>. Leaf ids
+    coincide with the node ids of the forest that was exported.
+
+    <b>\#include</b> \<vigra/random_forest_3_binary_impex.hxx\><br>
+    Namespace: vigra::rf3
+*/
+template <typename FEATURES, typename LABELS>
+class FlatRandomForest
+{
+public:
+
+    typedef FEATURES Features;
+    typedef typename Features::value_type FeatureType;
+    typedef LABELS Labels;
+    typedef typename Labels::value_type LabelType;
+
+    /// \brief Interpret the \a size bytes at \a data as a flat random forest.
+    ///
+    /// The memory must be 8-byte aligned and stay valid for the lifetime of the object.
+    /// The optional \a owner keeps the memory alive (e.g. a file mapping).
+    FlatRandomForest(
+        void const * data,
+        size_t size,
+        std::shared_ptr<void const> const & owner = std::shared_ptr<void const>()
+    );
+
+    /// \brief Predict the given data.
+    /// \note labels must be a 1-D array with size <tt>features.shape(0)</tt>.
+    void predict(
+        FEATURES const & features,
+        LABELS & labels,
+        int n_threads = -1,
+        const std::vector<size_t> & tree_indices = std::vector<size_t>()
+    ) const;
+
+    /// \brief Predict the probabilities of the given data.
+    /// \note probs should have the shape (features.shape()[0], num_classes).
+    template <typename PROBS>
+    void predict_probabilities(
+        FEATURES const & features,
+        PROBS & probs,
+        int n_threads = -1,
+        const std::vector<size_t> & tree_indices = std::vector<size_t>()
+    ) const;
+
+    /// \brief For each data point in features, compute the corresponding leaf ids and return the average number of split comparisons.
+    /// \note ids should have the shape (features.shape()[0], num_trees).
+    template <typename IDS>
+    double leaf_ids(
+        FEATURES const & features,
+        IDS & ids,
+        int n_threads = -1,
+        std::vector<size_t> tree_indices = std::vector<size_t>()
+    ) const;
+
+    /// \brief Return the number of nodes.
+    size_t num_nodes() const
+    {
+        return header_->num_nodes_;
+    }
+
+    /// \brief Return the number of trees.
+    size_t num_trees() const
+    {
+        return header_->num_trees_;
+    }
+
+    /// \brief Return the number of classes.
+    size_t num_classes() const
+    {
+        return header_->num_classes_;
+    }
+
+    /// \brief Return the number of features.
+    size_t num_features() const
+    {
+        return header_->num_features_;
+    }
+
+    /// \brief Return the class label that corresponds to class index \a i.
+    LabelType class_label(size_t i) const
+    {
+        LabelType l;
+        std::memcpy(&l, classes_ + i*sizeof(LabelType), sizeof(LabelType));
+        return l;
+    }
+
+    /// \brief Return the problem specification that was stored with the forest.
+    ProblemSpec<LabelType> problem_spec() const;
+
+    /// \brief Convert back into a modifiable \ref vigra::rf3::RandomForest.
+    ///
+    /// Prediction works directly on the flat representation, so this is only
+    /// needed when the forest shall be changed, e.g. merged with another forest.
+    /// The leaf responses of the result are the normalized class distributions.
+    RandomForest<FEATURES, LABELS> to_random_forest() const;
+
+private:
+
+    /// \brief Find the leaf of tree \a k that contains \a sub_features.
+    template <typename SUBFEATURES>
+    UInt64 find_leaf(SUBFEATURES const & sub_features, size_t k, double & split_comparisons) const
+    {
+        UInt64 n = roots_[k];
+        while (nodes_[n].dim_ != detail::rf3_flat_leaf_tag)
+        {
+            detail::RF3FlatNode const & node = nodes_[n];
+            n = node.child_ + (sub_features(node.dim_) <= node.threshold_ ? 0 : 1);
+            split_comparisons += 1.0;
+        }
+        return n;
+    }
+
+    std::vector<size_t> check_tree_indices(std::vector<size_t> tree_indices) const;
+
+    std::shared_ptr<void const> owner_;
+    detail::RF3FlatHeader const * header_;
+    UInt64 const * roots_;
+    detail::RF3FlatNode const * nodes_;
+    double const * responses_;
+    char const * classes_;
+};
+
+template <typename FEATURES, typename LABELS>
+FlatRandomForest<FEATURES, LABELS>::FlatRandomForest(
+    void const * data,
+    size_t size,
+    std::shared_ptr<void const> const & owner
+)   :
+    owner_(owner)
+{
+    char const * base = static_cast<char const *>(data);
+    vigra_precondition(base != 0 && reinterpret_cast<std::size_t>(base) % 8 == 0,
+                       "FlatRandomForest(): Data must be 8-byte aligned.");
+    vigra_precondition(size >= sizeof(detail::RF3FlatHeader),
+                       "FlatRandomForest(): Data is too small to contain a random forest.");
+
+    header_ = reinterpret_cast<detail::RF3FlatHeader const *>(base);
+    vigra_precondition(std::memcmp(header_->magic_, detail::rf3_flat_magic, sizeof(detail::rf3_flat_magic)) == 0,
+                       "FlatRandomForest(): Data is not a flat random forest.");
+    vigra_precondition(header_->byte_order_ == detail::rf3_flat_byte_order,
+                       "FlatRandomForest(): Random forest was stored with a different byte order.");
+    vigra_precondition(header_->version_ <= detail::rf3_flat_version,
+                       "FlatRandomForest(): unexpected file format version.");
+    vigra_precondition(header_->label_size_ == sizeof(LabelType) &&
+                       header_->label_kind_ == detail::rf3_flat_label_kind<LabelType>(),
+                       "FlatRandomForest(): Label type differs from the stored label type.");
+    vigra_precondition(header_->total_size_ <= size,
+                       "FlatRandomForest(): Data is truncated.");
+
+    // Every section must lie within the data (written without overflow: count*item_size <= total-offset).
+    UInt64 const total = header_->total_size_;
+    auto check_section = [total](UInt64 offset, UInt64 count, UInt64 item_size)
+    {
+        vigra_precondition(offset % 8 == 0 && offset >= sizeof(detail::RF3FlatHeader) && offset <= total &&
+                           (item_size == 0 || count <= (total - offset) / item_size),
+                           "FlatRandomForest(): Section out of bounds, the data is corrupt.");
+    };
+    UInt64 const n_classes = header_->num_classes_;
+    vigra_precondition(n_classes > 0 && n_classes <= total / sizeof(double),
+                       "FlatRandomForest(): Invalid number of classes, the data is corrupt.");
+    check_section(header_->roots_offset_, header_->num_trees_, sizeof(UInt64));
+    check_section(header_->nodes_offset_, header_->num_nodes_, sizeof(detail::RF3FlatNode));
+    check_section(header_->responses_offset_, header_->num_leaves_, n_classes*sizeof(double));
+    check_section(header_->classes_offset_, n_classes, sizeof(LabelType));
+
+    roots_ = reinterpret_cast<UInt64 const *>(base + header_->roots_offset_);
+    nodes_ = reinterpret_cast<detail::RF3FlatNode const *>(base + header_->nodes_offset_);
+    responses_ = reinterpret_cast<double const *>(base + header_->responses_offset_);
+    classes_ = base + header_->classes_offset_;
+
+    // Prediction follows the stored indices without checks, so every tree must
+    // only reach valid nodes, and no node may be reached twice (which excludes cycles).
+    UInt64 const n_nodes = header_->num_nodes_;
+    std::vector<UInt8> visited(n_nodes, 0);
+    std::vector<UInt64> stack;
+    UInt64 n_visited = 0;
+    for (size_t k = 0; k < num_trees(); ++k)
+    {
+        stack.push_back(roots_[k]);
+        while (!stack.empty())
+        {
+            UInt64 const n = stack.back();
+            stack.pop_back();
+            vigra_precondition(n < n_nodes && !visited[n],
+                               "FlatRandomForest(): Invalid node index, the data is corrupt.");
+            visited[n] = 1;
+            ++n_visited;
+            detail::RF3FlatNode const & node = nodes_[n];
+            if (node.dim_ == detail::rf3_flat_leaf_tag)
+            {
+                vigra_precondition(node.child_ < header_->num_leaves_,
+                                   "FlatRandomForest(): Invalid leaf response index, the data is corrupt.");
+            }
+            else
+            {
+                vigra_precondition(node.dim_ < header_->num_features_,
+                                   "FlatRandomForest(): Invalid split feature, the data is corrupt.");
+                stack.push_back(node.child_);
+                stack.push_back(UInt64(node.child_) + 1);
+            }
+        }
+    }
+    vigra_precondition(n_visited == n_nodes,
+                       "FlatRandomForest(): Nodes outside of the trees, the data is corrupt.");
+}
+
+template <typename FEATURES, typename LABELS>
+ProblemSpec<typename FlatRandomForest<FEATURES, LABELS>::LabelType>
+FlatRandomForest<FEATURES, LABELS>::problem_spec() const
+{
+    std::vector<LabelType> distinct_classes(num_classes());
+    for (size_t i = 0; i < distinct_classes.size(); ++i)
+        distinct_classes[i] = class_label(i);
+    return ProblemSpec<LabelType>()
+               .num_features(header_->num_features_)
+               .num_instances(header_->num_instances_)
+               .distinct_classes(distinct_classes)
+               .actual_mtry(header_->actual_mtry_)
+               .actual_msample(header_->actual_msample_);
+}
+
+template <typename FEATURES, typename LABELS>
+RandomForest<FEATURES, LABELS>
+FlatRandomForest<FEATURES, LABELS>::to_random_forest() const
+{
+    typedef RandomForest<FEATURES, LABELS> RF;
+    typedef typename RF::Node Node;
+
+    typename RF::Graph gr;
+    typename RF::template NodeMap<typename RF::SplitTests>::type split_tests;
+    typename RF::template NodeMap<typename RF::AccInputType>::type node_responses;
+
+    // The flat node indices are the node ids, so the nodes can be added in order.
+    size_t const n_classes = num_classes();
+    for (size_t i = 0; i < num_nodes(); ++i)
+        gr.addNode();
+    for (size_t i = 0; i < num_nodes(); ++i)
+    {
+        detail::RF3FlatNode const & flat = nodes_[i];
+        if (flat.dim_ == detail::rf3_flat_leaf_tag)
+        {
+            double const * response = responses_ + flat.child_ * n_classes;
+            node_responses.insert(Node(i), typename RF::AccInputType(response, response + n_classes));
+        }
+        else
+        {
+            gr.addArc(Node(i), Node(flat.child_));
+            gr.addArc(Node(i), Node(flat.child_ + 1));
+            split_tests.insert(Node(i), typename RF::SplitTests(flat.dim_, static_cast<FeatureType>(flat.threshold_)));
+        }
+    }
+
+    RF rf(gr, split_tests, node_responses, problem_spec());
+    rf.options_.tree_count(num_trees());
+    return rf;
+}
+
+template <typename FEATURES, typename LABELS>
+std::vector<size_t> FlatRandomForest<FEATURES, LABELS>::check_tree_indices(
+    std::vector<size_t> tree_indices
+) const {
+    // By default, tree_indices is empty. In that case we want to use all trees.
+    if (tree_indices.size() == 0)
+    {
+        tree_indices.resize(num_trees());
+        std::iota(tree_indices.begin(), tree_indices.end(), 0);
+    }
+    else
+    {
+        std::sort(tree_indices.begin(), tree_indices.end());
+        tree_indices.erase(std::unique(tree_indices.begin(), tree_indices.end()), tree_indices.end());
+        for (auto i : tree_indices)
+            vigra_precondition(i < num_trees(), "FlatRandomForest: Tree index out of range.");
+    }
+    return tree_indices;
+}
+
+template <typename FEATURES, typename LABELS>
+void FlatRandomForest<FEATURES, LABELS>::predict(
+    FEATURES const & features,
+    LABELS & labels,
+    int n_threads,
+    const std::vector<size_t> & tree_indices
+) const {
+    vigra_precondition(features.shape()[0] == labels.shape()[0],
+                       "FlatRandomForest::predict(): Shape mismatch between features and labels.");
+
+    MultiArray<2, double> probs(Shape2(features.shape()[0], num_classes()));
+    predict_probabilities(features, probs, n_threads, tree_indices);
+    for (size_t i = 0; i < (size_t)features.shape()[0]; ++i)
+    {
+        auto const sub_probs = probs.template bind<0>(i);
+        auto it = std::max_element(sub_probs.begin(), sub_probs.end());
+        labels(i) = class_label(std::distance(sub_probs.begin(), it));
+    }
+}
+
+template <typename FEATURES, typename LABELS>
+template <typename PROBS>
+void FlatRandomForest<FEATURES, LABELS>::predict_probabilities(
+    FEATURES const & features,
+    PROBS & probs,
+    int n_threads,
+    const std::vector<size_t> & tree_indices
+) const {
+    vigra_precondition(features.shape()[0] == probs.shape()[0],
+                       "FlatRandomForest::predict_probabilities(): Shape mismatch between features and probabilities.");
+    vigra_precondition((size_t)features.shape()[1] == num_features(),
+                       "FlatRandomForest::predict_probabilities(): Number of features in prediction differs from training.");
+    vigra_precondition((size_t)probs.shape()[1] == num_classes(),
+                       "FlatRandomForest::predict_probabilities(): Number of labels in probabilities differs from training.");
+
+    std::vector<size_t> const trees = check_tree_indices(tree_indices);
+
+    if (n_threads == -1)
+        n_threads = std::thread::hardware_concurrency();
+    if (n_threads < 1)
+        n_threads = 1;
+
+    size_t const n_classes = num_classes();
+    parallel_foreach(
+        n_threads,
+        features.shape()[0],
+        [&features, &probs, &trees, n_classes, this](size_t, size_t i) {
+            auto const sub_features = features.template bind<0>(i);
+            auto sub_probs = probs.template bind<0>(i);
+            std::fill(sub_probs.begin(), sub_probs.end(), 0.0);
+            double split_comparisons = 0.0;
+            for (auto k : trees)
+            {
+                UInt64 const leaf = this->find_leaf(sub_features, k, split_comparisons);
+                double const * response = this->responses_ + this->nodes_[leaf].child_ * n_classes;
+                for (size_t c = 0; c < n_classes; ++c)
+                    sub_probs(c) += response[c];
+            }
+        }
+    );
+}
+
+template <typename FEATURES, typename LABELS>
+template <typename IDS>
+double FlatRandomForest<FEATURES, LABELS>::leaf_ids(
+    FEATURES const & features,
+    IDS & ids,
+    int n_threads,
+    std::vector<size_t> tree_indices
+) const {
+    vigra_precondition(features.shape()[0] == ids.shape()[0],
+                       "FlatRandomForest::leaf_ids(): Shape mismatch between features and probabilities.");
+    vigra_precondition((size_t)features.shape()[1] == num_features(),
+                       "FlatRandomForest::leaf_ids(): Number of features in prediction differs from training.");
+    vigra_precondition((size_t)ids.shape()[1] == num_trees(),
+                       "FlatRandomForest::leaf_ids(): Leaf array has wrong shape.");
+
+    tree_indices = check_tree_indices(tree_indices);
+
+    if (n_threads == -1)
+        n_threads = std::thread::hardware_concurrency();
+    if (n_threads < 1)
+        n_threads = 1;
+    std::vector<double> split_comparisons(n_threads, 0.0);
+    std::fill(ids.begin(), ids.end(), -1);
+    parallel_foreach(
+        n_threads,
+        features.shape()[0],
+        [this, &features, &ids, &split_comparisons, &tree_indices](size_t thread_id, size_t i) {
+            auto const sub_features = features.template bind<0>(i);
+            for (auto k : tree_indices)
+                ids(i, k) = this->find_leaf(sub_features, k, split_comparisons[thread_id]);
+        }
+    );
+
+    double const sum_split_comparisons = std::accumulate(split_comparisons.begin(), split_comparisons.end(), 0.0);
+    return sum_split_comparisons / features.shape()[0];
+}
+
+/********************************************************/
+/*                                                      */
+/*          rf3::random_forest_serialize_binary         */
+/*                                                      */
+/********************************************************/
+
+/** \brief Write a \ref vigra::rf3::RandomForest into a stream using the flat binary format.
+
+    The forest must use the default split tests and the <tt>ArgMaxVectorAcc</tt>
+    (as returned by \ref vigra::rf3::random_forest()). The stream should be opened in
+    binary mode. The result can be read with \ref vigra::rf3::FlatRandomForest.
+    Training options other than those stored in the \ref vigra::rf3::ProblemSpec
+    are not part of the format.
+
+    <b>\#include</b> \<vigra/random_forest_3_binary_impex.hxx\><br>
+    Namespace: vigra::rf3
+*/
+template <typename RF>
+void random_forest_serialize_binary(RF const & rf, std::ostream & out)
+{
+    typedef typename RF::LabelType LabelType;
+    typedef typename RF::Node Node;
+
+    auto const & gr = rf.graph_;
+    auto const & p = rf.problem_spec_;
+    size_t const num_nodes = gr.numNodes();
+    size_t const num_classes = p.num_classes_;
+
+    vigra_precondition(num_nodes < detail::rf3_flat_leaf_tag,
+                       "random_forest_serialize_binary(): Too many nodes for the flat format.");
+
+    // Translate the nodes and collect the leaf responses.
+    std::vector<detail::RF3FlatNode> nodes(num_nodes);
+    std::vector<double> responses;
+    UInt64 num_leaves = 0;
+    for (size_t i = 0; i < num_nodes; ++i)
+    {
+        Node const n(i);
+        detail::RF3FlatNode & flat = nodes[i];
+        if (gr.numChildren(n) == 0)
+        {
+            // Store the normalized distribution, so prediction only needs to sum up.
+            auto const & prob = rf.node_responses_.at(n);
+            double const total = std::accumulate(prob.begin(), prob.end(), 0.0);
+            vigra_precondition(prob.size() <= num_classes,
+                               "random_forest_serialize_binary(): Leaf response has too many classes.");
+            for (size_t c = 0; c < num_classes; ++c)
+                responses.push_back(c < prob.size() ? prob[c] / total : 0.0);
+            flat.threshold_ = 0.0;
+            flat.dim_ = detail::rf3_flat_leaf_tag;
+            flat.child_ = static_cast<UInt32>(num_leaves);
+            ++num_leaves;
+        }
+        else
+        {
+            Node const left = gr.getChild(n, 0);
+            Node const right = gr.getChild(n, 1);
+            vigra_precondition(gr.numChildren(n) == 2 && right.id() == left.id() + 1,
+                               "random_forest_serialize_binary(): The children of a node must have consecutive ids.");
+            auto const & split = rf.split_tests_.at(n);
+            flat.threshold_ = split.val_;
+            flat.dim_ = static_cast<UInt32>(split.dim_);
+            flat.child_ = static_cast<UInt32>(left.id());
+        }
+    }
+
+    std::vector<UInt64> roots(gr.numRoots());
+    for (size_t k = 0; k < roots.size(); ++k)
+        roots[k] = gr.getRoot(k).id();
+
+    // Compute the section offsets.
+    detail::RF3FlatHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic_, detail::rf3_flat_magic, sizeof(header.magic_));
+    header.byte_order_ = detail::rf3_flat_byte_order;
+    header.version_ = detail::rf3_flat_version;
+    header.label_size_ = sizeof(LabelType);
+    header.label_kind_ = detail::rf3_flat_label_kind<LabelType>();
+    header.num_features_ = p.num_features_;
+    header.num_instances_ = p.num_instances_;
+    header.num_classes_ = num_classes;
+    header.actual_mtry_ = p.actual_mtry_;
+    header.actual_msample_ = p.actual_msample_;
+    header.num_trees_ = roots.size();
+    header.num_nodes_ = num_nodes;
+    header.num_leaves_ = num_leaves;
+    header.roots_offset_ = detail::rf3_flat_align(sizeof(header));
+    header.nodes_offset_ = detail::rf3_flat_align(header.roots_offset_ + roots.size()*sizeof(UInt64));
+    header.responses_offset_ = detail::rf3_flat_align(header.nodes_offset_ + nodes.size()*sizeof(detail::RF3FlatNode));
+    header.classes_offset_ = detail::rf3_flat_align(header.responses_offset_ + responses.size()*sizeof(double));
+    header.total_size_ = detail::rf3_flat_align(header.classes_offset_ + num_classes*sizeof(LabelType));
+
+    // Write the sections with zero padding in between.
+    UInt64 written = 0;
+    auto write_section = [&out, &written](UInt64 offset, void const * data, size_t size)
+    {
+        static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        out.write(zeros, offset - written);
+        out.write(static_cast<char const *>(data), size);
+        written = offset + size;
+    };
+    write_section(0, &header, sizeof(header));
+    write_section(header.roots_offset_, roots.data(), roots.size()*sizeof(UInt64));
+    write_section(header.nodes_offset_, nodes.data(), nodes.size()*sizeof(detail::RF3FlatNode));
+    write_section(header.responses_offset_, responses.data(), responses.size()*sizeof(double));
+    write_section(header.classes_offset_, p.distinct_classes_.data(), num_classes*sizeof(LabelType));
+    write_section(header.total_size_, 0, 0);
+
+    vigra_postcondition(static_cast<bool>(out),
+                        "random_forest_serialize_binary(): Writing the random forest failed.");
+}
+
+//@}
+
+} // namespace rf3
+
+} // namespace vigra
+
+#endif
@@ -0,0 +1,410 @@
+/************************************************************************/
+/*                                                                      */
+/*        Copyright 2014-2015 by Ullrich Koethe and Philip Schill       */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#ifndef VIGRA_RF3_PROXIMITY_HXX
+#define VIGRA_RF3_PROXIMITY_HXX
+
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+#include "../multi_array.hxx"
+#include "../threadpool.hxx"
+#include "random_forest_visitors.hxx"
+
+namespace vigra
+{
+namespace rf3
+{
+
+/** \brief Sparse matrix of random forest proximities.
+
+    The proximity of two instances is the fraction of trees in which they end up
+    in the same leaf. Row \a i holds (at most) the \a max_neighbors instances with
+    the highest proximity to instance \a i (the instance itself is left out), sorted
+    by instance index. Thus, the matrix is a k-nearest-neighbor graph and not
+    necessarily symmetric.
+
+    <b>\#include</b> \<vigra/random_forest_3.hxx\><br/>
+    Namespace: vigra::rf3
+*/
+class RFProximities
+{
+public:
+
+    RFProximities()
+        :
+        offsets_(1, 0)
+    {}
+
+    /// \brief Return the number of rows (instances).
+    size_t num_instances() const
+    {
+        return offsets_.size() - 1;
+    }
+
+    /// \brief Return the number of stored neighbors of instance \a i.
+    size_t num_neighbors(size_t i) const
+    {
+        return offsets_[i+1] - offsets_[i];
+    }
+
+    /// \brief Return the index of the \a k-th neighbor of instance \a i.
+    size_t neighbor(size_t i, size_t k) const
+    {
+        return neighbors_[offsets_[i] + k];
+    }
+
+    /// \brief Return the proximity between instance \a i and its \a k-th neighbor.
+    double proximity(size_t i, size_t k) const
+    {
+        return proximities_[offsets_[i] + k];
+    }
+
+    /// \brief Return the proximity between instance \a i and \a j (0 if \a j is not stored in row \a i).
+    double operator()(size_t i, size_t j) const
+    {
+        if (i == j)
+            return 1.0;
+        auto const begin = neighbors_.begin() + offsets_[i];
+        auto const end = neighbors_.begin() + offsets_[i+1];
+        auto const it = std::lower_bound(begin, end, (UInt32)j);
+        if (it == end || *it != j)
+            return 0.0;
+        return proximities_[it - neighbors_.begin()];
+    }
+
+    /// \brief Row i is stored in [offsets_[i], offsets_[i+1]) of neighbors_ and proximities_.
+    std::vector<size_t> offsets_;
+    std::vector<UInt32> neighbors_;
+    std::vector<double> proximities_;
+};
+
+namespace detail
+{
+
+/// Number of set bits.
+inline UInt32 popcount(UInt64 x)
+{
+    x = x - ((x >> 1) & 0x5555555555555555ull);
+    x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (UInt32)((x * 0x0101010101010101ull) >> 56);
+}
+
+/**
+ * @brief Compute the proximities from the leaf ids.
+ *
+ * The instances are grouped by leaf (the leaf ids are unique in the whole forest,
+ * so one counting sort suffices), then the rows are computed in parallel: the
+ * co-occurrences of instance i are counted by going through the leaves of i, and
+ * the max_neighbors largest counts are kept. The working memory is one counter per
+ * instance and thread in addition to the leaf ids.
+ *
+ * If oob_masks is not empty, it contains a bit mask of length words_per_mask for
+ * each instance, where bit t is set if the instance is out-of-bag for tree t. Then,
+ * only trees where both instances are out-of-bag are counted, and the proximity is
+ * normalized by the number of those trees.
+ */
+template <typename IDS>
+RFProximities leaf_id_proximities_impl(
+        IDS const & ids,
+        size_t max_neighbors,
+        int n_threads,
+        std::vector<UInt64> const & oob_masks,
+        size_t words_per_mask
+){
+    size_t const num_instances = ids.shape()[0];
+    size_t const num_trees = ids.shape()[1];
+    vigra_precondition(num_instances < (size_t)NumericTraits<UInt32>::max(),
+                       "random_forest_proximities(): Too many instances.");
+    bool const use_oob = oob_masks.size() > 0;
+    auto is_oob = [&](size_t i, size_t t)
+    {
+        return (oob_masks[i*words_per_mask + t/64] >> (t%64)) & 1;
+    };
+
+    // Group the instances by leaf.
+    Int64 max_id = -1;
+    for (auto id : ids)
+        max_id = std::max(max_id, (Int64)id);
+    std::vector<size_t> leaf_offsets(max_id+2, 0);
+    for (size_t i = 0; i < num_instances; ++i)
+        for (size_t t = 0; t < num_trees; ++t)
+            if (ids(i, t) >= 0 && (!use_oob || is_oob(i, t)))
+                ++leaf_offsets[ids(i, t)+1];
+    std::partial_sum(leaf_offsets.begin(), leaf_offsets.end(), leaf_offsets.begin());
+    std::vector<UInt32> leaf_instances(leaf_offsets.back());
+    {
+        std::vector<size_t> pos(leaf_offsets.begin(), leaf_offsets.end()-1);
+        for (size_t i = 0; i < num_instances; ++i)
+            for (size_t t = 0; t < num_trees; ++t)
+                if (ids(i, t) >= 0 && (!use_oob || is_oob(i, t)))
+                    leaf_instances[pos[ids(i, t)]++] = (UInt32)i;
+    }
+
+    if (n_threads == -1)
+        n_threads = std::thread::hardware_concurrency();
+    if (n_threads < 1)
+        n_threads = 1;
+
+    // Compute the rows with fixed capacity max_neighbors (an instance has at most
+    // num_instances-1 neighbors, so a larger value would only waste memory).
+    if (num_instances > 0)
+        max_neighbors = std::min(max_neighbors, num_instances - 1);
+    typedef std::pair<double, UInt32> Entry;
+    std::vector<Entry> rows(num_instances * max_neighbors);
+    std::vector<size_t> row_sizes(num_instances, 0);
+    std::vector<std::vector<UInt32> > counters(n_threads);
+    std::vector<std::vector<UInt32> > touched(n_threads);
+    std::vector<std::vector<Entry> > candidates(n_threads);
+    parallel_foreach(
+        n_threads,
+        num_instances,
+        [&](size_t thread_id, size_t i)
+        {
+            auto & counter = counters[thread_id];
+            auto & touched_instances = touched[thread_id];
+            auto & cands = candidates[thread_id];
+            if (counter.size() != num_instances)
+                counter.resize(num_instances, 0);
+
+            // Count how often the other instances share a leaf with i.
+            for (size_t t = 0; t < num_trees; ++t)
+            {
+                Int64 const leaf = ids(i, t);
+                if (leaf < 0 || (use_oob && !is_oob(i, t)))
+                    continue;
+                for (size_t k = leaf_offsets[leaf]; k < leaf_offsets[leaf+1]; ++k)
+                {
+                    UInt32 const j = leaf_instances[k];
+                    if (j == i)
+                        continue;
+                    if (counter[j] == 0)
+                        touched_instances.push_back(j);
+                    ++counter[j];
+                }
+            }
+
+            // Normalize the counts and reset the counters.
+            cands.clear();
+            for (auto j : touched_instances)
+            {
+                double norm = num_trees;
+                if (use_oob)
+                {
+                    norm = 0.0;
+                    for (size_t w = 0; w < words_per_mask; ++w)
+                        norm += detail::popcount(oob_masks[i*words_per_mask + w] & oob_masks[j*words_per_mask + w]);
+                }
+                cands.push_back(Entry(counter[j] / norm, j));
+                counter[j] = 0;
+            }
+            touched_instances.clear();
+
+            // Keep the neighbors with the highest proximities (the lower index on ties).
+            auto greater = [](Entry const & a, Entry const & b)
+            {
+                return a.first > b.first || (a.first == b.first && a.second < b.second);
+            };
+            size_t const n = std::min(max_neighbors, cands.size());
+            std::nth_element(cands.begin(), cands.begin() + n, cands.end(), greater);
+            std::sort(cands.begin(), cands.begin() + n,
+                [](Entry const & a, Entry const & b)
+                {
+                    return a.second < b.second;
+                }
+            );
+            std::copy(cands.begin(), cands.begin() + n, rows.begin() + i*max_neighbors);
+            row_sizes[i] = n;
+        }
+    );
+
+    // Compact the rows.
+    RFProximities prox;
+    prox.offsets_.resize(num_instances+1);
+    prox.offsets_[0] = 0;
+    for (size_t i = 0; i < num_instances; ++i)
+        prox.offsets_[i+1] = prox.offsets_[i] + row_sizes[i];
+    prox.neighbors_.resize(prox.offsets_.back());
+    prox.proximities_.resize(prox.offsets_.back());
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        for (size_t k = 0; k < row_sizes[i]; ++k)
+        {
+            prox.proximities_[prox.offsets_[i]+k] = rows[i*max_neighbors+k].first;
+            prox.neighbors_[prox.offsets_[i]+k] = rows[i*max_neighbors+k].second;
+        }
+    }
+    return prox;
+}
+
+} // namespace detail
+
+/** \brief Compute sparse random forest proximities from precomputed leaf ids.
+
+    \a ids must have the shape <tt>num_instances x num_trees</tt> and contain the leaf
+    ids as computed by \ref vigra::rf3::RandomForest::leaf_ids() (negative ids are ignored).
+    Since the leaf ids can be cached, this is useful when the proximities are computed
+    repeatedly, e.g. for different values of \a max_neighbors.
+
+    Only the \a max_neighbors neighbors with highest proximity are kept for each instance,
+    so the result needs <tt>O(num_instances * max_neighbors)</tt> memory. The run time is
+    proportional to the sum of the squared leaf sizes, i.e. it is small for fully grown trees.
+
+    <b>\#include</b> \<vigra/random_forest_3.hxx\><br/>
+    Namespace: vigra::rf3
+*/
+template <typename IDS>
+RFProximities
+leaf_id_proximities(
+        IDS const & ids,
+        size_t max_neighbors,
+        int n_threads = -1
+){
+    return detail::leaf_id_proximities_impl(ids, max_neighbors, n_threads, std::vector<UInt64>(), 0);
+}
+
+/** \brief Compute sparse random forest proximities of the given instances.
+
+    The proximity of two instances is the fraction of trees in which they end up in the same
+    leaf. For each instance, the \a max_neighbors other instances with the highest proximity
+    are stored, see \ref vigra::rf3::RFProximities. Use \ref vigra::rf3::OOBProximities to
+    get the out-of-bag proximities of the training data.
+
+    <b> Usage:</b>
+
+    \code
+    auto rf = rf3::random_forest(train_features, train_labels);
+    auto prox = rf3::random_forest_proximities(rf, features, 20);
+    for (size_t k = 0; k < prox.num_neighbors(i); ++k)
+        std::cout << prox.neighbor(i, k) << ": " << prox.proximity(i, k) << "\n";
+    \endcode
+
+    <b>\#include</b> \<vigra/random_forest_3.hxx\><br/>
+    Namespace: vigra::rf3
+*/
+template <typename RF>
+RFProximities
+random_forest_proximities(
+        RF const & rf,
+        typename RF::Features const & features,
+        size_t max_neighbors,
+        int n_threads = -1
+){
+    MultiArray<2, Int64> ids(Shape2(features.shape()[0], rf.num_trees()));
+    rf.leaf_ids(features, ids, n_threads);
+    return leaf_id_proximities(ids, max_neighbors, n_threads);
+}
+
+/**
+ * @brief Compute the out-of-bag proximities of the training data.
+ *
+ * Two instances are only compared in trees for which both are out-of-bag, and the
+ * proximity is normalized by the number of these trees (Breiman's out-of-bag proximity).
+ * Only the max_neighbors neighbors with the highest proximity are stored for each
+ * instance, see RFProximities.
+ */
+class OOBProximities : public RFVisitorBase
+{
+public:
+
+    explicit OOBProximities(size_t max_neighbors = 20, int n_threads = -1)
+        :
+        max_neighbors_(max_neighbors),
+        n_threads_(n_threads)
+    {}
+
+    /**
+     * Save whether a data point is in-bag (weight > 0) or out-of-bag (weight == 0).
+     */
+    template <typename TREE, typename FEATURES, typename LABELS, typename WEIGHTS>
+    void visit_before_tree(
+            TREE & /*tree*/,
+            FEATURES & /*features*/,
+            LABELS & /*labels*/,
+            WEIGHTS & weights
+    ){
+        double const EPS = 1e-20;
+        is_in_bag_.resize(weights.size());
+        for (size_t i = 0; i < weights.size(); ++i)
+            is_in_bag_[i] = std::abs(weights[i]) >= EPS;
+    }
+
+    /**
+     * Compute the proximities.
+     */
+    template <typename VISITORS, typename RF, typename FEATURES, typename LABELS>
+    void visit_after_training(
+            VISITORS & visitors,
+            RF & rf,
+            const FEATURES & features,
+            const LABELS & /*labels*/
+    ){
+        vigra_precondition(visitors.size() == rf.num_trees(),
+                           "OOBProximities::visit_after_training(): Number of visitors must be equal to number of trees.");
+        size_t const num_instances = features.shape()[0];
+        size_t const num_trees = rf.num_trees();
+        for (auto vptr : visitors)
+            vigra_precondition(vptr->is_in_bag_.size() == num_instances,
+                               "OOBProximities::visit_after_training(): Some visitors have the wrong number of data points.");
+
+        size_t const words_per_mask = (num_trees + 63) / 64;
+        std::vector<UInt64> oob_masks(num_instances * words_per_mask, 0);
+        for (size_t t = 0; t < num_trees; ++t)
+            for (size_t i = 0; i < num_instances; ++i)
+                if (!visitors[t]->is_in_bag_[i])
+                    oob_masks[i*words_per_mask + t/64] |= UInt64(1) << (t%64);
+
+        MultiArray<2, Int64> ids(Shape2(num_instances, num_trees));
+        rf.leaf_ids(features, ids, n_threads_);
+        proximities_ = detail::leaf_id_proximities_impl(ids, max_neighbors_, n_threads_, oob_masks, words_per_mask);
+    }
+
+    /**
+     * the out-of-bag proximities
+     */
+    RFProximities proximities_;
+
+private:
+    size_t max_neighbors_;
+    int n_threads_;
+    std::vector<bool> is_in_bag_; // whether a data point is in-bag or out-of-bag
+};
+
+} // namespace rf3
+} // namespace vigra
+
+#endif
@@ -538,13 +538,16 @@ public:
         next_(RFStopVisiting())
     {}
 
-    explicit RFVisitorNode(RFVisitorNode<Visitor, Next, !CPY> & other)
+    // The rest of the chain differs in the copy argument as well.
+    template <typename OTHER_NEXT>
+    explicit RFVisitorNode(RFVisitorNode<Visitor, OTHER_NEXT, !CPY> & other)
         :
         visitor_(other.visitor_),
         next_(other.next_)
     {}
 
-    explicit RFVisitorNode(RFVisitorNode<Visitor, Next, !CPY> const & other)
+    template <typename OTHER_NEXT>
+    explicit RFVisitorNode(RFVisitorNode<Visitor, OTHER_NEXT, !CPY> const & other)
         :
         visitor_(other.visitor_),
         next_(other.next_)
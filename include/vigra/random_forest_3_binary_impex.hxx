@@ -0,0 +1,231 @@
+/************************************************************************/
+/*                                                                      */
+/*        Copyright 2014-2015 by Ullrich Koethe and Philip Schill       */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#ifndef VIGRA_RF3_IMPEX_BINARY_HXX
+#define VIGRA_RF3_IMPEX_BINARY_HXX
+
+#include <string>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+
+#include "config.hxx"
+#include "random_forest_3/random_forest.hxx"
+#include "random_forest_3/random_forest_common.hxx"
+#include "random_forest_3/random_forest_flat.hxx"
+
+#ifdef _WIN32
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+#endif
+
+namespace vigra
+{
+namespace rf3
+{
+
+namespace detail
+{
+
+// Read-only mapping of a whole file. The mapping is shared, so all processes
+// that map the same file use the same physical pages of the page cache.
+class ReadOnlyFileMapping
+{
+public:
+
+    explicit ReadOnlyFileMapping(std::string const & filename)
+        :
+        data_(0),
+        size_(0)
+    {
+    #ifdef _WIN32
+        file_ = ::CreateFile(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file_ == INVALID_HANDLE_VALUE)
+            throw std::runtime_error("random_forest_map_binary(): unable to open file '" + filename + "'.");
+        LARGE_INTEGER size;
+        if (!::GetFileSizeEx(file_, &size))
+        {
+            ::CloseHandle(file_);
+            throw std::runtime_error("random_forest_map_binary(): unable to determine file size.");
+        }
+        size_ = static_cast<size_t>(size.QuadPart);
+        mapping_ = ::CreateFileMapping(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping_ == NULL)
+        {
+            ::CloseHandle(file_);
+            throw std::runtime_error("random_forest_map_binary(): CreateFileMapping() failed.");
+        }
+        data_ = ::MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+        if (data_ == NULL)
+        {
+            ::CloseHandle(mapping_);
+            ::CloseHandle(file_);
+            throw std::runtime_error("random_forest_map_binary(): MapViewOfFile() failed.");
+        }
+    #else
+        int const fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd == -1)
+            throw std::runtime_error("random_forest_map_binary(): unable to open file '" + filename + "'.");
+        struct stat st;
+        if (::fstat(fd, &st) == -1)
+        {
+            ::close(fd);
+            throw std::runtime_error("random_forest_map_binary(): unable to determine file size.");
+        }
+        size_ = static_cast<size_t>(st.st_size);
+        if (size_ > 0)
+        {
+            data_ = ::mmap(0, size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (data_ == MAP_FAILED)
+            {
+                data_ = 0;
+                ::close(fd);
+                throw std::runtime_error("random_forest_map_binary(): mmap() failed.");
+            }
+        }
+        // The mapping stays valid after the file descriptor is closed.
+        ::close(fd);
+    #endif
+    }
+
+    ~ReadOnlyFileMapping()
+    {
+    #ifdef _WIN32
+        ::UnmapViewOfFile(data_);
+        ::CloseHandle(mapping_);
+        ::CloseHandle(file_);
+    #else
+        if (data_ != 0)
+            ::munmap(data_, size_);
+    #endif
+    }
+
+    void const * data() const
+    {
+        return data_;
+    }
+
+    size_t size() const
+    {
+        return size_;
+    }
+
+private:
+
+    ReadOnlyFileMapping(ReadOnlyFileMapping const &);
+    ReadOnlyFileMapping & operator=(ReadOnlyFileMapping const &);
+
+    void * data_;
+    size_t size_;
+#ifdef _WIN32
+    HANDLE file_;
+    HANDLE mapping_;
+#endif
+};
+
+} // namespace detail
+
+/** \brief Save a \ref vigra::rf3::RandomForest in the flat binary format.
+
+    In contrast to \ref vigra::rf3::random_forest_export_HDF5(), the resulting file
+    does not need HDF5 and can be used for prediction without deserialization, see
+    \ref vigra::rf3::random_forest_map_binary().
+
+    <b>\#include</b> \<vigra/random_forest_3_binary_impex.hxx\><br>
+    Namespace: vigra::rf3
+*/
+template <typename RF>
+void random_forest_export_binary(
+        RF const & rf,
+        std::string const & filename
+){
+    std::ofstream out(filename.c_str(), std::ios::binary | std::ios::trunc);
+    vigra_precondition(out.is_open(),
+                       "random_forest_export_binary(): unable to open file '" + filename + "'.");
+    random_forest_serialize_binary(rf, out);
+}
+
+/** \brief Memory-map a random forest that was saved with \ref vigra::rf3::random_forest_export_binary().
+
+    The returned \ref vigra::rf3::FlatRandomForest (and all its copies) keeps the mapping alive.
+    Nothing but the header is touched when the forest is mapped, the operating system
+    loads the tree nodes on demand and shares them between all processes that map the
+    same file.
+
+    <b> Usage:</b>
+
+    \code
+    auto rf = rf3::random_forest(train_features, train_labels);
+    rf3::random_forest_export_binary(rf, "forest.rf3");
+
+    // in the worker processes
+    auto flat_rf = rf3::random_forest_map_binary<Features, Labels>("forest.rf3");
+    flat_rf.predict(test_features, test_labels);
+    \endcode
+
+    <b>\#include</b> \<vigra/random_forest_3_binary_impex.hxx\><br>
+    Namespace: vigra::rf3
+*/
+template <typename FEATURES, typename LABELS>
+FlatRandomForest<FEATURES, LABELS>
+random_forest_map_binary(std::string const & filename)
+{
+    std::shared_ptr<detail::ReadOnlyFileMapping> mapping(new detail::ReadOnlyFileMapping(filename));
+    return FlatRandomForest<FEATURES, LABELS>(mapping->data(), mapping->size(), mapping);
+}
+
+/** \brief Load a random forest that was saved with \ref vigra::rf3::random_forest_export_binary().
+
+    Use \ref vigra::rf3::random_forest_map_binary() if the forest is only used for prediction.
+
+    <b>\#include</b> \<vigra/random_forest_3_binary_impex.hxx\><br>
+    Namespace: vigra::rf3
+*/
+template <typename FEATURES, typename LABELS>
+RandomForest<FEATURES, LABELS>
+random_forest_import_binary(std::string const & filename)
+{
+    return random_forest_map_binary<FEATURES, LABELS>(filename).to_random_forest();
+}
+
+} // namespace rf3
+} // namespace vigra
+
+#endif // VIGRA_RF3_IMPEX_BINARY_HXX
@@ -144,12 +144,18 @@ random_forest_import_HDF5(HDF5File & h5ctx, std::string const & pathname = "")
     int mtry_switch_int;
     int bootstrap_sampling_int;
     int tree_count;
+    double training_set_calc_switch = 1.0;
+    double training_set_size = 0.0;
     h5ctx.cd(rf_hdf5_options);
     h5ctx.read("min_split_node_size_", min_num_instances);
     h5ctx.read("mtry_", mtry);
     h5ctx.read("mtry_switch_", mtry_switch_int);
     h5ctx.read("sample_with_replacement_", bootstrap_sampling_int);
     h5ctx.read("tree_count_", tree_count);
+    if (h5ctx.existsDataset("training_set_calc_switch_"))
+        h5ctx.read("training_set_calc_switch_", training_set_calc_switch);
+    if (h5ctx.existsDataset("training_set_size_"))
+        h5ctx.read("training_set_size_", training_set_size);
     h5ctx.cd_up();
 
     RandomForestOptionTags mtry_switch = (RandomForestOptionTags)mtry_switch_int;
@@ -170,6 +176,9 @@ random_forest_import_HDF5(HDF5File & h5ctx, std::string const & pathname = "")
                             .min_num_instances(min_num_instances)
                             .bootstrap_sampling(bootstrap_sampling)
                             .tree_count(tree_count);
+    // A fixed sample size is stored as in the old random forest (training_set_calc_switch_ == RF_CONST == 7).
+    if (training_set_calc_switch == 7.0 && training_set_size > 0.0)
+        options.bootstrap_sample_size((size_t)training_set_size);
     options.features_per_node_switch_ = mtry_switch;
     options.features_per_node_ = mtry;
     if (is_weighted)
@@ -332,10 +341,11 @@ void random_forest_export_HDF5(
     h5context.write("prepare_online_learning_", 0.0);
     h5context.write("sample_with_replacement_", opts.bootstrap_sampling_ ? 1 : 0);
     h5context.write("stratification_method_", 3.0);
-    h5context.write("training_set_calc_switch_", 1.0);
+    // RF_CONST (7) for a fixed sample size, RF_PROPORTIONAL (1) otherwise (see the old random forest)
+    h5context.write("training_set_calc_switch_", opts.bootstrap_sample_size_ > 0 ? 7.0 : 1.0);
     h5context.write("training_set_func_", 0.0);
     h5context.write("training_set_proportion_", 1.0);
-    h5context.write("training_set_size_", 0.0);
+    h5context.write("training_set_size_", (double)opts.bootstrap_sample_size_);
     h5context.write("tree_count_", opts.tree_count_);
     h5context.cd_up();
 
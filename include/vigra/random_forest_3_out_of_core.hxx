@@ -0,0 +1,345 @@
+/************************************************************************/
+/*                                                                      */
+/*        Copyright 2014-2015 by Ullrich Koethe and Philip Schill       */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+#ifndef VIGRA_RF3_OUT_OF_CORE_HXX
+#define VIGRA_RF3_OUT_OF_CORE_HXX
+
+#include <vector>
+#include <set>
+#include <map>
+#include <algorithm>
+
+#include "multi_array.hxx"
+#include "multi_array_chunked.hxx"
+#include "sampling.hxx"
+#include "threading.hxx"
+#include "threadpool.hxx"
+#include "random_forest_3.hxx"
+
+namespace vigra
+{
+namespace rf3
+{
+
+namespace detail
+{
+
+/// Copy the given rows (sorted in ascending order) of a chunked feature matrix into the buffer.
+/// Only the row blocks that contain at least one of the rows are read.
+template <typename T, typename ITER, typename STRIDE>
+void load_feature_rows(
+        ChunkedArray<2, T> const & features,
+        ITER rows_begin,
+        ITER rows_end,
+        MultiArrayView<2, T, STRIDE> buffer
+){
+    MultiArrayIndex const num_instances = features.shape(0);
+    MultiArrayIndex const num_features = features.shape(1);
+    MultiArrayIndex const block_rows = features.chunkShape(0);
+    vigra_precondition(buffer.shape(0) == std::distance(rows_begin, rows_end) && buffer.shape(1) == num_features,
+                       "load_feature_rows(): Buffer has wrong shape.");
+
+    MultiArray<2, T> block;
+    MultiArrayIndex k = 0;
+    for (ITER it = rows_begin; it != rows_end; )
+    {
+        MultiArrayIndex const block_begin = (*it / block_rows) * block_rows;
+        MultiArrayIndex const block_end = std::min(block_begin + block_rows, num_instances);
+        Shape2 const block_shape(block_end - block_begin, num_features);
+        if (block.shape() != block_shape)
+            block.reshape(block_shape);
+        features.checkoutSubarray(Shape2(block_begin, 0), block);
+        for (; it != rows_end && (MultiArrayIndex)*it < block_end; ++it, ++k)
+            buffer.bindInner(k) = block.bindInner(*it - block_begin);
+    }
+}
+
+
+
+/// \brief Train the trees on bootstrap samples that are loaded from the chunked array.
+template <typename T,
+          typename LABELS,
+          typename SCORER,
+          typename STOP,
+          typename RANDENGINE>
+RandomForest<MultiArrayView<2, T>, LABELS>
+random_forest_out_of_core_impl(
+        ChunkedArray<2, T> const & features,
+        LABELS const & labels,
+        RandomForestOptions const & options,
+        STOP const & stop,
+        RANDENGINE & randengine
+){
+    typedef MultiArrayView<2, T> Features;
+    typedef typename LABELS::value_type LabelType;
+    typedef RandomForest<Features, LABELS> RF;
+
+    size_t const num_instances = features.shape(0);
+    vigra_precondition(num_instances == (size_t)labels.size(),
+                       "random_forest_out_of_core(): Shape mismatch between features and labels.");
+    size_t const sample_size = options.bootstrap_sample_size_ > 0 ? options.bootstrap_sample_size_ : num_instances;
+
+    ProblemSpec<LabelType> pspec;
+    pspec.num_instances(num_instances)
+         .num_features(features.shape(1))
+         .actual_mtry(options.get_features_per_node(features.shape(1)))
+         .actual_msample(options.bootstrap_sampling_ ? sample_size : num_instances);
+
+    // Check the number of trees.
+    size_t const tree_count = options.tree_count_;
+    vigra_precondition(tree_count > 0, "random_forest_out_of_core(): tree_count must not be zero.");
+    std::vector<RF> trees(tree_count);
+
+    // Transform the labels to 0, 1, 2, ...
+    std::set<LabelType> const dlabels(labels.begin(), labels.end());
+    std::vector<LabelType> const distinct_labels(dlabels.begin(), dlabels.end());
+    pspec.distinct_classes(distinct_labels);
+    std::map<LabelType, size_t> label_map;
+    for (size_t i = 0; i < distinct_labels.size(); ++i)
+    {
+        label_map[distinct_labels[i]] = i;
+    }
+
+    MultiArray<1, size_t> transformed_labels(Shape1(labels.size()));
+    for (size_t i = 0; i < (size_t)labels.size(); ++i)
+    {
+        transformed_labels(i) = label_map[labels(i)];
+    }
+
+    // Check the vector with the class weights.
+    vigra_precondition(options.class_weights_.size() == 0 || options.class_weights_.size() == distinct_labels.size(),
+                       "random_forest_out_of_core(): The number of class weights must be 0 or equal to the number of classes.");
+
+    // Write the problem specification into the trees.
+    for (auto & t : trees)
+        t.problem_spec_ = pspec;
+
+    // Find the correct number of threads.
+    size_t n_threads = 1;
+    if (options.n_threads_ >= 1)
+        n_threads = options.n_threads_;
+    else if (options.n_threads_ == -1)
+        n_threads = std::thread::hardware_concurrency();
+
+    // Each tree gets its own random engine, so the result does not depend on the number of threads.
+    UniformIntRandomFunctor<RANDENGINE> rand_functor(randengine);
+    std::vector<UInt32> seeds(tree_count);
+    for (auto & seed : seeds)
+        seed = rand_functor();
+
+    // Train the trees. The pool processes the trees in order, so at most
+    // n_threads bootstrap samples are held in memory at the same time.
+    // Reading is serialized, since the storage backend (e.g. HDF5) may not be thread-safe.
+    threading::mutex read_mutex;
+    ThreadPool pool((size_t)n_threads);
+    std::vector<threading::future<void> > futures;
+    for (size_t i = 0; i < tree_count; ++i)
+    {
+        futures.emplace_back(
+            pool.enqueue([&, i](size_t /*thread_id*/)
+                {
+                    RANDENGINE tree_randengine(seeds[i]);
+
+                    // Draw the bootstrap sample and sort it, so the rows can be read block by block.
+                    std::vector<size_t> sampled_rows;
+                    if (options.bootstrap_sampling_)
+                    {
+                        SamplerOptions const sampler_options = SamplerOptions().withReplacement()
+                                                                               .sampleSize(sample_size)
+                                                                               .stratified(options.use_stratification_);
+                        Sampler<RANDENGINE> sampler(transformed_labels.begin(), transformed_labels.end(),
+                                                    sampler_options, &tree_randengine);
+                        sampler.sample();
+                        sampled_rows.assign(sampler.sampledIndices().begin(), sampler.sampledIndices().end());
+                        std::sort(sampled_rows.begin(), sampled_rows.end());
+                    }
+                    else
+                    {
+                        sampled_rows.resize(num_instances);
+                        std::iota(sampled_rows.begin(), sampled_rows.end(), 0);
+                    }
+
+                    // Keep each row only once and use its multiplicity as instance weight.
+                    std::vector<size_t> rows;
+                    std::vector<double> instance_weights;
+                    for (auto r : sampled_rows)
+                    {
+                        if (!rows.empty() && rows.back() == r)
+                        {
+                            ++instance_weights.back();
+                        }
+                        else
+                        {
+                            rows.push_back(r);
+                            instance_weights.push_back(1.0);
+                        }
+                    }
+                    std::vector<size_t>().swap(sampled_rows);
+
+                    // Load the sampled rows.
+                    MultiArray<2, T> tree_features(Shape2(rows.size(), features.shape(1)));
+                    MultiArray<1, size_t> tree_labels(Shape1(rows.size()));
+                    for (size_t k = 0; k < rows.size(); ++k)
+                        tree_labels(k) = transformed_labels(rows[k]);
+                    {
+                        threading::lock_guard<threading::mutex> lock(read_mutex);
+                        load_feature_rows(features, rows.begin(), rows.end(), tree_features);
+                    }
+
+                    RFStopVisiting visitor;
+                    random_forest_single_tree<RF, SCORER, RFStopVisiting, STOP>(
+                        tree_features, tree_labels, options, visitor, stop, trees[i], instance_weights, tree_randengine);
+                }
+            )
+        );
+    }
+    for (auto & fut : futures)
+        fut.get();
+
+    // Merge the trees together.
+    RF rf(trees[0]);
+    rf.options_ = options;
+    for (size_t i = 1; i < trees.size(); ++i)
+    {
+        rf.merge(trees[i]);
+    }
+    return rf;
+}
+
+
+
+/// \brief Get the stop criterion from the option object and pass it as template argument.
+template <typename T, typename LABELS, typename SCORER, typename RANDENGINE>
+inline
+RandomForest<MultiArrayView<2, T>, LABELS>
+random_forest_out_of_core_impl0(
+        ChunkedArray<2, T> const & features,
+        LABELS const & labels,
+        RandomForestOptions const & options,
+        RANDENGINE & randengine
+){
+    if (options.max_depth_ > 0)
+        return random_forest_out_of_core_impl<T, LABELS, SCORER, DepthStop, RANDENGINE>(features, labels, options, DepthStop(options.max_depth_), randengine);
+    else if (options.min_num_instances_ > 1)
+        return random_forest_out_of_core_impl<T, LABELS, SCORER, NumInstancesStop, RANDENGINE>(features, labels, options, NumInstancesStop(options.min_num_instances_), randengine);
+    else if (options.node_complexity_tau_ > 0)
+        return random_forest_out_of_core_impl<T, LABELS, SCORER, NodeComplexityStop, RANDENGINE>(features, labels, options, NodeComplexityStop(options.node_complexity_tau_), randengine);
+    else
+        return random_forest_out_of_core_impl<T, LABELS, SCORER, PurityStop, RANDENGINE>(features, labels, options, PurityStop(), randengine);
+}
+
+} // namespace detail
+
+/********************************************************/
+/*                                                      */
+/*               random_forest_out_of_core              */
+/*                                                      */
+/********************************************************/
+
+/** \brief Train a \ref vigra::rf3::RandomForest on features that do not fit into memory.
+
+    The features are given as a \ref vigra::ChunkedArray with shape
+    <tt>num_instances x num_features</tt>, e.g. a \ref vigra::ChunkedArrayHDF5, the labels
+    as an ordinary array with length <tt>num_instances</tt>. For each tree, only the rows of
+    its bootstrap sample are loaded into a dense buffer (duplicate rows are loaded once and
+    weighted by their multiplicity), and the tree is trained on that buffer. Use
+    \ref vigra::rf3::RandomForestOptions::bootstrap_sample_size() to choose a sample that
+    fits into memory: at most <tt>n_threads</tt> samples are held at the same time.
+    The rows are read one chunk row at a time, so chunks that span all features and
+    few instances are most efficient. Reading is serialized, training runs in parallel.
+
+    The trees are trained with the same algorithm as in \ref vigra::rf3::random_forest(),
+    but every tree gets its own random number generator (seeded from \a randengine), so
+    the result does not depend on the number of threads. Visitors are not supported,
+    since they need the full feature matrix. The resulting forest predicts from ordinary
+    feature matrices of type <tt>MultiArrayView<2, T></tt>.
+
+    <b> Usage:</b>
+
+    <b>\#include</b> \<vigra/random_forest_3_out_of_core.hxx\><br>
+    Namespace: vigra::rf3
+
+    \code
+    using namespace vigra;
+
+    HDF5File file("training_data.h5", HDF5File::ReadOnly);
+    ChunkedArrayHDF5<2, float> train_features(file, "features");
+    MultiArray<1, int> train_labels;
+    file.readAndResize("labels", train_labels);
+
+    auto rf = rf3::random_forest_out_of_core(train_features, train_labels,
+                                             rf3::RandomForestOptions().tree_count(100)
+                                                                       .bootstrap_sample_size(1000000));
+    \endcode
+*/
+doxygen_overloaded_function(template <...> void random_forest_out_of_core)
+
+template <typename T, typename LABELS, typename RANDENGINE>
+inline
+RandomForest<MultiArrayView<2, T>, LABELS>
+random_forest_out_of_core(
+        ChunkedArray<2, T> const & features,
+        LABELS const & labels,
+        RandomForestOptions const & options,
+        RANDENGINE & randengine
+){
+    typedef detail::GeneralScorer<GiniScore> GiniScorer;
+    typedef detail::GeneralScorer<EntropyScore> EntropyScorer;
+    typedef detail::GeneralScorer<KolmogorovSmirnovScore> KSDScorer;
+    if (options.split_ == RF_GINI)
+        return detail::random_forest_out_of_core_impl0<T, LABELS, GiniScorer, RANDENGINE>(features, labels, options, randengine);
+    else if (options.split_ == RF_ENTROPY)
+        return detail::random_forest_out_of_core_impl0<T, LABELS, EntropyScorer, RANDENGINE>(features, labels, options, randengine);
+    else if (options.split_ == RF_KSD)
+        return detail::random_forest_out_of_core_impl0<T, LABELS, KSDScorer, RANDENGINE>(features, labels, options, randengine);
+    else
+        throw std::runtime_error("random_forest_out_of_core(): Unknown split criterion.");
+}
+
+template <typename T, typename LABELS>
+inline
+RandomForest<MultiArrayView<2, T>, LABELS>
+random_forest_out_of_core(
+        ChunkedArray<2, T> const & features,
+        LABELS const & labels,
+        RandomForestOptions const & options = RandomForestOptions()
+){
+    auto randengine = MersenneTwister::global();
+    return random_forest_out_of_core(features, labels, options, randengine);
+}
+
+} // namespace rf3
+} // namespace vigra
+
+#endif
@@ -46,6 +46,12 @@
 #include "array_vector.hxx"
 #include "iteratoradapter.hxx"
 
+#ifndef VIGRA_SINGLE_THREADED
+# include <utility>
+# include <vector>
+# include "threading.hxx"
+#endif
+
 namespace vigra {
 
 namespace detail {
@@ -321,6 +327,108 @@ class UnionFindArray
     }
 };
 
+
+#ifndef VIGRA_SINGLE_THREADED
+
+    /** \brief Union-find structure that supports concurrent unions from many threads.
+
+        In contrast to \ref UnionFindArray, the set of indices <tt>[0, size)</tt> is
+        fixed at construction. <tt>findIndex()</tt> and <tt>makeUnion()</tt> may be called
+        concurrently from any number of threads: roots are linked with an atomic
+        compare-and-swap, and paths are shortened by path halving. Roots are always
+        linked to the smaller index, so the representative of each set is its smallest
+        element, independently of the order in which the unions were executed.
+
+        After all concurrent unions are done, <tt>makeContiguous()</tt> numbers the sets
+        consecutively in the order of their smallest elements (not thread-safe) and
+        returns the largest number (the array must not be empty). <tt>findLabel()</tt>
+        returns these numbers.
+
+        <b>\#include</b> \<vigra/union_find.hxx\><br>
+        Namespace: vigra
+    */
+template <class T>
+class ConcurrentUnionFindArray
+{
+    std::vector<threading::atomic<T> > parents_;
+    ArrayVector<T> labels_;
+
+  public:
+    typedef T value_type;
+
+    explicit ConcurrentUnionFindArray(std::size_t size = 0)
+    : parents_(size)
+    {
+        vigra_precondition(size == 0 || size - 1 <= (std::size_t)NumericTraits<T>::max(),
+           "ConcurrentUnionFindArray(): Need more labels than can be represented "
+           "in the index type.");
+        for(std::size_t k = 0; k < size; ++k)
+            parents_[k].store((T)k, threading::memory_order_relaxed);
+    }
+
+    std::size_t size() const
+    {
+        return parents_.size();
+    }
+
+    T findIndex(T index)
+    {
+        while(true)
+        {
+            T parent = parents_[index].load(threading::memory_order_relaxed);
+            if(parent == index)
+                return index;
+            // path halving: concurrent writers only ever replace a parent by one of its ancestors
+            T grandparent = parents_[parent].load(threading::memory_order_relaxed);
+            if(grandparent != parent)
+                parents_[index].compare_exchange_weak(parent, grandparent, threading::memory_order_relaxed);
+            index = grandparent;
+        }
+    }
+
+    T makeUnion(T l1, T l2)
+    {
+        while(true)
+        {
+            T i1 = findIndex(l1);
+            T i2 = findIndex(l2);
+            if(i1 == i2)
+                return i1;
+            if(i1 < i2)
+                std::swap(i1, i2);
+            // link the larger root, unless another thread has linked it in the meantime
+            T expected = i1;
+            if(parents_[i1].compare_exchange_strong(expected, i2, threading::memory_order_acq_rel))
+                return i2;
+            l1 = i1;
+            l2 = i2;
+        }
+    }
+
+    T makeContiguous()
+    {
+        vigra_precondition(parents_.size() > 0,
+           "ConcurrentUnionFindArray::makeContiguous(): the array must not be empty.");
+        labels_.resize(parents_.size());
+        T count = 0;
+        for(std::size_t i = 0; i < parents_.size(); ++i)
+        {
+            T root = findIndex((T)i);
+            labels_[i] = (root == (T)i)
+                             ? count++
+                             : labels_[root];
+        }
+        return count - 1;
+    }
+
+    T findLabel(T index) const
+    {
+        return labels_[index];
+    }
+};
+
+#endif // VIGRA_SINGLE_THREADED
+
 } // namespace vigra
 
 #endif // VIGRA_UNION_FIND_HXX
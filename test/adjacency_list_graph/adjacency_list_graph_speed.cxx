@@ -0,0 +1,165 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+// Compares construction of AdjacencyListGraph by addEdge() and addEdges(),
+// and traversal throughput of AdjacencyListGraph and its frozen (CSR) copy,
+// for plain neighbor iteration and for ShortestPathDijkstra.
+
+//We need to undefine NDEBUG so that we have TIC, TOC available!
+#undef NDEBUG
+
+#include <iostream>
+#include <vigra/timing.hxx>
+USETICTOC;
+#include <vigra/adjacency_list_graph.hxx>
+#include <vigra/graph_algorithms.hxx>
+#include <vigra/random.hxx>
+
+using namespace vigra;
+
+template <class GRAPH>
+Int64 sumOfNeighborIds(GRAPH const & g, int repetitions)
+{
+    Int64 sum = 0;
+    for (int k = 0; k < repetitions; ++k)
+        for (typename GRAPH::NodeIt n(g); n != lemon::INVALID; ++n)
+            for (typename GRAPH::OutArcIt a(g, *n); a != lemon::INVALID; ++a)
+                sum += g.id(g.target(*a));
+    return sum;
+}
+
+template <class GRAPH, class WEIGHTS>
+double shortestPathLength(GRAPH const & g, WEIGHTS const & weights)
+{
+    ShortestPathDijkstra<GRAPH, float> sp(g);
+    sp.run(weights, g.nodeFromId(0));
+    double sum = 0.0;
+    for (typename GRAPH::NodeIt n(g); n != lemon::INVALID; ++n)
+        sum += sp.distances()[*n];
+    return sum;
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    // a region adjacency graph-like random graph: a 3D grid of regions
+    // with face and some diagonal neighbors, edges in random order with duplicates
+    int const size = 80;
+    RandomNumberGenerator<MersenneTwister> random(1);
+    std::vector<TinyVector<Int64, 2> > pairs;
+    for (int z = 0; z < size; ++z)
+        for (int y = 0; y < size; ++y)
+            for (int x = 0; x < size; ++x)
+            {
+                Int64 const n = x + size*(y + size*z);
+                if (x+1 < size)
+                    pairs.push_back(TinyVector<Int64, 2>(n, n + 1));
+                if (y+1 < size)
+                    pairs.push_back(TinyVector<Int64, 2>(n + size, n));
+                if (z+1 < size)
+                    pairs.push_back(TinyVector<Int64, 2>(n, n + size*size));
+                if (x+1 < size && y+1 < size && random.uniform() < 0.5)
+                    pairs.push_back(TinyVector<Int64, 2>(n, n + 1 + size));
+            }
+    std::size_t const unique = pairs.size();
+    for (std::size_t k = 0; k < unique / 4; ++k)
+        pairs.push_back(pairs[random.uniformInt(unique)]);
+    for (std::size_t k = pairs.size() - 1; k > 0; --k)
+        std::swap(pairs[k], pairs[random.uniformInt(k + 1)]);
+
+    TIC;
+    AdjacencyListGraph g;
+    for (std::size_t k = 0; k < pairs.size(); ++k)
+        g.addEdge(pairs[k][0], pairs[k][1]);
+    double const t0 = TOCN;
+    TIC;
+    AdjacencyListGraph bulk;
+    bulk.addEdges(pairs.begin(), pairs.end());
+    double const t00 = TOCN;
+    vigra_invariant(bulk.edgeNum() == g.edgeNum() && bulk.nodeNum() == g.nodeNum(),
+                    "adjacency_list_graph_speed: results differ.");
+    std::cerr << "construction from " << pairs.size() << " node pairs: addEdge() " << t0 << " msec, "
+              << "addEdges() " << t00 << " msec (" << t0 / t00 << "x faster)" << std::endl;
+
+    {
+        // high node degrees, where addEdge() pays for the sorted insertion
+        std::vector<TinyVector<Int64, 2> > densePairs;
+        for (int k = 0; k < 1000000; ++k)
+            densePairs.push_back(TinyVector<Int64, 2>(random.uniformInt(4000), random.uniformInt(4000)));
+        TIC;
+        AdjacencyListGraph dense;
+        for (std::size_t k = 0; k < densePairs.size(); ++k)
+            if (densePairs[k][0] != densePairs[k][1])
+                dense.addEdge(densePairs[k][0], densePairs[k][1]);
+        double const t1 = TOCN;
+        TIC;
+        AdjacencyListGraph denseBulk;
+        denseBulk.addEdges(densePairs.begin(), densePairs.end());
+        double const t2 = TOCN;
+        vigra_invariant(denseBulk.edgeNum() == dense.edgeNum(), "adjacency_list_graph_speed: results differ.");
+        std::cerr << "construction of a graph with average degree " << 2*dense.edgeNum() / dense.nodeNum()
+                  << ": addEdge() " << t1 << " msec, addEdges() " << t2 << " msec (" << t1 / t2 << "x faster)" << std::endl;
+    }
+
+    AdjacencyListGraph::EdgeMap<float> weights(g);
+    for (AdjacencyListGraph::EdgeIt e(g); e != lemon::INVALID; ++e)
+        weights[*e] = random.uniform();
+
+    TIC;
+    FrozenAdjacencyListGraph const f = g.freeze();
+    std::cerr << "graph with " << g.nodeNum() << " nodes and " << g.edgeNum() << " edges, freeze(): "
+              << TOCS << std::endl;
+
+    int const repetitions = 10;
+    TIC;
+    Int64 const s1 = sumOfNeighborIds(g, repetitions);
+    double const t1 = TOCN;
+    TIC;
+    Int64 const s2 = sumOfNeighborIds(f, repetitions);
+    double const t2 = TOCN;
+    vigra_invariant(s1 == s2, "adjacency_list_graph_speed: results differ.");
+    std::cerr << "    OutArcIt traversal (" << repetitions << "x): AdjacencyListGraph " << t1 << " msec, "
+              << "FrozenAdjacencyListGraph " << t2 << " msec (" << t1 / t2 << "x faster)" << std::endl;
+
+    TIC;
+    double const d1 = shortestPathLength(g, weights);
+    double const t3 = TOCN;
+    TIC;
+    double const d2 = shortestPathLength(f, weights);
+    double const t4 = TOCN;
+    vigra_invariant(d1 == d2, "adjacency_list_graph_speed: results differ.");
+    std::cerr << "    ShortestPathDijkstra:          AdjacencyListGraph " << t3 << " msec, "
+              << "FrozenAdjacencyListGraph " << t4 << " msec (" << t3 / t4 << "x faster)" << std::endl;
+    return 0;
+}
@@ -1502,6 +1502,163 @@ struct AdjacencyListGraphTest{
     
     }
 
+    void addEdgesTest()
+    {
+        // random pairs with duplicates in both orientations
+        std::vector<TinyVector<Int64, 2> > pairs;
+        UInt32 seed = 1;
+        for(int i=0; i<500; ++i){
+            seed = seed*1664525u + 1013904223u;
+            const Int64 u = (seed >> 8) % 40 + 1;
+            seed = seed*1664525u + 1013904223u;
+            const Int64 v = (seed >> 8) % 40 + 1;
+            if(u!=v)
+                pairs.push_back(TinyVector<Int64, 2>(u, v));
+        }
+        // the same pairs with self loops
+        std::vector<TinyVector<Int64, 2> > loopPairs(pairs);
+        loopPairs.insert(loopPairs.begin()+7, TinyVector<Int64, 2>(5, 5));
+        loopPairs.insert(loopPairs.begin()+50, TinyVector<Int64, 2>(5, 5));
+        loopPairs.push_back(TinyVector<Int64, 2>(60, 60));
+
+        for(int existing=0; existing<4; ++existing){
+            if(existing==2)
+                pairs.swap(loopPairs);
+            GraphType g, bulk;
+            if(existing%2){
+                // start with a graph that already has nodes and edges
+                for(int k=0; k<2; ++k){
+                    GraphType & h = k==0 ? g : bulk;
+                    h.addEdge(Int64(3), Int64(45));
+                    h.addEdge(Int64(7), Int64(2));
+                    h.addEdge(pairs[10][1], pairs[10][0]);
+                }
+            }
+
+            std::vector<Int64> expectedIds;
+            for(size_t i=0; i<pairs.size(); ++i)
+                expectedIds.push_back(g.id(g.addEdge(pairs[i][0], pairs[i][1])));
+            std::vector<Int64> ids;
+            bulk.addEdges(pairs.begin(), pairs.end(), std::back_inserter(ids));
+
+            should(ids == expectedIds);
+            shouldEqual(bulk.nodeNum(), g.nodeNum());
+            shouldEqual(bulk.edgeNum(), g.edgeNum());
+            shouldEqual(bulk.maxNodeId(), g.maxNodeId());
+            shouldEqual(bulk.maxEdgeId(), g.maxEdgeId());
+            should(std::equal(NodeIt(g), NodeIt(lemon::INVALID), NodeIt(bulk)));
+            for(EdgeIt e(g); e!=lemon::INVALID; ++e){
+                should(bulk.u(*e) == g.u(*e));
+                should(bulk.v(*e) == g.v(*e));
+            }
+            for(NodeIt n(g); n!=lemon::INVALID; ++n){
+                shouldEqual(bulk.degree(*n), g.degree(*n));
+                should(std::equal(OutArcIt(g, *n), OutArcIt(lemon::INVALID), OutArcIt(bulk, *n)));
+            }
+
+            // self loops get valid ids, like in addEdge()
+            for(size_t i=0; i<ids.size(); ++i)
+                should(ids[i] >= 0);
+            if(existing>=2)
+                continue;
+
+            // adding the same edges again changes nothing
+            std::vector<Int64> idsAgain;
+            bulk.addEdges(pairs.begin(), pairs.end(), std::back_inserter(idsAgain));
+            should(idsAgain == expectedIds);
+            shouldEqual(bulk.edgeNum(), g.edgeNum());
+        }
+    }
+
+    void frozenGraphTest()
+    {
+        // node ids with holes, node 0 and 5 do not exist
+        GraphType g;
+        const Int64 nodeIds[] = { 1, 2, 3, 4, 6, 7 };
+        for(int i=0; i<6; ++i)
+            g.addNode(nodeIds[i]);
+        g.addEdge(g.nodeFromId(3), g.nodeFromId(1));
+        g.addEdge(g.nodeFromId(1), g.nodeFromId(2));
+        g.addEdge(g.nodeFromId(2), g.nodeFromId(4));
+        g.addEdge(g.nodeFromId(4), g.nodeFromId(3));
+        g.addEdge(g.nodeFromId(7), g.nodeFromId(1));
+        g.addEdge(g.nodeFromId(6), g.nodeFromId(4));
+        g.addEdge(g.nodeFromId(6), g.nodeFromId(7));
+
+        typedef FrozenAdjacencyListGraph FrozenGraph;
+        const FrozenGraph f = g.freeze();
+
+        shouldEqual(f.nodeNum(), g.nodeNum());
+        shouldEqual(f.edgeNum(), g.edgeNum());
+        shouldEqual(f.arcNum(), g.arcNum());
+        shouldEqual(f.maxNodeId(), g.maxNodeId());
+        shouldEqual(f.maxEdgeId(), g.maxEdgeId());
+        shouldEqual(f.maxArcId(), g.maxArcId());
+        shouldEqual(g.maxDegree(), 3u);
+        shouldEqual(f.maxDegree(), g.maxDegree());
+
+        for(Int64 id=-1; id<=g.maxNodeId()+1; ++id)
+            should(f.nodeFromId(id) == g.nodeFromId(id));
+        for(Int64 id=-1; id<=g.maxEdgeId()+1; ++id)
+            should(f.edgeFromId(id) == g.edgeFromId(id));
+        for(Int64 id=0; id<=g.maxArcId(); ++id)
+            should(f.arcFromId(id) == g.arcFromId(id));
+
+        // same iteration order as the original graph
+        should(std::equal(NodeIt(g), NodeIt(lemon::INVALID), FrozenGraph::NodeIt(f)));
+        shouldEqual(std::distance(FrozenGraph::NodeIt(f), FrozenGraph::NodeIt(lemon::INVALID)), g.nodeNum());
+        should(std::equal(EdgeIt(g), EdgeIt(lemon::INVALID), FrozenGraph::EdgeIt(f)));
+        shouldEqual(std::distance(FrozenGraph::EdgeIt(f), FrozenGraph::EdgeIt(lemon::INVALID)), g.edgeNum());
+        should(std::equal(ArcIt(g), ArcIt(lemon::INVALID), FrozenGraph::ArcIt(f)));
+
+        for(EdgeIt e(g); e!=lemon::INVALID; ++e){
+            should(f.u(*e) == g.u(*e));
+            should(f.v(*e) == g.v(*e));
+            for(int forward=0; forward<2; ++forward){
+                const Arc a = f.direct(*e, forward==1);
+                should(a == g.direct(*e, forward==1));
+                should(f.source(a) == g.source(a));
+                should(f.target(a) == g.target(a));
+                shouldEqual(f.direction(a), g.direction(a));
+            }
+            should(f.direct(*e, g.v(*e)) == g.direct(*e, g.v(*e)));
+            should(f.oppositeNode(g.u(*e), *e) == g.v(*e));
+        }
+
+        for(NodeIt a(g); a!=lemon::INVALID; ++a){
+            shouldEqual(f.degree(*a), g.degree(*a));
+            for(NodeIt b(g); b!=lemon::INVALID; ++b){
+                should(f.findEdge(*a, *b) == g.findEdge(*a, *b));
+                should(f.findArc(*a, *b) == g.findArc(*a, *b));
+            }
+
+            const FrozenGraph::IncEdgeIt incEnd(lemon::INVALID);
+            shouldEqual(std::distance(FrozenGraph::IncEdgeIt(f, *a), incEnd), (std::ptrdiff_t)g.degree(*a));
+            should(std::equal(IncEdgeIt(g, *a), IncEdgeIt(lemon::INVALID), FrozenGraph::IncEdgeIt(f, *a)));
+            should(std::equal(OutArcIt(g, *a), OutArcIt(lemon::INVALID), FrozenGraph::OutArcIt(f, *a)));
+            should(std::equal(InArcIt(g, *a), InArcIt(lemon::INVALID), FrozenGraph::InArcIt(f, *a)));
+            should(std::equal(NeighborNodeIt(g, *a), NeighborNodeIt(lemon::INVALID), FrozenGraph::NeighborNodeIt(f, *a)));
+            should(std::equal(GraphType::OutBackArcIt(g, *a), GraphType::OutBackArcIt(lemon::INVALID),
+                              FrozenGraph::OutBackArcIt(f, *a)));
+            for(FrozenGraph::OutArcIt arc(f, *a); arc!=lemon::INVALID; ++arc)
+                should(f.source(*arc) == *a);
+        }
+
+        // maps of the original graph work with the frozen graph
+        GraphType::EdgeMap<int> edgeMap(g);
+        for(EdgeIt e(g); e!=lemon::INVALID; ++e)
+            edgeMap[*e] = g.id(g.u(*e))*10 + g.id(g.v(*e));
+        for(FrozenGraph::EdgeIt e(f); e!=lemon::INVALID; ++e)
+            shouldEqual(edgeMap[*e], f.id(f.u(*e))*10 + f.id(f.v(*e)));
+
+        // empty graph
+        const FrozenGraph empty = GraphType().freeze();
+        shouldEqual(empty.nodeNum(), 0);
+        shouldEqual(empty.edgeNum(), 0);
+        should(FrozenGraph::NodeIt(empty) == lemon::INVALID);
+        should(FrozenGraph::EdgeIt(empty) == lemon::INVALID);
+    }
+
 };
 
 
@@ -1529,6 +1686,8 @@ struct AdjacencyListGraphTestSuite
 
         add( testCase( &AdjacencyListGraphTest::adjGraphArcTest));
         add( testCase( &AdjacencyListGraphTest::adjGraphArcItTest));
+        add( testCase( &AdjacencyListGraphTest::addEdgesTest));
+        add( testCase( &AdjacencyListGraphTest::frozenGraphTest));
         //add( testCase( &AdjacencyListGraphTest::adjGraphInArcItTest));
         //add( testCase( &AdjacencyListGraphTest::adjGraphOutArcItTest));
 
@@ -0,0 +1,209 @@
+/************************************************************************/
+/*                                                                      */
+/*     Copyright 2013-2014 by Martin Bidlingmaier and Ullrich Koethe    */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+#define VIGRA_CHECK_BOUNDS
+
+#include <vigra/blockwise_agglomeration.hxx>
+
+#include <vigra/multi_array.hxx>
+#include <vigra/multi_array_chunked.hxx>
+#include <vigra/random.hxx>
+#include <vigra/unittest.hxx>
+
+#include <iostream>
+#include <map>
+#include <algorithm>
+
+#include "utils.hxx"
+
+using namespace std;
+using namespace vigra;
+
+struct BlockwiseAgglomerationTest
+{
+    typedef MultiArray<2, UInt32> LabelArray;
+    typedef MultiArray<2, float>  DataArray;
+    typedef Shape2                Shape;
+
+    LabelArray superpixels, quadrants;
+    DataArray indicator;
+
+    // 3x3 superpixels, separated into four quadrants by a strong boundary
+    BlockwiseAgglomerationTest()
+    : superpixels(Shape(30)), quadrants(Shape(30)), indicator(Shape(30))
+    {
+        RandomMT19937 random(42);
+        for(int y = 0; y < 30; ++y)
+        {
+            for(int x = 0; x < 30; ++x)
+            {
+                superpixels(x, y) = 1 + (y / 3) * 10 + x / 3;
+                quadrants(x, y) = 1 + (y / 15) * 2 + x / 15;
+                indicator(x, y) = (x == 14 || x == 15 || y == 14 || y == 15)
+                                      ? 1.0f
+                                      : 0.2f * random.uniformInt(100) / 100.0f;
+            }
+        }
+    }
+
+    // every input region ends up in exactly one output region
+    template <class Array1, class Array2>
+    bool isCoarsening(Array1 const & fine, Array2 const & coarse)
+    {
+        std::map<UInt32, UInt32> mapping;
+        for(int i = 0; i < fine.size(); ++i)
+        {
+            auto m = mapping.insert(std::make_pair(fine[i], coarse[i]));
+            if(m.first->second != coarse[i])
+                return false;
+        }
+        return true;
+    }
+
+    void quadrantTest()
+    {
+        NeighborhoodType neighborhoods[] = { DirectNeighborhood, IndirectNeighborhood };
+        int block_sizes[] = { 4, 7, 15, 64 };
+        for(int n = 0; n < 2; ++n)
+        {
+            for(int b = 0; b < 4; ++b)
+            {
+                for(int threads = 1; threads <= 4; threads += 3)
+                {
+                    LabelArray result(superpixels.shape());
+                    UInt32 count = agglomerateRegionsBlockwise(superpixels, indicator, result, 0.5,
+                                         BlockwiseLabelOptions().neighborhood(neighborhoods[n])
+                                                                .blockShape(Shape(block_sizes[b]))
+                                                                .numThreads(threads));
+                    shouldEqual(count, 4u);
+                    should(equivalentLabels(result.begin(), result.end(),
+                                            quadrants.begin(), quadrants.end()));
+                    shouldEqual(*std::max_element(result.begin(), result.end()), 4u);
+                }
+            }
+        }
+    }
+
+    void thresholdTest()
+    {
+        LabelArray result(superpixels.shape());
+        BlockwiseLabelOptions options;
+        options.blockShape(Shape(8));
+
+        UInt32 count = agglomerateRegionsBlockwise(superpixels, indicator, result, 0.0, options);
+        shouldEqual(count, 100u);
+        should(equivalentLabels(result.begin(), result.end(),
+                                superpixels.begin(), superpixels.end()));
+
+        count = agglomerateRegionsBlockwise(superpixels, indicator, result, 10.0, options);
+        shouldEqual(count, 1u);
+        should(result == LabelArray(superpixels.shape(), 1u));
+    }
+
+    void consistencyTest()
+    {
+        Shape shape(47, 33);
+        LabelArray labels(shape);
+        DataArray data(shape);
+        for(int y = 0; y < shape[1]; ++y)
+            for(int x = 0; x < shape[0]; ++x)
+                labels(x, y) = 1 + (y / 4) * 12 + x / 4;
+        RandomMT19937 random(17);
+        for(auto & d : data)
+            d = random.uniformInt(100);
+
+        LabelArray reference(shape);
+        agglomerateRegionsBlockwise(labels, data, reference, 45.0,
+                                    BlockwiseLabelOptions().blockShape(Shape(10)).numThreads(1));
+        int block_sizes[] = { 5, 9, 64 };
+        for(int b = 0; b < 3; ++b)
+        {
+            LabelArray result(shape);
+            UInt32 count = agglomerateRegionsBlockwise(labels, data, result, 45.0,
+                               BlockwiseLabelOptions().blockShape(Shape(block_sizes[b])).numThreads(4));
+            shouldEqual(*std::max_element(result.begin(), result.end()), count);
+            should(count < *std::max_element(labels.begin(), labels.end()));
+            should(isCoarsening(labels, result));
+        }
+
+        // the result does not depend on the number of threads
+        LabelArray result(shape);
+        agglomerateRegionsBlockwise(labels, data, result, 45.0,
+                                    BlockwiseLabelOptions().blockShape(Shape(10)).numThreads(4));
+        should(result == reference);
+    }
+
+    void chunkedTest()
+    {
+        Shape chunk_shape(8);
+        ChunkedArrayLazy<2, UInt32> labels(superpixels.shape(), chunk_shape),
+                                    result(superpixels.shape(), chunk_shape);
+        ChunkedArrayLazy<2, float>  data(superpixels.shape(), chunk_shape);
+        labels.commitSubarray(Shape(0), superpixels);
+        data.commitSubarray(Shape(0), indicator);
+
+        UInt32 count = agglomerateRegionsBlockwise(labels, data, result, 0.5);
+        shouldEqual(count, 4u);
+
+        LabelArray tested(superpixels.shape()), reference(superpixels.shape());
+        result.checkoutSubarray(Shape(0), tested);
+        agglomerateRegionsBlockwise(superpixels, indicator, reference, 0.5,
+                                    BlockwiseLabelOptions().blockShape(chunk_shape));
+        should(tested == reference);
+    }
+};
+
+struct BlockwiseAgglomerationTestSuite
+  : public test_suite
+{
+    BlockwiseAgglomerationTestSuite()
+      : test_suite("blockwise agglomeration test")
+    {
+        add(testCase(&BlockwiseAgglomerationTest::quadrantTest));
+        add(testCase(&BlockwiseAgglomerationTest::thresholdTest));
+        add(testCase(&BlockwiseAgglomerationTest::consistencyTest));
+        add(testCase(&BlockwiseAgglomerationTest::chunkedTest));
+    }
+};
+
+int main(int argc, char** argv)
+{
+    BlockwiseAgglomerationTestSuite test;
+    int failed = test.run(testsToBeExecuted(argc, argv));
+
+    cout << test.report() << endl;
+
+    return failed != 0;
+}
@@ -135,6 +135,36 @@ void testOnData(DatasIterator datas_begin, DatasIterator datas_end,
     }
 }
 
+template <class Array>
+void testParallelOnData(Array const & data)
+{
+    NeighborhoodType neighborhoods[] = { DirectNeighborhood, IndirectNeighborhood };
+    int threads[] = { 1, 2, 3, 8 };
+    for(int n = 0; n < 2; ++n)
+    {
+        for(int t = 0; t < 4; ++t)
+        {
+            for(int with_background = 0; with_background < 2; ++with_background)
+            {
+                Array correct_labels(data.shape());
+                Array tested_labels(data.shape());
+
+                BlockwiseLabelOptions options;
+                options.neighborhood(neighborhoods[n]).numThreads(threads[t]);
+                if(with_background)
+                    options.ignoreBackgroundValue(1u);
+
+                unsigned int correct_label_number = labelMultiArray(data, correct_labels, options);
+                unsigned int tested_label_number = labelMultiArrayParallel(data, tested_labels, options);
+
+                // same labels as the sequential algorithm, not only equivalent ones
+                shouldEqual(correct_label_number, tested_label_number);
+                should(correct_labels == tested_labels);
+            }
+        }
+    }
+}
+
 struct BlockwiseLabelingTest
 {   
     typedef MultiArray<5, unsigned int> Array5;
@@ -282,6 +312,28 @@ struct BlockwiseLabelingTest
         testOnData(array_ones.begin(), array_ones.end(),
                      shape_ones.begin(), shape_ones.end());
     }
+    void parallelLabelingTest()
+    {
+        for(decltype(array_ones.size()) i = 0; i != array_ones.size(); ++i)
+            testParallelOnData(array_ones[i]);
+        for(decltype(array_twos.size()) i = 0; i != array_twos.size(); ++i)
+            testParallelOnData(array_twos[i]);
+        for(decltype(array_fives.size()) i = 0; i != array_fives.size(); ++i)
+            testParallelOnData(array_fives[i]);
+
+        MultiArray<3, unsigned int> volume(Shape3(40, 30, 50));
+        fillRandom(volume.begin(), volume.end(), 3);
+        testParallelOnData(volume);
+
+        // many tiny strips
+        MultiArray<3, unsigned int> thin(Shape3(30, 30, 5));
+        fillRandom(thin.begin(), thin.end(), 2);
+        MultiArray<3, unsigned int> correct_labels(thin.shape()), tested_labels(thin.shape());
+        unsigned int count = labelMultiArray(thin, correct_labels, IndirectNeighborhood);
+        shouldEqual(count, labelMultiArrayParallel(thin, tested_labels,
+                                     BlockwiseLabelOptions().neighborhood(IndirectNeighborhood).numThreads(16)));
+        should(correct_labels == tested_labels);
+    }
 };
 
 struct BlockwiseLabelingTestSuite
@@ -295,6 +347,7 @@ struct BlockwiseLabelingTestSuite
         add(testCase(&BlockwiseLabelingTest::fiveDimensionalRandomTest));
         add(testCase(&BlockwiseLabelingTest::debugTest));
         add(testCase(&BlockwiseLabelingTest::chunkedArrayTest));
+        add(testCase(&BlockwiseLabelingTest::parallelLabelingTest));
     }
 };
 
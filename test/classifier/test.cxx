@@ -427,6 +427,69 @@ struct ClassifierTest
         }
         std::cerr << "DONE!\n\n";
     }
+
+/**
+        ClassifierTest::RFPresortedAndParallelTest():
+    PresortedGiniSplit must find the same splits as GiniSplit. Parallel learning must
+    give the same forest for any number of threads.
+**/
+    void RFPresortedAndParallelTest()
+    {
+        std::cerr << "RFPresortedAndParallelTest(): Learning on Datasets\n";
+        for(int ii = 0; ii < data.size() ; ii++)
+        {
+            vigra::RandomForest<> RF2(vigra::RandomForestOptions()
+                                          .tree_count(16)
+                                          .features_per_node(vigra::RF_ALL));
+            vigra::RandomForest<> RF3(vigra::RandomForestOptions()
+                                          .tree_count(16)
+                                          .features_per_node(vigra::RF_ALL));
+            RF2.learn(  data.features(ii),
+                        data.labels(ii),
+                        rf_default(),
+                        vigra::GiniSplit(),
+                        rf_default(),
+                        vigra::RandomMT19937(1));
+            RF3.learn(  data.features(ii),
+                        data.labels(ii),
+                        rf_default(),
+                        vigra::PresortedGiniSplit(),
+                        rf_default(),
+                        vigra::RandomMT19937(1));
+            for(int jj = 0; jj < RF2.tree_count(); ++jj)
+            {
+                should(RF2.trees_[jj].topology_ == RF3.trees_[jj].topology_);
+                should(RF2.trees_[jj].parameters_ == RF3.trees_[jj].parameters_);
+            }
+
+            vigra::RandomForest<> RF4(vigra::RandomForestOptions()
+                                          .tree_count(16)
+                                          .n_threads(1));
+            vigra::RandomForest<> RF5(vigra::RandomForestOptions()
+                                          .tree_count(16)
+                                          .n_threads(4));
+            rf::visitors::OOB_Error oob4, oob5;
+            RF4.learn(  data.features(ii),
+                        data.labels(ii),
+                        rf::visitors::create_visitor(oob4),
+                        vigra::PresortedGiniSplit(),
+                        rf_default(),
+                        vigra::RandomMT19937(1));
+            RF5.learn(  data.features(ii),
+                        data.labels(ii),
+                        rf::visitors::create_visitor(oob5),
+                        vigra::PresortedGiniSplit(),
+                        rf_default(),
+                        vigra::RandomMT19937(1));
+            for(int jj = 0; jj < RF4.tree_count(); ++jj)
+            {
+                should(RF4.trees_[jj].topology_ == RF5.trees_[jj].topology_);
+                should(RF4.trees_[jj].parameters_ == RF5.trees_[jj].parameters_);
+            }
+            shouldEqual(oob4.oob_breiman, oob5.oob_breiman);
+        }
+        std::cerr << "DONE!\n\n";
+    }
 /**
         ClassifierTest::RFdefaultTest():
     Learns The Refactored Random Forest with a fixed Random Seed and default sampling Options on
@@ -1073,6 +1136,7 @@ struct ClassifierTestSuite
 
         add( testCase( &ClassifierTest::RFridgeRegressionTest));
         add( testCase( &ClassifierTest::RFSplitFunctorTest));
+        add( testCase( &ClassifierTest::RFPresortedAndParallelTest));
 #ifdef HasHDF5
         add( testCase( &ClassifierTest::HDF5ImpexTest));
         add( testCase( &ClassifierTest::HDF5InvalidImportTest));
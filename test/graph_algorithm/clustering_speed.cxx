@@ -0,0 +1,121 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+// Compares the run time of hierarchicalClustering() on a large region adjacency
+// graph in exact mode, with lazy priority updates, and in batch mode.
+
+//We need to undefine NDEBUG so that we have TIC, TOC available!
+#undef NDEBUG
+
+#include <iostream>
+#include <set>
+#include <vigra/timing.hxx>
+USETICTOC;
+#include <vigra/multi_array.hxx>
+#include <vigra/graph_algorithms.hxx>
+#include <vigra/hierarchical_clustering.hxx>
+#include <vigra/random.hxx>
+
+using namespace vigra;
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    typedef GridGraph<2, boost_graph::undirected_tag> Grid;
+    typedef TinyVector<float, 8>                      Feature;
+
+    // superpixel-like labels: 4x4 blocks with jittered boundaries
+    Shape2 const shape(1600, 1600);
+    MultiArrayIndex const block = 4;
+    RandomNumberGenerator<MersenneTwister> random(1);
+    MultiArray<2, UInt32> labels(shape);
+    MultiArrayIndex blocks = (shape[0] + block - 1) / block;
+    for (MultiArrayIndex y = 0; y < shape[1]; ++y)
+        for (MultiArrayIndex x = 0; x < shape[0]; ++x)
+        {
+            MultiArrayIndex xx = std::min<MultiArrayIndex>(shape[0]-1, x + random.uniformInt(2)),
+                            yy = std::min<MultiArrayIndex>(shape[1]-1, y + random.uniformInt(2));
+            labels(x, y) = (UInt32)(xx / block + blocks*(yy / block));
+        }
+
+    Grid graph(shape);
+    AdjacencyListGraph rag;
+    AdjacencyListGraph::EdgeMap<std::vector<Grid::Edge> > affEdges;
+    makeRegionAdjacencyGraph(graph, labels, rag, affEdges, -1, ParallelOptions());
+
+    AdjacencyListGraph::EdgeMap<float> edgeWeights(rag), edgeLengths(rag);
+    for (AdjacencyListGraph::EdgeIt e(rag); e != lemon::INVALID; ++e)
+    {
+        edgeWeights[*e] = (float)random.uniform();
+        edgeLengths[*e] = (float)affEdges[*e].size();
+    }
+    AdjacencyListGraph::NodeMap<float>   nodeSizes(rag, 16.0f);
+    AdjacencyListGraph::NodeMap<Feature> nodeFeatures(rag);
+    for (AdjacencyListGraph::NodeIt n(rag); n != lemon::INVALID; ++n)
+        for (int k = 0; k < Feature::static_size; ++k)
+            nodeFeatures[*n][k] = (float)random.uniform();
+
+    std::size_t const regions = 100;
+    std::cerr << "hierarchical clustering of a RAG with " << rag.nodeNum() << " nodes and "
+              << rag.edgeNum() << " edges into " << regions << " regions:" << std::endl;
+
+    char const * names[] = {
+        "exact:                         ",
+        "lazyPriorityUpdates():         ",
+        "mergeBatchSize(1000), 1 thread:",
+        "mergeBatchSize(1000):          " };
+    ClusteringOptions modes[] = {
+        ClusteringOptions(),
+        ClusteringOptions().lazyPriorityUpdates(),
+        ClusteringOptions().mergeBatchSize(1000).numThreads(1),
+        ClusteringOptions().mergeBatchSize(1000) };
+    double exact_time = 0.0;
+    for (int m = 0; m < 4; ++m)
+    {
+        AdjacencyListGraph::NodeMap<UInt32> seg(rag);
+        TIC;
+        hierarchicalClustering(rag, edgeWeights, edgeLengths, nodeFeatures, nodeSizes, seg,
+                               modes[m].minRegionCount(regions).nodeFeatureImportance(0.5));
+        double const t = TOCN;
+        if (m == 0)
+            exact_time = t;
+        std::cerr << "    " << names[m] << " " << t << " msec (" << exact_time / t << "x faster)" << std::endl;
+
+        std::set<UInt32> clusters;
+        for (AdjacencyListGraph::NodeIt n(rag); n != lemon::INVALID; ++n)
+            clusters.insert(seg[*n]);
+        vigra_invariant(clusters.size() == regions, "clustering_speed: wrong number of regions.");
+    }
+    return 0;
+}
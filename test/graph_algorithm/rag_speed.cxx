@@ -0,0 +1,169 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+// Compares the run time of the generic makeRegionAdjacencyGraph() with the
+// parallel slab-based builder for GridGraph label volumes, and the memory
+// needed for the affiliated edges in EdgeMap and compact representation.
+// Then, edge features are accumulated from a node volume by a serial loop over
+// the affiliated edges, by the parallel accumulateRagEdgeFeatures(), and by
+// the variant streaming over the label volume.
+
+//We need to undefine NDEBUG so that we have TIC, TOC available!
+#undef NDEBUG
+
+#include <iostream>
+#include <vigra/timing.hxx>
+USETICTOC;
+#include <vigra/multi_array.hxx>
+#include <vigra/graph_algorithms.hxx>
+#include <vigra/graph_rag_features.hxx>
+#include <vigra/random.hxx>
+
+using namespace vigra;
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    typedef GridGraph<3, boost_graph::undirected_tag> Grid;
+    typedef Grid::Edge                                GridEdge;
+
+    Shape3 const shape(200, 200, 200);
+    MultiArrayIndex const block = 8;
+
+    // supervoxel-like labels: blocks with jittered boundaries
+    RandomNumberGenerator<MersenneTwister> random(1);
+    MultiArray<3, UInt32> labels(shape);
+    MultiArrayIndex blocks = (shape[0] + block - 1) / block;
+    for (MultiArrayIndex z = 0; z < shape[2]; ++z)
+        for (MultiArrayIndex y = 0; y < shape[1]; ++y)
+            for (MultiArrayIndex x = 0; x < shape[0]; ++x)
+            {
+                MultiArrayIndex xx = std::min<MultiArrayIndex>(shape[0]-1, x + random.uniformInt(3)),
+                                yy = std::min<MultiArrayIndex>(shape[1]-1, y + random.uniformInt(3)),
+                                zz = std::min<MultiArrayIndex>(shape[2]-1, z + random.uniformInt(3));
+                labels(x, y, z) = (UInt32)(xx / block + blocks*(yy / block + blocks*(zz / block)));
+            }
+
+    Grid graph(shape, DirectNeighborhood);
+    Grid::NodeMap<UInt32> labelMap(graph);
+    labelMap = labels;
+
+    AdjacencyListGraph serialRag;
+    AdjacencyListGraph::EdgeMap<std::vector<GridEdge> > serialAffEdges;
+    TIC;
+    makeRegionAdjacencyGraph(graph, labelMap, serialRag, serialAffEdges);
+    double const serial_time = TOCN;
+    std::cerr << "RAG of " << serialRag.nodeNum() << " regions and " << serialRag.edgeNum()
+              << " edges in a " << shape << " volume:" << std::endl;
+    std::cerr << "    makeRegionAdjacencyGraph():                " << serial_time << " msec" << std::endl;
+
+    int const threads[] = { 1, ParallelOptions().getActualNumThreads() };
+    for (int k = 0; k < 2; ++k)
+    {
+        AdjacencyListGraph rag;
+        AdjacencyListGraph::EdgeMap<std::vector<GridEdge> > affEdges;
+        TIC;
+        makeRegionAdjacencyGraph(graph, labels, rag, affEdges, -1, ParallelOptions().numThreads(threads[k]));
+        double const parallel_time = TOCN;
+        std::cerr << "    makeRegionAdjacencyGraph(ParallelOptions): " << parallel_time << " msec with "
+                  << threads[k] << " thread(s) (" << serial_time / parallel_time << "x faster)" << std::endl;
+
+        vigra_invariant(rag.edgeNum() == serialRag.edgeNum(), "rag_speed: results differ.");
+        for (AdjacencyListGraph::EdgeIt e(rag); e != lemon::INVALID; ++e)
+            vigra_invariant(affEdges[*e] == serialAffEdges[*e], "rag_speed: results differ.");
+    }
+
+    std::size_t edgeMapBytes = 0;
+    for (AdjacencyListGraph::EdgeIt e(serialRag); e != lemon::INVALID; ++e)
+        edgeMapBytes += sizeof(std::vector<GridEdge>) + serialAffEdges[*e].capacity()*sizeof(GridEdge);
+
+    AdjacencyListGraph rag;
+    CompactAffiliatedEdges<Grid, UInt32> compactAffEdges;
+    TIC;
+    makeRegionAdjacencyGraph(graph, labels, rag, compactAffEdges);
+    double const compact_time = TOCN;
+    std::cerr << "    makeRegionAdjacencyGraph(CompactAffiliatedEdges): " << compact_time << " msec" << std::endl;
+    std::cerr << "    affiliated edges: " << edgeMapBytes / (1 << 20) << " MB (EdgeMap), "
+              << compactAffEdges.memoryConsumption() / (1 << 20) << " MB (compact)" << std::endl;
+
+    for (AdjacencyListGraph::EdgeIt e(rag); e != lemon::INVALID; ++e)
+    {
+        vigra_invariant(compactAffEdges[*e].size() == serialAffEdges[*e].size(), "rag_speed: results differ.");
+        for (std::size_t i = 0; i < serialAffEdges[*e].size(); ++i)
+            vigra_invariant(compactAffEdges[*e][i] == serialAffEdges[*e][i], "rag_speed: results differ.");
+    }
+
+    // edge features from the mean of the adjacent voxels, as computed by vigranumpy
+    using namespace vigra::acc;
+    typedef AccumulatorChain<double, Select<Mean, Minimum, Maximum, Variance> > EdgeChain;
+    typedef Grid::NodeMap<float> NodeData;
+    NodeData data(graph);
+    for (NodeData::iterator i = data.begin(); i != data.end(); ++i)
+        *i = (float)random.uniform();
+    OnTheFlyEdgeMap2<Grid, NodeData, MeanFunctor<double>, double> edgeValues(graph, data, MeanFunctor<double>());
+
+    AdjacencyListGraph::EdgeMap<EdgeChain> serialFeatures(serialRag);
+    TIC;
+    for (AdjacencyListGraph::EdgeIt e(serialRag); e != lemon::INVALID; ++e)
+        for (std::size_t i = 0; i < serialAffEdges[*e].size(); ++i)
+            serialFeatures[*e](edgeValues[serialAffEdges[*e][i]]);
+    double const serial_features_time = TOCN;
+    std::cerr << "edge features:" << std::endl;
+    std::cerr << "    serial loop over affiliated edges: " << serial_features_time << " msec" << std::endl;
+
+    for (int k = 0; k < 2; ++k)
+    {
+        ParallelOptions const options = ParallelOptions().numThreads(threads[k]);
+        AdjacencyListGraph::EdgeMap<EdgeChain> features(serialRag), streamed(serialRag);
+        TIC;
+        accumulateRagEdgeFeatures(serialRag, compactAffEdges, edgeValues, features, options);
+        double const parallel_features_time = TOCN;
+        TIC;
+        accumulateRagEdgeFeatures(graph, labels, serialRag, edgeValues, streamed, -1, options);
+        double const streamed_features_time = TOCN;
+        std::cerr << "    accumulateRagEdgeFeatures(affiliated edges): " << parallel_features_time << " msec, "
+                  << "(label volume): " << streamed_features_time << " msec with " << threads[k] << " thread(s) ("
+                  << serial_features_time / parallel_features_time << "x and "
+                  << serial_features_time / streamed_features_time << "x faster)" << std::endl;
+
+        for (AdjacencyListGraph::EdgeIt e(serialRag); e != lemon::INVALID; ++e)
+        {
+            vigra_invariant(get<Mean>(features[*e]) == get<Mean>(serialFeatures[*e]), "rag_speed: results differ.");
+            vigra_invariant(get<Maximum>(streamed[*e]) == get<Maximum>(serialFeatures[*e]), "rag_speed: results differ.");
+            vigra_invariant(std::abs(get<Mean>(streamed[*e]) - get<Mean>(serialFeatures[*e])) < 1e-10,
+                            "rag_speed: results differ.");
+        }
+    }
+    return 0;
+}
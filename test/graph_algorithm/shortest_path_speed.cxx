@@ -0,0 +1,97 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+// Compares ShortestPathDijkstra, ShortestPathDial, and ShortestPathDeltaStepping
+// for a geodesic distance map on a 3D grid graph with quantized edge weights.
+
+//We need to undefine NDEBUG so that we have TIC, TOC available!
+#undef NDEBUG
+
+#include <iostream>
+#include <vigra/timing.hxx>
+USETICTOC;
+#include <vigra/multi_array.hxx>
+#include <vigra/graph_algorithms.hxx>
+#include <vigra/random.hxx>
+
+using namespace vigra;
+
+typedef GridGraph<3, boost_graph::undirected_tag> Graph;
+
+template <class SP>
+double timeShortestPath(SP & sp, Graph::EdgeMap<float> const & weights, Graph::Node const & source,
+                        Graph::NodeMap<float> const * reference)
+{
+    TIC;
+    sp.run(weights, source);
+    double const t = TOCN;
+    if (reference)
+        for (Graph::NodeIt n(sp.graph()); n != lemon::INVALID; ++n)
+            vigra_invariant(sp.distances()[*n] == (*reference)[*n], "shortest_path_speed: distances differ.");
+    return t;
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    Graph graph(Shape3(120, 120, 120), DirectNeighborhood);
+    RandomNumberGenerator<MersenneTwister> random(1);
+    Graph::EdgeMap<float> weights(graph);
+    for (Graph::EdgeIt e(graph); e != lemon::INVALID; ++e)
+        weights[*e] = (float)(1 + random.uniformInt(16));
+    Graph::Node const source(60, 60, 60);
+
+    std::cerr << "shortest paths from one source on a grid graph with " << graph.nodeNum() << " nodes and "
+              << graph.edgeNum() << " edges:" << std::endl;
+
+    ShortestPathDijkstra<Graph, float> dijkstra(graph);
+    double const dijkstra_time = timeShortestPath(dijkstra, weights, source, 0);
+    std::cerr << "    ShortestPathDijkstra:                 " << dijkstra_time << " msec" << std::endl;
+    Graph::NodeMap<float> reference(graph);
+    reference = dijkstra.distances();
+
+    ShortestPathDial<Graph, float> dial(graph);
+    double t = timeShortestPath(dial, weights, source, &reference);
+    std::cerr << "    ShortestPathDial:                     " << t << " msec (" << dijkstra_time / t << "x faster)" << std::endl;
+
+    ShortestPathDeltaStepping<Graph, float> deltaSingle(graph, 0.0f, ParallelOptions().numThreads(1));
+    t = timeShortestPath(deltaSingle, weights, source, &reference);
+    std::cerr << "    ShortestPathDeltaStepping, 1 thread:  " << t << " msec (" << dijkstra_time / t << "x faster)" << std::endl;
+
+    ShortestPathDeltaStepping<Graph, float> delta(graph);
+    t = timeShortestPath(delta, weights, source, &reference);
+    std::cerr << "    ShortestPathDeltaStepping, " << ParallelOptions().getActualNumThreads() << " threads: "
+              << t << " msec (" << dijkstra_time / t << "x faster)" << std::endl;
+    return 0;
+}
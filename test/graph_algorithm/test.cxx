@@ -34,12 +34,17 @@
 /************************************************************************/
 
 #include <iostream>
+#include <set>
 #include "vigra/unittest.hxx"
 #include "vigra/stdimage.hxx"
 #include "vigra/multi_array.hxx"
 #include "vigra/adjacency_list_graph.hxx"
 #include "vigra/graph_algorithms.hxx"
+#include "vigra/graph_rag_project_back.hxx"
+#include "vigra/graph_rag_features.hxx"
+#include "vigra/hierarchical_clustering.hxx"
 #include "vigra/multi_resize.hxx"
+#include "vigra/random.hxx"
 
 using namespace vigra;
 
@@ -138,10 +143,9 @@ struct GraphAlgorithmTest{
 
     }
 
-    template <class Graph>
+    template <class Graph, class Sp = ShortestPathDijkstra<Graph,float> >
     void testShortestPathImpl(Graph const & g)
     {
-        typedef ShortestPathDijkstra<Graph,float> Sp;
         typedef typename Sp::PredecessorsMap PredMap;
         typedef typename Sp::DistanceMap     DistMap;
         typedef typename Graph::Node Node;
@@ -371,14 +375,121 @@ struct GraphAlgorithmTest{
         g.addEdge(n3,n4);
 
         testShortestPathImpl(g);
+        testShortestPathImpl<GraphType, ShortestPathDial<GraphType, float> >(g);
+        testShortestPathImpl<GraphType, ShortestPathDeltaStepping<GraphType, float> >(g);
     }
 
     void testShortestPathGridGraph()
     {
-        GridGraph<2> g(Shape2(2,2), DirectNeighborhood);
+        typedef GridGraph<2> Graph;
+        Graph g(Shape2(2,2), DirectNeighborhood);
 
         testShortestPathImpl(g);
         testShortestPathWithROIImpl(g);
+        testShortestPathImpl<Graph, ShortestPathDial<Graph, float> >(g);
+        testShortestPathImpl<Graph, ShortestPathDeltaStepping<Graph, float> >(g);
+    }
+
+    // compare with ShortestPathDijkstra on a 3D grid graph with integer weights
+    template <class Sp>
+    void checkShortestPathBuckets(Sp & sp, const std::string & name)
+    {
+        typedef GridGraph<3, boost_graph::undirected_tag> Graph;
+        typedef Graph::Node                               GNode;
+        const Graph & g = sp.graph();
+
+        RandomMT19937 random(3);
+        Graph::EdgeMap<float> weights(g);
+        for(Graph::EdgeIt e(g); e!=lemon::INVALID; ++e)
+            weights[*e] = 1.0f + random.uniformInt(20);
+
+        ShortestPathDijkstra<Graph, float> dijkstra(g);
+        const GNode source(3, 5, 7), target(15, 1, 12);
+
+        std::vector<GNode> sources;
+        sources.push_back(source);
+        sources.push_back(GNode(0, 15, 0));
+        sources.push_back(GNode(10, 10, 3));
+
+        for(int mode=0; mode<5; ++mode){
+            float maxDistance = NumericTraits<float>::max();
+            switch(mode){
+              case 0:
+                dijkstra.run(weights, source);
+                sp.run(weights, source);
+                break;
+              case 1:
+                dijkstra.run(weights, source, target);
+                sp.run(weights, source, target);
+                should(sp.target() == target);
+                break;
+              case 2:
+                maxDistance = 60.0f;
+                dijkstra.run(weights, source, lemon::INVALID, maxDistance);
+                sp.run(weights, source, lemon::INVALID, maxDistance);
+                break;
+              case 3:
+                dijkstra.runMultiSource(weights, sources.begin(), sources.end());
+                sp.runMultiSource(weights, sources.begin(), sources.end());
+                break;
+              case 4:
+                dijkstra.run(weights, target);
+                sp.reRun(weights, target);
+                break;
+            }
+            for(size_t i=1; i<sp.discoveryOrder().size(); ++i)
+                should(sp.distance(sp.discoveryOrder()[i-1]) <= sp.distance(sp.discoveryOrder()[i]));
+            if(mode == 1){
+                // nodes at the same distance as the target may or may not be visited
+                shouldEqual(sp.distance(target), dijkstra.distance(target));
+                should(sp.discoveryOrder().back() == target);
+                continue;
+            }
+            shouldMsg(sp.discoveryOrder().size() == dijkstra.discoveryOrder().size(), name.c_str());
+
+            for(Graph::NodeIt n(g); n!=lemon::INVALID; ++n){
+                const GNode pred = sp.predecessors()[*n];
+                shouldMsg((pred == lemon::INVALID) == (dijkstra.predecessors()[*n] == lemon::INVALID), name.c_str());
+                if(pred == lemon::INVALID)
+                    continue;
+                shouldEqual(sp.distances()[*n], dijkstra.distances()[*n]);
+                should(sp.distances()[*n] <= maxDistance);
+                if(pred != *n)
+                    shouldEqual(sp.distances()[*n], sp.distances()[pred] + weights[g.findEdge(pred, *n)]);
+            }
+        }
+    }
+
+    void testShortestPathBuckets()
+    {
+        typedef GridGraph<3, boost_graph::undirected_tag> Graph;
+        Graph g(Shape3(16, 16, 16), IndirectNeighborhood);
+
+        ShortestPathDial<Graph, float> dial(g);
+        checkShortestPathBuckets(dial, "ShortestPathDial");
+
+        // too few buckets for the largest weight, and exactly enough
+        float maxWeights[] = { 4.0f, 21.0f };
+        for(int m=0; m<2; ++m){
+            ShortestPathDial<Graph, float> dialWithMaxWeight(g, maxWeights[m]);
+            checkShortestPathBuckets(dialWithMaxWeight, "ShortestPathDial");
+        }
+
+        float deltas[] = { 0.0f, 1.0f, 7.5f, 100.0f };
+        for(int d=0; d<4; ++d){
+            for(int threads=1; threads<=4; threads+=3){
+                ShortestPathDeltaStepping<Graph, float> deltaStepping(g, deltas[d], ParallelOptions().numThreads(threads));
+                checkShortestPathBuckets(deltaStepping, "ShortestPathDeltaStepping");
+            }
+        }
+
+        // Dial's algorithm requires integer weights
+        Graph::EdgeMap<float> weights(g, 1.5f);
+        try{
+            dial.run(weights, Graph::Node(0));
+            failTest("no exception thrown");
+        }
+        catch(PreconditionViolation &){}
     }
 
     void testRegionAdjacencyGraph(){
@@ -453,6 +564,393 @@ struct GraphAlgorithmTest{
     }
 
 
+    template<unsigned int DIM>
+    void checkParallelRegionAdjacencyGraph(
+        const MultiArrayView<DIM, UInt32> & labels,
+        NeighborhoodType neighborhood,
+        Int64 ignoreLabel
+    ){
+        typedef GridGraph<DIM, boost_graph::undirected_tag> Grid;
+        typedef typename Grid::Edge GridEdge;
+        Grid g(labels.shape(), neighborhood);
+
+        GraphType serialRag;
+        GraphType::EdgeMap< std::vector<GridEdge> > serialAffEdges;
+        typename Grid::template NodeMap<UInt32> labelMap(g);
+        labelMap = labels;
+        makeRegionAdjacencyGraph(g, labelMap, serialRag, serialAffEdges, ignoreLabel);
+
+        int threads[] = { 1, 3, 8 };
+        for(int t=0; t<3; ++t){
+            GraphType rag;
+            GraphType::EdgeMap< std::vector<GridEdge> > affEdges;
+            makeRegionAdjacencyGraph(g, labels, rag, affEdges, ignoreLabel,
+                                     ParallelOptions().numThreads(threads[t]));
+
+            // node and edge ids as well as affiliated edges agree exactly
+            shouldEqual(rag.nodeNum(), serialRag.nodeNum());
+            shouldEqual(rag.edgeNum(), serialRag.edgeNum());
+            shouldEqual(rag.maxNodeId(), serialRag.maxNodeId());
+            shouldEqual(rag.maxEdgeId(), serialRag.maxEdgeId());
+            for(NodeIt n(serialRag); n!=lemon::INVALID; ++n)
+                should(rag.nodeFromId(serialRag.id(*n)) != lemon::INVALID);
+            for(EdgeIt e(serialRag); e!=lemon::INVALID; ++e){
+                const Edge re = rag.edgeFromId(serialRag.id(*e));
+                shouldEqual(rag.id(rag.u(re)), serialRag.id(serialRag.u(*e)));
+                shouldEqual(rag.id(rag.v(re)), serialRag.id(serialRag.v(*e)));
+                should(affEdges[re] == serialAffEdges[*e]);
+            }
+        }
+
+        // compact affiliated edges, built directly and converted from the EdgeMap
+        GraphType compactRag;
+        CompactAffiliatedEdges<Grid> compactAffEdges;
+        makeRegionAdjacencyGraph(g, labels, compactRag, compactAffEdges, ignoreLabel,
+                                 ParallelOptions().numThreads(3));
+        CompactAffiliatedEdges<Grid, UInt32> convertedAffEdges(g, serialRag, serialAffEdges);
+        shouldEqual(compactRag.edgeNum(), serialRag.edgeNum());
+        shouldEqual(compactAffEdges.numberOfAffiliatedEdges(), convertedAffEdges.numberOfAffiliatedEdges());
+        for(EdgeIt e(serialRag); e!=lemon::INVALID; ++e){
+            const std::vector<GridEdge> & expected = serialAffEdges[*e];
+            const Edge re = compactRag.edgeFromId(serialRag.id(*e));
+            shouldEqual(compactAffEdges[re].size(), expected.size());
+            shouldEqual(convertedAffEdges[*e].size(), expected.size());
+            shouldEqual(compactAffEdges.size(serialRag.id(*e)), expected.size());
+            for(size_t i=0; i<expected.size(); ++i){
+                should(compactAffEdges[re][i] == expected[i]);
+                should(convertedAffEdges[*e][i] == expected[i]);
+                shouldEqual(compactAffEdges[re].id(i), g.id(expected[i]));
+            }
+        }
+
+        // both representations can be used to project rag edge features back
+        GraphType::EdgeMap<Int64> ragFeatures(serialRag);
+        for(EdgeIt e(serialRag); e!=lemon::INVALID; ++e)
+            ragFeatures[*e] = serialRag.id(*e);
+        typename Grid::template EdgeMap<Int64> fromEdgeMap(g, -1), fromCompact(g, -1);
+        projectBackEdges(serialRag, g, serialAffEdges, ragFeatures, fromEdgeMap);
+        projectBackEdges(serialRag, g, convertedAffEdges, ragFeatures, fromCompact);
+        should(fromEdgeMap == fromCompact);
+        for(EdgeIt e(serialRag); e!=lemon::INVALID; ++e)
+            for(size_t i=0; i<serialAffEdges[*e].size(); ++i)
+                shouldEqual(fromCompact[serialAffEdges[*e][i]], serialRag.id(*e));
+    }
+
+    void testParallelRegionAdjacencyGraph(){
+        RandomMT19937 random(42);
+
+        // blocky labels with some noise, so that regions have long boundaries
+        MultiArray<3, UInt32> labels3(Shape3(23, 17, 21));
+        for(MultiArrayIndex z=0; z<labels3.shape(2); ++z)
+            for(MultiArrayIndex y=0; y<labels3.shape(1); ++y)
+                for(MultiArrayIndex x=0; x<labels3.shape(0); ++x)
+                    labels3(x,y,z) = random.uniform() < 0.1
+                                         ? random.uniformInt(60)
+                                         : x/6 + 4*(y/6 + 3*(z/6));
+        MultiArray<2, UInt32> labels2(Shape2(40, 31));
+        for(MultiArrayIndex y=0; y<labels2.shape(1); ++y)
+            for(MultiArrayIndex x=0; x<labels2.shape(0); ++x)
+                labels2(x,y) = random.uniform() < 0.1
+                                   ? random.uniformInt(40)
+                                   : x/7 + 6*(y/7);
+
+        NeighborhoodType neighborhoods[] = { DirectNeighborhood, IndirectNeighborhood };
+        for(int n=0; n<2; ++n){
+            checkParallelRegionAdjacencyGraph(labels3, neighborhoods[n], -1);
+            checkParallelRegionAdjacencyGraph(labels3, neighborhoods[n], 5);
+            checkParallelRegionAdjacencyGraph(labels2, neighborhoods[n], -1);
+            checkParallelRegionAdjacencyGraph(labels2, neighborhoods[n], 0);
+        }
+    }
+
+    typedef acc::AccumulatorChain<double, acc::Select<acc::Count, acc::Mean, acc::Minimum, acc::Maximum,
+                                                      acc::Variance> > OnePassChain;
+    typedef acc::AccumulatorChain<double, acc::Select<acc::Count, acc::Mean, acc::Minimum, acc::Maximum,
+                                                      acc::Variance, acc::Skewness,
+                                                      acc::StandardQuantiles<acc::AutoRangeHistogram<16> > > > TwoPassChain;
+
+    void checkSecondPassFeatures(const OnePassChain &, const OnePassChain &){
+    }
+
+    void checkSecondPassFeatures(const TwoPassChain & a, const TwoPassChain & expected){
+        using namespace vigra::acc;
+        typedef StandardQuantiles<AutoRangeHistogram<16> > Quantiles;
+        // skewness is undefined for constant values
+        if(get<Minimum>(expected) < get<Maximum>(expected))
+            shouldEqualTolerance(get<Skewness>(a), get<Skewness>(expected), 1e-8);
+        shouldEqualSequenceTolerance(get<Quantiles>(a).begin(), get<Quantiles>(a).end(),
+                                     get<Quantiles>(expected).begin(), 1e-10);
+    }
+
+    template<class CHAIN, unsigned int DIM, class EDGE_VALUES>
+    void checkRagEdgeFeatures(
+        const MultiArrayView<DIM, UInt32> & labels,
+        NeighborhoodType neighborhood,
+        Int64 ignoreLabel,
+        const EDGE_VALUES & edgeValues
+    ){
+        using namespace vigra::acc;
+        typedef GridGraph<DIM, boost_graph::undirected_tag> Grid;
+        typedef typename Grid::Edge GridEdge;
+        Grid g(labels.shape(), neighborhood);
+
+        GraphType rag;
+        GraphType::EdgeMap< std::vector<GridEdge> > affEdges;
+        makeRegionAdjacencyGraph(g, labels, rag, affEdges, ignoreLabel, ParallelOptions().numThreads(1));
+        CompactAffiliatedEdges<Grid> compactAffEdges(g, rag, affEdges);
+
+        // serial reference
+        GraphType::EdgeMap<CHAIN> expected(rag);
+        for(EdgeIt e(rag); e!=lemon::INVALID; ++e)
+            for(unsigned int k=1; k<=expected[*e].passesRequired(); ++k)
+                for(size_t i=0; i<affEdges[*e].size(); ++i)
+                    expected[*e].updatePassN(edgeValues[affEdges[*e][i]], k);
+
+        int threads[] = { 1, 3, 8 };
+        for(int t=0; t<3; ++t){
+            const ParallelOptions options = ParallelOptions().numThreads(threads[t]);
+            GraphType::EdgeMap<CHAIN> fromEdgeMap(rag), fromCompact(rag), streamed(rag);
+            accumulateRagEdgeFeatures(rag, affEdges, edgeValues, fromEdgeMap, options);
+            accumulateRagEdgeFeatures(rag, compactAffEdges, edgeValues, fromCompact, options);
+            accumulateRagEdgeFeatures(g, labels, rag, edgeValues, streamed, ignoreLabel, options);
+            for(EdgeIt e(rag); e!=lemon::INVALID; ++e){
+                shouldEqual(get<Count>(fromEdgeMap[*e]), get<Count>(expected[*e]));
+                shouldEqual(get<Count>(streamed[*e]), get<Count>(expected[*e]));
+                shouldEqual(get<Minimum>(fromEdgeMap[*e]), get<Minimum>(expected[*e]));
+                shouldEqual(get<Maximum>(fromCompact[*e]), get<Maximum>(expected[*e]));
+                shouldEqual(get<Minimum>(streamed[*e]), get<Minimum>(expected[*e]));
+                shouldEqual(get<Maximum>(streamed[*e]), get<Maximum>(expected[*e]));
+                shouldEqual(get<Mean>(fromCompact[*e]), get<Mean>(expected[*e]));
+                shouldEqualTolerance(get<Mean>(streamed[*e]), get<Mean>(expected[*e]), 1e-10);
+                shouldEqualTolerance(get<Variance>(streamed[*e]), get<Variance>(expected[*e]), 1e-10);
+                checkSecondPassFeatures(streamed[*e], expected[*e]);
+            }
+        }
+    }
+
+    void testRagEdgeFeatures(){
+        typedef GridGraph<3, boost_graph::undirected_tag> Grid;
+        RandomMT19937 random(11);
+
+        MultiArray<3, UInt32> labels(Shape3(23, 17, 21));
+        MultiArray<3, double> data(labels.shape());
+        for(MultiArrayIndex z=0; z<labels.shape(2); ++z)
+            for(MultiArrayIndex y=0; y<labels.shape(1); ++y)
+                for(MultiArrayIndex x=0; x<labels.shape(0); ++x){
+                    labels(x,y,z) = random.uniform() < 0.1
+                                        ? random.uniformInt(60)
+                                        : x/6 + 4*(y/6 + 3*(z/6));
+                    data(x,y,z) = random.uniform();
+                }
+
+        NeighborhoodType neighborhoods[] = { DirectNeighborhood, IndirectNeighborhood };
+        for(int n=0; n<2; ++n){
+            Grid g(labels.shape(), neighborhoods[n]);
+
+            // explicit grid edge values
+            Grid::EdgeMap<double> edgeValues(g);
+            for(Grid::EdgeIt e(g); e!=lemon::INVALID; ++e)
+                edgeValues[*e] = random.uniform();
+            checkRagEdgeFeatures<OnePassChain>(labels, neighborhoods[n], -1, edgeValues);
+            checkRagEdgeFeatures<TwoPassChain>(labels, neighborhoods[n], 5, edgeValues);
+
+            // values computed from the node data on the fly
+            typedef Grid::NodeMap<double> NodeData;
+            NodeData nodeData(g);
+            nodeData = data;
+            OnTheFlyEdgeMap2<Grid, NodeData, MeanFunctor<double>, double> implicitValues(g, nodeData, MeanFunctor<double>());
+            checkRagEdgeFeatures<TwoPassChain>(labels, neighborhoods[n], -1, implicitValues);
+        }
+    }
+
+    // number of connected components of the subgraph of edges inside clusters
+    size_t clusterComponents(const GraphType & g, const GraphType::NodeMap<UInt32> & seg){
+        UnionFindArray<Int64> ufd(g.maxNodeId()+1);
+        for(EdgeIt e(g); e!=lemon::INVALID; ++e)
+            if(seg[g.u(*e)] == seg[g.v(*e)])
+                ufd.makeUnion(g.id(g.u(*e)), g.id(g.v(*e)));
+        std::set<Int64> components;
+        for(NodeIt n(g); n!=lemon::INVALID; ++n)
+            components.insert(ufd.findIndex(g.id(*n)));
+        return components.size();
+    }
+
+    size_t clusterCount(const GraphType & g, const GraphType::NodeMap<UInt32> & seg){
+        std::set<UInt32> clusters;
+        for(NodeIt n(g); n!=lemon::INVALID; ++n)
+            clusters.insert(seg[*n]);
+        return clusters.size();
+    }
+
+    void testHierarchicalClusteringModes(){
+        RandomMT19937 random(3);
+
+        // a tree: merges never create parallel edges, and with size regularization
+        // the weights only grow, so lazy priority updates give the exact result
+        {
+            GraphType tree;
+            for(Int64 i=0; i<300; ++i){
+                tree.addNode(i);
+                if(i > 0)
+                    tree.addEdge(tree.nodeFromId(i), tree.nodeFromId(random.uniformInt(i)));
+            }
+            GraphType::EdgeMap<float> edgeWeights(tree), edgeLengths(tree, 1.0f);
+            for(EdgeIt e(tree); e!=lemon::INVALID; ++e)
+                edgeWeights[*e] = random.uniform();
+            GraphType::NodeMap<float> nodeSizes(tree), nodeFeatures(tree, 0.0f);
+            for(NodeIt n(tree); n!=lemon::INVALID; ++n)
+                nodeSizes[*n] = 1.0f + random.uniformInt(20);
+
+            GraphType::NodeMap<UInt32> exact(tree), lazy(tree);
+            ClusteringOptions options = ClusteringOptions().minRegionCount(20).nodeFeatureImportance(0.0);
+            hierarchicalClustering(tree, edgeWeights, edgeLengths, nodeFeatures, nodeSizes, exact, options);
+            hierarchicalClustering(tree, edgeWeights, edgeLengths, nodeFeatures, nodeSizes, lazy,
+                                   options.lazyPriorityUpdates());
+            for(NodeIt n(tree); n!=lemon::INVALID; ++n)
+                shouldEqual(lazy[*n], exact[*n]);
+        }
+
+        // a region adjacency graph
+        MultiArray<2, UInt32> labels(Shape2(60, 50));
+        for(MultiArrayIndex y=0; y<labels.shape(1); ++y)
+            for(MultiArrayIndex x=0; x<labels.shape(0); ++x)
+                labels(x,y) = random.uniform() < 0.1
+                                  ? random.uniformInt(80)
+                                  : x/4 + 15*(y/4);
+        GridGraph<2, boost_graph::undirected_tag> grid(labels.shape());
+        GraphType rag;
+        GraphType::EdgeMap< std::vector<GridGraph<2, boost_graph::undirected_tag>::Edge> > affEdges;
+        makeRegionAdjacencyGraph(grid, labels, rag, affEdges, -1, ParallelOptions().numThreads(1));
+
+        GraphType::EdgeMap<float> edgeWeights(rag), edgeLengths(rag);
+        for(EdgeIt e(rag); e!=lemon::INVALID; ++e){
+            edgeWeights[*e] = random.uniform();
+            edgeLengths[*e] = static_cast<float>(affEdges[*e].size());
+        }
+        GraphType::NodeMap<float> nodeSizes(rag), nodeFeatures(rag);
+        for(NodeIt n(rag); n!=lemon::INVALID; ++n){
+            nodeSizes[*n] = 1.0f + random.uniformInt(20);
+            nodeFeatures[*n] = random.uniform();
+        }
+
+        ClusteringOptions modes[] = {
+            ClusteringOptions(),
+            ClusteringOptions().lazyPriorityUpdates(),
+            ClusteringOptions().mergeBatchSize(16).numThreads(1),
+            ClusteringOptions().mergeBatchSize(16).numThreads(4),
+            ClusteringOptions().mergeBatchSize(1000).numThreads(4)
+        };
+        for(int m=0; m<5; ++m){
+            GraphType::NodeMap<UInt32> seg(rag);
+            hierarchicalClustering(rag, edgeWeights, edgeLengths, nodeFeatures, nodeSizes, seg,
+                                   modes[m].minRegionCount(10).nodeFeatureImportance(0.5));
+            shouldEqual(clusterCount(rag, seg), 10u);
+            shouldEqual(clusterComponents(rag, seg), 10u);
+
+            // nothing is merged above the maximum distance
+            hierarchicalClustering(rag, edgeWeights, edgeLengths, nodeFeatures, nodeSizes, seg,
+                                   modes[m].minRegionCount(1).maxMergeDistance(0.0));
+            shouldEqual(clusterCount(rag, seg), static_cast<size_t>(rag.nodeNum()));
+        }
+
+        // merge tree encoding in batch mode
+        {
+            typedef MergeGraphAdaptor<GraphType> MergeGraph;
+            typedef GraphType::EdgeMap<float> EdgeFloatMap;
+            typedef GraphType::NodeMap<float> NodeFloatMap;
+            typedef GraphType::NodeMap<UInt32> NodeLabelMap;
+            typedef cluster_operators::EdgeWeightNodeFeatures<MergeGraph, EdgeFloatMap, EdgeFloatMap,
+                NodeFloatMap, NodeFloatMap, EdgeFloatMap, NodeLabelMap> Operator;
+            MergeGraph mergeGraph(rag);
+            EdgeFloatMap ultrametric(rag);
+            NodeLabelMap seeds(rag, 0u);
+            Operator op(mergeGraph, edgeWeights, edgeLengths, nodeFeatures, nodeSizes, ultrametric, seeds,
+                        0.5f, metrics::ManhattanMetric, 1.0f, 1e7f, 0.8f, true);
+            HierarchicalClusteringImpl<Operator> clustering(op,
+                ClusteringOptions().minRegionCount(5).buildMergeTreeEncoding().mergeBatchSize(32).numThreads(3));
+            clustering.clusterBatches();
+            shouldEqual(mergeGraph.nodeNum(), 5u);
+            shouldEqual(clustering.mergeTreeEndcoding().size(), static_cast<size_t>(rag.nodeNum() - 5));
+            size_t leafNum = 0;
+            std::vector<Int64> leafs(rag.nodeNum());
+            for(size_t i=0; i<clustering.mergeTreeEndcoding().size(); ++i)
+                leafNum = std::max(leafNum, clustering.leafNodeIds(clustering.mergeTreeEndcoding()[i].r_, leafs.begin()));
+            should(leafNum > 1 && leafNum <= static_cast<size_t>(rag.nodeNum()) - 4);
+        }
+    }
+
+    void testFrozenGraphAlgorithms(){
+        typedef GridGraph<2, boost_graph::undirected_tag> Grid;
+        typedef FrozenAdjacencyListGraph FrozenGraph;
+        RandomMT19937 random(7);
+
+        MultiArray<2, UInt32> labels(Shape2(60, 50));
+        for(MultiArrayIndex y=0; y<labels.shape(1); ++y)
+            for(MultiArrayIndex x=0; x<labels.shape(0); ++x)
+                labels(x,y) = random.uniform() < 0.1
+                                  ? random.uniformInt(80)
+                                  : x/6 + 10*(y/6);
+        Grid grid(labels.shape());
+        GraphType rag;
+        GraphType::EdgeMap< std::vector<Grid::Edge> > affEdges;
+        makeRegionAdjacencyGraph(grid, labels, rag, affEdges, -1, ParallelOptions().numThreads(1));
+        const FrozenGraph frozen = rag.freeze();
+
+        // maps of the original graph are used for both graphs
+        GraphType::EdgeMap<float> edgeWeights(rag), edgeLengths(rag);
+        for(EdgeIt e(rag); e!=lemon::INVALID; ++e){
+            edgeWeights[*e] = random.uniform();
+            edgeLengths[*e] = static_cast<float>(affEdges[*e].size());
+        }
+        GraphType::NodeMap<float> nodeSizes(rag, 0.0f), nodeFeatures(rag, 0.0f);
+        for(NodeIt n(rag); n!=lemon::INVALID; ++n){
+            nodeSizes[*n] = 1.0f + random.uniformInt(20);
+            nodeFeatures[*n] = random.uniform();
+        }
+
+        // shortest paths
+        {
+            ShortestPathDijkstra<GraphType, float>   sp(rag);
+            ShortestPathDijkstra<FrozenGraph, float> spFrozen(frozen);
+            const Node source = rag.nodeFromId(labels(30, 25));
+            sp.run(edgeWeights, source);
+            spFrozen.run(edgeWeights, source);
+            for(NodeIt n(rag); n!=lemon::INVALID; ++n){
+                shouldEqual(sp.distances()[*n], spFrozen.distances()[*n]);
+                should(sp.predecessors()[*n] == spFrozen.predecessors()[*n]);
+            }
+        }
+        // watersheds
+        {
+            GraphType::NodeMap<UInt32> seeds(rag, 0u), seg(rag, 0u), segFrozen(rag, 0u);
+            seeds[rag.nodeFromId(labels(3, 3))] = 1;
+            seeds[rag.nodeFromId(labels(55, 3))] = 2;
+            seeds[rag.nodeFromId(labels(30, 45))] = 3;
+            edgeWeightedWatershedsSegmentation(rag, edgeWeights, seeds, seg);
+            edgeWeightedWatershedsSegmentation(frozen, edgeWeights, seeds, segFrozen);
+            for(NodeIt n(rag); n!=lemon::INVALID; ++n)
+                shouldEqual(seg[*n], segFrozen[*n]);
+        }
+        // felzenszwalb
+        {
+            GraphType::NodeMap<UInt32> seg(rag), segFrozen(rag);
+            felzenszwalbSegmentation(rag, edgeWeights, nodeSizes, 2.0f, seg);
+            felzenszwalbSegmentation(frozen, edgeWeights, nodeSizes, 2.0f, segFrozen);
+            for(NodeIt n(rag); n!=lemon::INVALID; ++n)
+                shouldEqual(seg[*n], segFrozen[*n]);
+        }
+        // hierarchical clustering
+        {
+            GraphType::NodeMap<UInt32> seg(rag), segFrozen(rag);
+            hierarchicalClustering(rag, edgeWeights, edgeLengths, nodeFeatures, nodeSizes, seg,
+                                   ClusteringOptions().minRegionCount(8).nodeFeatureImportance(0.5));
+            hierarchicalClustering(frozen, edgeWeights, edgeLengths, nodeFeatures, nodeSizes, segFrozen,
+                                   ClusteringOptions().minRegionCount(8).nodeFeatureImportance(0.5));
+            for(NodeIt n(rag); n!=lemon::INVALID; ++n)
+                shouldEqual(seg[*n], segFrozen[*n]);
+        }
+    }
+
     void testEdgeSort(){
         {
             GraphType g(0,0);
@@ -543,6 +1041,118 @@ struct GraphAlgorithmTest{
         shouldEqualSequence(edgeMap1.begin(), edgeMap1.end(), ref2);
         shouldEqualSequence(edgeMap2.begin(), edgeMap2.end(), ref2);
     }
+
+    struct MaxFunctor{
+        float operator()(float a, float b)const{
+            return std::max(a, b);
+        }
+    };
+
+    void testImplicitEdgeMaps()
+    {
+        typedef GridGraph<3, boost_graph::undirected_tag> Graph;
+        typedef Graph::Node                               GNode;
+
+        RandomMT19937 random(11);
+        Shape3 shape(12, 10, 8);
+        MultiArray<3, float> nodeWeights(shape), interpolated(2*shape-Shape3(1));
+        for(MultiArrayIndex i=0; i<nodeWeights.size(); ++i)
+            nodeWeights[i] = random.uniform();
+        resizeMultiArraySplineInterpolation(nodeWeights, interpolated, BSpline<1, double>());
+
+        Graph g(shape, IndirectNeighborhood);
+        Graph::EdgeMap<float> edgeMap(g);
+
+        // same values as the materialized maps
+        for(int euclidean=0; euclidean<2; ++euclidean){
+            edgeWeightsFromNodeWeights(g, nodeWeights, edgeMap, euclidean != 0);
+            ImplicitNodeWeightEdgeMap<3, boost_graph::undirected_tag, float, MeanFunctor<float>, float>
+                implicitMap = implicitEdgeWeightsFromNodeWeights(g, nodeWeights, euclidean != 0);
+            for(Graph::EdgeIt e(g); e!=lemon::INVALID; ++e)
+                shouldEqualTolerance(implicitMap[*e], edgeMap[*e], 1e-6f);
+
+            edgeWeightsFromNodeWeights(g, nodeWeights, edgeMap, euclidean != 0, MaxFunctor());
+            for(Graph::EdgeIt e(g); e!=lemon::INVALID; ++e)
+                shouldEqualTolerance(implicitEdgeWeightsFromNodeWeights<float>(g, nodeWeights, euclidean != 0, MaxFunctor())[*e],
+                                     edgeMap[*e], 1e-6f);
+
+            edgeWeightsFromInterpolatedImage(g, interpolated, edgeMap, euclidean != 0);
+            for(Graph::EdgeIt e(g); e!=lemon::INVALID; ++e)
+                shouldEqualTolerance(implicitEdgeWeightsFromInterpolatedImage(g, interpolated, euclidean != 0)[*e],
+                                     edgeMap[*e], 1e-6f);
+        }
+        should((IsImplicitGraphMap<ImplicitInterpolatedEdgeMap<3, boost_graph::undirected_tag, float> >::value));
+
+        // the stride tag of the weight arrays is passed through
+        typedef MultiArrayView<3, float, UnstridedArrayTag> UnstridedView;
+        MultiArray<4, float> stackedWeights(Shape4(2, 12, 10, 8)),
+                             stackedInterpolated(Shape4(2, 23, 19, 15));
+        stackedWeights.bind<0>(1) = nodeWeights;
+        stackedInterpolated.bind<0>(1) = interpolated;
+        UnstridedView unstridedWeights(nodeWeights.shape(), nodeWeights.data()),
+                      unstridedInterpolated(interpolated.shape(), interpolated.data());
+        ImplicitNodeWeightEdgeMap<3, boost_graph::undirected_tag, float, MeanFunctor<float>, float, UnstridedArrayTag>
+            unstridedMap = implicitEdgeWeightsFromNodeWeights(g, unstridedWeights, true);
+        edgeWeightsFromNodeWeights(g, nodeWeights, edgeMap, true);
+        for(Graph::EdgeIt e(g); e!=lemon::INVALID; ++e){
+            shouldEqualTolerance(unstridedMap[*e], edgeMap[*e], 1e-6f);
+            shouldEqualTolerance(implicitEdgeWeightsFromNodeWeights(g, stackedWeights.bind<0>(1), true)[*e],
+                                 edgeMap[*e], 1e-6f);
+        }
+        ImplicitInterpolatedEdgeMap<3, boost_graph::undirected_tag, float, UnstridedArrayTag>
+            unstridedInterpolatedMap = implicitEdgeWeightsFromInterpolatedImage(g, unstridedInterpolated, true);
+        edgeWeightsFromInterpolatedImage(g, interpolated, edgeMap, true);
+        for(Graph::EdgeIt e(g); e!=lemon::INVALID; ++e){
+            shouldEqualTolerance(unstridedInterpolatedMap[*e], edgeMap[*e], 1e-6f);
+            shouldEqualTolerance(implicitEdgeWeightsFromInterpolatedImage(g, stackedInterpolated.bind<0>(1), true)[*e],
+                                 edgeMap[*e], 1e-6f);
+        }
+        should((!IsImplicitGraphMap<Graph::EdgeMap<float> >::value));
+
+        // the algorithms give the same results with both maps
+        edgeWeightsFromNodeWeights(g, nodeWeights, edgeMap, true);
+        const ImplicitNodeWeightEdgeMap<3, boost_graph::undirected_tag, float, MeanFunctor<float>, float>
+            implicitMap = implicitEdgeWeightsFromNodeWeights(g, nodeWeights, true);
+        {
+            ShortestPathDijkstra<Graph, float> sp(g), spImplicit(g);
+            sp.run(edgeMap, GNode(3, 4, 5));
+            spImplicit.run(implicitMap, GNode(3, 4, 5));
+            for(Graph::NodeIt n(g); n!=lemon::INVALID; ++n){
+                shouldEqual(sp.distances()[*n], spImplicit.distances()[*n]);
+                should(sp.predecessors()[*n] == spImplicit.predecessors()[*n]);
+            }
+        }
+        {
+            Graph::NodeMap<UInt32> seeds(g, 0u), seg(g), segImplicit(g);
+            seeds[GNode(0, 0, 0)] = 1;
+            seeds[GNode(11, 9, 7)] = 2;
+            seeds[GNode(6, 0, 4)] = 3;
+            edgeWeightedWatershedsSegmentation(g, edgeMap, seeds, seg);
+            edgeWeightedWatershedsSegmentation(g, implicitMap, seeds, segImplicit);
+            should(seg == segImplicit);
+        }
+        {
+            Graph::NodeMap<float> nodeSizes(g, 1.0f);
+            Graph::NodeMap<UInt32> seg(g), segImplicit(g);
+            felzenszwalbSegmentation(g, edgeMap, nodeSizes, 0.5f, seg);
+            felzenszwalbSegmentation(g, implicitMap, nodeSizes, 0.5f, segImplicit);
+            should(seg == segImplicit);
+        }
+        {
+            Graph::EdgeMap<float> edgeLengths(g, 1.0f);
+            Graph::NodeMap<float> nodeSizes(g, 1.0f), nodeFeatures(g);
+            nodeFeatures = nodeWeights;
+            Graph::NodeMap<UInt32> seg(g), segImplicit(g);
+            hierarchicalClustering(g, edgeMap, edgeLengths, nodeFeatures, nodeSizes, seg,
+                                   ClusteringOptions().minRegionCount(20).nodeFeatureImportance(0.5));
+            hierarchicalClustering(g, implicitMap, edgeLengths, nodeFeatures, nodeSizes, segImplicit,
+                                   ClusteringOptions().minRegionCount(20).nodeFeatureImportance(0.5));
+            should(seg == segImplicit);
+            // the explicit map is not modified by the clustering
+            for(Graph::EdgeIt e(g); e!=lemon::INVALID; ++e)
+                shouldEqual(edgeMap[*e], implicitMap[*e]);
+        }
+    }
 };
 
 
@@ -555,9 +1165,15 @@ struct GraphAlgorithmTestSuite
     {   
         add( testCase( &GraphAlgorithmTest::testShortestPathAdjacencyListGraph));
         add( testCase( &GraphAlgorithmTest::testShortestPathGridGraph));
+        add( testCase( &GraphAlgorithmTest::testShortestPathBuckets));
         add( testCase( &GraphAlgorithmTest::testRegionAdjacencyGraph));
+        add( testCase( &GraphAlgorithmTest::testParallelRegionAdjacencyGraph));
+        add( testCase( &GraphAlgorithmTest::testRagEdgeFeatures));
+        add( testCase( &GraphAlgorithmTest::testFrozenGraphAlgorithms));
+        add( testCase( &GraphAlgorithmTest::testHierarchicalClusteringModes));
         add( testCase( &GraphAlgorithmTest::testEdgeSort));
         add( testCase( &GraphAlgorithmTest::testEdgeWeightComputation));
+        add( testCase( &GraphAlgorithmTest::testImplicitEdgeMaps));
         add( testCase( &GraphAlgorithmTest::testShortestPathGridGraph2));
     }
 };
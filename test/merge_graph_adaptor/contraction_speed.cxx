@@ -0,0 +1,178 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+// Compares MergeGraphAdaptor and EdgeContractionGraph on a large region
+// adjacency graph: agglomeration by mean edge weight with a priority queue.
+
+//We need to undefine NDEBUG so that we have TIC, TOC available!
+#undef NDEBUG
+
+#include <iostream>
+#include <vigra/timing.hxx>
+USETICTOC;
+#include <vigra/multi_array.hxx>
+#include <vigra/graph_algorithms.hxx>
+#include <vigra/merge_graph_adaptor.hxx>
+#include <vigra/edge_contraction_graph.hxx>
+#include <vigra/priority_queue.hxx>
+#include <vigra/random.hxx>
+
+using namespace vigra;
+
+typedef detail::GenericNode<Int64> Node;
+typedef detail::GenericEdge<Int64> Edge;
+
+// maintains the mean weight of every edge in a priority queue
+struct MeanEdgeWeight
+{
+    MeanEdgeWeight(std::vector<float> & weightSum, std::vector<float> & length,
+                   ChangeablePriorityQueue<float> & pq)
+    : weightSum_(&weightSum), length_(&length), pq_(&pq)
+    {}
+
+    void mergeNodes(const Node &, const Node &)
+    {}
+
+    void mergeEdges(const Edge & a, const Edge & b)
+    {
+        (*weightSum_)[a.id()] += (*weightSum_)[b.id()];
+        (*length_)[a.id()]    += (*length_)[b.id()];
+        pq_->deleteItem(b.id());
+        pq_->push(a.id(), (*weightSum_)[a.id()] / (*length_)[a.id()]);
+    }
+
+    void eraseEdge(const Edge & e)
+    {
+        pq_->deleteItem(e.id());
+    }
+
+    std::vector<float> * weightSum_;
+    std::vector<float> * length_;
+    ChangeablePriorityQueue<float> * pq_;
+};
+
+template <class MERGE_GRAPH>
+void agglomerate(MERGE_GRAPH & mg, ChangeablePriorityQueue<float> & pq, std::size_t regions)
+{
+    while (mg.nodeNum() > regions && !pq.empty())
+        mg.contractEdge(mg.edgeFromId(pq.top()));
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    typedef GridGraph<2, boost_graph::undirected_tag> Grid;
+
+    // superpixel-like labels: 4x4 blocks with jittered boundaries
+    Shape2 const shape(2000, 2000);
+    MultiArrayIndex const block = 4;
+    RandomNumberGenerator<MersenneTwister> random(1);
+    MultiArray<2, UInt32> labels(shape);
+    MultiArrayIndex blocks = (shape[0] + block - 1) / block;
+    for (MultiArrayIndex y = 0; y < shape[1]; ++y)
+        for (MultiArrayIndex x = 0; x < shape[0]; ++x)
+        {
+            MultiArrayIndex xx = std::min<MultiArrayIndex>(shape[0]-1, x + random.uniformInt(2)),
+                            yy = std::min<MultiArrayIndex>(shape[1]-1, y + random.uniformInt(2));
+            labels(x, y) = (UInt32)(xx / block + blocks*(yy / block));
+        }
+
+    Grid graph(shape);
+    AdjacencyListGraph rag;
+    AdjacencyListGraph::EdgeMap<std::vector<Grid::Edge> > affEdges;
+    makeRegionAdjacencyGraph(graph, labels, rag, affEdges, -1, ParallelOptions());
+
+    std::vector<float> weights(rag.maxEdgeId()+1), lengths(rag.maxEdgeId()+1);
+    for (AdjacencyListGraph::EdgeIt e(rag); e != lemon::INVALID; ++e)
+    {
+        lengths[rag.id(*e)] = (float)affEdges[*e].size();
+        weights[rag.id(*e)] = (float)random.uniform() * lengths[rag.id(*e)];
+    }
+
+    std::size_t const regions = 100;
+    std::cerr << "agglomeration of a RAG with " << rag.nodeNum() << " nodes and "
+              << rag.edgeNum() << " edges into " << regions << " regions:" << std::endl;
+
+    std::vector<Int64> reprAdaptor(rag.maxNodeId()+1), reprContraction(rag.maxNodeId()+1);
+    double adaptor_time = 0.0;
+    {
+        std::vector<float> weightSum(weights), length(lengths);
+        ChangeablePriorityQueue<float> pq(rag.maxEdgeId()+1);
+        MeanEdgeWeight callbacks(weightSum, length, pq);
+
+        TIC;
+        MergeGraphAdaptor<AdjacencyListGraph> mg(rag);
+        typedef MergeGraphAdaptor<AdjacencyListGraph> MG;
+        mg.registerMergeNodeCallBack(MG::MergeNodeCallBackType::from_method<MeanEdgeWeight, &MeanEdgeWeight::mergeNodes>(&callbacks));
+        mg.registerMergeEdgeCallBack(MG::MergeEdgeCallBackType::from_method<MeanEdgeWeight, &MeanEdgeWeight::mergeEdges>(&callbacks));
+        mg.registerEraseEdgeCallBack(MG::EraseEdgeCallBackType::from_method<MeanEdgeWeight, &MeanEdgeWeight::eraseEdge>(&callbacks));
+        for (AdjacencyListGraph::EdgeIt e(rag); e != lemon::INVALID; ++e)
+            pq.push(rag.id(*e), weightSum[rag.id(*e)] / length[rag.id(*e)]);
+        agglomerate(mg, pq, regions);
+        adaptor_time = TOCN;
+        std::cerr << "    MergeGraphAdaptor:    " << adaptor_time << " msec" << std::endl;
+
+        vigra_invariant(mg.nodeNum() == regions, "contraction_speed: wrong number of regions.");
+        for (AdjacencyListGraph::NodeIt n(rag); n != lemon::INVALID; ++n)
+            reprAdaptor[rag.id(*n)] = mg.reprNodeId(rag.id(*n));
+    }
+    {
+        std::vector<float> weightSum(weights), length(lengths);
+        ChangeablePriorityQueue<float> pq(rag.maxEdgeId()+1);
+
+        TIC;
+        EdgeContractionGraph<AdjacencyListGraph, MeanEdgeWeight> cg(rag, MeanEdgeWeight(weightSum, length, pq));
+        for (AdjacencyListGraph::EdgeIt e(rag); e != lemon::INVALID; ++e)
+            pq.push(rag.id(*e), weightSum[rag.id(*e)] / length[rag.id(*e)]);
+        agglomerate(cg, pq, regions);
+        double const t = TOCN;
+        std::cerr << "    EdgeContractionGraph: " << t << " msec (" << adaptor_time / t << "x faster), "
+                  << cg.memoryConsumption() / (1024*1024) << " MB" << std::endl;
+
+        vigra_invariant(cg.nodeNum() == regions, "contraction_speed: wrong number of regions.");
+        for (AdjacencyListGraph::NodeIt n(rag); n != lemon::INVALID; ++n)
+            reprContraction[rag.id(*n)] = cg.reprNodeId(rag.id(*n));
+    }
+
+    // both engines must produce the same clustering
+    std::vector<Int64> mapping(rag.maxNodeId()+1, -1);
+    for (AdjacencyListGraph::NodeIt n(rag); n != lemon::INVALID; ++n)
+    {
+        Int64 & m = mapping[reprContraction[rag.id(*n)]];
+        if (m == -1)
+            m = reprAdaptor[rag.id(*n)];
+        vigra_invariant(m == reprAdaptor[rag.id(*n)], "contraction_speed: clusterings differ.");
+    }
+    return 0;
+}
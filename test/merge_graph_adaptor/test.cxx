@@ -35,11 +35,15 @@
 
 
 #include <iostream>
+#include <map>
+#include <set>
 #include "vigra/unittest.hxx"
 #include "vigra/stdimage.hxx"
 #include "vigra/multi_array.hxx"
 #include "vigra/adjacency_list_graph.hxx"
 #include "vigra/merge_graph_adaptor.hxx"
+#include "vigra/edge_contraction_graph.hxx"
+#include "vigra/random.hxx"
 using namespace vigra;
 
 template<class ID_TYPE>
@@ -1691,6 +1695,175 @@ struct AdjacencyListGraph2MergeGraphTest{
 };
 
 
+// counts the callbacks and tracks how many edges of the
+// base graph are represented by each edge
+struct ContractionCounter
+{
+    typedef vigra::detail::GenericNode<vigra::Int64> Node;
+    typedef vigra::detail::GenericEdge<vigra::Int64> Edge;
+
+    ContractionCounter(const size_t maxEdgeId = 0)
+    : edgeSize(maxEdgeId+1, 1), mergedNodes(0), mergedEdges(0), erasedEdges(0), erasedSize(0)
+    {}
+
+    void mergeNodes(const Node &, const Node &){
+        ++mergedNodes;
+    }
+    void mergeEdges(const Edge & a, const Edge & b){
+        edgeSize[a.id()] += edgeSize[b.id()];
+        ++mergedEdges;
+    }
+    void eraseEdge(const Edge & e){
+        erasedSize += edgeSize[e.id()];
+        ++erasedEdges;
+    }
+
+    std::vector<size_t> edgeSize;
+    size_t mergedNodes, mergedEdges, erasedEdges, erasedSize;
+};
+
+struct EdgeContractionGraphTest
+{
+    typedef vigra::AdjacencyListGraph                                 Graph;
+    typedef vigra::MergeGraphAdaptor<Graph>                           MergeGraph;
+    typedef vigra::EdgeContractionGraph<Graph, ContractionCounter>   ContractionGraph;
+    typedef ContractionGraph::Node                                    Node;
+    typedef ContractionGraph::Edge                                    Edge;
+
+    // 8-neighborhood grid, so merging creates many parallel edges
+    void makeGrid(Graph & g, const int w, const int h){
+        for(int i=0; i<w*h; ++i)
+            g.addNode(i);
+        for(int y=0; y<h; ++y)
+        for(int x=0; x<w; ++x){
+            if(x+1<w)
+                g.addEdge(g.nodeFromId(x+w*y), g.nodeFromId(x+1+w*y));
+            if(y+1<h)
+                g.addEdge(g.nodeFromId(x+w*y), g.nodeFromId(x+w*(y+1)));
+            if(x+1<w && y+1<h)
+                g.addEdge(g.nodeFromId(x+w*y), g.nodeFromId(x+1+w*(y+1)));
+        }
+    }
+
+    void checkState(const Graph & g, const ContractionGraph & cg, const MergeGraph & mg){
+        shouldEqual(cg.nodeNum(), mg.nodeNum());
+        shouldEqual(cg.edgeNum(), mg.edgeNum());
+
+        // same partition of the nodes
+        std::map<vigra::Int64, vigra::Int64> toMg, toCg;
+        for(Graph::NodeIt n(g); n!=lemon::INVALID; ++n){
+            const vigra::Int64 c = cg.reprNodeId(g.id(*n));
+            const vigra::Int64 m = mg.reprNodeId(g.id(*n));
+            should(cg.hasNodeId(c));
+            if(toMg.find(c)==toMg.end())
+                toMg[c] = m;
+            if(toCg.find(m)==toCg.end())
+                toCg[m] = c;
+            shouldEqual(toMg[c], m);
+            shouldEqual(toCg[m], c);
+        }
+
+        size_t nodeCount = 0;
+        for(ContractionGraph::NodeIt n(cg); n!=lemon::INVALID; ++n, ++nodeCount){
+            shouldEqual(cg.degree(*n), mg.degree(mg.nodeFromId(toMg[cg.id(*n)])));
+            size_t degree = 0;
+            for(ContractionGraph::IncEdgeIt e(cg, *n); e!=lemon::INVALID; ++e, ++degree)
+                should(cg.u(*e)==*n || cg.v(*e)==*n);
+            shouldEqual(degree, cg.degree(*n));
+        }
+        shouldEqual(nodeCount, cg.nodeNum());
+
+        // every edge of the base graph is either inside a cluster,
+        // or represented by the edge between the two clusters
+        std::map<vigra::Int64, size_t> edgeSize;
+        for(Graph::EdgeIt e(g); e!=lemon::INVALID; ++e){
+            const vigra::Int64 cu = cg.reprNodeId(g.id(g.u(*e)));
+            const vigra::Int64 cv = cg.reprNodeId(g.id(g.v(*e)));
+            const vigra::Int64 r  = cg.reprEdgeId(g.id(*e));
+            if(cu==cv){
+                should(!cg.hasEdgeId(r));
+                shouldEqual(cg.id(cg.inactiveEdgesNode(Edge(g.id(*e)))), cu);
+                should(cg.findEdge(Node(cu), Node(cv))==lemon::INVALID);
+            }
+            else{
+                should(cg.hasEdgeId(r));
+                should(cg.findEdge(Node(cu), Node(cv))==Edge(r));
+                should(mg.findEdge(mg.nodeFromId(toMg[cu]), mg.nodeFromId(toMg[cv]))!=lemon::INVALID);
+                ++edgeSize[r];
+            }
+        }
+        size_t edgeCount = 0;
+        for(ContractionGraph::EdgeIt e(cg); e!=lemon::INVALID; ++e, ++edgeCount)
+            shouldEqual(cg.callbacks().edgeSize[cg.id(*e)], edgeSize[cg.id(*e)]);
+        shouldEqual(edgeCount, cg.edgeNum());
+    }
+
+    void randomContractionTest(){
+        Graph g;
+        makeGrid(g, 12, 10);
+
+        vigra::RandomMT19937 random(42);
+        for(int run=0; run<3; ++run){
+            ContractionGraph cg(g, ContractionCounter(g.maxEdgeId()));
+            MergeGraph mg(g);
+            checkState(g, cg, mg);
+
+            size_t mgMergedEdges = 0;
+            while(cg.edgeNum() > 0){
+                // contract the edge between the clusters of a random base edge
+                const Graph::Edge e = g.edgeFromId(random.uniformInt(g.maxEdgeId()+1));
+                const vigra::Int64 u = g.id(g.u(e)), v = g.id(g.v(e));
+                if(cg.reprNodeId(u)==cg.reprNodeId(v))
+                    continue;
+                const Edge ce = cg.findEdge(Node(cg.reprNodeId(u)), Node(cg.reprNodeId(v)));
+                const MergeGraph::Edge me = mg.findEdge(mg.nodeFromId(mg.reprNodeId(u)), mg.nodeFromId(mg.reprNodeId(v)));
+                should(ce!=lemon::INVALID);
+                should(me!=lemon::INVALID);
+
+                const size_t edgesBefore = mg.edgeNum();
+                cg.contractEdge(ce);
+                mg.contractEdge(me);
+                mgMergedEdges += edgesBefore - 1 - mg.edgeNum();
+                if(cg.nodeNum() % 10 == 0)
+                    checkState(g, cg, mg);
+            }
+            checkState(g, cg, mg);
+
+            const ContractionCounter & counter = cg.callbacks();
+            shouldEqual(counter.mergedNodes, g.nodeNum() - cg.nodeNum());
+            shouldEqual(counter.erasedEdges, counter.mergedNodes);
+            shouldEqual(counter.mergedEdges, mgMergedEdges);
+            shouldEqual(counter.erasedSize, g.edgeNum());
+            shouldEqual(cg.nodeNum(), 1u);
+            should(cg.memoryConsumption() > 0);
+        }
+    }
+
+    void noCallbacksTest(){
+        Graph g;
+        makeGrid(g, 3, 3);
+        vigra::EdgeContractionGraph<Graph> cg(g);
+        shouldEqual(cg.nodeNum(), 9u);
+        shouldEqual(cg.edgeNum(), 16u);
+
+        // merge 0|1, then 0|4 and 1|4 become parallel
+        cg.contractEdge(cg.findEdge(Node(0), Node(1)));
+        shouldEqual(cg.nodeNum(), 8u);
+        shouldEqual(cg.edgeNum(), 14u);
+        should(cg.reprNodeId(0)==cg.reprNodeId(1));
+        shouldEqual(cg.degree(Node(cg.reprNodeId(0))), 4u);
+        should(cg.findEdge(Node(cg.reprNodeId(0)), Node(4))!=lemon::INVALID);
+        should(cg.reprEdgeId(g.id(g.findEdge(g.nodeFromId(1), g.nodeFromId(4)))) ==
+               cg.reprEdgeId(g.id(g.findEdge(g.nodeFromId(0), g.nodeFromId(4)))));
+
+        try{
+            cg.contractEdge(Edge(g.id(g.findEdge(g.nodeFromId(0), g.nodeFromId(1)))));
+            failTest("no exception thrown");
+        }
+        catch(vigra::PreconditionViolation &){}
+    }
+};
+
  
 struct AdjacencyListGraphMergeGraphAdaptorTestSuite
 : public vigra::test_suite
@@ -1719,6 +1892,9 @@ struct AdjacencyListGraphMergeGraphAdaptorTestSuite
         // test which do some merging
         add( testCase( &AdjacencyListGraph2MergeGraphTest<vigra::UInt32>::GraphMergeGridDegreeTest));
         add( testCase( &AdjacencyListGraph2MergeGraphTest<vigra::UInt32>::GraphMergeGridEdgeTest));
+
+        add( testCase( &EdgeContractionGraphTest::noCallbacksTest));
+        add( testCase( &EdgeContractionGraphTest::randomContractionTest));
     }
 };
 
@@ -0,0 +1,97 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+// Compares the run time of the structure-of-arrays SoARegionStatistics with an
+// AccumulatorChainArray computing the same basic statistics on a 3D label volume.
+
+//We need to undefine NDEBUG so that we have TIC, TOC available!
+#undef NDEBUG
+
+#include <iostream>
+#include <vigra/timing.hxx>
+USETICTOC;
+#include <vigra/multi_array.hxx>
+#include <vigra/accumulator.hxx>
+#include <vigra/accumulator_soa.hxx>
+#include <vigra/random.hxx>
+
+using namespace vigra;
+using namespace vigra::acc;
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    typedef MultiArrayShape<3>::type Shape;
+
+    Shape const shape(200, 200, 200);
+    MultiArrayIndex const block = 5;   // 40^3 = 64000 regions
+
+    RandomNumberGenerator<MersenneTwister> random(1);
+    MultiArray<3, float> data(shape);
+    MultiArray<3, UInt32> labels(shape);
+    MultiArrayIndex blocks = shape[0] / block;
+    for (MultiArrayIndex z = 0; z < shape[2]; ++z)
+        for (MultiArrayIndex y = 0; y < shape[1]; ++y)
+            for (MultiArrayIndex x = 0; x < shape[0]; ++x)
+            {
+                data(x, y, z) = (float)random.uniform();
+                labels(x, y, z) = (UInt32)(x / block + blocks*(y / block + blocks*(z / block)));
+            }
+
+    std::cerr << "Statistics of " << labels[shape - Shape(1)] + 1 << " regions in a " << shape << " volume:" << std::endl;
+
+    AccumulatorChainArray<CoupledArrays<3, float, UInt32>,
+                          Select<DataArg<1>, LabelArg<2>,
+                                 Count, Sum, SumOfSquares, Minimum, Maximum, Coord<Sum> > > chain;
+    TIC;
+    extractFeatures(data, labels, chain);
+    double const chain_time = TOCN;
+    std::cerr << "    AccumulatorChainArray: " << chain_time << " msec" << std::endl;
+
+    SoARegionStatistics<3, float> soa;
+    TIC;
+    extractFeatures(data, labels, soa);
+    double const soa_time = TOCN;
+    std::cerr << "    SoARegionStatistics:   " << soa_time << " msec ("
+              << chain_time / soa_time << "x faster)" << std::endl;
+
+    for (MultiArrayIndex k = 0; k <= soa.maxRegionLabel(); ++k)
+    {
+        vigra_invariant(soa.count(k) == get<Count>(chain, k) &&
+                        soa.maximum(k) == get<Maximum>(chain, k) &&
+                        soa.coordSum(k) == get<Coord<Sum> >(chain, k),
+                        "soa_speed: results differ.");
+    }
+    return 0;
+}
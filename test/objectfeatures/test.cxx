@@ -41,6 +41,10 @@
 #include <vigra/unittest.hxx>
 #include <vigra/multi_array.hxx>
 #include <vigra/accumulator.hxx>
+#include <vigra/accumulator_parallel.hxx>
+#include <vigra/accumulator_soa.hxx>
+#include <vigra/accumulator_incremental.hxx>
+#include <vigra/random.hxx>
 
 namespace std {
 
@@ -1490,6 +1494,740 @@ struct AccumulatorTest
             shouldEqual(W(3, 0, 1), get<AutoRangeHistogram<3> >(c,3));
         }
     }
+
+    void testParallelExtraction()
+    {
+        using namespace vigra::acc;
+
+        typedef MultiArrayShape<2>::type Shape;
+        Shape shape(67, 53);
+        MultiArray<2, double> data(shape);
+        MultiArray<2, int> labels(shape);
+        for(MultiArrayIndex y=0; y<shape[1]; ++y)
+            for(MultiArrayIndex x=0; x<shape[0]; ++x)
+            {
+                data(x, y) = std::sin(0.1*x*y) + 0.01*x + 0.3*((x + 3*y) % 7);
+                labels(x, y) = (x / 10 + 3*(y / 20)) % 10;
+            }
+
+        {
+            typedef AccumulatorChainArray<CoupledArrays<2, double, int>,
+                                          Select<DataArg<1>, LabelArg<2>,
+                                                 Count, Mean, Variance, Skewness, Kurtosis,
+                                                 Minimum, Maximum, RegionCenter,
+                                                 StandardQuantiles<GlobalRangeHistogram<16> >,
+                                                 Global<Count>, Global<Mean>, Global<Kurtosis>
+                                          > > A;
+            shouldEqual(A().passesRequired(), 2u);
+
+            A a, b;
+            extractFeatures(data, labels, a);
+            extractFeatures(data, labels, b, ParallelOptions().numThreads(4));
+
+            shouldEqual(a.maxRegionLabel(), b.maxRegionLabel());
+            shouldEqual(b.current_pass_, 2u);
+            shouldEqual(get<Global<Count> >(a), get<Global<Count> >(b));
+            shouldEqualTolerance(get<Global<Mean> >(a), get<Global<Mean> >(b), 1e-12);
+            shouldEqualTolerance(get<Global<Kurtosis> >(a), get<Global<Kurtosis> >(b), 1e-12);
+            for(int k=0; k<=a.maxRegionLabel(); ++k)
+            {
+                shouldEqual(get<Count>(a, k), get<Count>(b, k));
+                shouldEqual(get<Minimum>(a, k), get<Minimum>(b, k));
+                shouldEqual(get<Maximum>(a, k), get<Maximum>(b, k));
+                shouldEqualTolerance(get<Mean>(a, k), get<Mean>(b, k), 1e-12);
+                shouldEqualTolerance(get<Variance>(a, k), get<Variance>(b, k), 1e-12);
+                shouldEqualTolerance(get<Skewness>(a, k), get<Skewness>(b, k), 1e-10);
+                shouldEqualTolerance(get<Kurtosis>(a, k), get<Kurtosis>(b, k), 1e-10);
+                shouldEqualSequenceTolerance(get<RegionCenter>(a, k).begin(), get<RegionCenter>(a, k).end(),
+                                             get<RegionCenter>(b, k).begin(), 1e-12);
+                shouldEqualSequence(get<GlobalRangeHistogram<16> >(a, k).begin(),
+                                    get<GlobalRangeHistogram<16> >(a, k).end(),
+                                    get<GlobalRangeHistogram<16> >(b, k).begin());
+                shouldEqualSequenceTolerance(get<StandardQuantiles<GlobalRangeHistogram<16> > >(a, k).begin(),
+                                             get<StandardQuantiles<GlobalRangeHistogram<16> > >(a, k).end(),
+                                             get<StandardQuantiles<GlobalRangeHistogram<16> > >(b, k).begin(), 1e-12);
+            }
+        }
+
+        {
+            // dynamic chain with a coordinate offset and an ignored label
+            typedef DynamicAccumulatorChainArray<CoupledArrays<2, double, int>,
+                                                 Select<DataArg<1>, LabelArg<2>,
+                                                        Count, Mean, Central<PowerSum<3> >, RegionCenter
+                                                 > > A;
+            A a, b;
+            activate<Central<PowerSum<3> > >(a);
+            activate<RegionCenter>(a);
+            a.ignoreLabel(0);
+            a.setCoordinateOffset(Shape(100, 200));
+            b = a;
+
+            extractFeatures(data, labels, a);
+            extractFeatures(data, labels, b, ParallelOptions().numThreads(3));
+
+            shouldEqual(get<Count>(b, 0), 0.0);
+            for(int k=1; k<=a.maxRegionLabel(); ++k)
+            {
+                shouldEqual(get<Count>(a, k), get<Count>(b, k));
+                shouldEqualTolerance(get<Central<PowerSum<3> > >(a, k), get<Central<PowerSum<3> > >(b, k), 1e-10);
+                shouldEqualSequenceTolerance(get<RegionCenter>(a, k).begin(), get<RegionCenter>(a, k).end(),
+                                             get<RegionCenter>(b, k).begin(), 1e-12);
+            }
+        }
+
+        {
+            // Central<Minimum> cannot be merged => sequential fallback
+            typedef AccumulatorChainArray<CoupledArrays<2, double, int>,
+                                          Select<DataArg<1>, LabelArg<2>, Count, Central<Minimum> > > A;
+            A a, b;
+            should(!a.isMergeable());
+            extractFeatures(data, labels, a);
+            extractFeatures(data, labels, b, ParallelOptions().numThreads(4));
+            for(int k=0; k<=a.maxRegionLabel(); ++k)
+            {
+                shouldEqual(get<Count>(a, k), get<Count>(b, k));
+                shouldEqual(get<Central<Minimum> >(a, k), get<Central<Minimum> >(b, k));
+            }
+
+            // in dynamic chains, only the active statistics must be mergeable
+            typedef AccumulatorChain<TinyVector<double, 2>, Select<Mean, Principal<Maximum> > > P;
+            typedef AccumulatorChain<double, Select<Mean, Variance, Skewness> > S;
+            should(!P().isMergeable());
+            should(S().isMergeable());
+            typedef DynamicAccumulatorChainArray<CoupledArrays<2, double, int>,
+                                                 Select<DataArg<1>, LabelArg<2>, Count, Central<Minimum> > > D;
+            D d;
+            activate<Count>(d);
+            should(d.isMergeable());
+            activate<Central<Minimum> >(d);
+            should(!d.isMergeable());
+        }
+
+        {
+            // iterator version with a plain chain
+            typedef AccumulatorChain<double, Select<Mean, Variance, Skewness, Minimum> > A;
+            A a, b;
+            extractFeatures(data.begin(), data.end(), a);
+            extractFeatures(data.begin(), data.end(), b, ParallelOptions().numThreads(4));
+            shouldEqual(get<Count>(a), get<Count>(b));
+            shouldEqual(get<Minimum>(a), get<Minimum>(b));
+            shouldEqualTolerance(get<Mean>(a), get<Mean>(b), 1e-12);
+            shouldEqualTolerance(get<Variance>(a), get<Variance>(b), 1e-12);
+            shouldEqualTolerance(get<Skewness>(a), get<Skewness>(b), 1e-10);
+        }
+    }
+
+    void testChunkedExtraction()
+    {
+        using namespace vigra::acc;
+
+        typedef MultiArrayShape<3>::type Shape;
+        Shape shape(37, 29, 21);
+        MultiArray<3, float> data(shape);
+        MultiArray<3, UInt32> labels(shape);
+        for(MultiArrayIndex z=0; z<shape[2]; ++z)
+            for(MultiArrayIndex y=0; y<shape[1]; ++y)
+                for(MultiArrayIndex x=0; x<shape[0]; ++x)
+                {
+                    data(x, y, z) = (float)(std::cos(0.05*x*z) + 0.02*y + 0.1*((x + 5*y + z) % 11));
+                    labels(x, y, z) = (UInt32)((x / 7 + 5*(y / 9) + 20*(z / 6)) % 57 + 1);
+                }
+        labels.subarray(Shape(0), Shape(10, 10, 10)) = 0;
+
+        ChunkedArrayLazy<3, float> chunkedData(shape, Shape(8));
+        ChunkedArrayCompressed<3, UInt32> chunkedLabels(shape, Shape(8));
+        chunkedData.commitSubarray(Shape(0), data);
+        chunkedLabels.commitSubarray(Shape(0), labels);
+
+        typedef AccumulatorChainArray<CoupledArrays<3, float, UInt32>,
+                                      Select<DataArg<1>, LabelArg<2>,
+                                             Count, Mean, Variance, Skewness, Minimum, Maximum,
+                                             RegionCenter, Coord<Maximum>,
+                                             GlobalRangeHistogram<8>, Global<Count>, Global<Mean>
+                                      > > A;
+        A a, b, c;
+        a.ignoreLabel(0);
+        b.ignoreLabel(0);
+        extractFeatures(data, labels, a);
+        extractFeatures(chunkedData, chunkedLabels, b, ParallelOptions().numThreads(4));
+        extractFeatures(chunkedData, chunkedLabels, c, ParallelOptions().numThreads(ParallelOptions::NoThreads));
+
+        shouldEqual(a.maxRegionLabel(), b.maxRegionLabel());
+        shouldEqual(a.maxRegionLabel(), c.maxRegionLabel());
+        shouldEqual(get<Global<Count> >(a), get<Global<Count> >(b));
+        shouldEqualTolerance(get<Global<Mean> >(a), get<Global<Mean> >(b), 1e-6);
+        shouldEqual(get<Count>(b, 0), 0.0);
+        for(int k=1; k<=a.maxRegionLabel(); ++k)
+        {
+            shouldEqual(get<Count>(a, k), get<Count>(b, k));
+            shouldEqual(get<Count>(a, k), get<Count>(c, k));
+            shouldEqual(get<Minimum>(a, k), get<Minimum>(b, k));
+            shouldEqual(get<Maximum>(a, k), get<Maximum>(b, k));
+            shouldEqual(get<Coord<Maximum> >(a, k), get<Coord<Maximum> >(b, k));
+            shouldEqualTolerance(get<Mean>(a, k), get<Mean>(b, k), 1e-6);
+            shouldEqualTolerance(get<Variance>(a, k), get<Variance>(b, k), 1e-6);
+            shouldEqualTolerance(get<Skewness>(a, k), get<Skewness>(b, k), 1e-5);
+            shouldEqualTolerance(get<Skewness>(a, k), get<Skewness>(c, k), 1e-5);
+            shouldEqualSequenceTolerance(get<RegionCenter>(a, k).begin(), get<RegionCenter>(a, k).end(),
+                                         get<RegionCenter>(b, k).begin(), 1e-10);
+            shouldEqualSequence(get<GlobalRangeHistogram<8> >(a, k).begin(),
+                                get<GlobalRangeHistogram<8> >(a, k).end(),
+                                get<GlobalRangeHistogram<8> >(b, k).begin());
+        }
+
+        // a chunk with all 256 values of a narrow label type, the ignored label cannot occur
+        MultiArray<3, float> byteData(Shape(16, 16, 3));
+        MultiArray<3, UInt8> byteLabels(byteData.shape());
+        for(MultiArrayIndex k=0; k<byteData.size(); ++k)
+        {
+            byteData[k] = (float)(k % 13);
+            byteLabels[k] = (UInt8)(k % 256);
+        }
+        ChunkedArrayLazy<3, float> chunkedByteData(byteData.shape(), Shape(16));
+        ChunkedArrayLazy<3, UInt8> chunkedByteLabels(byteData.shape(), Shape(16));
+        chunkedByteData.commitSubarray(Shape(0), byteData);
+        chunkedByteLabels.commitSubarray(Shape(0), byteLabels);
+
+        typedef AccumulatorChainArray<CoupledArrays<3, float, UInt8>,
+                                      Select<DataArg<1>, LabelArg<2>, Count, Mean> > ByteChain;
+        ByteChain d, e;
+        d.ignoreLabel(256);
+        e.ignoreLabel(256);
+        extractFeatures(byteData, byteLabels, d);
+        extractFeatures(chunkedByteData, chunkedByteLabels, e, ParallelOptions().numThreads(2));
+        shouldEqual(e.maxRegionLabel(), 255);
+        for(int k=0; k<=255; ++k)
+        {
+            shouldEqual(get<Count>(d, k), get<Count>(e, k));
+            shouldEqualTolerance(get<Mean>(d, k), get<Mean>(e, k), 1e-6);
+        }
+    }
+
+    void testSparseRegions()
+    {
+        using namespace vigra::acc;
+
+        typedef MultiArrayShape<2>::type Shape;
+        Shape shape(41, 37);
+        MultiArray<2, double> data(shape);
+        MultiArray<2, UInt32> labels(shape);
+        UInt32 used[] = { 3, 17, 100000, 2500000, 7 }; // label 7 will be ignored
+        for(MultiArrayIndex y=0; y<shape[1]; ++y)
+            for(MultiArrayIndex x=0; x<shape[0]; ++x)
+            {
+                data(x, y) = std::sin(0.3*x) * std::cos(0.2*y) + 0.01*(x + y);
+                labels(x, y) = used[(x / 9 + 2*(y / 8)) % 5];
+            }
+
+        typedef AccumulatorChainArray<CoupledArrays<2, double, UInt32>,
+                                      Select<DataArg<1>, LabelArg<2>,
+                                             Count, Mean, Variance, Skewness, Maximum, RegionCenter,
+                                             AutoRangeHistogram<4>, Global<Mean>
+                                      > > A;
+        A dense, sparse;
+        should(!dense.hasSparseRegionStorage());
+        sparse.setSparseRegionStorage();
+        should(sparse.hasSparseRegionStorage());
+        sparse.ignoreLabel(7);
+        dense.ignoreLabel(7);
+
+        extractFeatures(data, labels, dense);
+        extractFeatures(data, labels, sparse);
+
+        shouldEqual(sparse.maxRegionLabel(), 2500000);
+        shouldEqual(sparse.regionCount(), 2500001u);
+        shouldEqual(sparse.next_.regions_.size(), 5u); // empty region + 4 used labels
+        shouldEqualTolerance(get<Global<Mean> >(dense), get<Global<Mean> >(sparse), 1e-14);
+        for(int k=0; k<4; ++k)
+        {
+            UInt32 l = used[k];
+            shouldEqual(get<Count>(dense, l), get<Count>(sparse, l));
+            shouldEqual(get<Maximum>(dense, l), get<Maximum>(sparse, l));
+            shouldEqualTolerance(get<Mean>(dense, l), get<Mean>(sparse, l), 1e-14);
+            shouldEqualTolerance(get<Variance>(dense, l), get<Variance>(sparse, l), 1e-14);
+            shouldEqualTolerance(get<Skewness>(dense, l), get<Skewness>(sparse, l), 1e-12);
+            shouldEqualSequence(get<RegionCenter>(dense, l).begin(), get<RegionCenter>(dense, l).end(),
+                                get<RegionCenter>(sparse, l).begin());
+            shouldEqualSequence(get<AutoRangeHistogram<4> >(dense, l).begin(), get<AutoRangeHistogram<4> >(dense, l).end(),
+                                get<AutoRangeHistogram<4> >(sparse, l).begin());
+        }
+        // labels without data refer to the empty region
+        shouldEqual(get<Count>(sparse, 0), 0.0);
+        shouldEqual(get<Count>(sparse, 7), 0.0);
+        shouldEqual(get<Count>(sparse, 1234), 0.0);
+
+        // merging of sparse chains with different label sets
+        typedef AccumulatorChainArray<CoupledArrays<2, double, UInt32>,
+                                      Select<DataArg<1>, LabelArg<2>, Count, Mean, Variance> > B;
+        B left, right;
+        left.setSparseRegionStorage();
+        right.setSparseRegionStorage();
+        extractFeatures(data.subarray(Shape(0), Shape(20, 37)), labels.subarray(Shape(0), Shape(20, 37)), left);
+        extractFeatures(data.subarray(Shape(20, 0), shape), labels.subarray(Shape(20, 0), shape), right);
+        left.merge(right);
+        for(int k=0; k<4; ++k)
+        {
+            UInt32 l = used[k];
+            shouldEqual(get<Count>(dense, l), get<Count>(left, l));
+            shouldEqualTolerance(get<Mean>(dense, l), get<Mean>(left, l), 1e-14);
+            shouldEqualTolerance(get<Variance>(dense, l), get<Variance>(left, l), 1e-14);
+        }
+
+        left.merge(3, 17);
+        shouldEqual(get<Count>(left, 3), get<Count>(dense, 3) + get<Count>(dense, 17));
+        shouldEqual(get<Count>(left, 17), 0.0);
+
+        std::vector<int> labelMapping(2500001, 0);
+        labelMapping[3] = 1;
+        labelMapping[100000] = 1;
+        labelMapping[2500000] = 2;
+        B mapped, sparse2;
+        sparse2.setSparseRegionStorage();
+        extractFeatures(data, labels, sparse2);
+        mapped.merge(sparse2, labelMapping);
+        shouldEqual(mapped.maxRegionLabel(), 2);
+        shouldEqual(get<Count>(mapped, 1), get<Count>(dense, 3) + get<Count>(dense, 100000));
+        shouldEqual(get<Count>(mapped, 2), get<Count>(dense, 2500000));
+
+        // parallel and blockwise extraction with sparse region storage
+        A parallel;
+        parallel.setSparseRegionStorage();
+        parallel.ignoreLabel(7);
+        extractFeatures(data, labels, parallel, ParallelOptions().numThreads(4));
+        shouldEqual(parallel.next_.regions_.size(), 5u);
+
+        ChunkedArrayLazy<2, double> chunkedData(shape, Shape(16));
+        ChunkedArrayLazy<2, UInt32> chunkedLabels(shape, Shape(16));
+        chunkedData.commitSubarray(Shape(0), data);
+        chunkedLabels.commitSubarray(Shape(0), labels);
+        A chunked;
+        chunked.setSparseRegionStorage();
+        chunked.ignoreLabel(7);
+        extractFeatures(chunkedData, chunkedLabels, chunked, ParallelOptions().numThreads(3));
+        shouldEqual(chunked.next_.regions_.size(), 5u);
+
+        for(int k=0; k<4; ++k)
+        {
+            UInt32 l = used[k];
+            shouldEqual(get<Count>(dense, l), get<Count>(parallel, l));
+            shouldEqual(get<Count>(dense, l), get<Count>(chunked, l));
+            shouldEqualTolerance(get<Skewness>(dense, l), get<Skewness>(parallel, l), 1e-10);
+            shouldEqualTolerance(get<Skewness>(dense, l), get<Skewness>(chunked, l), 1e-10);
+            shouldEqualSequenceTolerance(get<RegionCenter>(dense, l).begin(), get<RegionCenter>(dense, l).end(),
+                                         get<RegionCenter>(chunked, l).begin(), 1e-10);
+        }
+    }
+
+    void testSoARegionStatistics()
+    {
+        using namespace vigra::acc;
+
+        typedef MultiArrayShape<3>::type Shape;
+        Shape shape(23, 19, 11);
+        MultiArray<3, float> data(shape);
+        MultiArray<3, UInt32> labels(shape);
+        for(MultiArrayIndex z=0; z<shape[2]; ++z)
+            for(MultiArrayIndex y=0; y<shape[1]; ++y)
+                for(MultiArrayIndex x=0; x<shape[0]; ++x)
+                {
+                    data(x, y, z) = (float)(std::sin(0.3*x) * std::cos(0.2*y) + 0.1*z);
+                    labels(x, y, z) = (x / 5 + 3*(y / 7) + 2*(z / 4)) % 13;
+                }
+
+        typedef AccumulatorChainArray<CoupledArrays<3, float, UInt32>,
+                                      Select<DataArg<1>, LabelArg<2>,
+                                             Count, Sum, Mean, Variance, Minimum, Maximum, RegionCenter
+                                      > > Chain;
+        Chain chain;
+        chain.ignoreLabel(4);
+        extractFeatures(data, labels, chain);
+
+        SoARegionStatistics<3, float> soa;
+        soa.ignoreLabel(4);
+        extractFeatures(data, labels, soa);
+
+        shouldEqual(soa.maxRegionLabel(), chain.maxRegionLabel());
+        shouldEqual(soa.count(4), 0.0);
+        for(int k=0; k<=soa.maxRegionLabel(); ++k)
+        {
+            if(k == 4)
+                continue;
+            shouldEqual(soa.count(k), get<Count>(chain, k));
+            shouldEqualTolerance(soa.sum(k), get<Sum>(chain, k), 1e-10);
+            shouldEqualTolerance(soa.mean(k), get<Mean>(chain, k), 1e-10);
+            shouldEqualTolerance(soa.variance(k), get<Variance>(chain, k), 1e-8);
+            shouldEqual(soa.minimum(k), get<Minimum>(chain, k));
+            shouldEqual(soa.maximum(k), get<Maximum>(chain, k));
+            TinyVector<double, 3> center = soa.regionCenter(k);
+            shouldEqualSequenceTolerance(center.begin(), center.end(),
+                                         get<RegionCenter>(chain, k).begin(), 1e-10);
+        }
+
+        // blockwise update with coordinate offsets and merging of separate results
+        Shape split(shape[0], shape[1], 5);
+        SoARegionStatistics<3, float> lower, upper;
+        lower.ignoreLabel(4);
+        upper.ignoreLabel(4);
+        lower.update(data.subarray(Shape(0), split), labels.subarray(Shape(0), split));
+        upper.setCoordinateOffset(Shape(0, 0, 5));
+        upper.update(data.subarray(Shape(0, 0, 5), shape), labels.subarray(Shape(0, 0, 5), shape));
+        lower.merge(upper);
+        shouldEqual(lower.maxRegionLabel(), soa.maxRegionLabel());
+        for(int k=0; k<=soa.maxRegionLabel(); ++k)
+        {
+            shouldEqual(lower.count(k), soa.count(k));
+            shouldEqualTolerance(lower.sum(k), soa.sum(k), 1e-10);
+            shouldEqual(lower.minimum(k), soa.minimum(k));
+            shouldEqual(lower.maximum(k), soa.maximum(k));
+            TinyVector<double, 3> c1 = lower.coordSum(k), c2 = soa.coordSum(k);
+            shouldEqualSequenceTolerance(c1.begin(), c1.end(), c2.begin(), 1e-10);
+        }
+
+        // merging of regions
+        double count = soa.count(1) + soa.count(2);
+        float maximum = std::max(soa.maximum(1), soa.maximum(2));
+        soa.merge(1, 2);
+        shouldEqual(soa.count(1), count);
+        shouldEqual(soa.maximum(1), maximum);
+        shouldEqual(soa.count(2), 0.0);
+
+        // reduced selection on a strided view
+        SoARegionStatistics<2, float, Select<Count, Maximum> > reduced;
+        MultiArrayView<2, float, StridedArrayTag> slice = data.bindAt(1, 3);
+        MultiArrayView<2, UInt32, StridedArrayTag> labelSlice = labels.bindAt(1, 3);
+        extractFeatures(slice, labelSlice, reduced);
+        AccumulatorChainArray<CoupledArrays<2, float, UInt32>, Select<DataArg<1>, LabelArg<2>, Count, Maximum> > chain2;
+        extractFeatures(slice, labelSlice, chain2);
+        shouldEqual(reduced.maxRegionLabel(), chain2.maxRegionLabel());
+        for(int k=0; k<=reduced.maxRegionLabel(); ++k)
+        {
+            shouldEqual(reduced.count(k), get<Count>(chain2, k));
+            if(reduced.count(k) > 0)
+                shouldEqual(reduced.maximum(k), get<Maximum>(chain2, k));
+        }
+
+        // a later block with a larger label enlarges the arrays
+        MultiArray<3, UInt32> larger(labels);
+        larger(0, 0, 7) = 100;
+        SoARegionStatistics<3, float> grown;
+        grown.update(data.subarray(Shape(0), split), larger.subarray(Shape(0), split));
+        should(grown.maxRegionLabel() <= soa.maxRegionLabel());
+        grown.setCoordinateOffset(Shape(0, 0, 5));
+        grown.update(data.subarray(Shape(0, 0, 5), shape), larger.subarray(Shape(0, 0, 5), shape));
+        shouldEqual(grown.maxRegionLabel(), 100);
+        shouldEqual(grown.count(100), 1.0);
+        shouldEqual(grown.sum(100), (double)data(0, 0, 7));
+        shouldEqual(grown.count(labels(0, 0, 7)), get<Count>(chain, labels(0, 0, 7)) - 1.0);
+        for(int k=soa.maxRegionLabel()+1; k<100; ++k)
+            shouldEqual(grown.count(k), 0.0);
+
+        grown.ignoreLabel(0);
+        grown.reset();
+        shouldEqual(grown.maxRegionLabel(), -1);
+        shouldEqual(grown.ignoredLabel(), 0);
+    }
+
+    template <class Store, class Labels>
+    void checkIncrementalFeatures(Store const & store, Labels const & labels, MultiArray<2, double> const & data)
+    {
+        using namespace vigra::acc;
+
+        MultiArray<2, UInt32> resolved(labels.shape());
+        for(MultiArrayIndex k=0; k<labels.size(); ++k)
+            resolved[k] = store.representative(labels[k]);
+        typename Store::Accumulator reference;
+        reference.ignoreLabel(0);
+        reference.setMaxRegionLabel(store.maxRegionLabel());
+        extractFeatures(data, resolved, reference);
+
+        for(int k=1; k<=store.maxRegionLabel(); ++k)
+        {
+            shouldEqual(get<Count>(store.features(), k), get<Count>(reference, k));
+            if(get<Count>(reference, k) == 0.0)
+                continue;
+            shouldEqualTolerance(get<Mean>(store.features(), k), get<Mean>(reference, k), 1e-10);
+            shouldEqualTolerance(get<Variance>(store.features(), k), get<Variance>(reference, k), 1e-10);
+            shouldEqualTolerance(get<Skewness>(store.features(), k), get<Skewness>(reference, k), 1e-8);
+            shouldEqual(get<Maximum>(store.features(), k), get<Maximum>(reference, k));
+            TinyVector<double, 2> c1 = get<RegionCenter>(store.features(), k),
+                                  c2 = get<RegionCenter>(reference, k);
+            shouldEqualSequenceTolerance(c1.begin(), c1.end(), c2.begin(), 1e-10);
+            shouldEqualSequence(store.boundingBox(k).begin().begin(), store.boundingBox(k).begin().end(),
+                                get<Coord<Minimum> >(reference, k).begin());
+        }
+    }
+
+    void testIncrementalFeatures()
+    {
+        using namespace vigra::acc;
+
+        typedef MultiArrayShape<2>::type Shape;
+        Shape shape(30, 20);
+        MultiArray<2, double> data(shape);
+        MultiArray<2, UInt32> labels(shape);
+        for(MultiArrayIndex y=0; y<shape[1]; ++y)
+            for(MultiArrayIndex x=0; x<shape[0]; ++x)
+            {
+                data(x, y) = std::sin(0.3*x) * std::cos(0.2*y) + 0.01*(x + y);
+                labels(x, y) = (x < 2 || y < 2) ? 0 : 1 + x / 10 + 3*(y / 10); // 6 regions and background
+            }
+
+        typedef AccumulatorChainArray<CoupledArrays<2, double, UInt32>,
+                                      Select<DataArg<1>, LabelArg<2>,
+                                             Count, Mean, Variance, Skewness, Maximum, RegionCenter, Coord<Minimum>
+                                      > > Chain;
+        Chain prototype;
+        prototype.ignoreLabel(0);
+        IncrementalRegionFeatures<2, double, UInt32, Chain> store(data, labels, prototype);
+        shouldEqual(store.maxRegionLabel(), 6);
+        shouldEqual(store.nextFreeLabel(), 7u);
+        should(store.changedRegions().empty());
+        checkIncrementalFeatures(store, labels, data);
+
+        // merges
+        shouldEqual(store.merge(3, 2), 2u);
+        shouldEqual(store.merge(6, 3), 2u);
+        shouldEqual(store.merge(2, 6), 2u);
+        shouldEqual(store.representative(6), 2u);
+        shouldEqual(store.changedRegions().size(), 1u);
+        shouldEqual(*store.changedRegions().begin(), 2);
+        shouldEqual(store.boundingBox(6).begin(), Shape(10, 2));
+        shouldEqual(store.boundingBox(6).end(), Shape(30, 20));
+        checkIncrementalFeatures(store, labels, data);
+
+        // split the merged region: the lower half becomes a new region
+        store.clearChangedRegions();
+        UInt32 newLabel = store.nextFreeLabel();
+        for(MultiArrayIndex y=12; y<shape[1]; ++y)
+            for(MultiArrayIndex x=0; x<shape[0]; ++x)
+                if(labels(x, y) != 0 && store.representative(labels(x, y)) == 2u)
+                    labels(x, y) = newLabel;
+        std::vector<UInt32> edited = { 6, newLabel };
+        store.recomputeRegions(edited);
+        shouldEqual(store.maxRegionLabel(), 7);
+        shouldEqual(store.changedRegions().size(), 2u);
+        should(store.changedRegions().count(7) == 1);
+        shouldEqual(store.boundingBox(2).end(), Shape(30, 12));
+        shouldEqual(store.boundingBox(newLabel).begin(), Shape(20, 12));
+        checkIncrementalFeatures(store, labels, data);
+
+        // erase a region by assigning its pixels to the background
+        for(MultiArrayIndex y=0; y<shape[1]; ++y)
+            for(MultiArrayIndex x=0; x<shape[0]; ++x)
+                if(labels(x, y) == 1u)
+                    labels(x, y) = 0;
+        std::vector<UInt32> erased = { 1 };
+        store.recomputeRegions(erased);
+        shouldEqual(get<Count>(store.features(), 1), 0.0);
+        should(store.boundingBox(1).isEmpty());
+        checkIncrementalFeatures(store, labels, data);
+
+        // merging a new region
+        shouldEqual(store.merge(newLabel, 4), 4u);
+        checkIncrementalFeatures(store, labels, data);
+    }
+
+    template <class Sketch>
+    void checkQuantileRanks(Sketch const & sketch, ArrayVector<double> const & sorted, double tolerance)
+    {
+        double quantiles[] = { 0.001, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999 };
+        for(int k=0; k<9; ++k)
+        {
+            double value = sketch.quantile(quantiles[k]);
+            double rank = (double)(std::lower_bound(sorted.begin(), sorted.end(), value) - sorted.begin()) / sorted.size();
+            should(std::abs(rank - quantiles[k]) <= tolerance);
+        }
+        shouldEqual(sketch.quantile(0.0), sorted.front());
+        shouldEqual(sketch.quantile(1.0), sorted.back());
+    }
+
+    void testTDigest()
+    {
+        using namespace vigra::acc;
+
+        int size = 100000;
+        RandomNumberGenerator<> random(42);
+        MultiArray<1, double> data((Shape1(size)));
+        for(int k=0; k<size; ++k)
+            data(k) = (k % 3 == 0)
+                          ? random.normal(10.0, 2.0)
+                          : std::exp(random.normal());
+        ArrayVector<double> sorted(data.begin(), data.end());
+        std::sort(sorted.begin(), sorted.end());
+
+        // global sketch in a single pass
+        AccumulatorChain<double, Select<TDigest<100>, StandardQuantiles<TDigest<100> >, Count> > a, a1, a2;
+        shouldEqual(a.passesRequired(), 1u);
+        extractFeatures(data.begin(), data.end(), a);
+        QuantileSketch const & sketch = get<TDigest<100> >(a);
+        shouldEqual(sketch.count(), (double)size);
+        should(sketch.size() <= 100u);
+        checkQuantileRanks(sketch, sorted, 0.002);
+
+        TinyVector<double, 7> q = get<StandardQuantiles<TDigest<100> > >(a);
+        shouldEqual(q[0], sorted.front());
+        shouldEqual(q[3], sketch.quantile(0.5));
+        shouldEqual(q[6], sorted.back());
+
+        // merging
+        extractFeatures(data.begin(), data.begin() + size / 3, a1);
+        extractFeatures(data.begin() + size / 3, data.end(), a2);
+        a1 += a2;
+        shouldEqual(get<TDigest<100> >(a1).count(), (double)size);
+        checkQuantileRanks(get<TDigest<100> >(a1), sorted, 0.002);
+
+        // small data sets are exact
+        QuantileSketch small;
+        double values[] = { 4.0, 1.0, 5.0, 3.0, 2.0 };
+        for(int k=0; k<5; ++k)
+            small.insert(values[k]);
+        shouldEqual(small.quantile(0.5), 3.0);
+        shouldEqual(small.quantile(0.0), 1.0);
+        shouldEqual(small.quantile(1.0), 5.0);
+        shouldEqual(QuantileSketch().quantile(0.5), 0.0);
+
+        // const queries merge the buffered values in a temporary copy, flush() in place
+        QuantileSketch flushed(small);
+        flushed.flush();
+        QuantileSketch const & buffered = small;
+        shouldEqual(buffered.quantile(0.3), flushed.quantile(0.3));
+        shouldEqual(buffered.size(), flushed.size());
+        small.insert(6.0);
+        flushed.insert(6.0);
+        shouldEqual(small.quantile(0.7), flushed.quantile(0.7));
+
+        // per-region and global sketches, sequential and parallel
+        MultiArray<2, double> image(Shape2(400, 250));
+        MultiArray<2, int> labels(image.shape());
+        ArrayVector<double> regionValues[2];
+        for(MultiArrayIndex k=0; k<image.size(); ++k)
+        {
+            labels[k] = (k % 400 < 150) ? 0 : 1;
+            image[k] = data[k % size] + 5.0 * labels[k];
+            regionValues[labels[k]].push_back(image[k]);
+        }
+        ArrayVector<double> all(image.begin(), image.end());
+        std::sort(all.begin(), all.end());
+
+        typedef AccumulatorChainArray<CoupledArrays<2, double, int>,
+                                      Select<DataArg<1>, LabelArg<2>, StandardQuantiles<TDigest<100> >,
+                                             Global<TDigest<200> > > > RegionChain;
+        RegionChain r, p;
+        extractFeatures(image, labels, r);
+        extractFeatures(image, labels, p, ParallelOptions().numThreads(4));
+        shouldEqual(r.passesRequired(), 1u);
+        checkQuantileRanks(get<Global<TDigest<200> > >(r), all, 0.005);
+        checkQuantileRanks(get<Global<TDigest<200> > >(p), all, 0.005);
+        for(int k=0; k<2; ++k)
+        {
+            std::sort(regionValues[k].begin(), regionValues[k].end());
+            checkQuantileRanks(get<TDigest<100> >(r, k), regionValues[k], 0.005);
+            checkQuantileRanks(get<TDigest<100> >(p, k), regionValues[k], 0.005);
+            shouldEqual(get<StandardQuantiles<TDigest<100> > >(p, k)[6], regionValues[k].back());
+        }
+    }
+
+    void testMultibandScatterMatrix()
+    {
+        using namespace vigra::acc;
+
+        // multiband data (runtime band count, batched scatter matrix update) must give
+        // the same results as TinyVector data (per-sample update)
+        static const int bands = 7;
+        MultiArray<3, double> data(Shape3(23, 17, bands));
+        MultiArray<2, TinyVector<double, bands> > vectors(Shape2(23, 17));
+        MultiArray<2, int> labels(Shape2(23, 17));
+        for(int y=0; y<17; ++y)
+            for(int x=0; x<23; ++x)
+            {
+                labels(x, y) = (x + 2*y) % 3;
+                for(int b=0; b<bands; ++b)
+                    data(x, y, b) = vectors(x, y)[b] = std::sin(0.3*x*(b+1)) + std::cos(0.7*y + b) + 10.0*b;
+            }
+
+        typedef AccumulatorChainArray<CoupledArrays<3, Multiband<double>, int>,
+                                      Select<DataArg<1>, LabelArg<2>, Covariance, Principal<Variance>,
+                                             Global<Covariance> > > MultibandChain;
+        typedef AccumulatorChainArray<CoupledArrays<2, TinyVector<double, bands>, int>,
+                                      Select<DataArg<1>, LabelArg<2>, Covariance, Principal<Variance>,
+                                             Global<Covariance> > > VectorChain;
+        MultibandChain m, m1, m2;
+        VectorChain v;
+        typedef CoupledIteratorType<3, Multiband<double>, int>::type Iterator;
+        Iterator i = createCoupledIterator(data.multiband(), labels);
+        extractFeatures(i, i.getEndIterator(), m);
+        extractFeatures(vectors, labels, v);
+
+        MultiArrayIndex split = 10;
+        Iterator i1 = createCoupledIterator(data.subarray(Shape3(0), Shape3(split, 17, bands)).multiband(),
+                                            labels.subarray(Shape2(0), Shape2(split, 17)));
+        Iterator i2 = createCoupledIterator(data.subarray(Shape3(split, 0, 0), Shape3(23, 17, bands)).multiband(),
+                                            labels.subarray(Shape2(split, 0), Shape2(23, 17)));
+        m1.setMaxRegionLabel(2);
+        m2.setMaxRegionLabel(2);
+        extractFeatures(i1, i1.getEndIterator(), m1);
+        extractFeatures(i2, i2.getEndIterator(), m2);
+        m1.merge(m2);
+
+        for(int k=0; k<3; ++k)
+        {
+            Matrix<double> const & expected = get<Covariance>(v, k);
+            Matrix<double> const & covariance = get<Covariance>(m, k);
+            Matrix<double> const & merged = get<Covariance>(m1, k);
+            shouldEqual(covariance.shape(), expected.shape());
+            shouldEqualSequenceTolerance(covariance.begin(), covariance.end(), expected.begin(), 1e-10);
+            shouldEqualSequenceTolerance(merged.begin(), merged.end(), expected.begin(), 1e-10);
+            MultiArray<1, double> const & principal = get<Principal<Variance> >(m, k);
+            shouldEqualSequenceTolerance(principal.begin(), principal.end(),
+                                         get<Principal<Variance> >(v, k).begin(), 1e-10);
+        }
+        Matrix<double> const & global = get<Global<Covariance> >(m);
+        shouldEqualSequenceTolerance(global.begin(), global.end(), get<Global<Covariance> >(v).begin(), 1e-10);
+
+        // reading the result in between must not change the final result
+        AccumulatorChain<MultiArrayView<1, double, StridedArrayTag>, Select<Covariance> > a;
+        AccumulatorChain<TinyVector<double, bands>, Select<Covariance> > b;
+        for(int x=0; x<23; ++x)
+        {
+            MultiArrayView<1, double, StridedArrayTag> sample = data.bindInner(Shape2(x, 0));
+            a(sample);
+            b(vectors(x, 0));
+            if(x == 4 || x == 11)
+                should(get<Covariance>(a).shape() == get<Covariance>(b).shape());
+        }
+        shouldEqualSequenceTolerance(get<Covariance>(a).begin(), get<Covariance>(a).end(),
+                                     get<Covariance>(b).begin(), 1e-10);
+
+        // get<>() adds pending samples to a copy, flush() to the accumulator itself
+        should(getAccumulator<FlatScatterMatrix>(a).batch_.size() > 0);
+        MultiArray<1, double> pending(get<FlatScatterMatrix>(a));
+        a.flush();
+        should(getAccumulator<FlatScatterMatrix>(a).batch_.size() == 0);
+        MultiArray<1, double> flushed(get<FlatScatterMatrix>(a));
+        shouldEqualSequence(pending.begin(), pending.end(), flushed.begin());
+
+        // zero and negative weights take the per-sample update (negative weights
+        // only once the weight sum is positive, see FlatScatterMatrix::compute())
+        MultiArray<2, double> weights(Shape2(23, 17));
+        for(int y=0; y<17; ++y)
+            for(int x=0; x<23; ++x)
+                weights(x, y) = (x > 0 && x < 10)         ? 0.0
+                              : (x >= 10 && (x + y) % 6 == 0) ? -0.25
+                                                             : 1.0 + 0.1*x;
+        AccumulatorChain<CoupledArrays<3, Multiband<double>, double>,
+                         Select<DataArg<1>, WeightArg<2>, Weighted<Covariance> > > mw;
+        AccumulatorChain<CoupledArrays<2, TinyVector<double, bands>, double>,
+                         Select<DataArg<1>, WeightArg<2>, Weighted<Covariance> > > vw;
+        typedef CoupledIteratorType<3, Multiband<double>, double>::type WeightedIterator;
+        WeightedIterator iw = createCoupledIterator(data.multiband(), weights);
+        extractFeatures(iw, iw.getEndIterator(), mw);
+        extractFeatures(vectors, weights, vw);
+        Matrix<double> const & weighted = get<Weighted<Covariance> >(mw);
+        for(MultiArrayIndex k=0; k<weighted.size(); ++k)
+            should(!std::isnan(weighted[k]));
+        shouldEqualSequenceTolerance(weighted.begin(), weighted.end(),
+                                     get<Weighted<Covariance> >(vw).begin(), 1e-10);
+    }
 };
 
 struct FeaturesTestSuite : public vigra::test_suite
@@ -1506,6 +2244,13 @@ struct FeaturesTestSuite : public vigra::test_suite
         add(testCase(&AccumulatorTest::testHistogram));
         add(testCase(&AccumulatorTest::testRegionAccumulators));
         add(testCase(&AccumulatorTest::testIndexSpecifiers));
+        add(testCase(&AccumulatorTest::testParallelExtraction));
+        add(testCase(&AccumulatorTest::testChunkedExtraction));
+        add(testCase(&AccumulatorTest::testSparseRegions));
+        add(testCase(&AccumulatorTest::testSoARegionStatistics));
+        add(testCase(&AccumulatorTest::testIncrementalFeatures));
+        add(testCase(&AccumulatorTest::testTDigest));
+        add(testCase(&AccumulatorTest::testMultibandScatterMatrix));
     }
 };
 
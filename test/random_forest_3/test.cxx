@@ -35,13 +35,45 @@
 #include <vigra/unittest.hxx>
 #include <vigra/random_forest_3.hxx>
 #include <vigra/random.hxx>
+#include <vigra/random_forest_3_binary_impex.hxx>
+#include <vigra/random_forest_3_out_of_core.hxx>
 #ifdef HasHDF5
     #include <vigra/random_forest_3_hdf5_impex.hxx>
 #endif
 
+#include <cstring>
+#include <sstream>
+
 using namespace vigra;
 using namespace vigra::rf3;
 
+// Records which instances are in-bag for every tree.
+class InBagRecorder : public RFVisitorBase
+{
+public:
+
+    template <typename TREE, typename FEATURES, typename LABELS, typename WEIGHTS>
+    void visit_before_tree(TREE &, FEATURES &, LABELS &, WEIGHTS & weights)
+    {
+        is_in_bag_.resize(weights.size());
+        for (size_t i = 0; i < weights.size(); ++i)
+            is_in_bag_[i] = weights[i] != 0;
+    }
+
+    template <typename VISITORS, typename RF, typename FEATURES, typename LABELS>
+    void visit_after_training(VISITORS & visitors, RF &, const FEATURES &, const LABELS &)
+    {
+        in_bag_.clear();
+        for (auto vptr : visitors)
+            in_bag_.push_back(vptr->is_in_bag_);
+    }
+
+    std::vector<std::vector<bool> > in_bag_; // in_bag_[tree][instance]
+
+private:
+    std::vector<bool> is_in_bag_;
+};
+
 struct RandomForestTests
 {
     void test_base_class()
@@ -206,6 +238,387 @@ struct RandomForestTests
         }
     }
 
+    void test_binary_impex()
+    {
+        typedef MultiArray<2, float> Features;
+        typedef MultiArray<1, int> Labels;
+
+        // Create a (noisy) 4x4 chessboard with three classes.
+        size_t const nx = 40;
+        size_t const ny = 40;
+        RandomNumberGenerator<MersenneTwister> rand;
+        Features train_x(Shape2(nx*ny, 3));
+        Labels train_y(Shape1(nx*ny));
+        for (size_t y = 0; y < ny; ++y)
+        {
+            for (size_t x = 0; x < nx; ++x)
+            {
+                train_x(y*nx+x, 0) = x + 2*rand.uniform()-1;
+                train_x(y*nx+x, 1) = y + 2*rand.uniform()-1;
+                train_x(y*nx+x, 2) = rand.uniform();
+                train_y(y*nx+x) = ((x/10+y/10) % 3) * 5 - 3;
+            }
+        }
+
+        RandomForestOptions const options = RandomForestOptions()
+                                                   .tree_count(10)
+                                                   .n_threads(1);
+        auto rf = random_forest(train_x, train_y, options);
+        random_forest_export_binary(rf, "rf_out.rf3");
+
+        // The mapped forest must predict exactly like the original one.
+        auto flat_rf = random_forest_map_binary<Features, Labels>("rf_out.rf3");
+        shouldEqual(flat_rf.num_trees(), rf.num_trees());
+        shouldEqual(flat_rf.num_nodes(), rf.num_nodes());
+        shouldEqual(flat_rf.num_classes(), rf.num_classes());
+        shouldEqual(flat_rf.num_features(), rf.num_features());
+        should(flat_rf.problem_spec() == rf.problem_spec_);
+
+        MultiArray<2, double> probs(Shape2(nx*ny, rf.num_classes()));
+        MultiArray<2, double> flat_probs(probs.shape());
+        rf.predict_probabilities(train_x, probs, 1);
+        flat_rf.predict_probabilities(train_x, flat_probs, 2);
+        shouldEqualSequence(probs.begin(), probs.end(), flat_probs.begin());
+
+        Labels pred_y(train_y.shape());
+        Labels flat_pred_y(train_y.shape());
+        rf.predict(train_x, pred_y, 1);
+        flat_rf.predict(train_x, flat_pred_y, 2);
+        shouldEqualSequence(pred_y.begin(), pred_y.end(), flat_pred_y.begin());
+
+        MultiArray<2, Int64> ids(Shape2(nx*ny, rf.num_trees()));
+        MultiArray<2, Int64> flat_ids(ids.shape());
+        double const comparisons = rf.leaf_ids(train_x, ids, 1);
+        double const flat_comparisons = flat_rf.leaf_ids(train_x, flat_ids, 2);
+        shouldEqualSequence(ids.begin(), ids.end(), flat_ids.begin());
+        shouldEqualTolerance(comparisons, flat_comparisons, 1e-10);
+
+        // Predicting with a subset of the trees.
+        std::vector<size_t> tree_indices;
+        tree_indices.push_back(7);
+        tree_indices.push_back(2);
+        rf.predict_probabilities(train_x, probs, 1, tree_indices);
+        flat_rf.predict_probabilities(train_x, flat_probs, 1, tree_indices);
+        shouldEqualSequence(probs.begin(), probs.end(), flat_probs.begin());
+
+        // Converting back gives a forest with the same predictions.
+        auto rf2 = random_forest_import_binary<Features, Labels>("rf_out.rf3");
+        shouldEqual(rf2.num_nodes(), rf.num_nodes());
+        rf2.predict(train_x, flat_pred_y, 1);
+        shouldEqualSequence(pred_y.begin(), pred_y.end(), flat_pred_y.begin());
+
+        // The label type must match the stored one.
+        try
+        {
+            random_forest_map_binary<Features, MultiArray<1, double> >("rf_out.rf3");
+            failTest("random_forest_map_binary(): no exception thrown for wrong label type.");
+        }
+        catch (PreconditionViolation &)
+        {}
+
+        // Corrupt data must be rejected when loading.
+        std::ostringstream stream;
+        random_forest_serialize_binary(rf, stream);
+        std::string const bytes = stream.str();
+        std::vector<UInt64> buffer((bytes.size() + 7) / 8);
+        typedef FlatRandomForest<Features, Labels> FlatRF;
+        for (int c = 0; c < 6; ++c)
+        {
+            std::memcpy(buffer.data(), bytes.data(), bytes.size());
+            rf3::detail::RF3FlatHeader & header = *reinterpret_cast<rf3::detail::RF3FlatHeader *>(buffer.data());
+            rf3::detail::RF3FlatNode * nodes = reinterpret_cast<rf3::detail::RF3FlatNode *>(
+                                              reinterpret_cast<char *>(buffer.data()) + header.nodes_offset_);
+            size_t inner = 0;
+            while (nodes[inner].dim_ == rf3::detail::rf3_flat_leaf_tag)
+                ++inner;
+            size_t leaf = 0;
+            while (nodes[leaf].dim_ != rf3::detail::rf3_flat_leaf_tag)
+                ++leaf;
+            switch (c)
+            {
+                case 0: header.num_nodes_ += 1000; break;                        // nodes beyond the data
+                case 1: header.classes_offset_ = header.total_size_ + 8; break;  // section beyond the data
+                case 2: nodes[inner].child_ = header.num_nodes_; break;          // child out of range
+                case 3: nodes[inner].child_ = inner; break;                      // cycle
+                case 4: nodes[inner].dim_ = header.num_features_; break;         // split feature out of range
+                case 5: nodes[leaf].child_ = header.num_leaves_; break;          // response out of range
+            }
+            try
+            {
+                FlatRF flat(buffer.data(), bytes.size());
+                failTest("FlatRandomForest(): no exception thrown for corrupt data.");
+            }
+            catch (PreconditionViolation &)
+            {}
+        }
+        // The unmodified data still loads, truncated data does not.
+        std::memcpy(buffer.data(), bytes.data(), bytes.size());
+        FlatRF intact(buffer.data(), bytes.size());
+        shouldEqual(intact.num_nodes(), rf.num_nodes());
+        try
+        {
+            FlatRF truncated(buffer.data(), bytes.size() - 8);
+            failTest("FlatRandomForest(): no exception thrown for truncated data.");
+        }
+        catch (PreconditionViolation &)
+        {}
+    }
+
+    void test_out_of_core()
+    {
+        // Create a (noisy) 4x4 chessboard and store it in a compressed chunked array.
+        size_t const nx = 100;
+        size_t const ny = 100;
+        RandomNumberGenerator<MersenneTwister> rand;
+        MultiArray<2, double> train_x(Shape2(nx*ny, 3));
+        MultiArray<1, int> train_y(Shape1(nx*ny));
+        for (size_t y = 0; y < ny; ++y)
+        {
+            for (size_t x = 0; x < nx; ++x)
+            {
+                train_x(y*nx+x, 0) = x + 2*rand.uniform()-1;
+                train_x(y*nx+x, 1) = y + 2*rand.uniform()-1;
+                train_x(y*nx+x, 2) = rand.uniform();
+                train_y(y*nx+x) = ((x/25+y/25) % 2) * 3 + 1;
+            }
+        }
+        ChunkedArrayCompressed<2, double> chunked_x(train_x.shape(), Shape2(256, 4));
+        chunked_x.commitSubarray(Shape2(), train_x);
+
+        MultiArray<2, double> rows(Shape2(3, 3));
+        std::vector<size_t> row_indices = { 5, 300, 301 };
+        rf3::detail::load_feature_rows(chunked_x, row_indices.begin(), row_indices.end(), rows);
+        for (size_t k = 0; k < row_indices.size(); ++k)
+            shouldEqualSequence(rows.bindInner(k).begin(), rows.bindInner(k).end(),
+                                train_x.bindInner(row_indices[k]).begin());
+
+        // The result must not depend on the number of threads.
+        RandomForestOptions options = RandomForestOptions()
+                                             .tree_count(10)
+                                             .bootstrap_sample_size(2000)
+                                             .n_threads(1);
+        RandomNumberGenerator<MersenneTwister> rand1(42);
+        auto rf1 = random_forest_out_of_core(chunked_x, train_y, options, rand1);
+        options.n_threads(3);
+        RandomNumberGenerator<MersenneTwister> rand2(42);
+        auto rf2 = random_forest_out_of_core(chunked_x, train_y, options, rand2);
+        shouldEqual(rf1.num_trees(), 10);
+        shouldEqual(rf1.num_nodes(), rf2.num_nodes());
+        shouldEqual(rf1.problem_spec_.actual_msample_, 2000);
+
+        // As in the out-of-core version, the sample size only applies to bootstrap sampling.
+        auto rf_all = random_forest(train_x, train_y, RandomForestOptions()
+                                                          .tree_count(2)
+                                                          .bootstrap_sample_size(2000)
+                                                          .bootstrap_sampling(false)
+                                                          .n_threads(1));
+        shouldEqual(rf_all.problem_spec_.actual_msample_, nx*ny);
+
+        MultiArray<2, double> probs1(Shape2(nx*ny, 2));
+        MultiArray<2, double> probs2(probs1.shape());
+        rf1.predict_probabilities(train_x, probs1, 1);
+        rf2.predict_probabilities(train_x, probs2, 1);
+        shouldEqualSequence(probs1.begin(), probs1.end(), probs2.begin());
+
+        MultiArray<1, int> pred_y(train_y.shape());
+        rf1.predict(train_x, pred_y, 1);
+        size_t errors = 0;
+        for (size_t i = 0; i < nx*ny; ++i)
+            if (pred_y(i) != train_y(i))
+                ++errors;
+        should(errors < nx*ny / 20);
+    }
+
+    void test_update()
+    {
+        // Create a (noisy) 4x4 chessboard, the first instances form the initial training set.
+        size_t const nx = 100;
+        size_t const ny = 100;
+        size_t const n_old = nx*ny/2;
+        RandomNumberGenerator<MersenneTwister> rand;
+        MultiArray<2, double> train_x(Shape2(nx*ny, 2));
+        MultiArray<1, int> train_y(Shape1(nx*ny));
+        for (size_t y = 0; y < ny; ++y)
+        {
+            for (size_t x = 0; x < nx; ++x)
+            {
+                train_x(y*nx+x, 0) = x + 2*rand.uniform()-1;
+                train_x(y*nx+x, 1) = y + 2*rand.uniform()-1;
+                train_y(y*nx+x) = (x/25+y/25) % 2;
+            }
+        }
+        MultiArray<2, double> old_x(train_x.subarray(Shape2(0, 0), Shape2(n_old, 2)));
+        MultiArray<1, int> old_y(train_y.subarray(Shape1(0), Shape1(n_old)));
+
+        RandomForestOptions const options = RandomForestOptions()
+                                                   .tree_count(10)
+                                                   .n_threads(1);
+        RandomNumberGenerator<MersenneTwister> randengine(42);
+        auto rf = random_forest(old_x, old_y, options, RFStopVisiting(), randengine);
+
+        // A sub forest predicts like the selected trees of the original one.
+        std::vector<size_t> tree_indices = { 1, 4, 5 };
+        auto sub_rf = rf.sub_forest(tree_indices);
+        shouldEqual(sub_rf.num_trees(), 3);
+        MultiArray<2, double> probs(Shape2(nx*ny, 2));
+        MultiArray<2, double> sub_probs(probs.shape());
+        rf.predict_probabilities(train_x, probs, 1, tree_indices);
+        sub_rf.predict_probabilities(train_x, sub_probs, 1);
+        shouldEqualSequence(probs.begin(), probs.end(), sub_probs.begin());
+
+        // The old trees have never seen the upper half of the board.
+        std::vector<size_t> new_instances(nx*ny - n_old);
+        std::iota(new_instances.begin(), new_instances.end(), n_old);
+        auto count_errors = [&](RandomForest<MultiArray<2, double>, MultiArray<1, int> > const & forest)
+        {
+            MultiArray<1, int> pred_y(train_y.shape());
+            forest.predict(train_x, pred_y, 1);
+            size_t errors = 0;
+            for (auto i : new_instances)
+                if (pred_y(i) != train_y(i))
+                    ++errors;
+            return errors;
+        };
+        size_t const errors_before = count_errors(rf);
+
+        auto const old_rf = rf;
+        auto const replaced = random_forest_update(rf, train_x, train_y, new_instances, 6, randengine);
+        shouldEqual(replaced.size(), 6);
+        shouldEqual(rf.num_trees(), 10);
+        shouldEqual(rf.problem_spec_.num_instances_, nx*ny);
+        should(count_errors(rf) < errors_before);
+
+        // The remaining trees are unchanged and come first.
+        std::vector<size_t> kept;
+        for (size_t t = 0; t < 10; ++t)
+            if (std::find(replaced.begin(), replaced.end(), t) == replaced.end())
+                kept.push_back(t);
+        std::vector<size_t> first_trees = { 0, 1, 2, 3 };
+        old_rf.predict_probabilities(train_x, probs, 1, kept);
+        rf.predict_probabilities(train_x, sub_probs, 1, first_trees);
+        shouldEqualSequence(probs.begin(), probs.end(), sub_probs.begin());
+
+        // A new class requires training of all trees.
+        train_y(0) = 2;
+        auto const all_replaced = random_forest_update(rf, train_x, train_y, std::vector<size_t>(1, 0), 2, randengine);
+        shouldEqual(all_replaced.size(), 10);
+        shouldEqual(rf.num_classes(), 3);
+    }
+
+    void test_proximities()
+    {
+        // Create a (noisy) 4x4 chessboard.
+        size_t const nx = 20;
+        size_t const ny = 20;
+        size_t const n = nx*ny;
+        RandomNumberGenerator<MersenneTwister> rand;
+        MultiArray<2, double> train_x(Shape2(n, 2));
+        MultiArray<1, int> train_y(Shape1(n), 0);
+        for (size_t y = 0; y < ny; ++y)
+        {
+            for (size_t x = 0; x < nx; ++x)
+            {
+                train_x(y*nx+x, 0) = x + 2*rand.uniform()-1;
+                train_x(y*nx+x, 1) = y + 2*rand.uniform()-1;
+                train_y(y*nx+x) = (x/5+y/5) % 2;
+            }
+        }
+
+        OOBProximities oob_prox(10, 2);
+        InBagRecorder in_bag;
+        RandomForestOptions const options = RandomForestOptions()
+                                                   .tree_count(20)
+                                                   .max_depth(4)
+                                                   .n_threads(1);
+        auto rf = random_forest(train_x, train_y, options, create_visitor(oob_prox, in_bag));
+
+        // Compare with the brute force computation.
+        MultiArray<2, Int64> ids(Shape2(n, rf.num_trees()));
+        rf.leaf_ids(train_x, ids, 1);
+        MultiArray<2, double> prox(Shape2(n, n), 0.0);
+        for (size_t i = 0; i < n; ++i)
+            for (size_t j = 0; j < n; ++j)
+                for (size_t t = 0; t < rf.num_trees(); ++t)
+                    if (ids(i, t) == ids(j, t))
+                        prox(i, j) += 1.0 / rf.num_trees();
+
+        auto const all = random_forest_proximities(rf, train_x, n, 2);
+        shouldEqual(all.num_instances(), n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = 0; j < n; ++j)
+                shouldEqualTolerance(all(i, j), prox(i, j), 1e-12);
+            for (size_t k = 0; k+1 < all.num_neighbors(i); ++k)
+                should(all.neighbor(i, k) < all.neighbor(i, k+1));
+        }
+
+        // max_neighbors is limited by the number of other instances.
+        auto const unlimited = leaf_id_proximities(ids, (size_t)1 << 40, 2);
+        for (size_t i = 0; i < n; ++i)
+            shouldEqual(unlimited.num_neighbors(i), all.num_neighbors(i));
+
+        // Only the largest proximities are kept.
+        auto const sparse = leaf_id_proximities(ids, 5, 3);
+        for (size_t i = 0; i < n; ++i)
+        {
+            shouldEqual(sparse.num_neighbors(i), std::min<size_t>(5, all.num_neighbors(i)));
+            std::vector<double> row(prox.template bind<0>(i).begin(), prox.template bind<0>(i).end());
+            row.erase(row.begin() + i);
+            std::sort(row.begin(), row.end(), std::greater<double>());
+            double smallest = 1.0;
+            for (size_t k = 0; k < sparse.num_neighbors(i); ++k)
+            {
+                shouldEqualTolerance(sparse.proximity(i, k), prox(i, sparse.neighbor(i, k)), 1e-12);
+                smallest = std::min(smallest, sparse.proximity(i, k));
+            }
+            if (sparse.num_neighbors(i) > 0)
+                shouldEqualTolerance(smallest, row[sparse.num_neighbors(i)-1], 1e-12);
+        }
+
+        // The out-of-bag proximities are normalized by the number of common out-of-bag trees.
+        // Compare with the brute force computation.
+        shouldEqual(in_bag.in_bag_.size(), rf.num_trees());
+        MultiArray<2, double> oob_prox_ref(Shape2(n, n), 0.0);
+        for (size_t i = 0; i < n; ++i)
+        {
+            for (size_t j = 0; j < n; ++j)
+            {
+                if (i == j)
+                    continue;
+                size_t common = 0, same = 0;
+                for (size_t t = 0; t < rf.num_trees(); ++t)
+                {
+                    if (in_bag.in_bag_[t][i] || in_bag.in_bag_[t][j])
+                        continue;
+                    ++common;
+                    if (ids(i, t) == ids(j, t))
+                        ++same;
+                }
+                if (same > 0)
+                    oob_prox_ref(i, j) = (double)same / common;
+            }
+        }
+        auto const & oob = oob_prox.proximities_;
+        shouldEqual(oob.num_instances(), n);
+        for (size_t i = 0; i < n; ++i)
+        {
+            std::vector<double> row;
+            for (size_t j = 0; j < n; ++j)
+                if (oob_prox_ref(i, j) > 0.0)
+                    row.push_back(oob_prox_ref(i, j));
+            std::sort(row.begin(), row.end(), std::greater<double>());
+            shouldEqual(oob.num_neighbors(i), std::min<size_t>(10, row.size()));
+            double smallest = 1.0;
+            for (size_t k = 0; k < oob.num_neighbors(i); ++k)
+            {
+                shouldEqualTolerance(oob.proximity(i, k), oob_prox_ref(i, oob.neighbor(i, k)), 1e-12);
+                smallest = std::min(smallest, oob.proximity(i, k));
+            }
+            if (oob.num_neighbors(i) > 0)
+                shouldEqualTolerance(smallest, row[oob.num_neighbors(i)-1], 1e-12);
+        }
+    }
+
 #ifdef HasHDF5
     void test_import()
     {
@@ -252,8 +665,18 @@ struct RandomForestTests
         auto rf = random_forest_import_HDF5<Features, Labels>(infile);
 
         // Save the dummy random forest.
-        HDF5File outfile("data/rf_out.h5", HDF5File::New);
-        random_forest_export_HDF5(rf, outfile);
+        rf.options_.bootstrap_sample_size(300);
+        {
+            HDF5File outfile("data/rf_out.h5", HDF5File::New);
+            random_forest_export_HDF5(rf, outfile);
+        }
+
+        // The options survive the round trip.
+        HDF5File reloaded_file("data/rf_out.h5", HDF5File::ReadOnly);
+        auto reloaded = random_forest_import_HDF5<Features, Labels>(reloaded_file);
+        shouldEqual(reloaded.options_.bootstrap_sample_size_, 300);
+        shouldEqual(reloaded.options_.bootstrap_sampling_, rf.options_.bootstrap_sampling_);
+        shouldEqual(reloaded.num_trees(), rf.num_trees());
     }
 #endif
 };
@@ -268,6 +691,10 @@ struct RandomForestTestSuite : public test_suite
         add(testCase(&RandomForestTests::test_default_rf));
         add(testCase(&RandomForestTests::test_oob_visitor));
         add(testCase(&RandomForestTests::test_var_importance_visitor));
+        add(testCase(&RandomForestTests::test_binary_impex));
+        add(testCase(&RandomForestTests::test_out_of_core));
+        add(testCase(&RandomForestTests::test_update));
+        add(testCase(&RandomForestTests::test_proximities));
 #ifdef HasHDF5
         add(testCase(&RandomForestTests::test_import));
         add(testCase(&RandomForestTests::test_export));
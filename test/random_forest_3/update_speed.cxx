@@ -0,0 +1,109 @@
+/************************************************************************/
+/*                                                                      */
+/*        Copyright 2014-2015 by Ullrich Koethe and Philip Schill       */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+// Measures the latency of rf3::random_forest_update() compared to training
+// the whole forest again, as it occurs in interactive labeling: the user adds
+// a few labels at a time and expects an updated prediction immediately.
+
+//We need to undefine NDEBUG so that we have TIC, TOC available!
+#undef NDEBUG
+
+#include <iostream>
+#include <vigra/timing.hxx>
+USETICTOC;
+#include <vigra/random_forest_3.hxx>
+#include <vigra/random.hxx>
+
+using namespace vigra;
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    typedef MultiArray<2, float> Features;
+    typedef MultiArray<1, int> Labels;
+
+    size_t const num_instances = 10000;
+    size_t const num_features = 30;
+    size_t const tree_count = 100;
+    size_t const labels_per_update = 10;
+    size_t const num_updates = 5;
+
+    // Three classes, separated by a few of the features plus noise.
+    RandomNumberGenerator<MersenneTwister> random(1);
+    Features features(Shape2(num_instances, num_features));
+    Labels labels(Shape1(num_instances), 0);
+    for (size_t i = 0; i < num_instances; ++i)
+    {
+        for (size_t j = 0; j < num_features; ++j)
+            features(i, j) = random.uniform();
+        double const v = features(i, 0) + features(i, 1) - features(i, 2) + 0.2*random.normal();
+        labels(i) = v < 0.3 ? 0 : (v < 0.9 ? 1 : 2);
+    }
+
+    rf3::RandomForestOptions const options = rf3::RandomForestOptions()
+                                                    .tree_count(tree_count)
+                                                    .n_threads(1);
+    size_t n = num_instances - labels_per_update*num_updates;
+    Features train_x(features.subarray(Shape2(0, 0), Shape2(n, num_features)));
+    Labels train_y(labels.subarray(Shape1(0), Shape1(n)));
+
+    std::cerr << "Training " << tree_count << " trees on " << n << " instances:" << std::endl;
+    TIC;
+    auto rf = rf3::random_forest(train_x, train_y, options, rf3::RFStopVisiting(), random);
+    double const full_time = TOCN;
+    std::cerr << "    " << full_time << " msec" << std::endl;
+
+    size_t const replace_counts[] = { 1, 5, 10 };
+    for (auto replace_count : replace_counts)
+    {
+        auto updated_rf = rf;
+        size_t m = n;
+        double update_time = 0.0;
+        for (size_t u = 0; u < num_updates; ++u, m += labels_per_update)
+        {
+            Features x(features.subarray(Shape2(0, 0), Shape2(m + labels_per_update, num_features)));
+            Labels y(labels.subarray(Shape1(0), Shape1(m + labels_per_update)));
+            std::vector<size_t> new_instances(labels_per_update);
+            std::iota(new_instances.begin(), new_instances.end(), m);
+            TIC;
+            rf3::random_forest_update(updated_rf, x, y, new_instances, replace_count, random);
+            update_time += TOCN;
+        }
+        std::cerr << "Update replacing " << replace_count << " trees per " << labels_per_update
+                  << " new labels:" << std::endl;
+        std::cerr << "    " << update_time / num_updates << " msec per update ("
+                  << full_time * num_updates / update_time << "x faster than training)" << std::endl;
+    }
+    return 0;
+}
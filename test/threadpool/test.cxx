@@ -37,6 +37,8 @@
 #include <vigra/threading.hxx>
 #include <vigra/threadpool.hxx>
 #include <vigra/timing.hxx>
+#include <vigra/union_find.hxx>
+#include <vigra/random.hxx>
 #include <numeric>
 
 using namespace vigra;
@@ -231,6 +233,67 @@ struct ThreadPoolTests
         size_t const sum = std::accumulate(results.begin(), results.end(), 0);
         shouldEqual(sum, n);
     }
+
+    void test_concurrent_union_find()
+    {
+        size_t const n = 100000;
+        size_t const n_unions = 3*n/4;
+
+        // short-range unions create long chains that are merged from many threads at once
+        RandomMT19937 random(42);
+        std::vector<std::pair<UInt32, UInt32> > unions(n_unions);
+        for (size_t k = 0; k < n_unions; ++k)
+        {
+            UInt32 u = random.uniformInt(n);
+            UInt32 v = (k % 4 == 0)
+                          ? random.uniformInt(n)
+                          : (UInt32)std::min<size_t>(n-1, u + 1 + random.uniformInt(8));
+            unions[k] = std::make_pair(u, v);
+        }
+
+        UnionFindArray<UInt32> sequential(n);
+        for (size_t k = 0; k < n_unions; ++k)
+            sequential.makeUnion(unions[k].first, unions[k].second);
+        UInt32 sequential_count = sequential.makeContiguous();
+
+        size_t const n_threads[] = { 1, 2, 8, 32 };
+        for (int t = 0; t < 4; ++t)
+        {
+            for (int repetition = 0; repetition < 5; ++repetition)
+            {
+                ConcurrentUnionFindArray<UInt32> concurrent(n);
+                ThreadPool pool(n_threads[t]);
+                size_t const chunk = (n_unions + n_threads[t] - 1) / n_threads[t];
+                for (size_t begin = 0; begin < n_unions; begin += chunk)
+                {
+                    pool.enqueue(
+                        [&concurrent, &unions, begin, chunk, n_unions](size_t /*thread_id*/)
+                        {
+                            size_t end = std::min(begin + chunk, n_unions);
+                            for (size_t k = begin; k < end; ++k)
+                                concurrent.makeUnion(unions[k].first, unions[k].second);
+                        }
+                    );
+                }
+                pool.waitFinished();
+
+                // roots are the smallest set members, so the numbering must agree exactly
+                shouldEqual(concurrent.makeContiguous(), sequential_count);
+                for (UInt32 k = 0; k < n; ++k)
+                    if (concurrent.findLabel(k) != sequential.findLabel(k))
+                        shouldEqual(concurrent.findLabel(k), sequential.findLabel(k));
+            }
+        }
+
+        ConcurrentUnionFindArray<UInt32> empty;
+        try
+        {
+            empty.makeContiguous();
+            failTest("no exception thrown");
+        }
+        catch (PreconditionViolation &)
+        {}
+    }
 };
 
 struct ThreadPoolTestSuite : public test_suite
@@ -244,6 +307,7 @@ struct ThreadPoolTestSuite : public test_suite
         add(testCase(&ThreadPoolTests::test_parallel_foreach));
         add(testCase(&ThreadPoolTests::test_parallel_foreach_exception));
         add(testCase(&ThreadPoolTests::test_parallel_foreach_sum_serial));
+        add(testCase(&ThreadPoolTests::test_concurrent_union_find));
 #if !defined(USE_BOOST_THREAD) || \
     defined(BOOST_THREAD_PROVIDES_VARIADIC_THREAD)
         add(testCase(&ThreadPoolTests::test_parallel_foreach_sum));
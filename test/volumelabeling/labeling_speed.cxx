@@ -0,0 +1,101 @@
+/************************************************************************/
+/*                                                                      */
+/*               Copyright 2011-2016 by Ullrich Koethe                  */
+/*                                                                      */
+/*    This file is part of the VIGRA computer vision library.           */
+/*    The VIGRA Website is                                              */
+/*        http://hci.iwr.uni-heidelberg.de/vigra/                       */
+/*    Please direct questions, bug reports, and contributions to        */
+/*        ullrich.koethe@iwr.uni-heidelberg.de    or                    */
+/*        vigra@informatik.uni-hamburg.de                               */
+/*                                                                      */
+/*    Permission is hereby granted, free of charge, to any person       */
+/*    obtaining a copy of this software and associated documentation    */
+/*    files (the "Software"), to deal in the Software without           */
+/*    restriction, including without limitation the rights to use,      */
+/*    copy, modify, merge, publish, distribute, sublicense, and/or      */
+/*    sell copies of the Software, and to permit persons to whom the    */
+/*    Software is furnished to do so, subject to the following          */
+/*    conditions:                                                       */
+/*                                                                      */
+/*    The above copyright notice and this permission notice shall be    */
+/*    included in all copies or substantial portions of the             */
+/*    Software.                                                         */
+/*                                                                      */
+/*    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND    */
+/*    EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES   */
+/*    OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND          */
+/*    NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT       */
+/*    HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY,      */
+/*    WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING      */
+/*    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR     */
+/*    OTHER DEALINGS IN THE SOFTWARE.                                   */
+/*                                                                      */
+/************************************************************************/
+
+// Compares the run time of the decision-tree raster scan used by labelMultiArray()
+// for 2D and 3D arrays with the generic GridGraph-based labeling.
+
+//We need to undefine NDEBUG so that we have TIC, TOC available!
+#undef NDEBUG
+
+#include <iostream>
+#include <vigra/timing.hxx>
+USETICTOC;
+#include <vigra/multi_array.hxx>
+#include <vigra/multi_labeling.hxx>
+#include <vigra/random.hxx>
+
+using namespace vigra;
+
+template <unsigned int N>
+void compare(MultiArrayView<N, UInt8> const & data, NeighborhoodType neighborhood,
+             LabelOptions options, char const * name)
+{
+    MultiArray<N, UInt32> scan(data.shape()), graph(data.shape());
+
+    options.neighborhood(neighborhood);
+    TIC;
+    UInt32 count = labelMultiArray(data, graph, LabelOptions(options).useScan(false));
+    double const graph_time = TOCN;
+    TIC;
+    labelMultiArray(data, scan, options);
+    double const scan_time = TOCN;
+
+    std::cerr << "    " << name << (neighborhood == DirectNeighborhood ? ", direct:   " : ", indirect: ")
+              << count << " regions, GridGraph " << graph_time << " msec, scan "
+              << scan_time << " msec (" << graph_time / scan_time << "x faster)" << std::endl;
+    vigra_invariant(scan == graph, "labeling_speed: results differ.");
+}
+
+template <unsigned int N>
+void run(typename MultiArrayShape<N>::type const & shape)
+{
+    RandomNumberGenerator<MersenneTwister> random(1);
+    MultiArray<N, UInt8> binary(shape), multi(shape);
+
+    // random binary mask with 30% foreground and random data with four values
+    for(auto i = binary.begin(); i != binary.end(); ++i)
+    {
+        *i = random.uniform() < 0.3 ? 1 : 0;
+    }
+    for(auto i = multi.begin(); i != multi.end(); ++i)
+    {
+        *i = (UInt8)random.uniformInt(4);
+    }
+
+    std::cerr << "Labeling a " << shape << " array:" << std::endl;
+    NeighborhoodType neighborhoods[] = { DirectNeighborhood, IndirectNeighborhood };
+    for(int k = 0; k < 2; ++k)
+    {
+        compare(binary, neighborhoods[k], LabelOptions().ignoreBackgroundValue(UInt8(0)), "binary       ");
+        compare(multi,  neighborhoods[k], LabelOptions(), "four values  ");
+    }
+}
+
+int main(int /*argc*/, char ** /*argv*/)
+{
+    run<2>(Shape2(2000, 2000));
+    run<3>(Shape3(200, 200, 200));
+    return 0;
+}
@@ -40,6 +40,7 @@
 
 #include "vigra/labelvolume.hxx"
 #include "vigra/multi_labeling.hxx"
+#include "vigra/random.hxx"
 
 using namespace vigra;
 
@@ -457,6 +458,69 @@ struct VolumeLabelingTest
         shouldEqualSequence(res.begin(), res.end(), out6);
     }
 
+    template <unsigned int N>
+    void checkScanLabeling(MultiArrayView<N, int> const & data)
+    {
+        NeighborhoodType neighborhoods[] = { DirectNeighborhood, IndirectNeighborhood };
+
+        for(int k = 0; k < 2; ++k)
+        {
+            MultiArray<N, unsigned int> scan(data.shape()), graph(data.shape());
+
+            int count = labelMultiArray(data, scan, LabelOptions().neighborhood(neighborhoods[k]));
+            shouldEqual(count, (int)labelMultiArray(data, graph,
+                                    LabelOptions().neighborhood(neighborhoods[k]).useScan(false)));
+            should(scan == graph);
+
+            count = labelMultiArrayWithBackground(data, scan, neighborhoods[k], 0);
+            shouldEqual(count, (int)labelMultiArray(data, graph,
+                                    LabelOptions().neighborhood(neighborhoods[k])
+                                                  .ignoreBackgroundValue(0).useScan(false)));
+            should(scan == graph);
+
+            // strided views take the same code path
+            MultiArray<N, unsigned int> transposed(reverse(data.shape()));
+            count = labelMultiArray(data.transpose(), transposed, neighborhoods[k]);
+            shouldEqual(count, (int)labelMultiArray(data.transpose(), graph.transpose(),
+                                    LabelOptions().neighborhood(neighborhoods[k]).useScan(false)));
+            should(transposed == graph.transpose());
+        }
+    }
+
+    void labelingScanTest()
+    {
+        RandomMT19937 random(42);
+
+        MultiArray<2, int> image(Shape2(37, 29));
+        MultiArray<3, int> volume(Shape3(17, 13, 11));
+        for(int values = 2; values <= 4; ++values)
+        {
+            for(auto & v : image)
+                v = random.uniformInt(values);
+            checkScanLabeling(image);
+
+            for(auto & v : volume)
+                v = random.uniformInt(values);
+            checkScanLabeling(volume);
+        }
+
+        // degenerate shapes
+        MultiArray<2, int> line(Shape2(1, 20));
+        for(auto & v : line)
+            v = random.uniformInt(2);
+        checkScanLabeling(line);
+        checkScanLabeling(MultiArray<3, int>(Shape3(1, 1, 1)));
+
+        // the scan reproduces the labels of the generic algorithm on the test volumes
+        IntVolume res(vol6.shape());
+        should(2 == labelMultiArray(vol6, res, LabelOptions().ignoreBackgroundValue(0.0)));
+        IntVolume res2(vol3.shape());
+        should(5 == labelMultiArray(vol3, res2, LabelOptions().useScan(false)));
+        IntVolume res3(vol3.shape());
+        should(5 == labelMultiArray(vol3, res3, LabelOptions()));
+        should(res2 == res3);
+    }
+
     IntVolume vol1, vol2, vol3;
     DoubleVolume vol4, vol5, vol6;
 };
@@ -479,6 +543,7 @@ struct VolumeLabelingTestSuite
         add( testCase( &VolumeLabelingTest::labelingTwentySixTest3));
         add( testCase( &VolumeLabelingTest::labelingTwentySixWithBackgroundTest1));
         add( testCase( &VolumeLabelingTest::labelingAllTest));
+        add( testCase( &VolumeLabelingTest::labelingScanTest));
     }
 };
 
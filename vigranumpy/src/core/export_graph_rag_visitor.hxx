@@ -685,7 +685,7 @@ public:
                 // set n_bins = ceil( n_values**1./2.5 ) , clipped to [2,64]
                 // turned out to be suitable empirically 
                 // see https://github.com/consti123/quantile_tests
-                size_t n_bins = std::pow( affiliatedEdges.size(), 1. / 2.5); 
+                size_t n_bins = std::pow( affEdges.size(), 1. / 2.5); 
                 n_bins = std::max( n_bins_min, std::min(n_bins, n_bins_max) );
                 a.setHistogramOptions(HistogramOptions().setBinCount(n_bins));
                 
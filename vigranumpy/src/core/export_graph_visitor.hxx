@@ -577,10 +577,11 @@ public:
         NumpyArray<1,UInt32> edgeIds  =(NumpyArray<1,UInt32>())
     ){
         edgeIds.reshapeIfEmpty(typename NumpyArray<1,index_type>::difference_type(edges.shape(0)));
-        for(MultiArrayIndex i=0; i<edges.shape(0); ++i){
-            const Edge e = self.addEdge(edges(i,0),edges(i,1));
-            edgeIds(i)=self.id(e);
-        }
+        // sort and insert all edges at once instead of calling addEdge() per row
+        std::vector<TinyVector<index_type, 2> > pairs(edges.shape(0));
+        for(MultiArrayIndex i=0; i<edges.shape(0); ++i)
+            pairs[i] = TinyVector<index_type, 2>(edges(i,0), edges(i,1));
+        self.addEdges(pairs.begin(), pairs.end(), edgeIds.begin());
         return edgeIds;
     }
 };
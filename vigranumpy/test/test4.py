@@ -264,6 +264,26 @@ class TestGraph(object):
 
         assert np.array_equal(findEdges,edgeIds)
 
+    def testAddEdgesSelfLoops(self):
+        IV = vigraph.INVALID
+        elist = [
+            [1,3],
+            [2,2],
+            [3,1],
+            [3,4]
+        ]
+        edges = np.array(elist,dtype=np.uint32)
+
+        g = vigraph.listGraph()
+        edgeIds = g.addEdges(edges)
+
+        # self loops get a valid edge, as with addEdge()
+        assert g.edgeNum == 3
+        assert edgeIds[0] == edgeIds[2]
+        for eId in edgeIds :
+            assert g.edgeFromId(int(eId))!=IV
+        assert g.nodeFromId(2)!=IV
+
     def testIters(self):
         g  = vigraph.listGraph()
         